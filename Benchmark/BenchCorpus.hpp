@@ -0,0 +1,74 @@
+#pragma once
+#include <string>
+#include <random>
+#include <iterator>
+
+// Generates a script in the style of our generated bundles: many small functions with
+// declarations, control flow, calls, comments and string literals.
+// docLines adds a block of prose comments and string tables before every function.
+static std::string GenerateScript(size_t targetBytes, int docLines = 0, unsigned seed = 42) {
+	static const char* names[] = { "count", "index", "total", "value", "buffer_size", "left", "right", "node_id" };
+	std::mt19937 rng(seed);
+	auto pick = [&](int n) { return static_cast<int>(rng() % n); };
+	std::string out;
+	out.reserve(targetBytes + 1024);
+	int func = 0;
+	while (out.size() < targetBytes) {
+		for (int i = 0; i < docLines; i++) {
+			out += "// Computes the weighted total for step " + std::to_string(i) + ", see the design notes for the derivation.\n";
+		}
+		if (docLines > 0) {
+			out += "let string help_" + std::to_string(func) + " = \"usage: compute <a> <b> <scale>, prints the weighted result of every step\";\n";
+		}
+		out += "// generated function number " + std::to_string(func) + "\n";
+		out += "function int compute_" + std::to_string(func++) + "(int a, int b, double scale) {\n";
+		out += "    let int " + std::string(names[pick(8)]) + " = a * " + std::to_string(pick(1000)) + " + b;\n";
+		out += "    let double ratio = scale / 3.25 + 0.5;\n";
+		out += "    let string label = \"result of step " + std::to_string(pick(100)) + "\\n\";\n";
+		out += "    for (let int i = 0; i < " + std::to_string(pick(64)) + "; i++) {\n";
+		out += "        if (a >= i && (b % 3) != 0 || scale < 1.0) {\n";
+		out += "            a += (b << 2) - (i >> 1) ^ 7;\n";
+		out += "        } else {\n";
+		out += "            b -= a / (i + 1);\n";
+		out += "        }\n";
+		out += "    }\n";
+		out += "    print(label, " + std::string(names[pick(8)]) + ", ratio);\n";
+		out += "    return a + b;\n";
+		out += "}\n\n";
+	}
+	return out;
+}
+
+// Generates declarations whose initializers are random binary expression trees over every
+// precedence level, with unary operators, calls and parentheses mixed in.
+static std::string GenerateExpressions(size_t targetBytes, int depth = 5, unsigned seed = 7) {
+	static const char* ops[] = { "||", "&&", "|", "^", "&", "==", "!=", "<", ">", "<=", ">=",
+		"<<", ">>", "+", "-", "*", "/", "%" };
+	static const char* operands[] = { "a", "b", "count", "-x", "!flag", "f(a, 2)", "v[i]", "p.x", "42", "3.5" };
+	const int opCount = static_cast<int>(std::size(ops)), operandCount = static_cast<int>(std::size(operands));
+	std::mt19937 rng(seed);
+	auto pick = [&](int n) { return static_cast<int>(rng() % n); };
+	std::string out;
+	out.reserve(targetBytes + 1024);
+	auto expression = [&](auto& self, int level) -> void {
+		if (level == 0 || pick(4) == 0) {
+			out += operands[pick(operandCount)];
+			return;
+		}
+		bool paren = pick(5) == 0;
+		if (paren) out += '(';
+		self(self, level - 1);
+		out += ' ';
+		out += ops[pick(opCount)];
+		out += ' ';
+		self(self, level - 1);
+		if (paren) out += ')';
+	};
+	int index = 0;
+	while (out.size() < targetBytes) {
+		out += "let int e_" + std::to_string(index++) + " = ";
+		expression(expression, depth);
+		out += ";\n";
+	}
+	return out;
+}
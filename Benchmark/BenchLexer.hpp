@@ -0,0 +1,70 @@
+#pragma once
+#include "benchmark/benchmark.h"
+#include "BenchCorpus.hpp"
+#include <Lexer.h>
+#include <LexerScan.h>
+#include <TokenStream.h>
+#include <sstream>
+
+using namespace CppInterp;
+
+// range(0): corpus size in MiB, range(1): comment lines per function, range(2): LexerScan fast paths on/off
+static void BM_LexerTokenize(benchmark::State& state) {
+	const std::string source = GenerateScript(static_cast<size_t>(state.range(0)) << 20, static_cast<int>(state.range(1)));
+	auto& lexer = Lexer::Instance();
+	size_t tokenCount = 0, tokenBytes = 0;
+	for (auto _ : state) {
+		// what Tokenize(source) does, with the scan mode of this run
+		LexContext context;
+		context.m_fastScan = state.range(2) != 0;
+		TokenList tokens;
+		lexer.TokenizeChunk(context, source, true, tokens);
+		tokenCount = tokens.size();
+		tokenBytes = tokens.MemoryUsage();
+		benchmark::DoNotOptimize(tokens.Types());
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+	state.counters["tokens"] = static_cast<double>(tokenCount);
+	state.counters["tokenBytes"] = static_cast<double>(tokenBytes);
+	state.SetLabel(state.range(2) ? LexerScan::GetInstructionSet() : "byte-at-a-time");
+}
+BENCHMARK(BM_LexerTokenize)
+	->ArgNames({ "MiB", "docLines", "fastScan" })
+	->ArgsProduct({ { 1, 8 }, { 0, 6 }, { 0, 1 } })
+	->Unit(benchmark::kMillisecond);
+
+// range(0): corpus size in MiB, tokens are pulled from an istream in DefaultChunkSize chunks
+static void BM_TokenStream(benchmark::State& state) {
+	const std::string source = GenerateScript(static_cast<size_t>(state.range(0)) << 20);
+	size_t tokenCount = 0;
+	for (auto _ : state) {
+		std::istringstream input(source);
+		TokenStream stream(input);
+		Token token;
+		tokenCount = 0;
+		while (stream.Next(token))
+			++tokenCount;
+		benchmark::DoNotOptimize(token);
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+	state.counters["tokens"] = static_cast<double>(tokenCount);
+}
+BENCHMARK(BM_TokenStream)->ArgName("MiB")->Arg(8)->Unit(benchmark::kMillisecond);
+
+// range(0): worker threads, the 32 MiB corpus is cut into one chunk per thread
+static void BM_LexerTokenizeParallel(benchmark::State& state) {
+	const std::string source = GenerateScript(size_t(32) << 20);
+	const size_t threadCount = static_cast<size_t>(state.range(0));
+	ThreadPool pool(threadCount);
+	auto& lexer = Lexer::Instance();
+	for (auto _ : state) {
+		auto tokens = lexer.Tokenize(source, pool, threadCount);
+		benchmark::DoNotOptimize(tokens.Types());
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+}
+BENCHMARK(BM_LexerTokenizeParallel)
+	->ArgName("threads")
+	->RangeMultiplier(2)->Range(1, 16)
+	->UseRealTime()
+	->Unit(benchmark::kMillisecond);
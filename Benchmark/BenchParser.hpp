@@ -0,0 +1,259 @@
+#pragma once
+#include "benchmark/benchmark.h"
+#include "BenchCorpus.hpp"
+#include <Parser.h>
+#include <FlatAst.h>
+#include <AstCache.h>
+#include <filesystem>
+
+using namespace CppInterp;
+
+// about one million tokens of generated script, lexed and parsed from a string
+static void BM_ParserParse(benchmark::State& state) {
+	const std::string source = GenerateScript(size_t(3800) << 10);
+	Parser parser;
+	size_t nodeCount = 0, arenaBytes = 0;
+	for (auto _ : state) {
+		AstNode* root = parser.Parse(source);
+		nodeCount = parser.GetNodeCount();
+		arenaBytes = parser.GetArena().GetBytesUsed();
+		benchmark::DoNotOptimize(root);
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+	state.counters["nodes"] = static_cast<double>(nodeCount);
+	state.counters["arenaBytes"] = static_cast<double>(arenaBytes);
+}
+BENCHMARK(BM_ParserParse)->Unit(benchmark::kMillisecond);
+
+// range(0): corpus size in MiB of declarations initialized with deep binary expressions
+// range(0): worker threads, lexing and parsing both cut the source into one chunk per thread
+static void BM_ParserParseParallel(benchmark::State& state) {
+	const std::string source = GenerateScript(size_t(3800) << 10);
+	const size_t threadCount = static_cast<size_t>(state.range(0));
+	ThreadPool pool(threadCount);
+	Parser parser;
+	for (auto _ : state) {
+		AstNode* root = parser.Parse(source, pool, threadCount);
+		benchmark::DoNotOptimize(root);
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+	state.counters["nodes"] = static_cast<double>(parser.GetNodeCount());
+}
+BENCHMARK(BM_ParserParseParallel)
+	->ArgName("threads")
+	->RangeMultiplier(2)->Range(1, 8)
+	->UseRealTime()
+	->Unit(benchmark::kMillisecond);
+
+// range(0): percent of the function bodies used after a lazy parse, 100 with eager parsing for reference
+static void BM_ParserLazyBodies(benchmark::State& state) {
+	const std::string source = GenerateScript(size_t(3800) << 10);
+	const int64_t used = state.range(0);
+	const bool lazy = used < 100;
+	Parser parser;
+	parser.SetLazyBodies(lazy);
+	for (auto _ : state) {
+		auto* program = static_cast<ProgramNode*>(parser.Parse(source));
+		int64_t function = 0;
+		for (AstNode* item : program->m_declarations) {
+			if (item->m_nodeType == NodeType::FUNCTION_DECL && function++ % 100 < used)
+				benchmark::DoNotOptimize(parser.ParseBody(*static_cast<FunctionDeclNode*>(item)));
+		}
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+	state.counters["nodes"] = static_cast<double>(parser.GetNodeCount());
+	state.counters["arenaBytes"] = static_cast<double>(parser.GetArena().GetBytesUsed());
+	state.SetLabel(lazy ? "lazy" : "eager");
+}
+BENCHMARK(BM_ParserLazyBodies)->ArgName("usedPercent")->Arg(0)->Arg(10)->Arg(50)->Arg(100)->Unit(benchmark::kMillisecond);
+
+// Many small sources, as an editor service sees them: a new parser for each one against one parser
+// that is reused and keeps its buffers.
+static void BM_ParserSnippets(benchmark::State& state) {
+	std::vector<std::string> snippets;
+	for (int i = 0; i < 1000; i++) {
+		snippets.push_back("function int f" + std::to_string(i) + "(int a, int b) {\n\tlet int c = a * " +
+			std::to_string(i) + " + b;\n\tif (c > 10) { return c - 1; }\n\treturn c;\n}\n");
+	}
+	const bool reuse = state.range(0) != 0;
+	Parser reused;
+	for (auto _ : state) {
+		for (const std::string& snippet : snippets) {
+			if (reuse) {
+				benchmark::DoNotOptimize(reused.Parse(snippet));
+			}
+			else {
+				Parser parser;
+				benchmark::DoNotOptimize(parser.Parse(snippet));
+			}
+		}
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * snippets.size()));
+	state.SetLabel(reuse ? "reused" : "fresh");
+}
+BENCHMARK(BM_ParserSnippets)->ArgName("reuse")->DenseRange(0, 1)->Unit(benchmark::kMillisecond);
+
+static void BM_ParserExpressions(benchmark::State& state) {
+	const std::string source = GenerateExpressions(static_cast<size_t>(state.range(0)) << 20);
+	Parser parser;
+	size_t nodeCount = 0;
+	for (auto _ : state) {
+		AstNode* root = parser.Parse(source);
+		nodeCount = parser.GetNodeCount();
+		benchmark::DoNotOptimize(root);
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+	state.counters["nodes"] = static_cast<double>(nodeCount);
+}
+BENCHMARK(BM_ParserExpressions)->ArgName("MiB")->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond);
+
+// Sums the symbols of every identifier, the traversal a name resolution pass starts from
+class SymbolSumVisitor : public AstVisitor {
+public:
+	uint64_t m_sum = 0;
+
+	void Walk(AstNode* node) { if (node) node->Accept(*this); }
+	template <typename List>
+	void WalkList(const List& list) { for (auto* node : list) Walk(node); }
+
+	void Visit(ProgramNode& node) override { WalkList(node.m_declarations); }
+	void Visit(ImportNode&) override {}
+	void Visit(FunctionDeclNode& node) override { Walk(node.m_returnType); Walk(node.m_name); Walk(node.m_body); WalkList(node.m_params); }
+	void Visit(CompoundStmtNode& node) override { WalkList(node.m_statements); }
+	void Visit(ExpressionStmtNode& node) override { Walk(node.m_expression); }
+	void Visit(VariableDeclNode& node) override { Walk(node.m_type); WalkList(node.m_declarators); }
+	void Visit(StructDeclNode& node) override { Walk(node.m_name); WalkList(node.m_members); }
+	void Visit(IfStmtNode& node) override { Walk(node.m_condition); Walk(node.m_thenStmt); Walk(node.m_elseStmt); }
+	void Visit(SwitchStmtNode& node) override { Walk(node.m_condition); Walk(node.m_default); WalkList(node.m_cases); }
+	void Visit(CaseNode& node) override { Walk(node.m_literal); WalkList(node.m_statements); }
+	void Visit(DefaultNode& node) override { WalkList(node.m_statements); }
+	void Visit(WhileStmtNode& node) override { Walk(node.m_condition); Walk(node.m_body); }
+	void Visit(ForStmtNode& node) override { Walk(node.m_init); Walk(node.m_condition); Walk(node.m_increment); Walk(node.m_body); }
+	void Visit(ReturnStmtNode& node) override { Walk(node.m_expression); }
+	void Visit(BreakStmtNode&) override {}
+	void Visit(ContinueStmtNode&) override {}
+	void Visit(CommaExprNode& node) override { WalkList(node.m_expressions); }
+	void Visit(AssignmentExprNode& node) override { Walk(node.m_left); Walk(node.m_right); }
+	void Visit(ConditionalExprNode& node) override { Walk(node.m_condition); Walk(node.m_trueExpr); Walk(node.m_falseExpr); }
+	void Visit(BinaryExprNode& node) override { Walk(node.m_left); Walk(node.m_right); }
+	void Visit(UnaryExprNode& node) override { Walk(node.m_operand); }
+	void Visit(PostfixExprNode& node) override { Walk(node.m_primary); }
+	void Visit(FunctionCallNode& node) override { Walk(node.m_callee); WalkList(node.m_arguments); }
+	void Visit(ArrayIndexNode& node) override { Walk(node.m_array); Walk(node.m_index); }
+	void Visit(MemberAccessNode& node) override { Walk(node.m_object); Walk(node.m_memberName); }
+	void Visit(FunctionLiteralNode& node) override { Walk(node.m_returnType); Walk(node.m_body); WalkList(node.m_params); }
+	void Visit(IdentifierNode& node) override { m_sum += node.m_symbol; }
+	void Visit(LiteralNode&) override {}
+	void Visit(ParameterNode& node) override { Walk(node.m_type); Walk(node.m_declarator); }
+	void Visit(DeclaratorNode& node) override { Walk(node.m_name); Walk(node.m_initializer); WalkList(node.m_arraySizes); }
+	void Visit(StructMemberNode& node) override { Walk(node.m_type); WalkList(node.m_declarators); }
+	void Visit(InitializerNode& node) override { WalkList(node.m_values); }
+	void Visit(BuiltinTypeNode&) override {}
+	void Visit(NamedTypeNode&) override {}
+	void Visit(FunctionTypeNode& node) override { Walk(node.m_returnType); WalkList(node.m_paramTypes); }
+};
+
+struct FlatSymbolSum {
+	uint64_t m_sum = 0;
+	bool Enter(const FlatAst& ast, FlatAst::NodeIndex node) {
+		if (ast.Kind(node) == NodeType::IDENTIFIER)
+			m_sum += ast.Symbol(node);
+		return true;
+	}
+};
+
+// range(0): 0 walks the pointer tree through AstVisitor, 1 walks the FlatAst copy of it,
+// 2 scans the FlatAst rows in index order as passes that ignore the structure can
+static void BM_AstTraversal(benchmark::State& state) {
+	const std::string source = GenerateScript(size_t(3800) << 10);
+	Parser parser;
+	AstNode* root = parser.Parse(source);
+	FlatAst flat = FlatAst::FromTree(root);
+	for (auto _ : state) {
+		uint64_t sum;
+		if (state.range(0) == 0) {
+			SymbolSumVisitor visitor;
+			visitor.Walk(root);
+			sum = visitor.m_sum;
+		}
+		else if (state.range(0) == 1) {
+			FlatSymbolSum visitor;
+			flat.Walk(visitor);
+			sum = visitor.m_sum;
+		}
+		else {
+			sum = 0;
+			for (FlatAst::NodeIndex node = 0; node < flat.Size(); node++)
+				if (flat.Kind(node) == NodeType::IDENTIFIER)
+					sum += flat.Symbol(node);
+		}
+		benchmark::DoNotOptimize(sum);
+	}
+	state.counters["nodes"] = static_cast<double>(flat.Size());
+	state.counters["treeBytes"] = static_cast<double>(state.range(0) == 0 ? parser.GetArena().GetBytesUsed() : flat.MemoryUsage());
+	static const char* labels[] = { "pointer", "flat walk", "flat scan" };
+	state.SetLabel(labels[state.range(0)]);
+}
+BENCHMARK(BM_AstTraversal)->ArgName("mode")->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+
+static void BM_FlatAstConvert(benchmark::State& state) {
+	const std::string source = GenerateScript(size_t(3800) << 10);
+	Parser parser;
+	AstNode* root = parser.Parse(source);
+	for (auto _ : state) {
+		FlatAst flat = FlatAst::FromTree(root);
+		benchmark::DoNotOptimize(flat.Size());
+	}
+}
+BENCHMARK(BM_FlatAstConvert)->Unit(benchmark::kMillisecond);
+
+// One keystroke in the middle of a ~50k line script, typed and then taken back: mode 0 edits
+// inside a line, mode 1 inserts a line break, mode 2 is the full parse an editor would do instead.
+static void BM_ParserReparse(benchmark::State& state) {
+	std::string source = GenerateScript(size_t(2) << 20);
+	const size_t offset = source.find("^ 7;", source.size() / 2) + 2;
+	const std::string_view text = state.range(0) == 1 ? "\n" : "1";
+	Parser parser;
+	parser.Parse(source);
+	size_t incremental = 0, edits = 0;
+	for (auto _ : state) {
+		if (state.range(0) == 2) {
+			benchmark::DoNotOptimize(parser.Parse(source));
+			continue;
+		}
+		benchmark::DoNotOptimize(parser.Reparse({ offset, 0, text }));
+		incremental += parser.LastReparseIncremental();
+		benchmark::DoNotOptimize(parser.Reparse({ offset, text.size(), "" }));
+		incremental += parser.LastReparseIncremental();
+		// replaced blocks stay in the arena until the next full parse
+		if (++edits % 4096 == 0) {
+			state.PauseTiming();
+			parser.Parse(source);
+			state.ResumeTiming();
+		}
+	}
+	static const char* labels[] = { "keystroke", "newline", "full parse" };
+	state.SetLabel(labels[state.range(0)]);
+	state.counters["lines"] = static_cast<double>(std::count(source.begin(), source.end(), '\n'));
+	if (edits > 0)
+		state.counters["incremental"] = static_cast<double>(incremental) / (2.0 * edits);
+}
+BENCHMARK(BM_ParserReparse)->ArgName("mode")->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+
+// range(0): 0 parses the 3.8 MiB script, 1 loads its tree from a warm AstCache instead
+static void BM_ParserCached(benchmark::State& state) {
+	const std::string source = GenerateScript(size_t(3800) << 10);
+	auto directory = std::filesystem::temp_directory_path() / "cppinterp_bench_cache";
+	AstCache cache(directory);
+	Parser parser;
+	parser.Parse(source, cache);
+	for (auto _ : state) {
+		AstNode* root = state.range(0) ? parser.Parse(source, cache) : parser.Parse(source);
+		benchmark::DoNotOptimize(root);
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+	state.counters["entryBytes"] = static_cast<double>(std::filesystem::file_size(cache.EntryPath(AstCache::Hash(source))));
+	state.SetLabel(state.range(0) ? (parser.LastParseCached() ? "cache hit" : "cache miss") : "parse");
+	std::filesystem::remove_all(directory);
+}
+BENCHMARK(BM_ParserCached)->ArgName("cached")->DenseRange(0, 1)->Unit(benchmark::kMillisecond);
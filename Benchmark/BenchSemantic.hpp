@@ -0,0 +1,58 @@
+#pragma once
+#include "benchmark/benchmark.h"
+#include "BenchCorpus.hpp"
+#include <Parser.h>
+#include <SemanticAnalyzer.h>
+
+using namespace CppInterp;
+
+// checks the parsed ~4 MiB script, the tree is parsed once outside the loop
+static void BM_SemanticAnalyze(benchmark::State& state) {
+	const std::string source = GenerateScript(size_t(3800) << 10);
+	Parser parser;
+	AstNode* root = parser.Parse(source);
+	SemanticAnalyzer analyzer;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(analyzer.Analyze(root));
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+	state.counters["nodes"] = static_cast<double>(parser.GetNodeCount());
+	state.counters["types"] = static_cast<double>(analyzer.GetTypes().Size());
+	state.counters["diagnostics"] = static_cast<double>(analyzer.GetDiagnostics().size());
+}
+BENCHMARK(BM_SemanticAnalyze)->Unit(benchmark::kMillisecond);
+
+// range(0): worker threads, the function bodies are checked in one run per thread
+static void BM_SemanticAnalyzeParallel(benchmark::State& state) {
+	const std::string source = GenerateScript(size_t(3800) << 10);
+	const size_t threadCount = static_cast<size_t>(state.range(0));
+	ThreadPool pool(threadCount);
+	Parser parser;
+	AstNode* root = parser.Parse(source);
+	SemanticAnalyzer analyzer;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(analyzer.Analyze(root, pool, threadCount));
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * source.size()));
+	state.counters["diagnostics"] = static_cast<double>(analyzer.GetDiagnostics().size());
+}
+BENCHMARK(BM_SemanticAnalyzeParallel)
+	->ArgName("threads")
+	->RangeMultiplier(2)->Range(1, 8)
+	->UseRealTime()
+	->Unit(benchmark::kMillisecond);
+
+// one function body of the corpus marked as edited and checked again, against BM_SemanticAnalyze
+static void BM_SemanticReanalyze(benchmark::State& state) {
+	const std::string source = GenerateScript(size_t(3800) << 10);
+	Parser parser;
+	auto* program = static_cast<ProgramNode*>(parser.Parse(source));
+	SemanticAnalyzer analyzer;
+	analyzer.Analyze(program);
+	AstNode* changed[] = { program->m_declarations[program->m_declarations.size() / 2] };
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(analyzer.Reanalyze(program, changed));
+	}
+	state.counters["checked"] = static_cast<double>(analyzer.GetLastCheckedCount());
+}
+BENCHMARK(BM_SemanticReanalyze)->Unit(benchmark::kMicrosecond);
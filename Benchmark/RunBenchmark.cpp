@@ -0,0 +1,6 @@
+#include "benchmark/benchmark.h"
+#include "BenchLexer.hpp"
+#include "BenchParser.hpp"
+#include "BenchSemantic.hpp"
+
+BENCHMARK_MAIN();
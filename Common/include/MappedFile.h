@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <stdexcept>
+
+// Read-only memory mapping of a whole file, the view stays valid until the object is closed or destroyed
+class MappedFile
+{
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string &path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    void Open(const std::string &path);
+
+    void Close();
+
+    inline const char *Data() const noexcept { return m_data; }
+    inline size_t Size() const noexcept { return m_size; }
+    inline std::string_view View() const noexcept { return std::string_view(m_data, m_size); }
+    inline bool IsOpen() const noexcept { return m_open; }
+
+private:
+    void Swap(MappedFile &other) noexcept;
+
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+    bool m_open = false;
+#ifdef _WIN32
+    // HANDLEs of the file and its mapping, opaque so that includers do not get <windows.h>
+    void *m_file = nullptr;
+    void *m_mapping = nullptr;
+#endif
+};
@@ -1,5 +1,13 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
 
 template <typename T, typename = void>
 struct HasSerialize : std::false_type
@@ -57,6 +65,17 @@ inline constexpr bool IsMapContainerV = IsMapContainer<T>::value;
 template <typename T>
 inline constexpr bool IsContainerV = IsContainer<T>::value;
 
+template <typename T>
+struct IsTuple : std::false_type
+{
+};
+
+template <typename... Ts>
+struct IsTuple<std::tuple<Ts...>> : std::true_type
+{
+};
+
+// Tie() returns a std::tuple of references to the members, a const overload is needed to serialize
 template <typename T, typename = void>
 struct HasTie : std::false_type
 {
@@ -64,9 +83,7 @@ struct HasTie : std::false_type
 
 template <typename T>
 struct HasTie<T, std::void_t<decltype(std::declval<T>().Tie())>>
-	: std::bool_constant<std::is_base_of_v<
-		  std::tuple<>,
-		  std::remove_cv_t<std::remove_reference_t<decltype(std::declval<T>().Tie())>>>>
+	: IsTuple<std::remove_cv_t<std::remove_reference_t<decltype(std::declval<T>().Tie())>>>
 {
 };
 
@@ -166,15 +183,27 @@ inline std::enable_if_t<std::is_unsigned_v<T>, void> SerializeVariant(T data, st
 template <typename T>
 inline std::enable_if_t<std::is_unsigned_v<T>, void> DeserializeVariant(T &data, const std::vector<char> &buffer, size_t &offset)
 {
-	data = 0;
-	int shift = 0;
-	while (buffer.size() >= offset + 1)
+	// locals instead of the references, so the loop does not write through them every byte
+	const char *ptr = buffer.data() + offset;
+	const char *end = buffer.data() + buffer.size();
+	if (ptr < end && !(*ptr & 0x80))
 	{
-		uint8_t byte = buffer[offset++];
-		data |= (byte & 0x7F) << shift;
+		// most values fit in one byte
+		data = static_cast<T>(*ptr);
+		++offset;
+		return;
+	}
+	T value = 0;
+	for (int shift = 0; ptr < end && shift < static_cast<int>(sizeof(T) * 8); shift += 7)
+	{
+		uint8_t byte = static_cast<uint8_t>(*ptr++);
+		value |= static_cast<T>(byte & 0x7F) << shift;
 		if (!(byte & 0x80))
+		{
+			data = value;
+			offset = ptr - buffer.data();
 			return;
-		shift += 7;
+		}
 	}
 	throw std::runtime_error("Unexpected end of buffer while decoding Varint");
 }
@@ -224,6 +253,34 @@ struct CanUseZigZag : std::bool_constant<
 template <typename T>
 inline constexpr bool CanUseZigZagV = CanUseZigZag<T>::value;
 
+template <typename Container, typename = void>
+struct HasResize : std::false_type
+{
+};
+
+template <typename Container>
+struct HasResize<Container, std::void_t<decltype(std::declval<Container>().resize(0))>> : std::true_type
+{
+};
+
+template <typename Container>
+inline constexpr bool HasResizeV = HasResize<Container>::value;
+
+// vectors and strings of bytes are copied as one block
+template <typename Container, typename = void>
+struct IsByteBlock : std::false_type
+{
+};
+
+template <typename Container>
+struct IsByteBlock<Container, std::void_t<decltype(std::declval<Container>().data()), decltype(std::declval<Container>().resize(0))>>
+	: std::bool_constant<sizeof(typename Container::value_type) == 1 && std::is_arithmetic_v<typename Container::value_type>>
+{
+};
+
+template <typename Container>
+inline constexpr bool IsByteBlockV = IsByteBlock<Container>::value;
+
 // Serializer
 class Serializer
 {
@@ -298,9 +355,21 @@ private:
 	SerializeImp(const Container &container, std::vector<char> &out)
 	{
 		SerializeVariant(container.size(), out);
-		for (const auto &item : container)
+		if constexpr (IsByteBlockV<Container>)
 		{
-			SerializeImp(item, out);
+			// an empty container may have no storage at all
+			if (!container.empty())
+			{
+				const char *ptr = reinterpret_cast<const char *>(container.data());
+				out.insert(out.end(), ptr, ptr + container.size());
+			}
+		}
+		else
+		{
+			for (const auto &item : container)
+			{
+				SerializeImp(item, out);
+			}
 		}
 	}
 
@@ -371,7 +440,37 @@ private:
 		size_t size;
 		DeserializeVariant(size, buffer, offset);
 		data.clear();
-		TryReserve(data, size);
+		if constexpr (IsByteBlockV<Container>)
+		{
+			if (size > buffer.size() - offset)
+			{
+				throw std::runtime_error("Buffer too small to deserialize byte block.");
+			}
+			data.resize(size);
+			// data() of an empty block may be null, which memcpy does not accept even for 0 bytes
+			if (size)
+			{
+				std::memcpy(data.data(), buffer.data() + offset, size);
+			}
+			offset += size;
+			return;
+		}
+		// every element takes at least a byte, a corrupt size must not reserve more than that
+		if constexpr (std::is_arithmetic_v<ValueType> && HasResizeV<Container>)
+		{
+			if (size > buffer.size() - offset)
+			{
+				throw std::runtime_error("Buffer too small to deserialize container.");
+			}
+			// numbers are decoded in place instead of appended one by one
+			data.resize(size);
+			for (auto &element : data)
+			{
+				DeSerializeImp(element, buffer, offset);
+			}
+			return;
+		}
+		TryReserve(data, std::min(size, buffer.size() - offset), 0);
 		if constexpr (IsMapContainerV<Container>)
 		{
 			for (size_t i = 0; i < size; ++i)
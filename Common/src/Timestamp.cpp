@@ -60,7 +60,11 @@ std::string Timestamp::ToString() const
     int microseconds = m_timestampMicroSeconds % 1000000;
 
     struct tm ptm;
+#ifdef _WIN32
     localtime_s(&ptm, &seconds);
+#else
+    localtime_r(&seconds, &ptm);
+#endif
     char buffer[128];
     snprintf(buffer, sizeof(buffer),
              "%4d-%02d-%02d %02d:%02d:%02d.%06d",
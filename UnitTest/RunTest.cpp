@@ -1,7 +1,8 @@
 #include <iostream>
 #include "gtest/gtest.h"
-//#include "TestLexer.hpp"
+#include "TestLexer.hpp"
 #include"TestParser.hpp"
+#include "TestSemantic.hpp"
 
 int main(int argc, char** argv)
 {
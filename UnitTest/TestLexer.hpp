@@ -1,5 +1,7 @@
 #include "gtest/gtest.h"
 #include <Lexer.h>
+#include <TokenStream.h>
+#include <sstream>
 
 using namespace CppInterp;
 
@@ -127,8 +129,8 @@ std::vector<MultiTokenCase> multiTokenCases = {
 	},
 	{
 		"char c='\\n'; string s=\"hello\\tworld\";",
-		{TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::CHARACTER_LITERAL, TokenType::SEMICOLON,
-		 TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::STRING_LITERAL, TokenType::SEMICOLON},
+		{TokenType::CHAR, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::CHARACTER_LITERAL, TokenType::SEMICOLON,
+		 TokenType::STRING, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::STRING_LITERAL, TokenType::SEMICOLON},
 		{"char", "c", "=", "'\n'", ";", "string", "s", "=", "\"hello\tworld\"", ";"}
 	},
 	{
@@ -150,8 +152,8 @@ std::vector<MultiTokenCase> multiTokenCases = {
 	},
 	{
 		"char c='a'; string s=\"hello\";",
-		{TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::CHARACTER_LITERAL, TokenType::SEMICOLON,
-		 TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::STRING_LITERAL, TokenType::SEMICOLON},
+		{TokenType::CHAR, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::CHARACTER_LITERAL, TokenType::SEMICOLON,
+		 TokenType::STRING, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::STRING_LITERAL, TokenType::SEMICOLON},
 		{"char", "c", "=", "'a'", ";", "string", "s", "=", "\"hello\"", ";"}
 	},
 	{
@@ -161,9 +163,9 @@ std::vector<MultiTokenCase> multiTokenCases = {
 	},
 	{
 		"if(a&&b||c){return;}",
-		{TokenType::IDENTIFIER, TokenType::LEFT_PAREN, TokenType::IDENTIFIER, TokenType::AND,
+		{TokenType::IF, TokenType::LEFT_PAREN, TokenType::IDENTIFIER, TokenType::AND,
 		 TokenType::IDENTIFIER, TokenType::OR, TokenType::IDENTIFIER, TokenType::RIGHT_PAREN,
-		 TokenType::LEFT_BRACE, TokenType::IDENTIFIER, TokenType::SEMICOLON, TokenType::RIGHT_BRACE},
+		 TokenType::LEFT_BRACE, TokenType::RETURN, TokenType::SEMICOLON, TokenType::RIGHT_BRACE},
 		{"if", "(", "a", "&&", "b", "||", "c", ")", "{", "return", ";", "}"}
 	},
 	{
@@ -228,13 +230,13 @@ std::vector<MultiTokenCase> complexTokenCases = {
 				return 0;
 			})",
 		{
-			TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::LEFT_PAREN, TokenType::RIGHT_PAREN, TokenType::LEFT_BRACE,
+			TokenType::INT, TokenType::IDENTIFIER, TokenType::LEFT_PAREN, TokenType::RIGHT_PAREN, TokenType::LEFT_BRACE,
 
-			TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::INT_LITERAL, TokenType::SEMICOLON,
-			TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::DOUBLE_LITERAL, TokenType::SEMICOLON,
-			TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::CHARACTER_LITERAL, TokenType::SEMICOLON,
-			TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::STRING_LITERAL, TokenType::SEMICOLON,
-			TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::IDENTIFIER, TokenType::SEMICOLON,
+			TokenType::INT, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::INT_LITERAL, TokenType::SEMICOLON,
+			TokenType::DOUBLE, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::DOUBLE_LITERAL, TokenType::SEMICOLON,
+			TokenType::CHAR, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::CHARACTER_LITERAL, TokenType::SEMICOLON,
+			TokenType::STRING, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::STRING_LITERAL, TokenType::SEMICOLON,
+			TokenType::BOOL, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::BOOL_LITERAL, TokenType::SEMICOLON,
 
 			TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::IDENTIFIER, TokenType::ADD,
 			TokenType::INT_LITERAL, TokenType::MULTIPLY, TokenType::LEFT_PAREN,
@@ -244,7 +246,7 @@ std::vector<MultiTokenCase> complexTokenCases = {
 			TokenType::IDENTIFIER, TokenType::SELF_ADD, TokenType::DOUBLE_LITERAL, TokenType::SEMICOLON,
 			TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::CHARACTER_LITERAL, TokenType::SEMICOLON,
 
-			TokenType::IDENTIFIER, TokenType::LEFT_PAREN,
+			TokenType::IF, TokenType::LEFT_PAREN,
 			TokenType::IDENTIFIER, TokenType::GREATER_EQUAL, TokenType::INT_LITERAL,
 			TokenType::AND, TokenType::IDENTIFIER, TokenType::OR,
 			TokenType::IDENTIFIER, TokenType::LESS, TokenType::DOUBLE_LITERAL,
@@ -252,15 +254,15 @@ std::vector<MultiTokenCase> complexTokenCases = {
 			TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::STRING_LITERAL, TokenType::ADD, TokenType::IDENTIFIER, TokenType::SEMICOLON,
 			TokenType::RIGHT_BRACE,
 
-			TokenType::IDENTIFIER, TokenType::LEFT_PAREN,
-			TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::INT_LITERAL, TokenType::SEMICOLON,
+			TokenType::FOR, TokenType::LEFT_PAREN,
+			TokenType::INT, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::INT_LITERAL, TokenType::SEMICOLON,
 			TokenType::IDENTIFIER, TokenType::LESS, TokenType::INT_LITERAL, TokenType::SEMICOLON,
 			TokenType::IDENTIFIER, TokenType::INCREMENT,
 			TokenType::RIGHT_PAREN, TokenType::LEFT_BRACE,
 
-			TokenType::IDENTIFIER, TokenType::LEFT_PAREN, TokenType::IDENTIFIER, TokenType::RIGHT_PAREN,
+			TokenType::WHILE, TokenType::LEFT_PAREN, TokenType::IDENTIFIER, TokenType::RIGHT_PAREN,
 			TokenType::LEFT_BRACE,
-			TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::IDENTIFIER, TokenType::SEMICOLON,
+			TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::BOOL_LITERAL, TokenType::SEMICOLON,
 			TokenType::RIGHT_BRACE,
 			TokenType::RIGHT_BRACE,
 
@@ -269,7 +271,7 @@ std::vector<MultiTokenCase> complexTokenCases = {
 			TokenType::IDENTIFIER, TokenType::COMMA, TokenType::IDENTIFIER,
 			TokenType::RIGHT_PAREN, TokenType::SEMICOLON,
 
-			TokenType::IDENTIFIER, TokenType::INT_LITERAL, TokenType::SEMICOLON,
+			TokenType::RETURN, TokenType::INT_LITERAL, TokenType::SEMICOLON,
 
 			TokenType::RIGHT_BRACE
 		},
@@ -327,40 +329,40 @@ std::vector<MultiTokenCase> complexTokenCases = {
             return sum;
         })",
 	{
-		TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::LEFT_BRACE,
-		TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::SEMICOLON,
-		TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::SEMICOLON,
+		TokenType::STRUCT, TokenType::IDENTIFIER, TokenType::LEFT_BRACE,
+		TokenType::INT, TokenType::IDENTIFIER, TokenType::SEMICOLON,
+		TokenType::INT, TokenType::IDENTIFIER, TokenType::SEMICOLON,
 		TokenType::RIGHT_BRACE, TokenType::SEMICOLON,
 
-		TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::LEFT_PAREN,
-		TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::COMMA,
-		TokenType::IDENTIFIER, TokenType::IDENTIFIER,
+		TokenType::INT, TokenType::IDENTIFIER, TokenType::LEFT_PAREN,
+		TokenType::INT, TokenType::IDENTIFIER, TokenType::COMMA,
+		TokenType::INT, TokenType::IDENTIFIER,
 		TokenType::RIGHT_PAREN, TokenType::LEFT_BRACE,
-		TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::ADD, TokenType::IDENTIFIER, TokenType::SEMICOLON,
+		TokenType::RETURN, TokenType::IDENTIFIER, TokenType::ADD, TokenType::IDENTIFIER, TokenType::SEMICOLON,
 		TokenType::RIGHT_BRACE,
 
-		TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::LEFT_PAREN, TokenType::RIGHT_PAREN,
+		TokenType::INT, TokenType::IDENTIFIER, TokenType::LEFT_PAREN, TokenType::RIGHT_PAREN,
 		TokenType::LEFT_BRACE,
 
 		TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::ASSIGN,
 		TokenType::LEFT_BRACE, TokenType::INT_LITERAL, TokenType::COMMA, TokenType::INT_LITERAL, TokenType::RIGHT_BRACE, TokenType::SEMICOLON,
 
-		TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::LEFT_SQUARE, TokenType::INT_LITERAL, TokenType::RIGHT_SQUARE,
+		TokenType::INT, TokenType::IDENTIFIER, TokenType::LEFT_SQUARE, TokenType::INT_LITERAL, TokenType::RIGHT_SQUARE,
 		TokenType::ASSIGN,
 		TokenType::LEFT_BRACE, TokenType::INT_LITERAL, TokenType::COMMA, TokenType::INT_LITERAL, TokenType::COMMA, TokenType::INT_LITERAL, TokenType::RIGHT_BRACE, TokenType::SEMICOLON,
 
-		TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::ASSIGN,
+		TokenType::INT, TokenType::IDENTIFIER, TokenType::ASSIGN,
 		TokenType::IDENTIFIER, TokenType::LEFT_PAREN,
 		TokenType::IDENTIFIER, TokenType::LEFT_SQUARE, TokenType::INT_LITERAL, TokenType::RIGHT_SQUARE, TokenType::COMMA,
 		TokenType::IDENTIFIER, TokenType::DOT, TokenType::IDENTIFIER, TokenType::ADD, TokenType::IDENTIFIER, TokenType::DOT, TokenType::IDENTIFIER,
 		TokenType::RIGHT_PAREN, TokenType::SEMICOLON,
 
-		TokenType::IDENTIFIER, TokenType::LEFT_PAREN,
+		TokenType::IF, TokenType::LEFT_PAREN,
 		TokenType::IDENTIFIER, TokenType::NOT_EQUAL, TokenType::INT_LITERAL,
 		TokenType::RIGHT_PAREN, TokenType::LEFT_BRACE,
 
-		TokenType::IDENTIFIER, TokenType::LEFT_PAREN,
-		TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::INT_LITERAL, TokenType::SEMICOLON,
+		TokenType::FOR, TokenType::LEFT_PAREN,
+		TokenType::INT, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::INT_LITERAL, TokenType::SEMICOLON,
 		TokenType::IDENTIFIER, TokenType::LESS, TokenType::INT_LITERAL, TokenType::SEMICOLON,
 		TokenType::IDENTIFIER, TokenType::INCREMENT,
 		TokenType::RIGHT_PAREN, TokenType::LEFT_BRACE,
@@ -370,7 +372,7 @@ std::vector<MultiTokenCase> complexTokenCases = {
 		TokenType::RIGHT_BRACE,
 		TokenType::RIGHT_BRACE,
 
-		TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::SEMICOLON,
+		TokenType::RETURN, TokenType::IDENTIFIER, TokenType::SEMICOLON,
 
 		TokenType::RIGHT_BRACE
 	},
@@ -425,8 +427,8 @@ std::vector<PositionTokenCase> positionTokenCases = {
     a = a + 1;
 })",
 		{
-			TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::LEFT_PAREN, TokenType::RIGHT_PAREN, TokenType::LEFT_BRACE,
-			TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::INT_LITERAL, TokenType::SEMICOLON,
+			TokenType::INT, TokenType::IDENTIFIER, TokenType::LEFT_PAREN, TokenType::RIGHT_PAREN, TokenType::LEFT_BRACE,
+			TokenType::INT, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::INT_LITERAL, TokenType::SEMICOLON,
 			TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::IDENTIFIER, TokenType::ADD, TokenType::INT_LITERAL, TokenType::SEMICOLON,
 			TokenType::RIGHT_BRACE
 		},
@@ -454,7 +456,7 @@ std::vector<PositionTokenCase> positionTokenCases = {
     float y = 3.14;
 		x = x + y;)",
 		{
-			TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::INT_LITERAL, TokenType::SEMICOLON,
+			TokenType::INT, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::INT_LITERAL, TokenType::SEMICOLON,
 			TokenType::IDENTIFIER, TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::DOUBLE_LITERAL, TokenType::SEMICOLON,
 			TokenType::IDENTIFIER, TokenType::ASSIGN, TokenType::IDENTIFIER, TokenType::ADD, TokenType::IDENTIFIER, TokenType::SEMICOLON
 		},
@@ -480,7 +482,7 @@ class LexerPositionTest : public ::testing::TestWithParam<PositionTokenCase> {};
 
 TEST_P(LexerPositionTest, HandlesTokenPositions) {
 	const auto& param = GetParam();
-	std::vector<Token> tokens = g_lexer.Tokenize(param.input);
+	TokenList tokens = g_lexer.Tokenize(param.input);
 
 	ASSERT_EQ(tokens.size(), param.expectedTypes.size())
 		<< "Token count mismatch for input: " << param.input;
@@ -535,3 +537,360 @@ TEST(LexerExceptionTest, InvalidEscape) {
 		FAIL() << "Expected LexerException, but caught unknown exception";
 	}
 }
+
+TEST(TokenListTest, ContentViewsSource) {
+	std::string input = "let string s = \"plain\";";
+	TokenList tokens = g_lexer.Tokenize(input);
+	ASSERT_EQ(tokens.size(), 6);
+	EXPECT_EQ(tokens[1].m_content.data(), input.data() + 4);
+	EXPECT_EQ(tokens[4].m_content.data(), input.data() + 15);
+}
+
+TEST(TokenListTest, CopyKeepsEscapedLiterals) {
+	std::string input = "s = \"a\\tb\"; c = '\\n';";
+	TokenList copy;
+	{
+		TokenList tokens = g_lexer.Tokenize(input);
+		copy = tokens;
+	}
+	ASSERT_EQ(copy.size(), 8);
+	EXPECT_EQ(copy[2].m_content, "\"a\tb\"");
+	EXPECT_EQ(copy[6].m_content, "'\n'");
+	EXPECT_EQ(copy[1].m_content.data(), input.data() + 2);
+	// identifier text comes from the symbol table
+	EXPECT_EQ(copy[0].m_content, "s");
+}
+
+TEST(LexerFastScanTest, MatchesByteByByte) {
+	std::string input =
+		"// comment with bytes outside the character set: \xC3\xA9 @ $ and a long tail ..............\n"
+		"let string s = \"a string body longer than one vector register, with \\\"escapes\\\" \\t and \xE2\x82\xAC\";\n"
+		"        let int a_very_long_identifier_name_spanning_more_than_32_bytes = other_identifier_0;\n"
+		"\t\t\tif (x) { y = \"\"; } // trailing comment at end of input";
+	LexContext byteByByte;
+	byteByByte.m_fastScan = false;
+	TokenList expected;
+	g_lexer.TokenizeChunk(byteByByte, input, true, expected);
+	TokenList tokens = g_lexer.Tokenize(input);
+	ASSERT_EQ(tokens.size(), expected.size());
+	for (size_t i = 0; i < tokens.size(); ++i) {
+		EXPECT_EQ(tokens[i].m_type, expected[i].m_type) << "at token " << i;
+		EXPECT_EQ(tokens[i].m_content, expected[i].m_content) << "at token " << i;
+		EXPECT_EQ(tokens[i].m_line, expected[i].m_line) << "at token " << i;
+		EXPECT_EQ(tokens[i].m_column, expected[i].m_column) << "at token " << i;
+	}
+	EXPECT_EQ(tokens[4].m_content, "\"a string body longer than one vector register, with \"escapes\" \t and \xE2\x82\xAC\"");
+}
+
+static void ExpectSameTokens(TokenStream& stream, const TokenList& expected) {
+	Token token;
+	size_t count = 0;
+	while (stream.Next(token)) {
+		ASSERT_LT(count, expected.size());
+		EXPECT_EQ(token.m_type, expected[count].m_type) << "at token " << count;
+		EXPECT_EQ(token.m_content, expected[count].m_content) << "at token " << count;
+		EXPECT_EQ(token.m_line, expected[count].m_line) << "at token " << count;
+		EXPECT_EQ(token.m_column, expected[count].m_column) << "at token " << count;
+		++count;
+	}
+	EXPECT_EQ(count, expected.size());
+}
+
+static const std::string g_streamInput =
+	"function int add(int a, int b) { return a + b; } // sum\n"
+	"let string s = \"split \\\"across\\\" chunks\\n\"; let char c = '\\t';\n"
+	"let double d = 3.14159; x <<= 2; y >>= 1; z = a->b :: c;\n"
+	"identifier_at_the_end";
+
+TEST(TokenStreamTest, MemoryChunksMatchTokenize) {
+	TokenList expected = g_lexer.Tokenize(g_streamInput);
+	for (size_t chunkSize : { 1, 2, 3, 5, 8, 13, 64, 4096 }) {
+		SCOPED_TRACE("chunk size " + std::to_string(chunkSize));
+		TokenStream stream(std::string_view(g_streamInput), chunkSize);
+		ExpectSameTokens(stream, expected);
+	}
+}
+
+TEST(TokenStreamTest, IstreamChunksMatchTokenize) {
+	TokenList expected = g_lexer.Tokenize(g_streamInput);
+	for (size_t chunkSize : { 1, 4, 7, 4096 }) {
+		SCOPED_TRACE("chunk size " + std::to_string(chunkSize));
+		std::istringstream input(g_streamInput);
+		TokenStream stream(input, chunkSize);
+		ExpectSameTokens(stream, expected);
+	}
+}
+
+TEST(TokenStreamTest, PeekDoesNotConsume) {
+	std::istringstream input("a b");
+	TokenStream stream(input, 1);
+	ASSERT_NE(stream.Peek(), nullptr);
+	EXPECT_EQ(stream.Peek()->m_content, "a");
+	Token token;
+	ASSERT_TRUE(stream.Next(token));
+	EXPECT_EQ(token.m_content, "a");
+	ASSERT_TRUE(stream.Next(token));
+	EXPECT_EQ(token.m_content, "b");
+	EXPECT_EQ(stream.Peek(), nullptr);
+	EXPECT_FALSE(stream.Next(token));
+}
+
+TEST(LexerPositionTest, LinesAfterCommentsCrlfAndMultilineStrings) {
+	std::string input = "a // note\r\nb = \"two\nlines\";\r\n\r\nc @";
+	try {
+		g_lexer.Tokenize(input);
+		FAIL() << "Expected LexerException due to invalid character '@'";
+	}
+	catch (const LexerException& ex) {
+		EXPECT_EQ(ex.GetRow(), 5);
+		EXPECT_EQ(ex.GetCol(), 3);
+	}
+	std::string valid = input.substr(0, input.size() - 2);
+	TokenList tokens = g_lexer.Tokenize(valid);
+	ASSERT_EQ(tokens.size(), 6);
+	EXPECT_EQ(tokens[1].m_line, 2);
+	EXPECT_EQ(tokens[3].m_line, 2);
+	EXPECT_EQ(tokens[3].m_column, 5);
+	EXPECT_EQ(tokens[4].m_line, 3);
+	EXPECT_EQ(tokens[5].m_line, 5);
+	EXPECT_EQ(tokens[5].m_column, 1);
+}
+
+static void ExpectSameTokens(const TokenList& tokens, const TokenList& expected) {
+	ASSERT_EQ(tokens.size(), expected.size());
+	for (size_t i = 0; i < tokens.size(); ++i) {
+		ASSERT_EQ(tokens[i].m_type, expected[i].m_type) << "at token " << i;
+		ASSERT_EQ(tokens[i].m_content, expected[i].m_content) << "at token " << i;
+		ASSERT_EQ(tokens[i].m_line, expected[i].m_line) << "at token " << i;
+		ASSERT_EQ(tokens[i].m_column, expected[i].m_column) << "at token " << i;
+		ASSERT_EQ(tokens[i].m_symbol, expected[i].m_symbol) << "at token " << i;
+	}
+}
+
+// with long multi-line strings most line starts a chunk can be cut at are inside a literal
+static std::string MakeParallelInput(size_t minSize, int stringLines) {
+	std::string unit = "let string s = \"first\r\n";
+	for (int i = 0; i < stringLines; i++)
+		unit += "\tline with \\\"escapes\\\" // not a comment\n";
+	unit += "last\"; // comment\r\nlet int a = b + 12; let char c = '\\n';\n";
+	std::string input;
+	while (input.size() < minSize)
+		input += unit;
+	return input;
+}
+
+TEST(LexerParallelTest, MatchesSerialTokenize) {
+	ThreadPool pool(4);
+	for (int stringLines : { 0, 40 }) {
+		std::string input = MakeParallelInput(Lexer::MinParallelChunkSize * 8, stringLines);
+		TokenList expected = g_lexer.Tokenize(input);
+		for (size_t chunkCount : { 2, 3, 8 }) {
+			TokenList tokens = g_lexer.Tokenize(input, pool, chunkCount);
+			ExpectSameTokens(tokens, expected);
+		}
+	}
+}
+
+TEST(LexerParallelTest, TokenizeIntoListKeepsCapacity) {
+	ThreadPool pool(4);
+	std::string input = MakeParallelInput(Lexer::MinParallelChunkSize * 4, 20);
+	TokenList expected = g_lexer.Tokenize(input);
+	TokenList tokens;
+	g_lexer.Tokenize(input, tokens, pool, 4);
+	size_t capacity = tokens.MemoryUsage();
+	const TokenType::Type* types = tokens.Types();
+	g_lexer.Tokenize(input, tokens, pool, 4);
+	EXPECT_EQ(tokens.MemoryUsage(), capacity);
+	EXPECT_EQ(tokens.Types(), types);
+	ExpectSameTokens(tokens, expected);
+}
+
+TEST(LexerParallelTest, ReportsSerialErrorPosition) {
+	ThreadPool pool(4);
+	std::string input = MakeParallelInput(Lexer::MinParallelChunkSize * 4, 0);
+	input.insert(input.find("let int a", input.size() * 3 / 4), "@");
+	int row = 0, col = 0;
+	try {
+		g_lexer.Tokenize(input);
+	}
+	catch (const LexerException& ex) {
+		row = ex.GetRow();
+		col = ex.GetCol();
+	}
+	ASSERT_NE(row, 0);
+	try {
+		g_lexer.Tokenize(input, pool, 4);
+		FAIL() << "Expected LexerException due to invalid character '@'";
+	}
+	catch (const LexerException& ex) {
+		EXPECT_EQ(ex.GetRow(), row);
+		EXPECT_EQ(ex.GetCol(), col);
+	}
+}
+
+static_assert(ClassifyKeyword("continue") == TokenType::CONTINUE);
+static_assert(ClassifyKeyword("struct") == TokenType::STRUCT && ClassifyKeyword("string") == TokenType::STRING);
+static_assert(ClassifyKeyword("strong") == TokenType::IDENTIFIER);
+
+TEST(LexerKeywordTest, ClassifiesKeywordsWhenIdentifierIsAccepted) {
+	std::string input = "function let const struct if else switch case default while for return break continue "
+		"true false NULL int double char string bool void import lambda";
+	std::vector<TokenType::Type> expected = { TokenType::FUNCTION, TokenType::LET, TokenType::CONST, TokenType::STRUCT,
+		TokenType::IF, TokenType::ELSE, TokenType::SWITCH, TokenType::CASE, TokenType::DEFAULT, TokenType::WHILE,
+		TokenType::FOR, TokenType::RETURN, TokenType::BREAK, TokenType::CONTINUE, TokenType::BOOL_LITERAL,
+		TokenType::BOOL_LITERAL, TokenType::NULL_LITERAL, TokenType::INT, TokenType::DOUBLE, TokenType::CHAR,
+		TokenType::STRING, TokenType::BOOL, TokenType::VOID, TokenType::IMPORT, TokenType::LAMBDA };
+	TokenList tokens = g_lexer.Tokenize(input);
+	ASSERT_EQ(tokens.size(), expected.size());
+	for (size_t i = 0; i < tokens.size(); ++i) {
+		EXPECT_EQ(tokens[i].m_type, expected[i]) << "at token " << tokens[i].m_content;
+		EXPECT_TRUE(TokenType::IsKeyword(tokens[i].m_type));
+	}
+
+	for (const Token& token : g_lexer.Tokenize("functions le Null iff struc strings chars _int voids lambda_ cas"))
+		EXPECT_EQ(token.m_type, TokenType::IDENTIFIER) << "at token " << token.m_content;
+}
+
+TEST(LexerKeywordTest, ClassifiesKeywordsSplitAcrossChunks) {
+	std::string input = "let continue = lambda;";
+	TokenStream stream(std::string_view(input), 3);
+	ExpectSameTokens(stream, g_lexer.Tokenize(input));
+}
+
+TEST(SymbolTableTest, IdentifiersShareInternedSymbols) {
+	auto& symbols = SymbolTable::Instance();
+	std::string input = "alpha = beta + alpha; let string beta_2 = \"alpha\";";
+	TokenList tokens = g_lexer.Tokenize(input);
+	ASSERT_EQ(tokens.size(), 12);
+	EXPECT_NE(tokens[0].m_symbol, InvalidSymbol);
+	EXPECT_EQ(tokens[0].m_symbol, tokens[4].m_symbol);
+	EXPECT_NE(tokens[0].m_symbol, tokens[2].m_symbol);
+	EXPECT_EQ(symbols.GetName(tokens[2].m_symbol), "beta");
+	EXPECT_EQ(symbols.Find("beta_2"), tokens[8].m_symbol);
+	// keywords, operators and literals are not interned
+	EXPECT_EQ(tokens[6].m_symbol, InvalidSymbol);
+	EXPECT_EQ(tokens[1].m_symbol, InvalidSymbol);
+	EXPECT_EQ(tokens[10].m_symbol, InvalidSymbol);
+}
+
+TEST(SymbolTableTest, ConcurrentInternReturnsOneIdPerName) {
+	auto& symbols = SymbolTable::Instance();
+	ThreadPool pool(4);
+	std::vector<std::future<std::vector<SymbolId>>> futures;
+	for (int task = 0; task < 4; task++) {
+		futures.push_back(pool.SubmitTask([&symbols, task]() {
+			std::vector<SymbolId> ids;
+			for (int i = 0; i < 1000; i++) {
+				std::string name = "concurrent_" + std::to_string((i * 7 + task * 13) % 1000);
+				ids.push_back(symbols.Intern(name));
+			}
+			return ids;
+			}));
+	}
+	for (int task = 0; task < 4; task++) {
+		std::vector<SymbolId> ids = futures[task].get();
+		for (int i = 0; i < 1000; i++) {
+			std::string name = "concurrent_" + std::to_string((i * 7 + task * 13) % 1000);
+			EXPECT_EQ(ids[i], symbols.Find(name));
+			EXPECT_EQ(symbols.GetName(ids[i]), name);
+		}
+	}
+}
+
+TEST(TokenListTest, ComputesPositionsFromLineStarts) {
+	std::string input = "a\n\n  bb = \"x\ny\" ;\r\n\tc";
+	TokenList tokens = g_lexer.Tokenize(input);
+	ASSERT_EQ(tokens.size(), 6);
+	EXPECT_EQ(tokens.Type(3), TokenType::STRING_LITERAL);
+	EXPECT_EQ(tokens.Offset(1), 5);
+	EXPECT_EQ(tokens.Position(1), std::make_pair(3, 3));
+	EXPECT_EQ(tokens.Position(2), std::make_pair(3, 6));
+	EXPECT_EQ(tokens.Position(3), std::make_pair(3, 8));
+	EXPECT_EQ(tokens.Position(4), std::make_pair(4, 4));
+	EXPECT_EQ(tokens.Position(5), std::make_pair(5, 2));
+	EXPECT_LT(tokens.MemoryUsage(), tokens.size() * sizeof(Token));
+}
+
+TEST(TokenListTest, PushBackKeepsPositions) {
+	std::string input = "function int f() {\n  return 1;\n}\n\n\nlet int x = 2;";
+	TokenList lexed = g_lexer.Tokenize(input);
+	TokenList pushed;
+	for (const Token& token : lexed)
+		pushed.push_back(token);
+	ExpectSameTokens(pushed, lexed);
+	pushed.clear();
+	pushed.push_back(lexed.back());
+	EXPECT_EQ(pushed[0].m_line, 6);
+	EXPECT_EQ(pushed[0].m_column, 14);
+}
+
+TEST(TokenListTest, TokenizeIntoListKeepsCapacity) {
+	std::string large;
+	for (int i = 0; i < 200; i++)
+		large += "let string s" + std::to_string(i) + " = \"a\\tb\";\n";
+	std::string small = "a\n  b";
+	TokenList tokens;
+	g_lexer.Tokenize(large, tokens);
+	size_t capacity = tokens.MemoryUsage();
+	g_lexer.Tokenize(small, tokens);
+	EXPECT_EQ(tokens.MemoryUsage(), capacity);
+	ExpectSameTokens(tokens, g_lexer.Tokenize(small));
+	EXPECT_EQ(tokens.Position(1), std::make_pair(2, 3));
+}
+
+TEST(TokenStreamTest, MultilineStringsAcrossChunksKeepPositions) {
+	std::string input = "a = \"one\ntwo\nthree\";\r\nb = \"x\";\n\n  c";
+	TokenList expected = g_lexer.Tokenize(input);
+	for (size_t chunkSize : { 1, 2, 5, 7 }) {
+		std::istringstream in(input);
+		TokenStream stream(in, chunkSize);
+		ExpectSameTokens(stream, expected);
+	}
+}
+
+TEST(LexerLiteralTest, DecodesLiteralValues) {
+	std::string input = "12 3.5 9223372036854775807 'x' '\\n' \"a\\tb\" \"\" true false 0.125";
+	TokenList tokens = g_lexer.Tokenize(input);
+	ASSERT_EQ(tokens.size(), 10);
+	EXPECT_EQ(tokens[0].m_literal.m_int, 12);
+	EXPECT_EQ(tokens[1].m_literal.m_double, 3.5);
+	EXPECT_EQ(tokens[2].m_literal.m_int, INT64_MAX);
+	EXPECT_EQ(tokens[3].m_literal.m_char, 'x');
+	EXPECT_EQ(tokens[4].m_literal.m_char, '\n');
+	EXPECT_EQ(tokens[5].m_literal.m_string, "a\tb");
+	EXPECT_EQ(tokens[6].m_literal.m_string, "");
+	EXPECT_TRUE(tokens[7].m_literal.m_bool);
+	EXPECT_FALSE(tokens[8].m_literal.m_bool);
+	EXPECT_EQ(tokens.Literal(9).m_double, 0.125);
+
+	TokenList pushed;
+	for (const Token& token : tokens)
+		pushed.push_back(token);
+	EXPECT_EQ(pushed[2].m_literal.m_int, INT64_MAX);
+	EXPECT_EQ(pushed[9].m_literal.m_double, 0.125);
+}
+
+TEST(LexerLiteralTest, StreamedLiteralsKeepValues) {
+	std::string input = "let int big = 123456789; let string s = \"split\\tacross\"; let double d = 2.75;";
+	TokenList expected = g_lexer.Tokenize(input);
+	std::istringstream in(input);
+	TokenStream stream(in, 4);
+	Token token;
+	for (size_t i = 0; stream.Next(token); i++) {
+		ASSERT_LT(i, expected.size());
+		EXPECT_EQ(token.m_literal.m_int, expected[i].m_literal.m_int) << "at token " << i;
+		EXPECT_EQ(token.m_literal.m_string, expected[i].m_literal.m_string) << "at token " << i;
+	}
+}
+
+TEST(LexerExceptionTest, IntegerOutOfRange) {
+	try {
+		g_lexer.Tokenize("x = 1;\ny = 99999999999999999999;");
+		FAIL() << "Expected LexerException for an integer literal out of range";
+	}
+	catch (const LexerException& ex) {
+		EXPECT_EQ(ex.GetChar(), '9');
+		EXPECT_EQ(ex.GetRow(), 2);
+		EXPECT_EQ(ex.GetCol(), 5);
+	}
+}
@@ -1,5 +1,11 @@
 #include "gtest/gtest.h"
 #include <Parser.h>
+#include <FlatAst.h>
+#include <AstCache.h>
+#include <Serializer.hpp>
+#include <sstream>
+#include <fstream>
+#include <filesystem>
 
 using namespace CppInterp;
 
@@ -271,7 +277,7 @@ public:
 
 	void Visit(AssignmentExprNode& node) override {
 		CheckNodeType(&node);
-		EXPECT_EQ(node.m_op, currentExpected->content);
+		EXPECT_EQ(OpCode::GetName(node.m_op), currentExpected->content);
 		EXPECT_TRUE(node.m_left);
 		AstCompareVisitor v1(&currentExpected->children[0], path + "/left");
 		node.m_left->Accept(v1);
@@ -318,7 +324,7 @@ public:
 
 	void Visit(UnaryExprNode& node) override {
 		CheckNodeType(&node);
-		EXPECT_EQ(node.m_op, currentExpected->content);
+		EXPECT_EQ(OpCode::GetName(node.m_op), currentExpected->content);
 		EXPECT_TRUE(node.m_operand);
 		AstCompareVisitor v(&currentExpected->children[0], path + "/operand");
 		node.m_operand->Accept(v);
@@ -329,7 +335,7 @@ public:
 
 	void Visit(PostfixExprNode& node) override {
 		CheckNodeType(&node);
-		EXPECT_EQ(node.m_op, currentExpected->content);
+		EXPECT_EQ(OpCode::GetName(node.m_op), currentExpected->content);
 		EXPECT_TRUE(node.m_primary);
 		AstCompareVisitor v(&currentExpected->children[0], path + "/primary");
 		node.m_primary->Accept(v);
@@ -406,7 +412,8 @@ public:
 
 	void Visit(IdentifierNode& node) override {
 		CheckNodeType(&node);
-		EXPECT_EQ(node.m_name, currentExpected->content);
+		EXPECT_EQ(node.m_symbol, SymbolTable::Instance().Find(currentExpected->content));
+		EXPECT_EQ(node.GetName(), currentExpected->content);
 		EXPECT_TRUE(currentExpected->children.empty())
 			<< "Child is not empty at path: " << path;
 	}
@@ -490,7 +497,8 @@ public:
 
 	void Visit(NamedTypeNode& node) override {
 		CheckNodeType(&node);
-		EXPECT_EQ(node.m_name, currentExpected->content);
+		EXPECT_EQ(node.m_symbol, SymbolTable::Instance().Find(currentExpected->content));
+		EXPECT_EQ(node.GetName(), currentExpected->content);
 		EXPECT_TRUE(currentExpected->children.empty())
 			<< "Child is not empty at path: " << path;
 	}
@@ -724,7 +732,18 @@ TEST_P(ParserSyntaxTest, ParsesAst) {
 	AstPrinter::PrintAstTree(root);
 	ASSERT_NE(root, nullptr);
 	ExpectAstMatch(root, param.expectedTree);
-	ExpectAstNodeNumsMatch(root, g_parser.GetNodes().size());
+	ExpectAstNodeNumsMatch(root, g_parser.GetNodeCount());
+}
+
+TEST_P(ParserSyntaxTest, ParsesAstFromStream) {
+	static Parser g_parser;
+	const auto& param = GetParam();
+	std::istringstream input(param.input);
+	TokenStream stream(input, 7);
+	AstNode* root = g_parser.Parse(stream);
+	ASSERT_NE(root, nullptr);
+	ExpectAstMatch(root, param.expectedTree);
+	ExpectAstNodeNumsMatch(root, g_parser.GetNodeCount());
 }
 
 static ExpectedNode MakeNode(NodeType::Type type,
@@ -1917,4 +1936,824 @@ const std::vector<ParserCase> parserCases = {
 	{source23, case23},
 };
 
-INSTANTIATE_TEST_SUITE_P(ParserSyntax, ParserSyntaxTest, ::testing::ValuesIn(parserCases));
\ No newline at end of file
+INSTANTIATE_TEST_SUITE_P(ParserSyntax, ParserSyntaxTest, ::testing::ValuesIn(parserCases));
+
+static std::string WriteTempSource(const std::string& name, const std::string& content) {
+	auto path = std::filesystem::temp_directory_path() / name;
+	std::ofstream out(path, std::ios::binary);
+	out << content;
+	return path.string();
+}
+
+TEST(ParserFileTest, ParsesMappedFile) {
+	std::string path = WriteTempSource("cppinterp_parse_file.ci", source2);
+	Parser parser;
+	AstNode* root = parser.ParseFile(path);
+	ExpectAstMatch(root, case2);
+	ExpectAstNodeNumsMatch(root, parser.GetNodeCount());
+	std::filesystem::remove(path);
+}
+
+TEST(ParserFileTest, ReportsLexerErrorPosition) {
+	std::string path = WriteTempSource("cppinterp_lexer_error.ci", "let int a = 1;\r\n// comment\r\nlet int b = 2 # 3;\r\n");
+	Parser parser;
+	try {
+		parser.ParseFile(path);
+		FAIL() << "Expected LexerException due to invalid character '#'";
+	}
+	catch (const LexerException& ex) {
+		EXPECT_EQ(ex.GetChar(), '#');
+		EXPECT_EQ(ex.GetRow(), 3);
+		EXPECT_EQ(ex.GetCol(), 15);
+	}
+	std::filesystem::remove(path);
+}
+
+TEST(ParserFileTest, MissingFileThrows) {
+	Parser parser;
+	EXPECT_THROW(parser.ParseFile("cppinterp_no_such_file.ci"), std::runtime_error);
+}
+
+TEST(ParserLiteralTest, LiteralNodesCarryDecodedValues) {
+	Parser parser;
+	AstNode* root = parser.Parse("let int a = 42; let double d = 0.5; let char c = '\\t'; let string s = \"x\\ny\"; let bool b = true;");
+	auto* program = static_cast<ProgramNode*>(root);
+	ASSERT_EQ(program->m_declarations.size(), 5);
+	auto initializer = [&](size_t index) {
+		auto* decl = static_cast<VariableDeclNode*>(program->m_declarations[index]);
+		return static_cast<LiteralNode*>(decl->m_declarators[0]->m_initializer);
+	};
+	EXPECT_EQ(initializer(0)->m_literal.m_int, 42);
+	EXPECT_EQ(initializer(1)->m_literal.m_double, 0.5);
+	EXPECT_EQ(initializer(2)->m_literal.m_char, '\t');
+	EXPECT_EQ(initializer(3)->m_literal.m_string, "x\ny");
+	EXPECT_TRUE(initializer(4)->m_literal.m_bool);
+}
+
+TEST(ParserArenaTest, NodesAndListsLiveInTheArena) {
+	Parser parser;
+	AstNode* root = parser.Parse("struct P { int x, y; }; function int f(int a) { return a + 1; }");
+	auto* program = static_cast<ProgramNode*>(root);
+	const AstArena& arena = parser.GetArena();
+	EXPECT_EQ(program->m_declarations.get_allocator().resource(), &arena);
+	auto* function = static_cast<FunctionDeclNode*>(program->m_declarations[1]);
+	EXPECT_EQ(function->m_params.get_allocator().resource(), &arena);
+	EXPECT_EQ(function->m_body->m_statements.get_allocator().resource(), &arena);
+	// nodes are bump allocated in creation order
+	EXPECT_LT(static_cast<void*>(program), static_cast<void*>(function));
+	EXPECT_LT(static_cast<void*>(function), static_cast<void*>(function->m_body));
+	ExpectAstNodeNumsMatch(root, parser.GetNodeCount());
+}
+
+TEST(ParserArenaTest, ReparseReusesFirstBlock) {
+	Parser parser;
+	parser.Parse("let int a = 1;");
+	size_t capacity = parser.GetArena().Capacity();
+	EXPECT_EQ(capacity, AstArena::BlockSize);
+	AstNode* first = parser.GetAstRoot();
+	AstNode* root = parser.Parse("let int b = 2;");
+	EXPECT_EQ(root, first);
+	EXPECT_EQ(parser.GetArena().Capacity(), capacity);
+	EXPECT_EQ(static_cast<IdentifierNode*>(static_cast<VariableDeclNode*>(
+		static_cast<ProgramNode*>(root)->m_declarations[0])->m_declarators[0]->m_name)->GetName(), "b");
+}
+
+TEST(ParserArenaTest, OversizedAllocationGetsItsOwnBlock) {
+	AstArena arena;
+	void* small = arena.allocate(24, 8);
+	void* large = arena.allocate(AstArena::BlockSize * 2, 64);
+	EXPECT_EQ(reinterpret_cast<std::uintptr_t>(large) % 64, 0);
+	EXPECT_EQ(arena.Capacity(), AstArena::BlockSize + AstArena::BlockSize * 2 + 64);
+	EXPECT_NE(small, large);
+	arena.Reset();
+	EXPECT_EQ(arena.Capacity(), AstArena::BlockSize);
+	EXPECT_EQ(arena.allocate(24, 8), small);
+}
+
+// fully parenthesized rendering of binary, unary and leaf expressions
+static std::string Parenthesize(const ExpressionNode* node) {
+	switch (node->m_nodeType) {
+	case NodeType::BINARY_EXPR: {
+		auto* binary = static_cast<const BinaryExprNode*>(node);
+		EXPECT_EQ(binary->m_left->m_parent, binary);
+		EXPECT_EQ(binary->m_right->m_parent, binary);
+		return "(" + Parenthesize(binary->m_left) + " " + std::string(OpCode::GetName(binary->m_op)) + " " + Parenthesize(binary->m_right) + ")";
+	}
+	case NodeType::UNARY_EXPR: {
+		auto* unary = static_cast<const UnaryExprNode*>(node);
+		return std::string(OpCode::GetName(unary->m_op)) + Parenthesize(unary->m_operand);
+	}
+	case NodeType::IDENTIFIER:
+		return std::string(static_cast<const IdentifierNode*>(node)->GetName());
+	case NodeType::LITERAL:
+		return std::string(static_cast<const LiteralNode*>(node)->m_value);
+	default:
+		return "?";
+	}
+}
+
+TEST(ParserPrecedenceTest, BinaryOperatorsBindByLevel) {
+	const std::pair<const char*, const char*> cases[] = {
+		{ "a || b && c | d ^ e & f == g < h << i + j * k;", "(a || (b && (c | (d ^ (e & (f == (g < (h << (i + (j * k))))))))))" },
+		{ "a * b + c << d < e == f & g ^ h | i && j || k;", "((((((((((a * b) + c) << d) < e) == f) & g) ^ h) | i) && j) || k)" },
+		{ "a - b - c / d % e;", "((a - b) - ((c / d) % e))" },
+		{ "a <= b != c >= d >> 1;", "((a <= b) != (c >= (d >> 1)))" },
+		{ "-a * !b + ~c;", "((-a * !b) + ~c)" },
+		{ "(a + b) * c;", "((a + b) * c)" },
+	};
+	for (const auto& [source, expected] : cases) {
+		Parser parser;
+		auto* program = static_cast<ProgramNode*>(parser.Parse(source));
+		ASSERT_EQ(program->m_declarations.size(), 1) << source;
+		auto* statement = static_cast<ExpressionStmtNode*>(program->m_declarations[0]);
+		EXPECT_EQ(statement->m_expression->m_parent, statement) << source;
+		EXPECT_EQ(Parenthesize(statement->m_expression), expected) << source;
+	}
+}
+
+TEST(ParserOpCodeTest, ExpressionNodesCarryOpCodes) {
+	Parser parser;
+	auto* program = static_cast<ProgramNode*>(parser.Parse("a += -b - c++; d = !e % ~f;"));
+	ASSERT_EQ(program->m_declarations.size(), 2);
+	auto expression = [&](size_t index) {
+		return static_cast<ExpressionStmtNode*>(program->m_declarations[index])->m_expression;
+	};
+	auto* add = static_cast<AssignmentExprNode*>(expression(0));
+	EXPECT_EQ(add->m_op, OpCode::ADD_ASSIGN);
+	auto* subtract = static_cast<BinaryExprNode*>(add->m_right);
+	EXPECT_EQ(subtract->m_op, OpCode::SUBTRACT);
+	EXPECT_EQ(static_cast<UnaryExprNode*>(subtract->m_left)->m_op, OpCode::NEGATE);
+	EXPECT_EQ(static_cast<PostfixExprNode*>(subtract->m_right)->m_op, OpCode::POST_INCREMENT);
+
+	auto* assign = static_cast<AssignmentExprNode*>(expression(1));
+	EXPECT_EQ(assign->m_op, OpCode::ASSIGN);
+	auto* modulo = static_cast<BinaryExprNode*>(assign->m_right);
+	EXPECT_EQ(modulo->m_op, OpCode::MODULO);
+	EXPECT_EQ(static_cast<UnaryExprNode*>(modulo->m_left)->m_op, OpCode::LOGICAL_NOT);
+	EXPECT_EQ(static_cast<UnaryExprNode*>(modulo->m_right)->m_op, OpCode::BIT_NOT);
+	EXPECT_EQ(OpCode::GetName(OpCode::NEGATE), "-");
+	EXPECT_EQ(OpCode::GetName(OpCode::ADD_ASSIGN), "+=");
+}
+
+// every flat row mirrors its pointer node and every flat edge is a parent link of the tree
+static void ExpectFlatMatchesTree(const FlatAst& flat, const std::vector<const AstNode*>& origins, size_t nodeCount) {
+	ASSERT_EQ(flat.Size(), origins.size());
+	EXPECT_EQ(flat.Size(), nodeCount);
+	size_t edges = 0;
+	for (FlatAst::NodeIndex index = 0; index < flat.Size(); index++) {
+		const AstNode* node = origins[index];
+		EXPECT_EQ(flat.Kind(index), node->m_nodeType);
+		EXPECT_EQ(flat.Line(index), node->m_line);
+		EXPECT_EQ(flat.Column(index), node->m_column);
+		flat.ForEachChild(index, [&](FlatAst::NodeIndex child) {
+			EXPECT_GT(child, index);
+			EXPECT_EQ(origins[child]->m_parent, node) << NodeTypeToString(flat.Kind(child)) << " under " << NodeTypeToString(flat.Kind(index));
+			edges++;
+		});
+	}
+	EXPECT_EQ(edges + 1, flat.Size());
+}
+
+TEST(FlatAstTest, MatchesPointerTree) {
+	for (const ParserCase& parserCase : parserCases) {
+		Parser parser;
+		AstNode* root = parser.Parse(parserCase.input);
+		std::vector<const AstNode*> origins;
+		FlatAst flat = FlatAst::FromTree(root, &origins);
+		SCOPED_TRACE(parserCase.input);
+		ExpectFlatMatchesTree(flat, origins, parser.GetNodeCount());
+	}
+}
+
+TEST(FlatAstTest, AccessorsAndWalk) {
+	Parser parser;
+	AstNode* root = parser.Parse("import \"io\"; const int a = 42, b[2]; function int f(int x) { return -x * 2; }");
+	FlatAst flat = FlatAst::FromTree(root);
+	auto declarations = flat.List(FlatAst::Root);
+	ASSERT_EQ(declarations.size(), 3);
+
+	FlatAst::NodeIndex import = declarations[0];
+	EXPECT_EQ(flat.Kind(import), NodeType::IMPORT_STMT);
+	EXPECT_EQ(flat.Text(import), "\"io\"");
+	EXPECT_EQ(flat.Op(import), 1);
+
+	FlatAst::NodeIndex variable = declarations[1];
+	EXPECT_EQ(flat.Op(variable), 1);
+	EXPECT_EQ(flat.Text(flat.Child(variable, 0)), "int");
+	auto declarators = flat.List(variable);
+	ASSERT_EQ(declarators.size(), 2);
+	EXPECT_EQ(flat.Symbol(flat.Child(declarators[0], 0)), SymbolTable::Instance().Find("a"));
+	FlatAst::NodeIndex literal = flat.Child(declarators[0], 1);
+	EXPECT_EQ(flat.Op(literal), TokenType::INT_LITERAL);
+	EXPECT_EQ(flat.Literal(literal).m_int, 42);
+	EXPECT_EQ(flat.Child(declarators[1], 1), FlatAst::InvalidNode);
+	EXPECT_EQ(flat.List(declarators[1]).size(), 1);
+
+	FlatAst::NodeIndex function = declarations[2];
+	EXPECT_EQ(flat.List(function).size(), 1);
+	FlatAst::NodeIndex body = flat.Child(function, 2);
+	FlatAst::NodeIndex product = flat.Child(flat.List(body)[0], 0);
+	EXPECT_EQ(flat.Op(product), OpCode::MULTIPLY);
+	EXPECT_EQ(flat.Op(flat.Child(product, 0)), OpCode::NEGATE);
+
+	struct Counter {
+		size_t entered = 0, left = 0, depth = 0, maxDepth = 0;
+		bool Enter(const FlatAst& ast, FlatAst::NodeIndex node) {
+			entered++;
+			maxDepth = std::max(maxDepth, ++depth);
+			return ast.Kind(node) != NodeType::FUNCTION_DECL;
+		}
+		void Leave(const FlatAst&, FlatAst::NodeIndex) { left++; depth--; }
+	} counter;
+	flat.Walk(counter);
+	// the function is entered but neither left nor descended into
+	size_t functionNodes = flat.Size() - function;
+	EXPECT_EQ(counter.entered, flat.Size() - functionNodes + 1);
+	EXPECT_EQ(counter.left, counter.entered - 1);
+	EXPECT_EQ(counter.maxDepth, 4);
+}
+
+TEST(FlatAstTest, AtLeastHalfThePointerTree) {
+	std::string source;
+	for (int i = 0; i < 50; i++)
+		for (const ParserCase& parserCase : parserCases)
+			source += parserCase.input + "\n";
+	Parser parser;
+	FlatAst flat = FlatAst::FromTree(parser.Parse(source));
+	EXPECT_EQ(flat.Size(), parser.GetNodeCount());
+	EXPECT_LE(flat.MemoryUsage() * 2, parser.GetArena().GetBytesUsed());
+}
+
+TEST(ParserRecoveryTest, ThrowsFirstErrorByDefault) {
+	Parser parser;
+	EXPECT_FALSE(parser.GetErrorRecovery());
+	EXPECT_THROW(parser.Parse("let int a = ;\nlet int b = 2;"), ParserException);
+}
+
+TEST(ParserRecoveryTest, ReportsEveryErrorInOnePass) {
+	Parser parser;
+	parser.SetErrorRecovery(true);
+	auto* program = static_cast<ProgramNode*>(parser.Parse(
+		"let int a = ;\n"
+		"let int b = 2;\n"
+		"function int f(int x {\n"
+		"    return x;\n"
+		"}\n"
+		"struct P { int x; };\n"
+		"c = (1 + ;\n"
+		"let int d = 4;\n"));
+	ASSERT_EQ(parser.GetDiagnostics().size(), 3);
+	EXPECT_EQ(parser.GetDiagnostics()[0].GetRow(), 1);
+	EXPECT_EQ(parser.GetDiagnostics()[1].GetRow(), 3);
+	EXPECT_EQ(parser.GetDiagnostics()[2].GetRow(), 7);
+	// b, P and d survive, the broken function is skipped through its closing brace
+	ASSERT_EQ(program->m_declarations.size(), 3);
+	EXPECT_EQ(program->m_declarations[0]->m_nodeType, NodeType::VAR_DECL);
+	EXPECT_EQ(program->m_declarations[1]->m_nodeType, NodeType::STRUCT_DECL);
+	EXPECT_EQ(program->m_declarations[2]->m_nodeType, NodeType::VAR_DECL);
+	EXPECT_EQ(program->m_declarations[2]->m_line, 8);
+}
+
+TEST(ParserRecoveryTest, ErrorInBlockKeepsTheRestOfTheFunction) {
+	Parser parser;
+	parser.SetErrorRecovery(true);
+	auto* program = static_cast<ProgramNode*>(parser.Parse(
+		"function void f() {\n"
+		"    let int a = 1;\n"
+		"    switch (a) { case 1: a = * 2; break; }\n"
+		"    a = a +;\n"
+		"    if (a) { a = 2; }\n"
+		"}\n"
+		"let int z = 0;\n"));
+	ASSERT_EQ(parser.GetDiagnostics().size(), 2);
+	EXPECT_EQ(parser.GetDiagnostics()[0].GetRow(), 3);
+	EXPECT_EQ(parser.GetDiagnostics()[1].GetRow(), 4);
+	ASSERT_EQ(program->m_declarations.size(), 2);
+	auto* function = static_cast<FunctionDeclNode*>(program->m_declarations[0]);
+	ASSERT_EQ(function->m_body->m_statements.size(), 2);
+	EXPECT_EQ(function->m_body->m_statements[0]->m_nodeType, NodeType::VAR_DECL);
+	EXPECT_EQ(function->m_body->m_statements[1]->m_nodeType, NodeType::IF_STMT);
+	EXPECT_EQ(function->m_body->m_statements[1]->m_parent, function->m_body);
+}
+
+TEST(ParserRecoveryTest, StrayTokensAndEndOfInput) {
+	Parser parser;
+	parser.SetErrorRecovery(true);
+	auto* program = static_cast<ProgramNode*>(parser.Parse("} ) let int a = 1; function void g() { a = 1;"));
+	ASSERT_EQ(parser.GetDiagnostics().size(), 3);
+	EXPECT_EQ(parser.GetDiagnostics()[2].GetMessage(), "Unexpected end of input while peeking next token");
+	ASSERT_EQ(program->m_declarations.size(), 1);
+	EXPECT_EQ(program->m_declarations[0]->m_nodeType, NodeType::VAR_DECL);
+
+	parser.Parse("let int b = 2;");
+	EXPECT_FALSE(parser.HasErrors());
+}
+
+static void ExpectSameTree(const AstNode* actual, const AstNode* expected) {
+	FlatAst left = FlatAst::FromTree(actual);
+	FlatAst right = FlatAst::FromTree(expected);
+	ASSERT_EQ(left.Size(), right.Size());
+	for (FlatAst::NodeIndex index = 0; index < left.Size(); index++) {
+		ASSERT_EQ(left.Kind(index), right.Kind(index)) << "node " << index;
+		EXPECT_EQ(left.Op(index), right.Op(index)) << "node " << index;
+		EXPECT_EQ(left.Line(index), right.Line(index)) << "node " << index;
+		EXPECT_EQ(left.Column(index), right.Column(index)) << "node " << index;
+		std::vector<FlatAst::NodeIndex> leftChildren, rightChildren;
+		left.ForEachChild(index, [&](FlatAst::NodeIndex child) { leftChildren.push_back(child); });
+		right.ForEachChild(index, [&](FlatAst::NodeIndex child) { rightChildren.push_back(child); });
+		EXPECT_EQ(leftChildren, rightChildren) << "node " << index;
+		switch (left.Kind(index)) {
+		case NodeType::IDENTIFIER:
+		case NodeType::NAMED_TYPE:
+			EXPECT_EQ(left.Symbol(index), right.Symbol(index)) << "node " << index;
+			break;
+		case NodeType::LITERAL:
+		case NodeType::BUILTIN_TYPE:
+		case NodeType::IMPORT_STMT:
+			EXPECT_EQ(left.Text(index), right.Text(index)) << "node " << index;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static const char* ReparseSource =
+	"import \"io\";\n"
+	"let int total = 0;\n"
+	"function int add(int a, int b) {\n"
+	"    let int c = a + b;\n"
+	"    if (c > 10) {\n"
+	"        c = c - 1;\n"
+	"    }\n"
+	"    return c;\n"
+	"}\n"
+	"struct P { int x; };\n"
+	"function int main() {\n"
+	"    total = add(1, 2);\n"
+	"    return total;\n"
+	"}\n";
+
+TEST(ParserReparseTest, EditInsideBlockMatchesFullParse) {
+	Parser parser;
+	std::string source = ReparseSource;
+	auto* program = static_cast<ProgramNode*>(parser.Parse(source));
+	AstNode* untouched = program->m_declarations[4];
+	AstNode* edited = program->m_declarations[2];
+
+	// "c - 1" becomes "c - 100"
+	size_t offset = source.find("c - 1") + 5;
+	parser.Reparse({ offset, 0, "00" });
+	source.insert(offset, "00");
+	EXPECT_TRUE(parser.LastReparseIncremental());
+	EXPECT_EQ(parser.GetSource(), source);
+	// the innermost block is parsed again, its function and the rest of the program are kept
+	EXPECT_EQ(program->m_declarations[4], untouched);
+	EXPECT_EQ(program->m_declarations[2], edited);
+
+	Parser fresh;
+	ExpectSameTree(program, fresh.Parse(source));
+}
+
+TEST(ParserReparseTest, NewlinesShiftLaterPositions) {
+	Parser parser;
+	std::string source = ReparseSource;
+	AstNode* root = parser.Parse(source);
+
+	const std::vector<std::pair<std::string, std::string>> edits = {
+		{ "return c;", "\n    c = c * 2;\n    " },
+		{ "let int c", "\n\n" },
+		{ "total = add", "let int k = 3;\n    " },
+	};
+	for (const auto& [anchor, text] : edits) {
+		size_t offset = source.find(anchor);
+		parser.Reparse({ offset, 0, text });
+		source.insert(offset, text);
+		EXPECT_TRUE(parser.LastReparseIncremental()) << text;
+		Parser fresh;
+		ExpectSameTree(root, fresh.Parse(source));
+	}
+
+	// removing the inserted lines again
+	size_t offset = source.find("let int k = 3;\n    ");
+	parser.Reparse({ offset, 19, "" });
+	source.erase(offset, 19);
+	EXPECT_TRUE(parser.LastReparseIncremental());
+	Parser fresh;
+	ExpectSameTree(root, fresh.Parse(source));
+}
+
+TEST(ParserReparseTest, FallsBackToFullParse) {
+	Parser parser;
+	std::string source = ReparseSource;
+	parser.Parse(source);
+
+	// outside of every block
+	size_t offset = source.find("total = 0") + 8;
+	AstNode* root = parser.Reparse({ offset, 1, "5" });
+	source.replace(offset, 1, "5");
+	EXPECT_FALSE(parser.LastReparseIncremental());
+	Parser fresh;
+	ExpectSameTree(root, fresh.Parse(source));
+
+	// on the first byte of a function
+	offset = source.find("function int main");
+	root = parser.Reparse({ offset, 1, "f" });
+	source.replace(offset, 1, "f");
+	EXPECT_FALSE(parser.LastReparseIncremental());
+	ExpectSameTree(root, fresh.Parse(source));
+
+	// text that closes the block early
+	offset = source.find("total = add");
+	root = parser.Reparse({ offset, 0, "} {" });
+	source.insert(offset, "} {");
+	EXPECT_FALSE(parser.LastReparseIncremental());
+	ExpectSameTree(root, fresh.Parse(source));
+
+	EXPECT_THROW(parser.Reparse({ source.size() + 1, 0, "" }), std::out_of_range);
+	Parser empty;
+	EXPECT_THROW(empty.Reparse({ 0, 0, "" }), std::logic_error);
+}
+
+TEST(ParserReparseTest, SyntaxErrorInsideBlockThrows) {
+	Parser parser;
+	std::string source = ReparseSource;
+	parser.Parse(source);
+	size_t offset = source.find("total = add");
+	EXPECT_THROW(parser.Reparse({ offset, 0, "let = ;" }), ParserException);
+}
+
+// about 40 tokens per function, so count functions are enough for several parallel runs
+static std::string MakeLargeScript(int count) {
+	std::string source = "import \"io\";\nlet int total = 0;\n";
+	for (int i = 0; i < count; i++) {
+		std::string n = std::to_string(i);
+		source += "function int f" + n + "(int a, int b) {\n";
+		source += "    if (a > " + n + ") { a = a - b; } else { b = b * 2; }\n";
+		source += "    while (a < b) { a += 3; }\n";
+		source += "    return a + b;\n";
+		source += "}\n";
+		source += i % 3 == 0 ? "if (total > 1) { total = 0; } else { total = " + n + "; }\n" : "total = f" + n + "(1, 2);\n";
+	}
+	return source;
+}
+
+TEST(ParserParallelTest, MatchesSequentialParse) {
+	ThreadPool pool(4);
+	const std::string source = MakeLargeScript(4000);
+	Parser sequential, parallel;
+	AstNode* expected = sequential.Parse(source);
+	for (size_t chunkCount : { 1, 2, 4, 7 }) {
+		AstNode* root = parallel.Parse(source, pool, chunkCount);
+		ExpectSameTree(root, expected);
+		EXPECT_EQ(parallel.GetNodeCount(), sequential.GetNodeCount());
+		// the runs hold their nodes in arenas of their own
+		if (chunkCount > 1) {
+			EXPECT_EQ(parallel.GetArena().GetObjectCount(), 1);
+		}
+		for (AstNode* item : static_cast<ProgramNode*>(root)->m_declarations)
+			ASSERT_EQ(item->m_parent, root);
+	}
+
+	// blocks of every run can be reparsed
+	std::string edited = source;
+	size_t offset = edited.rfind("a += 3") + 5;
+	parallel.Reparse({ offset, 1, "4" });
+	edited.replace(offset, 1, "4");
+	EXPECT_TRUE(parallel.LastReparseIncremental());
+	ExpectSameTree(parallel.GetAstRoot(), sequential.Parse(edited));
+
+	std::string path = WriteTempSource("parallel.cpi", source);
+	ExpectSameTree(parallel.ParseFile(path, pool, 4), sequential.Parse(source));
+}
+
+TEST(ParserParallelTest, ErrorsMatchSequentialParse) {
+	ThreadPool pool(4);
+	std::string source = MakeLargeScript(4000);
+	// an unbalanced brace in the middle puts the run cuts in the wrong places
+	source.insert(source.find("function int f2500"), "{ let int x = ;\n");
+	Parser sequential, parallel;
+	int row = 0;
+	try {
+		sequential.Parse(source);
+		FAIL() << "expected a syntax error";
+	}
+	catch (const ParserException& ex) {
+		row = ex.GetRow();
+	}
+	try {
+		parallel.Parse(source, pool, 4);
+		FAIL() << "expected a syntax error";
+	}
+	catch (const ParserException& ex) {
+		EXPECT_EQ(ex.GetRow(), row);
+	}
+
+	sequential.SetErrorRecovery(true);
+	parallel.SetErrorRecovery(true);
+	AstNode* expected = sequential.Parse(source);
+	AstNode* root = parallel.Parse(source, pool, 4);
+	ASSERT_EQ(parallel.GetDiagnostics().size(), sequential.GetDiagnostics().size());
+	EXPECT_EQ(parallel.GetDiagnostics()[0].GetRow(), row);
+	ExpectSameTree(root, expected);
+}
+
+static size_t ParseAllBodies(Parser& parser, AstNode* root) {
+	size_t parsed = 0;
+	for (AstNode* item : static_cast<ProgramNode*>(root)->m_declarations) {
+		if (item->m_nodeType != NodeType::FUNCTION_DECL)
+			continue;
+		auto* function = static_cast<FunctionDeclNode*>(item);
+		parsed += !function->IsBodyParsed();
+		EXPECT_NE(parser.ParseBody(*function), nullptr);
+	}
+	return parsed;
+}
+
+TEST(ParserLazyBodyTest, BodiesParseOnFirstUse) {
+	Parser eager, lazy;
+	lazy.SetLazyBodies(true);
+	AstNode* expected = eager.Parse(ReparseSource);
+	auto* program = static_cast<ProgramNode*>(lazy.Parse(ReparseSource));
+	EXPECT_EQ(lazy.GetUnparsedBodyCount(), 2);
+	EXPECT_LT(lazy.GetNodeCount(), eager.GetNodeCount());
+
+	auto* add = static_cast<FunctionDeclNode*>(program->m_declarations[2]);
+	EXPECT_FALSE(add->IsBodyParsed());
+	EXPECT_EQ(add->m_body, nullptr);
+	ASSERT_EQ(add->m_params.size(), 2);
+	CompoundStmtNode* body = lazy.ParseBody(*add);
+	ASSERT_NE(body, nullptr);
+	EXPECT_EQ(body->m_parent, add);
+	EXPECT_EQ(lazy.ParseBody(*add), body);
+	EXPECT_EQ(lazy.GetUnparsedBodyCount(), 1);
+
+	EXPECT_EQ(ParseAllBodies(lazy, program), 1);
+	EXPECT_EQ(lazy.GetUnparsedBodyCount(), 0);
+	EXPECT_EQ(lazy.GetNodeCount(), eager.GetNodeCount());
+	ExpectSameTree(program, expected);
+}
+
+TEST(ParserLazyBodyTest, ErrorsInBodiesSurfaceOnUse) {
+	const char* source =
+		"function int good() { return 1; }\n"
+		"function int bad() {\n"
+		"    let int x = ;\n"
+		"    return x;\n"
+		"}\n"
+		"let int y = good();\n";
+	Parser parser;
+	parser.SetLazyBodies(true);
+	auto* program = static_cast<ProgramNode*>(parser.Parse(source));
+	ASSERT_EQ(program->m_declarations.size(), 3);
+	auto* bad = static_cast<FunctionDeclNode*>(program->m_declarations[1]);
+	try {
+		parser.ParseBody(*bad);
+		FAIL() << "expected a syntax error";
+	}
+	catch (const ParserException& ex) {
+		EXPECT_EQ(ex.GetRow(), 3);
+	}
+	EXPECT_FALSE(bad->IsBodyParsed());
+
+	parser.SetErrorRecovery(true);
+	program = static_cast<ProgramNode*>(parser.Parse(source));
+	EXPECT_FALSE(parser.HasErrors());
+	bad = static_cast<FunctionDeclNode*>(program->m_declarations[1]);
+	CompoundStmtNode* body = parser.ParseBody(*bad);
+	ASSERT_EQ(parser.GetDiagnostics().size(), 1);
+	EXPECT_EQ(parser.GetDiagnostics()[0].GetRow(), 3);
+	ASSERT_EQ(body->m_statements.size(), 1);
+	EXPECT_EQ(body->m_statements[0]->m_nodeType, NodeType::RETURN_STMT);
+
+	// an unclosed body is still an error of the parse itself
+	EXPECT_THROW(Parser().Parse("function int f() { return 1;"), ParserException);
+}
+
+TEST(ParserLazyBodyTest, WorksWithParallelParseAndReparse) {
+	ThreadPool pool(4);
+	const std::string source = MakeLargeScript(4000);
+	Parser eager, lazy;
+	lazy.SetLazyBodies(true);
+	AstNode* expected = eager.Parse(source);
+	AstNode* root = lazy.Parse(source, pool, 4);
+	EXPECT_EQ(lazy.GetUnparsedBodyCount(), 4000);
+	EXPECT_EQ(ParseAllBodies(lazy, root), 4000);
+	ExpectSameTree(root, expected);
+
+	// skipped bodies make Reparse parse everything again
+	root = lazy.Parse(source);
+	std::string edited = source;
+	size_t offset = edited.rfind("a += 3") + 5;
+	root = lazy.Reparse({ offset, 1, "4" });
+	edited.replace(offset, 1, "4");
+	EXPECT_FALSE(lazy.LastReparseIncremental());
+	ParseAllBodies(lazy, root);
+	ExpectSameTree(root, eager.Parse(edited));
+}
+
+TEST(FlatAstTest, BinaryImageRoundTrip) {
+	Parser parser;
+	AstNode* root = parser.Parse(
+		"import \"io\";\n"
+		"struct P { int x, y[4]; };\n"
+		"function string name(P p, double scale) {\n"
+		"    let char c = 'x';\n"
+		"    let string s = \"tab\\there\";\n"
+		"    switch (p.x) { case 1: break; default: c = 'y'; }\n"
+		"    for (let int i = 0; i < 3; i++) { scale *= -1.5; continue; }\n"
+		"    let (int) -> int f = lambda(int v) -> int { return v ? v : !v; };\n"
+		"    return s;\n"
+		"}\n"
+		"let int a = 1, b[2] = { 1, 2 };\n");
+	FlatAst flat = FlatAst::FromTree(root);
+	std::string image = flat.ToBinary();
+	EXPECT_LT(image.size(), flat.MemoryUsage());
+
+	FlatAst loaded = FlatAst::FromBinary(image);
+	AstArena arena;
+	TextArena texts;
+	AstNode* copy = loaded.ToTree(arena, texts);
+	ExpectSameTree(copy, root);
+	EXPECT_EQ(arena.GetObjectCount(), parser.GetNodeCount());
+	auto* function = static_cast<FunctionDeclNode*>(static_cast<ProgramNode*>(copy)->m_declarations[2]);
+	EXPECT_EQ(function->m_name->GetName(), "name");
+	EXPECT_EQ(function->m_parent, copy);
+	EXPECT_EQ(function->m_body->m_parent, function);
+
+	std::string damaged = image.substr(0, image.size() / 2);
+	EXPECT_THROW(FlatAst::FromBinary(damaged), std::runtime_error);
+	EXPECT_THROW(FlatAst::FromBinary("not an image"), std::runtime_error);
+}
+
+TEST(ParserCacheTest, SecondParseLoadsTheStoredTree) {
+	auto directory = std::filesystem::temp_directory_path() / "cppinterp_ast_cache_test";
+	std::filesystem::remove_all(directory);
+	AstCache cache(directory);
+	const std::string source = MakeLargeScript(200);
+
+	Parser parser, reference;
+	parser.SetLazyBodies(true);
+	AstNode* root = parser.Parse(source, cache);
+	EXPECT_FALSE(parser.LastParseCached());
+	EXPECT_EQ(parser.GetUnparsedBodyCount(), 0);
+	EXPECT_TRUE(std::filesystem::exists(cache.EntryPath(AstCache::Hash(source))));
+
+	root = parser.Parse(source, cache);
+	EXPECT_TRUE(parser.LastParseCached());
+	ExpectSameTree(root, reference.Parse(source));
+
+	// edits parse the whole source and the edited text gets its own entry
+	size_t offset = source.find("a += 3") + 5;
+	root = parser.Reparse({ offset, 1, "4" });
+	EXPECT_FALSE(parser.LastReparseIncremental());
+	std::string edited(parser.GetSource());
+	ParseAllBodies(parser, root);
+	ExpectSameTree(root, reference.Parse(edited));
+	parser.Parse(edited, cache);
+	EXPECT_FALSE(parser.LastParseCached());
+	parser.Parse(edited, cache);
+	EXPECT_TRUE(parser.LastParseCached());
+
+	std::string path = WriteTempSource("cached.cpi", source);
+	root = parser.ParseFile(path, cache);
+	EXPECT_TRUE(parser.LastParseCached());
+	ExpectSameTree(root, reference.Parse(source));
+	std::filesystem::remove_all(directory);
+}
+
+TEST(ParserCacheTest, BrokenSourcesAndEntriesAreMisses) {
+	auto directory = std::filesystem::temp_directory_path() / "cppinterp_ast_cache_miss";
+	std::filesystem::remove_all(directory);
+	AstCache cache(directory);
+
+	Parser parser;
+	parser.SetErrorRecovery(true);
+	const std::string broken = "let int a = ;\nlet int b = 2;\n";
+	parser.Parse(broken, cache);
+	EXPECT_TRUE(parser.HasErrors());
+	EXPECT_FALSE(std::filesystem::exists(cache.EntryPath(AstCache::Hash(broken))));
+
+	const std::string source = "let int a = 1;\n";
+	parser.Parse(source, cache);
+	std::filesystem::path entry = cache.EntryPath(AstCache::Hash(source));
+	ASSERT_TRUE(std::filesystem::exists(entry));
+	std::filesystem::resize_file(entry, std::filesystem::file_size(entry) - 3);
+	AstNode* root = parser.Parse(source, cache);
+	EXPECT_FALSE(parser.LastParseCached());
+	EXPECT_EQ(static_cast<ProgramNode*>(root)->m_declarations.size(), 1);
+	// the miss wrote the entry again
+	parser.Parse(source, cache);
+	EXPECT_TRUE(parser.LastParseCached());
+
+	// an entry of another source under a colliding hash, laid out as AstCache writes it
+	struct CollidingEntry {
+		uint64_t m_sourceHash;
+		std::string m_source;
+		std::string m_tree;
+		auto Tie() { return std::tie(m_sourceHash, m_source, m_tree); }
+		auto Tie() const { return std::tie(m_sourceHash, m_source, m_tree); }
+	};
+	const std::string other = "let int b = 2;\n";
+	CollidingEntry colliding{ AstCache::Hash(other), source, FlatAst::FromTree(root).ToBinary() };
+	{
+		std::string data = Serializer::Serialize(colliding);
+		std::ofstream file(cache.EntryPath(AstCache::Hash(other)), std::ios::binary | std::ios::trunc);
+		file.write(data.data(), static_cast<std::streamsize>(data.size()));
+	}
+	root = parser.Parse(other, cache);
+	EXPECT_FALSE(parser.LastParseCached());
+	auto* declaration = static_cast<VariableDeclNode*>(static_cast<ProgramNode*>(root)->m_declarations[0]);
+	EXPECT_EQ(declaration->m_declarators[0]->m_name->GetName(), "b");
+	std::filesystem::remove_all(directory);
+}
+
+TEST(ParserCacheTest, FlippedBytesInAnEntryAreMissesOrValidTrees) {
+	auto directory = std::filesystem::temp_directory_path() / "cppinterp_ast_cache_flips";
+	std::filesystem::remove_all(directory);
+	AstCache cache(directory);
+	const std::string source = "function int f(int a[2]) { if (a[0]) return -a[1]; return f(a); }\nlet int x = 1 + 2 * 3;\n";
+	Parser parser, reference;
+	AstNode* expected = reference.Parse(source);
+	parser.Parse(source, cache);
+	std::filesystem::path entry = cache.EntryPath(AstCache::Hash(source));
+	std::string stored;
+	{
+		std::ifstream file(entry, std::ios::binary);
+		stored.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+	ASSERT_FALSE(stored.empty());
+
+	// a changed kind or a cleared child must not reach the loader, whatever else a flip changes
+	// still has to give a tree that could have been parsed
+	size_t misses = 0;
+	for (size_t i = 0; i < stored.size(); i++) {
+		for (unsigned char mask : { 0x01, 0x10, 0xff }) {
+			std::string flipped = stored;
+			flipped[i] = static_cast<char>(flipped[i] ^ mask);
+			{
+				std::ofstream file(entry, std::ios::binary | std::ios::trunc);
+				file.write(flipped.data(), static_cast<std::streamsize>(flipped.size()));
+			}
+			AstNode* root = parser.Parse(source, cache);
+			if (!parser.LastParseCached()) {
+				misses++;
+				ExpectSameTree(root, expected);
+				continue;
+			}
+			ASSERT_EQ(root->m_nodeType, NodeType::PROGRAM);
+			EXPECT_NO_THROW(FlatAst::FromBinary(FlatAst::FromTree(root).ToBinary())) << "byte " << i;
+		}
+	}
+	EXPECT_GT(misses, stored.size());
+	std::filesystem::remove_all(directory);
+}
+
+TEST(ParserReuseTest, TokenOverloadsMatchSourceParse) {
+	const std::string source = MakeLargeScript(20);
+	Parser reference;
+	AstNode* expected = reference.Parse(source);
+
+	TokenList tokens = Lexer::Instance().Tokenize(source);
+	Parser parser;
+	ExpectSameTree(parser.Parse(tokens), expected);
+	// the borrowed list is read again by lazy bodies
+	parser.SetLazyBodies(true);
+	AstNode* root = parser.Parse(tokens);
+	EXPECT_GT(ParseAllBodies(parser, root), 0);
+	ExpectSameTree(root, expected);
+	parser.SetLazyBodies(false);
+
+	std::vector<Token> built(tokens.begin(), tokens.end());
+	ExpectSameTree(parser.Parse(std::span<const Token>(built)), expected);
+	ExpectSameTree(parser.Parse(TokenList(tokens)), expected);
+	ExpectSameTree(parser.Parse(std::move(tokens)), expected);
+	// a string parse afterwards reads its own tokens again
+	ExpectSameTree(parser.Parse(source), expected);
+}
+
+TEST(ParserReuseTest, BuffersOutliveParses) {
+	std::string source = MakeLargeScript(4);
+	Parser reference;
+	AstNode* expected = reference.Parse(source);
+
+	Parser parser;
+	std::string moved = source;
+	const char* data = moved.data();
+	ExpectSameTree(parser.Parse(std::move(moved)), expected);
+	EXPECT_EQ(parser.GetSource().data(), data);
+
+	// once grown, small parses reuse the same buffers
+	parser.Parse(source);
+	data = parser.GetSource().data();
+	parser.Parse("let int x = 1;");
+	const size_t arena = parser.GetArena().Capacity();
+	for (int i = 0; i < 100; i++) {
+		std::string snippet = "let int x" + std::to_string(i) + " = " + std::to_string(i) + " * 2;";
+		auto* program = static_cast<ProgramNode*>(parser.Parse(snippet));
+		ASSERT_EQ(program->m_declarations.size(), 1);
+		EXPECT_EQ(parser.GetSource().data(), data);
+	}
+	EXPECT_EQ(parser.GetArena().Capacity(), arena);
+	ExpectSameTree(parser.Parse(source), expected);
+}
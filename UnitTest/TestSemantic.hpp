@@ -0,0 +1,465 @@
+#include "gtest/gtest.h"
+#include <Parser.h>
+#include <SemanticAnalyzer.h>
+
+using namespace CppInterp;
+
+static const char* ValidProgram = R"(import "io";
+struct Point { int x, y; double weight; };
+let Point origin = { 0, 0, 1.0 };
+let int table[2][3] = { { 1, 2, 3 }, { 4, 5, 6 } };
+const int limit = 10;
+function int sum(int values[3], int count) {
+	let int total = 0;
+	for (let int i = 0; i < count; i++) {
+		total += values[i];
+	}
+	return total;
+}
+function double scale(Point p, double factor) {
+	let (double) -> double twice = lambda(double v) -> double { return v * factor; };
+	return twice(p.weight) + p.x;
+}
+function string describe(int code) {
+	switch (code) {
+	case 1: return "one";
+	case 2: { return "two"; }
+	default: break;
+	}
+	if (code > limit) { return "big"; } else { return "other" + 's'; }
+}
+let int s = sum(table[0], 3);
+origin.x = s;
+print(describe(s), scale(origin, 2.5));
+while (s > 0) { s--; if (s == 5) { continue; } }
+)";
+
+static void ExpectNoDiagnostics(const SemanticAnalyzer& analyzer) {
+	for (const SemanticException& diagnostic : analyzer.GetDiagnostics())
+		ADD_FAILURE() << diagnostic.what();
+}
+
+TEST(TypeTableTest, InternsArraysAndFunctions) {
+	TypeTable types;
+	const TypeInfo* intType = types.Builtin(TypeKind::INT);
+	const TypeInfo* doubleType = types.Builtin(TypeKind::DOUBLE);
+	EXPECT_EQ(types.FindBuiltin("int"), intType);
+	EXPECT_EQ(types.FindBuiltin("Point"), nullptr);
+
+	const TypeInfo* row = types.GetArray(intType, 3);
+	EXPECT_EQ(types.GetArray(intType, 3), row);
+	EXPECT_NE(types.GetArray(intType, 4), row);
+	EXPECT_EQ(types.GetArray(row, 2)->ToString(), "int[2][3]");
+
+	std::vector<const TypeInfo*> params = { intType, row };
+	const TypeInfo* function = types.GetFunction(doubleType, params);
+	std::vector<const TypeInfo*> same = { types.FindBuiltin("int"), types.GetArray(intType, 3) };
+	EXPECT_EQ(types.GetFunction(doubleType, same), function);
+	EXPECT_NE(types.GetFunction(doubleType, same, true), function);
+	EXPECT_NE(types.GetFunction(intType, same), function);
+	EXPECT_EQ(function->ToString(), "(int, int[3]) -> double");
+	EXPECT_EQ(types.Get(function->m_id), function);
+
+	// structs are nominal
+	SymbolId name = SymbolTable::Instance().Intern("Point");
+	EXPECT_NE(types.NewStruct(name, nullptr), types.NewStruct(name, nullptr));
+}
+
+TEST(SemanticAnalyzerTest, AcceptsValidProgram) {
+	Parser parser;
+	AstNode* root = parser.Parse(ValidProgram);
+	SemanticAnalyzer analyzer;
+	EXPECT_TRUE(analyzer.Analyze(root));
+	ExpectNoDiagnostics(analyzer);
+
+	TypeTable& types = analyzer.GetTypes();
+	const TypeInfo* intType = types.Builtin(TypeKind::INT);
+	std::vector<const TypeInfo*> params = { types.GetArray(intType, 3), intType };
+	EXPECT_EQ(analyzer.FindGlobal("sum"), types.GetFunction(intType, params));
+	EXPECT_EQ(analyzer.FindGlobal("table")->ToString(), "int[2][3]");
+	const TypeInfo* point = analyzer.FindGlobal("origin");
+	ASSERT_TRUE(point->Is(TypeKind::STRUCT));
+	ASSERT_EQ(point->m_fields.size(), 3);
+	EXPECT_EQ(point->m_fields[2].m_type, types.Builtin(TypeKind::DOUBLE));
+	EXPECT_EQ(analyzer.FindGlobal("missing"), nullptr);
+
+	// the analysis of a second program starts over
+	EXPECT_TRUE(analyzer.Analyze(parser.Parse(ValidProgram)));
+	EXPECT_FALSE(analyzer.Analyze(parser.Parse("let int a = b;")));
+	EXPECT_EQ(analyzer.FindGlobal("sum"), nullptr);
+}
+
+TEST(SemanticAnalyzerTest, RecordsExpressionTypes) {
+	Parser parser;
+	auto* program = static_cast<ProgramNode*>(parser.Parse(
+		"let double d = 1 + 2.5;\nlet string s = \"a\" + 'b';\nlet bool b = d < 3 && !false;\nlet int c = 'x' * 2;"));
+	SemanticAnalyzer analyzer;
+	ASSERT_TRUE(analyzer.Analyze(program));
+	const TypeKind::Type expected[] = { TypeKind::DOUBLE, TypeKind::STRING, TypeKind::BOOL, TypeKind::INT };
+	ASSERT_EQ(program->m_declarations.size(), std::size(expected));
+	for (size_t i = 0; i < std::size(expected); i++) {
+		auto* decl = static_cast<VariableDeclNode*>(program->m_declarations[i]);
+		const TypeInfo* type = decl->m_declarators[0]->m_initializer->m_valueType;
+		ASSERT_NE(type, nullptr);
+		EXPECT_EQ(type->m_kind, expected[i]) << type->ToString();
+	}
+}
+
+TEST(SemanticAnalyzerTest, ScopesNestAndShadow) {
+	Parser parser;
+	SemanticAnalyzer analyzer;
+	analyzer.Analyze(parser.Parse(
+		"let int a = 1;\n{ let string a = \"s\"; a += \"t\"; let int b = 2; }\na += 1;\nb = 3;\n"));
+	ASSERT_EQ(analyzer.GetDiagnostics().size(), 1);
+	EXPECT_EQ(analyzer.GetDiagnostics()[0].GetMessage(), "use of undeclared identifier 'b'");
+	EXPECT_EQ(analyzer.GetDiagnostics()[0].GetRow(), 4);
+
+	// one mistake is reported once, not again by every expression around it
+	analyzer.Analyze(parser.Parse("let int a = missing + 1 * 2 - a;"));
+	EXPECT_EQ(analyzer.GetDiagnostics().size(), 1);
+}
+
+// every identifier a test program names, in source order
+static std::vector<IdentifierNode*> CollectIdentifiers(AstNode* root) {
+	std::vector<IdentifierNode*> found;
+	auto walk = [&](auto& self, AstNode* node) -> void {
+		if (node->m_nodeType == NodeType::IDENTIFIER)
+			found.push_back(static_cast<IdentifierNode*>(node));
+		ForEachChild(*node, [&](AstNode* child) { self(self, child); });
+	};
+	walk(walk, root);
+	return found;
+}
+
+TEST(SemanticAnalyzerTest, BindsIdentifiersToSlots) {
+	Parser parser;
+	auto* program = static_cast<ProgramNode*>(parser.Parse(R"(let int g = 1;
+function int f(int a, int b) {
+	{ let int c = a; }
+	{ let int d = b; let int e = d; }
+	let (int) -> int add = lambda(int x) -> int { return x + a + g; };
+	print(add(1));
+	return g;
+}
+{ let int t = g; }
+)"));
+	SemanticAnalyzer analyzer;
+	ASSERT_TRUE(analyzer.Analyze(program));
+	ExpectNoDiagnostics(analyzer);
+	EXPECT_EQ(program->m_globalCount, 2);
+	EXPECT_EQ(program->m_frameSize, 1);
+	auto* function = static_cast<FunctionDeclNode*>(program->m_declarations[1]);
+	// a and b, then the sibling blocks share slots 2 and 3, add takes 2 once they closed
+	EXPECT_EQ(function->m_frameSize, 4);
+
+	struct Expected {
+		std::string_view name;
+		BindingKind::Type binding;
+		uint16_t depth;
+		uint32_t slot;
+	};
+	const Expected expected[] = {
+		// functions are collected before the variables
+		{ "g", BindingKind::GLOBAL, 0, 1 }, { "f", BindingKind::GLOBAL, 0, 0 },
+		{ "a", BindingKind::LOCAL, 0, 0 }, { "b", BindingKind::LOCAL, 0, 1 },
+		{ "c", BindingKind::LOCAL, 0, 2 }, { "a", BindingKind::LOCAL, 0, 0 },
+		{ "d", BindingKind::LOCAL, 0, 2 }, { "b", BindingKind::LOCAL, 0, 1 },
+		{ "e", BindingKind::LOCAL, 0, 3 }, { "d", BindingKind::LOCAL, 0, 2 },
+		{ "add", BindingKind::LOCAL, 0, 2 }, { "x", BindingKind::LOCAL, 0, 0 },
+		{ "x", BindingKind::LOCAL, 0, 0 }, { "a", BindingKind::LOCAL, 1, 0 },
+		{ "g", BindingKind::GLOBAL, 0, 1 }, { "print", BindingKind::NATIVE, 0, 0 },
+		{ "add", BindingKind::LOCAL, 0, 2 }, { "g", BindingKind::GLOBAL, 0, 1 },
+		{ "t", BindingKind::LOCAL, 0, 0 }, { "g", BindingKind::GLOBAL, 0, 1 },
+	};
+	std::vector<IdentifierNode*> identifiers = CollectIdentifiers(program);
+	ASSERT_EQ(identifiers.size(), std::size(expected));
+	for (size_t i = 0; i < identifiers.size(); i++) {
+		SCOPED_TRACE(std::string(expected[i].name) + " at " + std::to_string(i));
+		EXPECT_EQ(identifiers[i]->GetName(), expected[i].name);
+		EXPECT_EQ(identifiers[i]->m_binding, expected[i].binding);
+		EXPECT_EQ(identifiers[i]->m_depth, expected[i].depth);
+		EXPECT_EQ(identifiers[i]->m_slot, expected[i].slot);
+	}
+}
+
+// functions and top-level statements, with errors in some of both
+static std::string MakeCheckedScript(int count) {
+	std::string source = "let int total = 0;\n";
+	for (int i = 0; i < count; i++) {
+		std::string n = std::to_string(i);
+		source += "function int f" + n + "(int a) {\n\tlet int b[2] = { a, " + n + " };\n";
+		source += i % 7 == 3 ? "\treturn \"s\";\n}\n" : "\treturn b[1] + f" + std::to_string(i / 2) + "(a);\n}\n";
+		if (i % 5 == 0)
+			source += i % 10 == 0 ? "total += f" + n + "(1);\n" : "total = missing" + n + ";\n";
+	}
+	return source;
+}
+
+TEST(SemanticAnalyzerTest, ParallelMatchesSequential) {
+	const std::string source = MakeCheckedScript(400);
+	Parser sequentialParser, parallelParser;
+	AstNode* sequentialRoot = sequentialParser.Parse(source);
+	AstNode* parallelRoot = parallelParser.Parse(source);
+	SemanticAnalyzer sequential, parallel;
+	ThreadPool pool(3);
+	EXPECT_FALSE(sequential.Analyze(sequentialRoot));
+	for (int round = 0; round < 2; round++) {
+		EXPECT_FALSE(parallel.Analyze(parallelRoot, pool, 4));
+
+		const auto& expected = sequential.GetDiagnostics();
+		const auto& actual = parallel.GetDiagnostics();
+		ASSERT_EQ(actual.size(), expected.size());
+		EXPECT_GT(actual.size(), 90);
+		for (size_t i = 0; i < actual.size(); i++) {
+			EXPECT_EQ(actual[i].GetMessage(), expected[i].GetMessage());
+			EXPECT_EQ(actual[i].GetRow(), expected[i].GetRow());
+			EXPECT_EQ(actual[i].GetCol(), expected[i].GetCol());
+		}
+
+		std::vector<IdentifierNode*> expectedNames = CollectIdentifiers(sequentialRoot);
+		std::vector<IdentifierNode*> actualNames = CollectIdentifiers(parallelRoot);
+		ASSERT_EQ(actualNames.size(), expectedNames.size());
+		for (size_t i = 0; i < actualNames.size(); i++) {
+			EXPECT_EQ(actualNames[i]->m_binding, expectedNames[i]->m_binding);
+			EXPECT_EQ(actualNames[i]->m_slot, expectedNames[i]->m_slot);
+			// names being declared are not expressions and get no type
+			const TypeInfo* type = actualNames[i]->m_valueType;
+			ASSERT_EQ(type == nullptr, expectedNames[i]->m_valueType == nullptr);
+			if (type) {
+				EXPECT_EQ(type->ToString(), expectedNames[i]->m_valueType->ToString());
+			}
+		}
+		auto* program = static_cast<ProgramNode*>(parallelRoot);
+		EXPECT_EQ(static_cast<FunctionDeclNode*>(program->m_declarations[1])->m_frameSize, 2);
+	}
+	// what the parallel check recorded serves Reanalyze too
+	AstNode* changed[] = { static_cast<ProgramNode*>(parallelRoot)->m_declarations[5] };
+	EXPECT_FALSE(parallel.Reanalyze(parallelRoot, changed));
+	EXPECT_EQ(parallel.GetLastCheckedCount(), 1);
+	ASSERT_EQ(parallel.GetDiagnostics().size(), sequential.GetDiagnostics().size());
+	for (size_t i = 0; i < parallel.GetDiagnostics().size(); i++)
+		EXPECT_EQ(parallel.GetDiagnostics()[i].GetRow(), sequential.GetDiagnostics()[i].GetRow());
+
+	// too few functions to split, checked sequentially
+	EXPECT_TRUE(parallel.Analyze(parallelParser.Parse(ValidProgram), pool, 4));
+}
+
+// the diagnostics of reanalyzed against those of analyzing the edited source from scratch
+static void ExpectSameAsFresh(const SemanticAnalyzer& reanalyzed, std::string_view source) {
+	Parser parser;
+	SemanticAnalyzer fresh;
+	fresh.Analyze(parser.Parse(std::string(source)));
+	const auto& expected = fresh.GetDiagnostics();
+	const auto& actual = reanalyzed.GetDiagnostics();
+	ASSERT_EQ(actual.size(), expected.size());
+	for (size_t i = 0; i < actual.size(); i++) {
+		EXPECT_EQ(actual[i].GetMessage(), expected[i].GetMessage());
+		EXPECT_EQ(actual[i].GetRow(), expected[i].GetRow());
+		EXPECT_EQ(actual[i].GetCol(), expected[i].GetCol());
+	}
+}
+
+TEST(SemanticAnalyzerTest, ReanalyzesOnlyWhatAnEditAffects) {
+	Parser parser;
+	AstNode* root = parser.Parse(R"(function int f(int a) { return a; }
+function int g() { return f(1) + 1; }
+function int h() { let int n = 2; return n; }
+let int x = f(2);
+{ let string s = "s"; }
+h(true);
+)");
+	SemanticAnalyzer analyzer;
+	EXPECT_FALSE(analyzer.Analyze(root));
+	ASSERT_EQ(analyzer.GetDiagnostics().size(), 1);
+	EXPECT_EQ(analyzer.GetLastCheckedCount(), 6);
+
+	auto edit = [&](std::string_view from, std::string_view to) {
+		size_t offset = parser.GetSource().find(from);
+		ASSERT_NE(offset, std::string_view::npos);
+		parser.Reparse({ offset, from.size(), to });
+	};
+	auto reanalyze = [&] {
+		AstNode* changed[] = { parser.GetLastReparsed() };
+		return analyzer.Reanalyze(parser.GetAstRoot(), changed);
+	};
+
+	// a body: only its function is checked again
+	edit("let int n = 2;", "let int n = \"2\";");
+	ASSERT_TRUE(parser.LastReparseIncremental());
+	EXPECT_FALSE(reanalyze());
+	EXPECT_EQ(analyzer.GetLastCheckedCount(), 1);
+	ExpectSameAsFresh(analyzer, parser.GetSource());
+
+	// a block outside functions
+	edit("let string s = \"s\";", "let string s = 1;");
+	ASSERT_TRUE(parser.LastReparseIncremental());
+	EXPECT_FALSE(reanalyze());
+	EXPECT_EQ(analyzer.GetLastCheckedCount(), 1);
+	ExpectSameAsFresh(analyzer, parser.GetSource());
+
+	// a signature: its users g and x are checked again
+	edit("int a) { return a;", "string a) { return 1;");
+	ASSERT_TRUE(parser.LastReparseIncremental());
+	EXPECT_FALSE(reanalyze());
+	EXPECT_EQ(analyzer.GetLastCheckedCount(), 3);
+	ExpectSameAsFresh(analyzer, parser.GetSource());
+	EXPECT_EQ(analyzer.FindGlobal("f")->ToString(), "(string) -> int");
+
+	// fixing every error again
+	edit("string a) { return 1;", "int a) { return a;");
+	edit("let int n = \"2\";", "let int n = 2;");
+	AstNode* changed[] = { parser.GetLastReparsed() };
+	edit("let string s = 1;", "let string s = \"s\";");
+	AstNode* all[] = { changed[0], parser.GetLastReparsed(), static_cast<ProgramNode*>(parser.GetAstRoot())->m_declarations[0] };
+	EXPECT_FALSE(analyzer.Reanalyze(parser.GetAstRoot(), all));
+	ExpectSameAsFresh(analyzer, parser.GetSource());
+	ASSERT_EQ(analyzer.GetDiagnostics().size(), 1);
+
+	// a renamed function changes what the others see, everything is checked
+	edit("int h() {", "int k() {");
+	ASSERT_TRUE(parser.LastReparseIncremental());
+	EXPECT_FALSE(reanalyze());
+	EXPECT_EQ(analyzer.GetLastCheckedCount(), 6);
+	ExpectSameAsFresh(analyzer, parser.GetSource());
+	EXPECT_EQ(analyzer.GetDiagnostics()[0].GetMessage(), "use of undeclared identifier 'h'");
+
+	// a signature naming a changed function in an array size is checked again, a global naming it
+	// in its type is collected again
+	for (const char* global : { "", "let int x[f()];\n" }) {
+		Parser reparsed;
+		reparsed.Parse(std::string("function int f() { return 1; }\nfunction void g(int a[f()]) { }\n") + global + "function int h() { return 0; }\n");
+		SemanticAnalyzer incremental;
+		EXPECT_TRUE(incremental.Analyze(reparsed.GetAstRoot()));
+		size_t offset = reparsed.GetSource().find("int f() { return 1;");
+		reparsed.Reparse({ offset, 19, "string f() { return \"s\";" });
+		ASSERT_TRUE(reparsed.LastReparseIncremental());
+		AstNode* edited[] = { reparsed.GetLastReparsed() };
+		EXPECT_FALSE(incremental.Reanalyze(reparsed.GetAstRoot(), edited));
+		EXPECT_EQ(incremental.GetLastCheckedCount(), *global ? 4 : 2);
+		ExpectSameAsFresh(incremental, reparsed.GetSource());
+		ASSERT_EQ(incremental.GetDiagnostics().size(), *global ? 2 : 1);
+		EXPECT_EQ(incremental.GetDiagnostics()[0].GetMessage(), "array size must be an integer, not 'string'");
+		EXPECT_EQ(incremental.GetDiagnostics()[0].GetRow(), 2);
+	}
+}
+
+TEST(SemanticAnalyzerTest, LaysOutStructs) {
+	const char* source = R"(struct P { bool flag; double weight; char c; int n; };
+struct Q { char tag; P inner[2]; string name; };
+let Q q;
+let double w = q.inner[1].weight;
+let char c = q.tag;
+)";
+	struct Expected {
+		std::vector<uint32_t> offsets; // in declaration order
+		uint32_t size;
+		uint32_t align;
+	};
+	auto check = [&](bool reorder, const Expected& p, const Expected& q) {
+		Parser parser;
+		auto* program = static_cast<ProgramNode*>(parser.Parse(source));
+		SemanticAnalyzer analyzer;
+		analyzer.SetFieldReordering(reorder);
+		ASSERT_TRUE(analyzer.Analyze(program));
+		const TypeInfo* qType = analyzer.FindGlobal("q");
+		const TypeInfo* pType = qType->m_fields[1].m_type->m_element;
+		for (auto [type, expected] : { std::pair{ pType, &p }, std::pair{ qType, &q } }) {
+			SCOPED_TRACE(type->ToString());
+			ASSERT_EQ(type->m_fields.size(), expected->offsets.size());
+			for (size_t i = 0; i < type->m_fields.size(); i++)
+				EXPECT_EQ(type->m_fields[i].m_offset, expected->offsets[i]);
+			EXPECT_EQ(type->Size(), expected->size);
+			EXPECT_EQ(type->Alignment(), expected->align);
+		}
+		// member access reads at a fixed offset
+		auto member = [&](size_t item) {
+			auto* decl = static_cast<VariableDeclNode*>(program->m_declarations[item]);
+			return static_cast<MemberAccessNode*>(decl->m_declarators[0]->m_initializer);
+		};
+		EXPECT_EQ(member(3)->m_offset, p.offsets[1]);
+		EXPECT_EQ(member(4)->m_offset, q.offsets[0]);
+	};
+	// weight and n first, then the bytes
+	check(true, { { 16, 0, 17, 8 }, 24, 8 }, { { 56, 0, 48 }, 64, 8 });
+	check(false, { { 0, 8, 16, 24 }, 32, 8 }, { { 0, 8, 72 }, 80, 8 });
+
+	// local structs checked in parallel follow the setting too
+	std::string locals;
+	for (int i = 0; i < 80; i++)
+		locals += "function void f" + std::to_string(i) + "() { struct S { bool b; double d; }; let S s; s.b = true; }\n";
+	for (bool reorder : { true, false }) {
+		Parser parser;
+		auto* program = static_cast<ProgramNode*>(parser.Parse(locals));
+		SemanticAnalyzer analyzer;
+		analyzer.SetFieldReordering(reorder);
+		ThreadPool pool(3);
+		ASSERT_TRUE(analyzer.Analyze(program, pool, 4));
+		auto* body = static_cast<FunctionDeclNode*>(program->m_declarations.back())->m_body;
+		auto* assignment = static_cast<AssignmentExprNode*>(static_cast<ExpressionStmtNode*>(body->m_statements[2])->m_expression);
+		EXPECT_EQ(static_cast<MemberAccessNode*>(assignment->m_left)->m_offset, reorder ? 8 : 0);
+	}
+
+	TypeTable types;
+	EXPECT_EQ(types.GetArray(types.Builtin(TypeKind::CHAR), 5)->Size(), 5);
+	EXPECT_EQ(types.GetArray(types.Builtin(TypeKind::INT), 0)->Size(), 8);
+}
+
+struct SemanticErrorCase {
+	std::string input;
+	std::string message;
+	int row;
+};
+
+class SemanticErrorTest : public ::testing::TestWithParam<SemanticErrorCase> {};
+
+TEST_P(SemanticErrorTest, ReportsError) {
+	const auto& param = GetParam();
+	Parser parser;
+	SemanticAnalyzer analyzer;
+	EXPECT_FALSE(analyzer.Analyze(parser.Parse(param.input)));
+	ASSERT_FALSE(analyzer.GetDiagnostics().empty());
+	const SemanticException& diagnostic = analyzer.GetDiagnostics()[0];
+	EXPECT_EQ(diagnostic.GetMessage(), param.message);
+	EXPECT_EQ(diagnostic.GetRow(), param.row);
+	EXPECT_EQ(diagnostic.GetErrorType(), "SemanticError");
+}
+
+const std::vector<SemanticErrorCase> semanticErrorCases = {
+	{ "let int a = \"x\";", "cannot convert 'string' to 'int'", 1 },
+	{ "let int a = b;", "use of undeclared identifier 'b'", 1 },
+	{ "let int x = 1;\nlet int x = 2;", "redefinition of 'x'", 2 },
+	{ "let Shape s;", "unknown type 'Shape'", 1 },
+	{ "function int f() {\n}", "function 'f' does not return a value on every path", 1 },
+	{ "function void f(int a) {\n\treturn a;\n}", "a void function cannot return a value", 2 },
+	{ "function int f(int a) { return a; }\nlet int x = f(1, 2);", "wrong number of arguments, expected 1 and got 2", 2 },
+	{ "let int x = 1;\nlet int y = x();", "'int' is not a function", 2 },
+	{ "const int c = 1;\nc = 2;", "cannot assign to constant 'c'", 2 },
+	{ "const int c;", "const 'c' needs an initializer", 1 },
+	{ "let int a = 1;\na + 1 = 2;", "expression is not assignable", 2 },
+	{ "break;", "break outside a loop or switch", 1 },
+	{ "while (true) { }\ncontinue;", "continue outside a loop", 2 },
+	{ "return 1;", "return outside a function", 1 },
+	{ "if (\"s\") { }", "condition must be a bool or a number, not 'string'", 1 },
+	{ "let int a = 1 + \"s\";", "invalid operands 'int' and 'string' to '+'", 1 },
+	{ "let double d = 1.5 % 2;", "invalid operands 'double' and 'int' to '%'", 1 },
+	{ "let string s = -\"s\";", "invalid operand 'string' to '-'", 1 },
+	{ "let int a = 1;\nlet int b = a[0];", "cannot index 'int'", 2 },
+	{ "let int a[3];\nlet int b = a[1.5];", "array index must be an integer, not 'double'", 2 },
+	{ "let int a[0];", "array size must be positive, got 0", 1 },
+	{ "let int a[2] = { 1, 2, 3 };", "too many initializers for 'int[2]'", 1 },
+	{ "let int a = { 1 };", "cannot initialize 'int' with an initializer list", 1 },
+	{ "struct P { int x; };\nlet P p;\nlet int y = p.z;", "'P' has no member 'z'", 3 },
+	{ "let int a = 1;\nlet int b = a.x;", "member access on 'int', which is not a struct", 2 },
+	{ "struct S { S inner; };", "struct 'S' cannot contain itself", 1 },
+	{ "struct S { int a; double a; };", "duplicate member 'a' in struct 'S'", 1 },
+	{ "struct A { int n; B b; };\nstruct B { A a[2]; };", "struct 'B' cannot contain itself through 'A'", 2 },
+	{ "function void f() {\n\tstruct S { int a[1000000000]; };\n}", "struct 'S' is too large", 2 },
+	{ "let int n = 2;\nstruct S { int a[n]; };", "array size of a struct member must be a constant", 2 },
+	{ "switch (1) { case 1: break; case 1: break; }", "duplicate case value 1", 1 },
+	{ "switch (\"s\") { default: break; }", "switch condition must be an integer, not 'string'", 1 },
+	{ "let bool b = 1 ? \"s\" : 2;", "operands of '?:' have different types 'string' and 'int'", 1 },
+	{ "let (int) -> int f = lambda(int v) -> int { if (v > 0) { return v; } };",
+		"lambda does not return a value on every path", 1 },
+};
+
+INSTANTIATE_TEST_SUITE_P(SemanticErrors, SemanticErrorTest, ::testing::ValuesIn(semanticErrorCases));
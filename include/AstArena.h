@@ -0,0 +1,63 @@
+#pragma once
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace CppInterp {
+
+	// child lists of AST nodes, their storage comes from the arena that holds the node
+	template <typename T>
+	using AstList = std::pmr::vector<T>;
+
+	// Bump allocator for one parse: nodes are laid out in creation order and everything they own is
+	// allocated here as well, so they are never destroyed one by one and Reset frees them per block.
+	class AstArena : public std::pmr::memory_resource {
+	public:
+		static constexpr size_t BlockSize = 64 * 1024;
+
+		AstArena() = default;
+		AstArena(const AstArena&) = delete;
+		AstArena& operator=(const AstArena&) = delete;
+
+		// node types with child lists take the arena as their last constructor argument
+		template <typename T, typename... Args>
+		T* New(Args&&... args) {
+			void* memory = allocate(sizeof(T), alignof(T));
+			T* object;
+			if constexpr (std::is_constructible_v<T, Args..., std::pmr::memory_resource*>)
+				object = new (memory) T(std::forward<Args>(args)..., this);
+			else
+				object = new (memory) T(std::forward<Args>(args)...);
+			++m_objectCount;
+			return object;
+		}
+
+		inline size_t GetObjectCount() const { return m_objectCount; }
+		// bytes handed out, including list buffers left behind when a list grew
+		inline size_t GetBytesUsed() const { return m_bytesUsed; }
+		// bytes held by the blocks
+		size_t Capacity() const;
+		// drop every object, keeping the first block for reuse
+		void Reset();
+
+	private:
+		void* do_allocate(size_t bytes, size_t alignment) override;
+		// memory is only given back by Reset
+		void do_deallocate(void*, size_t, size_t) override {}
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+		struct Block {
+			std::unique_ptr<std::byte[]> m_data;
+			size_t m_capacity;
+		};
+
+		std::vector<Block> m_blocks;
+		std::byte* m_cursor = nullptr;
+		std::byte* m_end = nullptr;
+		size_t m_objectCount = 0;
+		size_t m_bytesUsed = 0;
+	};
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "FlatAst.h"
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+namespace CppInterp {
+
+	// Directory of parsed trees keyed by a hash of their source, so a script that did not change
+	// since its tree was stored is loaded instead of lexed and parsed again. An entry keeps its
+	// whole source; other bytes, a damaged file or another format is a miss.
+	class AstCache {
+	public:
+		// the directory is created by the first Store
+		explicit AstCache(std::filesystem::path directory);
+
+		// FNV-1a over 8-byte words, the same in every process and on every platform
+		static uint64_t Hash(std::string_view source);
+
+		std::optional<FlatAst> Load(std::string_view source) const;
+		// Written to a temporary file that is renamed over the entry, so a reader never sees half of
+		// it. False if it could not be written, the cache only saves work.
+		bool Store(std::string_view source, const FlatAst& ast) const;
+
+		std::filesystem::path EntryPath(uint64_t hash) const;
+		inline const std::filesystem::path& GetDirectory() const { return m_directory; }
+
+	private:
+		std::filesystem::path m_directory;
+	};
+}
@@ -0,0 +1,190 @@
+#pragma once
+#include "Parser.h"
+#include <array>
+#include <bit>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace CppInterp {
+
+	// Fixed children of each kind in source order, followed by an optional child list:
+	//   FUNCTION_DECL     return type, name, body; parameters
+	//   VAR_DECL          type; declarators           STRUCT_DECL    name; members
+	//   IF_STMT           condition, then, else       SWITCH_STMT    condition, default; cases
+	//   CASE_STMT         literal; statements         FOR_STMT       init, condition, increment, body
+	//   COND_EXPR         condition, true, false      FUNCTION_CALL  callee; arguments
+	//   FUNCTION_LITERAL  return type, body; params   DECLARATOR     name, initializer; array sizes
+	//   STRUCT_MEMBER     type; declarators           FUNCTION_TYPE  return type; parameter types
+	// the remaining kinds follow the members of their pointer node in declaration order.
+	struct FlatAstShape {
+		uint8_t m_slots = 0; // fixed children, absent ones are InvalidNode
+		bool m_list = false;
+	};
+	constexpr FlatAstShape ComputeFlatAstShape(NodeType::Type kind) {
+		switch (kind) {
+		case NodeType::PROGRAM: return { 0, true };
+		case NodeType::FUNCTION_DECL: return { 3, true };
+		case NodeType::COMPOUND_STMT: return { 0, true };
+		case NodeType::EXPRESSION_STMT: return { 1, false };
+		case NodeType::VAR_DECL: return { 1, true };
+		case NodeType::STRUCT_DECL: return { 1, true };
+		case NodeType::IF_STMT: return { 3, false };
+		case NodeType::SWITCH_STMT: return { 2, true };
+		case NodeType::CASE_STMT: return { 1, true };
+		case NodeType::DEFAULT_STMT: return { 0, true };
+		case NodeType::WHILE_STMT: return { 2, false };
+		case NodeType::FOR_STMT: return { 4, false };
+		case NodeType::RETURN_STMT: return { 1, false };
+		case NodeType::COMMA_EXPR: return { 0, true };
+		case NodeType::ASSIGN_EXPR: return { 2, false };
+		case NodeType::COND_EXPR: return { 3, false };
+		case NodeType::BINARY_EXPR: return { 2, false };
+		case NodeType::UNARY_EXPR: return { 1, false };
+		case NodeType::POSTFIX_EXPR: return { 1, false };
+		case NodeType::FUNCTION_CALL: return { 1, true };
+		case NodeType::ARRAY_INDEX: return { 2, false };
+		case NodeType::MEMBER_ACCESS: return { 2, false };
+		case NodeType::FUNCTION_LITERAL: return { 2, true };
+		case NodeType::PARAMETER: return { 2, false };
+		case NodeType::DECLARATOR: return { 2, true };
+		case NodeType::STRUCT_MEMBER_DECL: return { 1, true };
+		case NodeType::INITIALIZER: return { 0, true };
+		case NodeType::FUNCTION_TYPE: return { 1, true };
+		// leaves, BREAK_STMT and CONTINUE_STMT have nothing, the others carry their data in the operands
+		default: return { 0, false };
+		}
+	}
+
+	// indexed by kind
+	inline constexpr std::array<FlatAstShape, 256> FlatAstShapes = [] {
+		std::array<FlatAstShape, 256> shapes{};
+		for (size_t kind = 0; kind < shapes.size(); kind++)
+			shapes[kind] = ComputeFlatAstShape(static_cast<NodeType::Type>(kind));
+		return shapes;
+	}();
+
+	// Index-based copy of a parsed tree for later phases. Nodes are numbered in preorder (the root
+	// is 0) and every node is one row of parallel arrays: kind, operator, position and two 32-bit
+	// operands. Nodes with more than two children or a child list keep them in one shared extra
+	// array, so the whole tree is a handful of flat buffers without vtables or parent pointers.
+	class FlatAst {
+	public:
+		using NodeIndex = uint32_t;
+		static constexpr NodeIndex InvalidNode = UINT32_MAX;
+		static constexpr NodeIndex Root = 0;
+
+		using Shape = FlatAstShape;
+		static constexpr Shape GetShape(NodeType::Type kind) { return FlatAstShapes[kind]; }
+
+		// Copies the tree under root. origins, when given, receives the pointer node of every index.
+		static FlatAst FromTree(const AstNode* root, std::vector<const AstNode*>* origins = nullptr);
+
+		inline size_t Size() const { return m_kinds.size(); }
+		inline bool Empty() const { return m_kinds.empty(); }
+
+		inline NodeType::Type Kind(NodeIndex node) const { return m_kinds[node]; }
+		// OpCode of operator nodes, the literal TokenType of LITERAL, 1 for const VAR_DECL and string IMPORT
+		inline uint8_t Op(NodeIndex node) const { return m_ops[node]; }
+		inline int Line(NodeIndex node) const { return static_cast<int>(m_lines[node]); }
+		inline int Column(NodeIndex node) const { return static_cast<int>(m_columns[node]); }
+
+		// fixed child slot of the node's shape, InvalidNode when absent
+		inline NodeIndex Child(NodeIndex node, size_t slot) const {
+			return Inline(m_kinds[node]) ? (slot == 0 ? m_lhs[node] : m_rhs[node]) : m_extra[m_lhs[node] + slot];
+		}
+		// the child list of the node's shape, empty for kinds without one
+		inline std::span<const NodeIndex> List(NodeIndex node) const {
+			Shape shape = GetShape(m_kinds[node]);
+			if (!shape.m_list)
+				return {};
+			const NodeIndex* count = m_extra.data() + m_lhs[node] + shape.m_slots;
+			return { count + 1, *count };
+		}
+
+		// IDENTIFIER and NAMED_TYPE
+		inline SymbolId Symbol(NodeIndex node) const { return m_lhs[node]; }
+		// module name of IMPORT_STMT, spelling of BUILTIN_TYPE and LITERAL
+		inline std::string_view Text(NodeIndex node) const { return m_texts[m_lhs[node]]; }
+		// decoded LITERAL, strings are kept as text and the other kinds as 64 bits, doubles by their bits
+		inline LiteralValue Literal(NodeIndex node) const {
+			LiteralValue value;
+			if (m_ops[node] == TokenType::STRING_LITERAL) {
+				value.m_string = m_texts[m_rhs[node]];
+				return value;
+			}
+			int64_t bits = m_literals[m_rhs[node]];
+			switch (m_ops[node]) {
+			case TokenType::DOUBLE_LITERAL: value.m_double = std::bit_cast<double>(bits); break;
+			case TokenType::CHARACTER_LITERAL: value.m_char = static_cast<char>(bits); break;
+			case TokenType::BOOL_LITERAL: value.m_bool = bits != 0; break;
+			default: value.m_int = bits; break;
+			}
+			return value;
+		}
+
+		// fixed children then the list, skipping absent slots
+		template <typename F>
+		void ForEachChild(NodeIndex node, F&& function) const {
+			Shape shape = GetShape(m_kinds[node]);
+			for (size_t slot = 0; slot < shape.m_slots; slot++) {
+				NodeIndex child = Child(node, slot);
+				if (child != InvalidNode)
+					function(child);
+			}
+			for (NodeIndex child : List(node))
+				function(child);
+		}
+
+		// Preorder walk. visitor.Enter(ast, node) returns false to skip the children and
+		// visitor.Leave(ast, node), if the visitor has one, is called after them. Passes that do not
+		// need the structure can simply loop over the indices, which are already in preorder.
+		template <typename Visitor>
+		void Walk(Visitor& visitor, NodeIndex node = Root) const {
+			if (!visitor.Enter(*this, node))
+				return;
+			ForEachChild(node, [&](NodeIndex child) { Walk(visitor, child); });
+			if constexpr (requires { visitor.Leave(*this, node); })
+				visitor.Leave(*this, node);
+		}
+
+		// bytes held by the buffers
+		size_t MemoryUsage() const;
+
+		// Builds the pointer tree again, nodes in arena and texts copied into texts. Symbols are those
+		// of this process, FromBinary already maps them.
+		AstNode* ToTree(AstArena& arena, TextArena& texts) const;
+
+		// Compact image for caches: the arrays go through the Common Serializer as varints, lines as
+		// differences and symbols as their names, so an image can be loaded by another process.
+		std::string ToBinary() const;
+		// throws std::runtime_error for an image that is damaged or from another format version
+		static FlatAst FromBinary(const std::string& image);
+
+	private:
+		friend class FlatAstBuilder;
+		friend class FlatAstLoader;
+
+		// throws std::runtime_error unless every index points where the accessors may read and every
+		// child has a kind its slot allows, so ToTree can cast it
+		void Validate() const;
+
+		// fixed children live in the operands themselves
+		static constexpr bool Inline(NodeType::Type kind) {
+			Shape shape = GetShape(kind);
+			return !shape.m_list && shape.m_slots <= 2;
+		}
+
+		std::vector<NodeType::Type> m_kinds;
+		std::vector<uint8_t> m_ops;
+		std::vector<uint32_t> m_lines;
+		std::vector<uint32_t> m_columns;
+		std::vector<uint32_t> m_lhs; // child, extra offset, symbol or text index
+		std::vector<uint32_t> m_rhs; // child, literal or decoded string index
+		std::vector<NodeIndex> m_extra;
+		std::vector<std::string_view> m_texts;
+		std::vector<int64_t> m_literals;
+		std::shared_ptr<const std::string> m_ownedText; // texts of a tree loaded by FromBinary
+	};
+}
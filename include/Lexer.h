@@ -1,9 +1,16 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include <memory>
 #include <vector>
-#include<unordered_map>
-#include<functional>
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <iterator>
 #include "Singleton.h"
+#include "ThreadPool.h"
+#include "TextArena.h"
+#include "SymbolTable.h"
 #include <stdexcept>
 #include<optional>
 #include "Exception.hpp"
@@ -48,7 +55,7 @@ namespace CppInterp {
 		constexpr Type COLON = 27;           // :
 		constexpr Type QUESTION = 28;        // ?
 		constexpr Type DOT = 29;             // .
-		//constexpr Type BACKSLASH = 30;       // \	
+		//constexpr Type BACKSLASH = 30;       // '\\'
 
 		// multiple symbol
 		constexpr Type SELF_ADD = 31;        // +=
@@ -69,12 +76,97 @@ namespace CppInterp {
 		constexpr Type DECREMENT = 46;       // --
 		constexpr Type POINT_TO = 47;        // ->
 		constexpr Type BELONG_TO = 48;       // ::
-		constexpr Type RIGHT_MOVE = 48;       // >>
-		constexpr Type LEFT_MOVE = 49;        // <<
-		constexpr Type SELF_RIGHT_MOVE = 50;  // >>=
-		constexpr Type SELF_LEFT_MOVE = 51;   // <<=
+		constexpr Type RIGHT_MOVE = 49;       // >>
+		constexpr Type LEFT_MOVE = 50;        // <<
+		constexpr Type SELF_RIGHT_MOVE = 51;  // >>=
+		constexpr Type SELF_LEFT_MOVE = 52;   // <<=
+
+		// keyword, recognized by the lexer when an identifier is accepted
+		constexpr Type FUNCTION = 53;      // function
+		constexpr Type LET = 54;           // let
+		constexpr Type CONST = 55;           // const
+		constexpr Type STRUCT = 56;           // struct
+		constexpr Type IF = 57;            // if
+		constexpr Type ELSE = 58;          // else
+		constexpr Type SWITCH = 59;          // switch
+		constexpr Type CASE = 60;          // case
+		constexpr Type DEFAULT = 61;          // default
+		constexpr Type WHILE = 62;         // while
+		constexpr Type FOR = 63;           // for
+		constexpr Type RETURN = 64;        // return
+		constexpr Type BREAK = 65;         // break
+		constexpr Type CONTINUE = 66;      // continue
+		constexpr Type BOOL_LITERAL = 67;          // false, true
+		constexpr Type NULL_LITERAL = 68;  // NULL
+		constexpr Type INT = 69;   // int
+		constexpr Type DOUBLE = 70;   // double
+		constexpr Type CHAR = 71;   // char
+		constexpr Type STRING = 72;   // string
+		constexpr Type BOOL = 73;   // bool
+		constexpr Type VOID = 74;   // void
+		constexpr Type IMPORT = 75;   // import
+		constexpr Type LAMBDA = 76;   // lambda
+
+		constexpr bool IsKeyword(Type type) {
+			return type >= FUNCTION && type <= LAMBDA;
+		}
 	}
 
+	// Keyword type of an identifier, or IDENTIFIER. Dispatches on length and first character,
+	// so at most one comparison against a keyword spelling is made.
+	constexpr TokenType::Type ClassifyKeyword(std::string_view word) {
+		auto is = [word](std::string_view keyword, TokenType::Type type) {
+			return word == keyword ? type : TokenType::IDENTIFIER;
+		};
+		switch (word.size()) {
+		case 2:
+			return is("if", TokenType::IF);
+		case 3:
+			switch (word[0]) {
+			case 'l': return is("let", TokenType::LET);
+			case 'f': return is("for", TokenType::FOR);
+			case 'i': return is("int", TokenType::INT);
+			}
+			break;
+		case 4:
+			switch (word[0]) {
+			case 'e': return is("else", TokenType::ELSE);
+			case 'c': return word[1] == 'a' ? is("case", TokenType::CASE) : is("char", TokenType::CHAR);
+			case 't': return is("true", TokenType::BOOL_LITERAL);
+			case 'N': return is("NULL", TokenType::NULL_LITERAL);
+			case 'b': return is("bool", TokenType::BOOL);
+			case 'v': return is("void", TokenType::VOID);
+			}
+			break;
+		case 5:
+			switch (word[0]) {
+			case 'c': return is("const", TokenType::CONST);
+			case 'w': return is("while", TokenType::WHILE);
+			case 'b': return is("break", TokenType::BREAK);
+			case 'f': return is("false", TokenType::BOOL_LITERAL);
+			}
+			break;
+		case 6:
+			switch (word[0]) {
+			case 's':
+				switch (word[1]) {
+				case 't': return word[3] == 'u' ? is("struct", TokenType::STRUCT) : is("string", TokenType::STRING);
+				case 'w': return is("switch", TokenType::SWITCH);
+				}
+				break;
+			case 'r': return is("return", TokenType::RETURN);
+			case 'd': return is("double", TokenType::DOUBLE);
+			case 'i': return is("import", TokenType::IMPORT);
+			case 'l': return is("lambda", TokenType::LAMBDA);
+			}
+			break;
+		case 7:
+			return is("default", TokenType::DEFAULT);
+		case 8:
+			return word[0] == 'f' ? is("function", TokenType::FUNCTION) : is("continue", TokenType::CONTINUE);
+		}
+		return TokenType::IDENTIFIER;
+	}
 
 	namespace Character {
 		using Type = uint8_t;
@@ -108,7 +200,7 @@ namespace CppInterp {
 		constexpr Type COLON = 24;           // :
 		constexpr Type QUESTION = 25;        // ?
 		constexpr Type DOT = 26;             // .
-		constexpr Type BACKSLASH = 27;       // \	
+		constexpr Type BACKSLASH = 27;       // '\\'
 		constexpr Type UNDERSCORE = 28;       // _
 		constexpr Type SINGLE_QUOTE = 29;    // '
 		constexpr Type DOUBLE_QUOTE = 30;    // "
@@ -116,57 +208,265 @@ namespace CppInterp {
 		constexpr Type LINESPLIT = 32;         // '\r' '\n' 
 	}
 
+	using CharacterTable = std::array<Character::Type, 256>;
+
+	constexpr CharacterTable BuildCharacterTable() {
+		CharacterTable table{};
+		for (int i = 0; i < 26; i++) {
+			table['a' + i] = Character::LETTER;
+			table['A' + i] = Character::LETTER;
+		}
+		for (int i = 0; i < 10; i++) {
+			table['0' + i] = Character::NUMBER;
+		}
+		table['('] = Character::LEFT_PAREN;
+		table[')'] = Character::RIGHT_PAREN;
+		table['{'] = Character::LEFT_BRACE;
+		table['}'] = Character::RIGHT_BRACE;
+		table['['] = Character::LEFT_SQUARE;
+		table[']'] = Character::RIGHT_SQUARE;
+		table[';'] = Character::SEMICOLON;
+		table[','] = Character::COMMA;
+		table['+'] = Character::ADD;
+		table['-'] = Character::SUBTRACT;
+		table['*'] = Character::MULTIPLY;
+		table['/'] = Character::DIVIDE;
+		table['%'] = Character::MODULO;
+		table['>'] = Character::GREATER;
+		table['<'] = Character::LESS;
+		table['!'] = Character::NOT;
+		table['='] = Character::ASSIGN;
+		table['&'] = Character::BIT_AND;
+		table['|'] = Character::BIT_OR;
+		table['^'] = Character::XOR;
+		table['~'] = Character::BIT_NOT;
+		table[':'] = Character::COLON;
+		table['?'] = Character::QUESTION;
+		table['.'] = Character::DOT;
+		table['\\'] = Character::BACKSLASH;
+		table['_'] = Character::UNDERSCORE;
+		table['\''] = Character::SINGLE_QUOTE;
+		table['"'] = Character::DOUBLE_QUOTE;
+		table[' '] = Character::WORDSPLIT;
+		table['\t'] = Character::WORDSPLIT;
+		table['\n'] = Character::LINESPLIT;
+		table['\r'] = Character::LINESPLIT;
+		return table;
+	}
+
 	class CharacterSet :public Singleton<CharacterSet> {
 		friend class ::Singleton<CharacterSet>;
 	public:
 		inline std::optional<Character::Type> GetCharacterType(char ch) const {
-			auto it = m_characterSet.find(ch);
-			if (it == m_characterSet.end()) {
+			Character::Type type = s_characterTable[static_cast<unsigned char>(ch)];
+			if (type == Character::UNKNOWN) {
 				return std::nullopt;
 			}
-			return it->second;
+			return type;
+		}
+
+		static constexpr const CharacterTable& GetCharacterTable() {
+			return s_characterTable;
 		}
 	private:
-		CharacterSet();
+		CharacterSet() = default;
 
-		std::unordered_map<char, Character::Type> m_characterSet;
+		static constexpr CharacterTable s_characterTable = BuildCharacterTable();
 	};
 
+	// escape character after '\\' and the character it stands for
+	constexpr std::array<std::pair<char, char>, 7> EscapeCharacterPairs = { {
+		{ 'n', '\n' },
+		{ 't', '\t' },
+		{ 'r', '\r' },
+		{ '\'', '\'' },
+		{ '"', '\"' },
+		{ '\\', '\\' },
+		{ '0', '\0' },
+	} };
+
+	// escaped value per byte, -1 if the byte can not follow '\\'
+	using EscapeTable = std::array<int16_t, 256>;
+
+	constexpr EscapeTable BuildEscapeTable() {
+		EscapeTable table{};
+		table.fill(-1);
+		for (auto [ch, escapeCh] : EscapeCharacterPairs) {
+			table[static_cast<unsigned char>(ch)] = static_cast<unsigned char>(escapeCh);
+		}
+		return table;
+	}
+
 	class EscapeCharacterSet : public Singleton<EscapeCharacterSet> {
 		friend class ::Singleton<EscapeCharacterSet>;
 	public:
 		inline bool IsEscapeCharacter(char ch) const {
-			return m_escapeCharacterSet.find(ch) != m_escapeCharacterSet.end();
+			return s_escapeTable[static_cast<unsigned char>(ch)] >= 0;
 		}
 
 		inline std::optional<char> Transform(char ch) const {
-			auto it = m_escapeCharacterSet.find(ch);
-			if (it == m_escapeCharacterSet.end()) {
+			int16_t escapeCh = s_escapeTable[static_cast<unsigned char>(ch)];
+			if (escapeCh < 0) {
 				return std::nullopt;
 			}
-			return it->second;
-		}
-
-		inline const std::unordered_map<char, char>& GetEscapeCharacterSet() const {
-			return m_escapeCharacterSet;
+			return static_cast<char>(escapeCh);
 		}
 
 	private:
-		EscapeCharacterSet();
+		EscapeCharacterSet() = default;
+
+		static constexpr EscapeTable s_escapeTable = BuildEscapeTable();
+	};
+
+	// Value of a literal token, decoded by the lexer. String and character text is unescaped
+	// while lexing, m_string views a string literal without its quotes.
+	struct LiteralValue {
+		union {
+			int64_t m_int;			// INT_LITERAL
+			double m_double;		// DOUBLE_LITERAL
+			char m_char;			// CHARACTER_LITERAL
+			bool m_bool;			// BOOL_LITERAL
+		};
+		std::string_view m_string;	// STRING_LITERAL
 
-		std::unordered_map<char, char> m_escapeCharacterSet;
+		constexpr LiteralValue() :m_int(0) {}
 	};
 
+	// m_content views either the lexed source or the owning TokenList's literal buffer.
+	// Identifiers also carry their interned symbol, other tokens have InvalidSymbol.
 	struct Token {
 		TokenType::Type m_type;
-		std::string m_content;
+		SymbolId m_symbol;
+		std::string_view m_content;
 		int m_line;
 		int m_column;
+		LiteralValue m_literal;
+
+		Token() :m_type(TokenType::UNKNOWN), m_symbol(InvalidSymbol), m_content(), m_line(0), m_column(0) {}
+		Token(TokenType::Type type, std::string_view content, int line, int column, SymbolId symbol = InvalidSymbol)
+			:m_type(type), m_symbol(symbol), m_content(content), m_line(line), m_column(column) {
+		}
+	};
+
+	// Tokens of one source as parallel arrays: a dense type array for lookahead, the start offset
+	// of each token, and one 32-bit extra per token. The extra of an identifier is its SymbolId;
+	// for other tokens it is the length of the text in the source, or with StoredFlag set, the index
+	// of text stored in the list (literals that do not appear verbatim in the source: unescaped,
+	// or split across chunks). Numeric literal values are kept in a side table.
+	// Line and column are computed from an index of line start offsets.
+	// Indexing builds a Token on the fly, its views into the source must outlive the list.
+	class TokenList {
+	public:
+		class ConstIterator {
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = Token;
+			using difference_type = std::ptrdiff_t;
+			using pointer = void;
+			using reference = Token;
+
+			ConstIterator() = default;
+			ConstIterator(const TokenList* list, size_t index) :m_list(list), m_index(index) {}
+			inline Token operator*() const { return (*m_list)[m_index]; }
+			inline ConstIterator& operator++() { ++m_index; return *this; }
+			inline ConstIterator operator++(int) { ConstIterator old = *this; ++m_index; return old; }
+			inline bool operator==(const ConstIterator& other) const { return m_index == other.m_index; }
+
+		private:
+			const TokenList* m_list = nullptr;
+			size_t m_index = 0;
+		};
+
+		static constexpr uint32_t StoredFlag = 0x80000000u;
 
-		Token() :m_type(TokenType::UNKNOWN), m_content(""), m_line(0), m_column(0) {}
-		Token(TokenType::Type type, const std::string& content, int line, int column)
-			:m_type(type), m_content(content), m_line(line), m_column(column) {
+		TokenList() = default;
+		TokenList(const TokenList& other);
+		TokenList(TokenList&& other) noexcept = default;
+		TokenList& operator=(TokenList other) noexcept;
+
+		inline size_t size() const { return m_types.size(); }
+		inline bool empty() const { return m_types.empty(); }
+		Token operator[](size_t index) const;
+		inline Token back() const { return (*this)[size() - 1]; }
+		inline ConstIterator begin() const { return ConstIterator(this, 0); }
+		inline ConstIterator end() const { return ConstIterator(this, size()); }
+
+		inline TokenType::Type Type(size_t index) const { return m_types[index]; }
+		inline const TokenType::Type* Types() const { return m_types.data(); }
+		inline uint32_t Offset(size_t index) const { return m_offsets[index]; }
+		inline SymbolId Symbol(size_t index) const {
+			return m_types[index] == TokenType::IDENTIFIER ? m_extras[index] : InvalidSymbol;
+		}
+		std::string_view Content(size_t index) const;
+		// decoded value of a literal token, zero for other tokens
+		LiteralValue Literal(size_t index) const;
+		// line and column of the token's first byte
+		std::pair<int, int> Position(size_t index) const;
+		// bytes held by the arrays and stored literals
+		size_t MemoryUsage() const;
+
+		// Append a token built elsewhere, its content is viewed as is. Positions are mapped onto
+		// synthetic offsets, so tokens must come in source order.
+		void push_back(const Token& token);
+		// drop the tokens but keep stored literals, tokens copied out of the list may still view them
+		void clear();
+		// drop the tokens and stored literals, line starts from keepLinesFrom's line on are kept
+		void Reset(uint32_t keepLinesFrom = UINT32_MAX);
+		// drop everything and start again at line 1, the arrays keep their capacity
+		void Restart();
+
+		// Move the tokens of other to the end. other must continue the same source, lexed into
+		// its own list starting at the start of this list's last line (see ResetLines).
+		void Append(TokenList&& other);
+
+		// used by the lexer: content offsets are relative to base, which is at baseOffset in the source
+		inline void SetSource(const char* base, uint32_t baseOffset) {
+			m_base = base;
+			m_baseOffset = baseOffset;
+		}
+		// restart the line index with line at lineStart
+		inline void ResetLines(int line, uint32_t lineStart) {
+			m_firstLine = line;
+			m_lineStarts.assign(1, lineStart);
 		}
+		inline void AddLineStart(uint32_t offset) { m_lineStarts.push_back(offset); }
+		inline void EmplaceSourceToken(TokenType::Type type, uint32_t offset, uint32_t length) {
+			m_types.push_back(type);
+			m_offsets.push_back(offset);
+			m_extras.push_back(length);
+		}
+		inline void EmplaceStoredToken(TokenType::Type type, uint32_t offset, std::string_view content) {
+			m_types.push_back(type);
+			m_offsets.push_back(offset);
+			m_extras.push_back(StoredFlag | static_cast<uint32_t>(m_stored.size()));
+			m_stored.push_back(content);
+		}
+		// value of the numeric literal just emplaced
+		inline void SetNumber(int64_t bits) {
+			m_numberTokens.push_back(static_cast<uint32_t>(size() - 1));
+			m_numbers.push_back(bits);
+		}
+		// replace the text extra of identifiers from first on with their symbol, under one table lock
+		void InternIdentifiers(size_t first);
+
+		inline std::string_view StoreLiteral(std::string_view literal) { return m_literals.Store(literal); }
+		inline bool OwnsLiteral(std::string_view content) const { return m_literals.Owns(content.data()); }
+
+	private:
+		std::string_view TextContent(size_t index) const;
+
+		std::vector<TokenType::Type> m_types;
+		std::vector<uint32_t> m_offsets;
+		std::vector<uint32_t> m_extras;
+		std::vector<std::string_view> m_stored;
+		std::vector<uint32_t> m_numberTokens;		// ascending indices of numeric literals
+		std::vector<int64_t> m_numbers;				// their values, doubles as bits
+		const char* m_base = nullptr;
+		uint32_t m_baseOffset = 0;
+		int m_firstLine = 1;						// line number of m_lineStarts[0]
+		std::vector<uint32_t> m_lineStarts{ 0 };
+		uint32_t m_end = 0;							// past the last synthetic offset of push_back
+		TextArena m_literals;
 	};
 
 	namespace State {
@@ -200,7 +500,7 @@ namespace CppInterp {
 
 	constexpr int StateSize = 25;
 
-	enum class Action {
+	enum class Action : uint8_t {
 		FORWARD,
 		RETRACT,
 		APPEND, //FORWARD + RETRACT
@@ -208,6 +508,7 @@ namespace CppInterp {
 		CLEAR,
 		NEWLINE,
 		ESCAPE,
+		REJECT, //no transition for this character
 	};
 
 	struct Transition {
@@ -215,24 +516,64 @@ namespace CppInterp {
 		TokenType::Type m_tokenType;
 		Action m_action;
 
-		Transition()
-			:m_next(State::START), m_tokenType(TokenType::UNKNOWN), m_action(Action::FORWARD) {
+		constexpr Transition()
+			:m_next(State::START), m_tokenType(TokenType::UNKNOWN), m_action(Action::REJECT) {
 		}
 
-		Transition(State::Type next, TokenType::Type tokenType, Action action)
+		constexpr Transition(State::Type next, TokenType::Type tokenType, Action action)
 			:m_next(next), m_tokenType(tokenType), m_action(action) {
 		}
 	};
 
+	// indexed by [state][input byte], character classes are folded in at compile time
+	using TransitionTable = std::array<std::array<Transition, 256>, StateSize>;
+
+	// FSM position carried from one chunk of a source to the next
+	struct LexContext {
+		State::Type m_state = State::START;
+		int m_row = 1;
+		int m_col = 1;
+		uint32_t m_offset = 0;			// source offset of the next chunk
+		bool m_pending = false;			// a token has started and is not emitted yet
+		bool m_spilled = false;			// its text is in m_spill instead of the current chunk
+		uint32_t m_tokenOffset = 0;
+		TokenType::Type m_pendingType = TokenType::UNKNOWN;
+		std::string m_spill;
+		// skip blank, identifier, comment and string body runs with LexerScan instead of byte by byte
+		bool m_fastScan = true;
+	};
+
 	class Lexer :public Singleton<Lexer> {
 		friend class ::Singleton<Lexer>;
 	public:
-		std::vector<Token> Tokenize(const std::string& str);
+		// tokens view into source, which must outlive the returned list
+		TokenList Tokenize(std::string_view source);
+		inline TokenList Tokenize(const char* source) { return Tokenize(std::string_view(source)); }
+		TokenList Tokenize(std::string&& source) = delete;
+		// Lex into tokens, dropping what it held. Its arrays keep their capacity, so a list reused
+		// for many small sources stops allocating once it has grown to fit them.
+		void Tokenize(std::string_view source, TokenList& tokens);
+		// Lex source split at line starts into up to chunkCount chunks on pool, the result and any
+		// exception are the same as Tokenize(source). Must not be called from a task of pool.
+		TokenList Tokenize(std::string_view source, ThreadPool& pool, size_t chunkCount);
+		// the same into tokens, which keep their capacity as with Tokenize(source, tokens)
+		void Tokenize(std::string_view source, TokenList& tokens, ThreadPool& pool, size_t chunkCount);
+
+		// Lex the next chunk of a source, resuming from context. Tokens inside the chunk view it, tokens
+		// spanning chunks or containing escapes are stored in the list. last flushes the pending token.
+		// Tokens already in the list must view the preceding bytes of the same buffer, or be Reset.
+		void TokenizeChunk(LexContext& context, std::string_view chunk, bool last, TokenList& tokens) const;
+
+		// chunks smaller than this are not worth a task
+		static constexpr size_t MinParallelChunkSize = 256 * 1024;
 
 	private:
 		Lexer();
 
-		std::unordered_map<Character::Type, Transition> m_stateTransitionTable[StateSize];
-		std::unordered_map<State::Type, Transition> m_stateOtherTransitionTable;
+		[[noreturn]] void ThrowRejected(State::Type state, char ch, int row, int col) const;
+		// decode the numeric literal at the end of tokens into its value
+		void DecodeNumber(TokenType::Type type, TokenList& tokens) const;
+
+		const TransitionTable& m_transitionTable;
 	};
 };
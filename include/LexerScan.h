@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+
+// Run scanners used by the lexer to skip a whole run of bytes in one call.
+// Each returns the length of the run starting at begin, never reading past end.
+// The instruction set is chosen at compile time: AVX2 when enabled, SSE2 on x86/x64, scalar otherwise.
+namespace CppInterp::LexerScan {
+
+	// ' ' and '\t'
+	size_t SkipBlanks(const char* begin, const char* end);
+
+	// [a-zA-Z0-9_]
+	size_t ScanIdentifier(const char* begin, const char* end);
+
+	// everything up to '\r' or '\n'
+	size_t ScanCommentBody(const char* begin, const char* end);
+
+	// everything up to '"', '\\', '\r' or '\n'
+	size_t ScanStringBody(const char* begin, const char* end);
+
+	// "AVX2", "SSE2" or "scalar"
+	const char* GetInstructionSet();
+}
@@ -1,37 +1,16 @@
 #pragma once
 #include"Lexer.h"
+#include "TokenStream.h"
+#include "MappedFile.h"
+#include "AstArena.h"
+#include "TextArena.h"
 #include <iostream>
 #include <algorithm>
+#include <span>
+#include <unordered_map>
 
 namespace CppInterp {
 
-	namespace TokenType {
-		constexpr Type FUNCTION = 39;      // function
-		constexpr Type LET = 40;           // let
-		constexpr Type CONST = 41;           // const
-		constexpr Type STRUCT = 42;           // struct
-		constexpr Type IF = 43;            // if
-		constexpr Type ELSE = 44;          // else
-		constexpr Type SWITCH = 45;          // switch
-		constexpr Type CASE = 46;          // case
-		constexpr Type DEFAULT = 47;          // default
-		constexpr Type WHILE = 48;         // while
-		constexpr Type FOR = 49;           // for
-		constexpr Type RETURN = 50;        // return
-		constexpr Type BREAK = 51;         // break
-		constexpr Type CONTINUE = 52;      // continue
-		constexpr Type BOOL_LITERAL = 53;          // false, true
-		constexpr Type NULL_LITERAL = 54;  // null
-		constexpr Type INT = 55;   // int
-		constexpr Type DOUBLE = 56;   // double
-		constexpr Type CHAR = 57;   // char
-		constexpr Type STRING = 58;   // string
-		constexpr Type BOOL = 59;   // bool
-		constexpr Type VOID = 60;   // void
-		constexpr Type IMPORT = 61;   // import
-		constexpr Type LAMBDA = 62;   // lambda
-	};
-
 	namespace NodeType {
 		using Type = uint8_t;
 
@@ -130,6 +109,149 @@ namespace CppInterp {
 		return typeStr;
 	}
 
+	// Operator stored in expression nodes, evaluators dispatch on it instead of the spelling
+	namespace OpCode {
+		using Type = uint8_t;
+
+		constexpr Type NONE = 0;
+
+		// --- Binary ---
+		constexpr Type LOGICAL_OR = 1;    // ||
+		constexpr Type LOGICAL_AND = 2;   // &&
+		constexpr Type BIT_OR = 3;        // |
+		constexpr Type BIT_XOR = 4;       // ^
+		constexpr Type BIT_AND = 5;       // &
+		constexpr Type EQUAL = 6;         // ==
+		constexpr Type NOT_EQUAL = 7;     // !=
+		constexpr Type LESS = 8;          // <
+		constexpr Type GREATER = 9;       // >
+		constexpr Type LESS_EQUAL = 10;   // <=
+		constexpr Type GREATER_EQUAL = 11; // >=
+		constexpr Type LEFT_SHIFT = 12;   // <<
+		constexpr Type RIGHT_SHIFT = 13;  // >>
+		constexpr Type ADD = 14;          // +
+		constexpr Type SUBTRACT = 15;     // -
+		constexpr Type MULTIPLY = 16;     // *
+		constexpr Type DIVIDE = 17;       // /
+		constexpr Type MODULO = 18;       // %
+
+		// --- Assignment ---
+		constexpr Type ASSIGN = 20;       // =
+		constexpr Type ADD_ASSIGN = 21;   // +=
+		constexpr Type SUB_ASSIGN = 22;   // -=
+		constexpr Type MUL_ASSIGN = 23;   // *=
+		constexpr Type DIV_ASSIGN = 24;   // /=
+		constexpr Type MOD_ASSIGN = 25;   // %=
+
+		// --- Unary ---
+		constexpr Type PLUS = 30;         // +
+		constexpr Type NEGATE = 31;       // -
+		constexpr Type LOGICAL_NOT = 32;  // !
+		constexpr Type BIT_NOT = 33;      // ~
+
+		// --- Postfix ---
+		constexpr Type POST_INCREMENT = 40; // ++
+		constexpr Type POST_DECREMENT = 41; // --
+
+		// binary and assignment operators, whose tokens are not shared
+		constexpr Type FromToken(TokenType::Type type) {
+			switch (type) {
+			case TokenType::OR: return LOGICAL_OR;
+			case TokenType::AND: return LOGICAL_AND;
+			case TokenType::BIT_OR: return BIT_OR;
+			case TokenType::XOR: return BIT_XOR;
+			case TokenType::BIT_AND: return BIT_AND;
+			case TokenType::EQUAL: return EQUAL;
+			case TokenType::NOT_EQUAL: return NOT_EQUAL;
+			case TokenType::LESS: return LESS;
+			case TokenType::GREATER: return GREATER;
+			case TokenType::LESS_EQUAL: return LESS_EQUAL;
+			case TokenType::GREATER_EQUAL: return GREATER_EQUAL;
+			case TokenType::LEFT_MOVE: return LEFT_SHIFT;
+			case TokenType::RIGHT_MOVE: return RIGHT_SHIFT;
+			case TokenType::ADD: return ADD;
+			case TokenType::SUBTRACT: return SUBTRACT;
+			case TokenType::MULTIPLY: return MULTIPLY;
+			case TokenType::DIVIDE: return DIVIDE;
+			case TokenType::MODULO: return MODULO;
+			case TokenType::ASSIGN: return ASSIGN;
+			case TokenType::SELF_ADD: return ADD_ASSIGN;
+			case TokenType::SELF_SUB: return SUB_ASSIGN;
+			case TokenType::SELF_MUL: return MUL_ASSIGN;
+			case TokenType::SELF_DIV: return DIV_ASSIGN;
+			case TokenType::SELF_MODULO: return MOD_ASSIGN;
+			default: return NONE;
+			}
+		}
+
+		// prefix operators, the parser also takes += and -= in prefix position
+		constexpr Type FromUnaryToken(TokenType::Type type) {
+			switch (type) {
+			case TokenType::ADD: return PLUS;
+			case TokenType::SUBTRACT: return NEGATE;
+			case TokenType::NOT: return LOGICAL_NOT;
+			case TokenType::BIT_NOT: return BIT_NOT;
+			case TokenType::SELF_ADD: return ADD_ASSIGN;
+			case TokenType::SELF_SUB: return SUB_ASSIGN;
+			default: return NONE;
+			}
+		}
+
+		constexpr Type FromPostfixToken(TokenType::Type type) {
+			switch (type) {
+			case TokenType::INCREMENT: return POST_INCREMENT;
+			case TokenType::DECREMENT: return POST_DECREMENT;
+			default: return NONE;
+			}
+		}
+
+		// source spelling, for printing
+		constexpr std::string_view GetName(Type op) {
+			switch (op) {
+			case LOGICAL_OR: return "||";
+			case LOGICAL_AND: return "&&";
+			case BIT_OR: return "|";
+			case BIT_XOR: return "^";
+			case BIT_AND: return "&";
+			case EQUAL: return "==";
+			case NOT_EQUAL: return "!=";
+			case LESS: return "<";
+			case GREATER: return ">";
+			case LESS_EQUAL: return "<=";
+			case GREATER_EQUAL: return ">=";
+			case LEFT_SHIFT: return "<<";
+			case RIGHT_SHIFT: return ">>";
+			case ADD: case PLUS: return "+";
+			case SUBTRACT: case NEGATE: return "-";
+			case MULTIPLY: return "*";
+			case DIVIDE: return "/";
+			case MODULO: return "%";
+			case ASSIGN: return "=";
+			case ADD_ASSIGN: return "+=";
+			case SUB_ASSIGN: return "-=";
+			case MUL_ASSIGN: return "*=";
+			case DIV_ASSIGN: return "/=";
+			case MOD_ASSIGN: return "%=";
+			case LOGICAL_NOT: return "!";
+			case BIT_NOT: return "~";
+			case POST_INCREMENT: return "++";
+			case POST_DECREMENT: return "--";
+			default: return "";
+			}
+		}
+	}
+
+	// Where an identifier's variable lives, resolved once by the SemanticAnalyzer so that running
+	// the program indexes storage instead of looking names up
+	namespace BindingKind {
+		using Type = uint8_t;
+
+		constexpr Type UNRESOLVED = 0;  // not analyzed yet, or not declared
+		constexpr Type LOCAL = 1;       // slot m_slot of the frame m_depth functions out
+		constexpr Type GLOBAL = 2;      // entry m_slot of the program's globals
+		constexpr Type NATIVE = 3;      // native m_slot, in the order the analyzer declared them
+	}
+
 	struct ProgramNode;
 	struct ImportNode;
 	struct FunctionDeclNode;
@@ -173,6 +295,8 @@ namespace CppInterp {
 	struct NamedTypeNode;
 	struct FunctionTypeNode;
 
+	struct TypeInfo;
+
 	class AstVisitor {
 	public:
 		virtual void Visit(ProgramNode& node) = 0;
@@ -231,13 +355,18 @@ namespace CppInterp {
 	};
 
 	struct ProgramNode : AstNode {
-		std::vector<AstNode*> m_declarations;
-		ProgramNode(AstNode* parent = nullptr) : AstNode(NodeType::PROGRAM, parent) {}
+		AstList<AstNode*> m_declarations;
+		// set by the SemanticAnalyzer: the top-level functions and variables, and the slots the
+		// blocks and loops outside any function need
+		uint32_t m_globalCount = 0;
+		uint32_t m_frameSize = 0;
+		ProgramNode(AstNode* parent = nullptr, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: AstNode(NodeType::PROGRAM, parent), m_declarations(resource) {}
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
 	};
 
 	struct ImportNode : AstNode {
-		std::string m_moduleName;
+		std::string_view m_moduleName;
 		bool m_isStringLiteral = false;
 		ImportNode(AstNode* parent = nullptr) : AstNode(NodeType::IMPORT_STMT, parent) {}
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
@@ -246,9 +375,15 @@ namespace CppInterp {
 	struct FunctionDeclNode : AstNode {
 		TypeNode* m_returnType = nullptr;
 		IdentifierNode* m_name = nullptr;
-		std::vector<ParameterNode*> m_params;
+		AstList<ParameterNode*> m_params;
 		CompoundStmtNode* m_body = nullptr;
-		FunctionDeclNode(AstNode* parent) : AstNode(NodeType::FUNCTION_DECL, parent) {}
+		// token range of a body skipped by a lazy parse, m_body stays null until Parser::ParseBody
+		uint32_t m_bodyBegin = 0;
+		uint32_t m_bodyEnd = 0;
+		uint32_t m_frameSize = 0; // slots for the parameters and locals, set by the SemanticAnalyzer
+		inline bool IsBodyParsed() const { return m_body || m_bodyEnd == 0; }
+		FunctionDeclNode(AstNode* parent, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: AstNode(NodeType::FUNCTION_DECL, parent), m_params(resource) {}
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
 
 	};
@@ -258,8 +393,9 @@ namespace CppInterp {
 	};
 
 	struct CompoundStmtNode : StatementNode {
-		std::vector<AstNode*> m_statements;
-		CompoundStmtNode(AstNode* parent) : StatementNode(NodeType::COMPOUND_STMT, parent) {}
+		AstList<AstNode*> m_statements;
+		CompoundStmtNode(AstNode* parent, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: StatementNode(NodeType::COMPOUND_STMT, parent), m_statements(resource) {}
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
 
 	};
@@ -274,16 +410,18 @@ namespace CppInterp {
 	struct VariableDeclNode : StatementNode {
 		bool m_isConst = false;
 		TypeNode* m_type = nullptr;
-		std::vector<DeclaratorNode*> m_declarators;
-		VariableDeclNode(AstNode* parent) : StatementNode(NodeType::VAR_DECL, parent) {}
+		AstList<DeclaratorNode*> m_declarators;
+		VariableDeclNode(AstNode* parent, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: StatementNode(NodeType::VAR_DECL, parent), m_declarators(resource) {}
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
 
 	};
 
 	struct StructDeclNode : StatementNode {
 		IdentifierNode* m_name = nullptr;
-		std::vector<StructMemberNode*> m_members;
-		StructDeclNode(AstNode* parent) : StatementNode(NodeType::STRUCT_DECL, parent) {}
+		AstList<StructMemberNode*> m_members;
+		StructDeclNode(AstNode* parent, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: StatementNode(NodeType::STRUCT_DECL, parent), m_members(resource) {}
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
 
 	};
@@ -299,22 +437,25 @@ namespace CppInterp {
 
 	struct SwitchStmtNode : StatementNode {
 		ExpressionNode* m_condition = nullptr;
-		std::vector<CaseNode*> m_cases;
+		AstList<CaseNode*> m_cases;
 		DefaultNode* m_default = nullptr;
-		SwitchStmtNode(AstNode* parent) : StatementNode(NodeType::SWITCH_STMT, parent) {}
+		SwitchStmtNode(AstNode* parent, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: StatementNode(NodeType::SWITCH_STMT, parent), m_cases(resource) {}
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
 	};
 
 	struct CaseNode : StatementNode {
 		LiteralNode* m_literal = nullptr;
-		std::vector<StatementNode*> m_statements;
-		CaseNode(AstNode* parent) : StatementNode(NodeType::CASE_STMT, parent) {}
+		AstList<StatementNode*> m_statements;
+		CaseNode(AstNode* parent, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: StatementNode(NodeType::CASE_STMT, parent), m_statements(resource) {}
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
 	};
 
 	struct DefaultNode : StatementNode {
-		std::vector<StatementNode*> m_statements;
-		DefaultNode(AstNode* parent) : StatementNode(NodeType::DEFAULT_STMT, parent) {}
+		AstList<StatementNode*> m_statements;
+		DefaultNode(AstNode* parent, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: StatementNode(NodeType::DEFAULT_STMT, parent), m_statements(resource) {}
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
 	};
 
@@ -351,17 +492,19 @@ namespace CppInterp {
 	};
 
 	struct ExpressionNode : AstNode {
+		const TypeInfo* m_valueType = nullptr; // set by the SemanticAnalyzer
 		using AstNode::AstNode;
 	};
 
 	struct CommaExprNode : ExpressionNode {
-		std::vector<ExpressionNode*> m_expressions;
-		CommaExprNode(AstNode* parent) : ExpressionNode(NodeType::COMMA_EXPR, parent) {}
+		AstList<ExpressionNode*> m_expressions;
+		CommaExprNode(AstNode* parent, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: ExpressionNode(NodeType::COMMA_EXPR, parent), m_expressions(resource) {}
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
 	};
 
 	struct AssignmentExprNode : ExpressionNode {
-		std::string m_op;
+		OpCode::Type m_op = OpCode::NONE;
 		ExpressionNode* m_left = nullptr;
 		ExpressionNode* m_right = nullptr;
 		AssignmentExprNode(AstNode* parent) : ExpressionNode(NodeType::ASSIGN_EXPR, parent) {}
@@ -377,7 +520,7 @@ namespace CppInterp {
 	};
 
 	struct BinaryExprNode : ExpressionNode {
-		std::string m_op;
+		OpCode::Type m_op = OpCode::NONE;
 		ExpressionNode* m_left = nullptr;
 		ExpressionNode* m_right = nullptr;
 		BinaryExprNode(AstNode* parent) : ExpressionNode(NodeType::BINARY_EXPR, parent) {}
@@ -385,7 +528,7 @@ namespace CppInterp {
 	};
 
 	struct UnaryExprNode : ExpressionNode {
-		std::string m_op;
+		OpCode::Type m_op = OpCode::NONE;
 		ExpressionNode* m_operand = nullptr;
 		UnaryExprNode(AstNode* parent) : ExpressionNode(NodeType::UNARY_EXPR, parent) {}
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
@@ -393,15 +536,16 @@ namespace CppInterp {
 
 	struct PostfixExprNode : ExpressionNode {
 		ExpressionNode* m_primary = nullptr;
-		std::string m_op;
+		OpCode::Type m_op = OpCode::NONE;
 		PostfixExprNode(AstNode* parent) : ExpressionNode(NodeType::POSTFIX_EXPR, parent) {}
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
 	};
 
 	struct FunctionCallNode : ExpressionNode {
 		ExpressionNode* m_callee = nullptr;
-		std::vector<ExpressionNode*> m_arguments; //expression and initilizer
-		FunctionCallNode(AstNode* parent) : ExpressionNode(NodeType::FUNCTION_CALL, parent) {}
+		AstList<ExpressionNode*> m_arguments; //expression and initilizer
+		FunctionCallNode(AstNode* parent, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: ExpressionNode(NodeType::FUNCTION_CALL, parent), m_arguments(resource) {}
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
 	};
 
@@ -415,34 +559,48 @@ namespace CppInterp {
 	struct MemberAccessNode : ExpressionNode {
 		ExpressionNode* m_object = nullptr;
 		IdentifierNode* m_memberName = nullptr;
+		uint32_t m_offset = 0; // of the member in its struct, set by the SemanticAnalyzer
 		MemberAccessNode(AstNode* parent) : ExpressionNode(NodeType::MEMBER_ACCESS, parent) {}
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
 	};
 
 	struct FunctionLiteralNode : ExpressionNode {
-		std::vector<ParameterNode*> m_params;
+		AstList<ParameterNode*> m_params;
 		TypeNode* m_returnType = nullptr;
 		CompoundStmtNode* m_body = nullptr;
-		FunctionLiteralNode(AstNode* parent) : ExpressionNode(NodeType::FUNCTION_LITERAL, parent) {}
+		uint32_t m_frameSize = 0; // slots for the parameters and locals, set by the SemanticAnalyzer
+		FunctionLiteralNode(AstNode* parent, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: ExpressionNode(NodeType::FUNCTION_LITERAL, parent), m_params(resource) {}
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
 	};
 
+	// symbol of an identifier token, tokens built by hand may not have been interned yet
+	inline SymbolId TokenSymbol(const Token& token) {
+		return token.m_symbol != InvalidSymbol ? token.m_symbol : SymbolTable::Instance().Intern(token.m_content);
+	}
+
 	struct IdentifierNode : ExpressionNode {
-		std::string m_name;
+		SymbolId m_symbol;
+		BindingKind::Type m_binding = BindingKind::UNRESOLVED;
+		uint16_t m_depth = 0;
+		uint32_t m_slot = 0;
 		IdentifierNode(const Token& token, AstNode* parent) : ExpressionNode(NodeType::IDENTIFIER, parent) {
-			m_name = token.m_content;
+			m_symbol = TokenSymbol(token);
 			m_line = token.m_line;
 			m_column = token.m_column;
 		}
+		inline std::string_view GetName() const { return SymbolTable::Instance().GetName(m_symbol); }
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
 	};
 
 	struct LiteralNode : ExpressionNode {
 		TokenType::Type m_literalType;
-		std::string m_value;
+		std::string_view m_value;
+		LiteralValue m_literal; // decoded by the lexer, read the member m_literalType selects
 		LiteralNode(const Token& token, AstNode* parent) : ExpressionNode(NodeType::LITERAL, parent) {
 			m_literalType = token.m_type;
 			m_value = token.m_content;
+			m_literal = token.m_literal;
 			m_line = token.m_line;
 			m_column = token.m_column;
 		}
@@ -458,22 +616,25 @@ namespace CppInterp {
 
 	struct DeclaratorNode : AstNode {
 		IdentifierNode* m_name = nullptr;
-		std::vector<ExpressionNode*> m_arraySizes;
+		AstList<ExpressionNode*> m_arraySizes;
 		ExpressionNode* m_initializer = nullptr;
-		DeclaratorNode(AstNode* parent) : AstNode(NodeType::DECLARATOR, parent) {}
+		DeclaratorNode(AstNode* parent, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: AstNode(NodeType::DECLARATOR, parent), m_arraySizes(resource) {}
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
 	};
 
 	struct StructMemberNode : AstNode {
 		TypeNode* m_type = nullptr;
-		std::vector<DeclaratorNode*> m_declarators;
-		StructMemberNode(AstNode* parent) : AstNode(NodeType::STRUCT_MEMBER_DECL, parent) {}
+		AstList<DeclaratorNode*> m_declarators;
+		StructMemberNode(AstNode* parent, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: AstNode(NodeType::STRUCT_MEMBER_DECL, parent), m_declarators(resource) {}
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
 	};
 
 	struct InitializerNode : ExpressionNode {
-		std::vector<ExpressionNode*> m_values;
-		InitializerNode(AstNode* parent) : ExpressionNode(NodeType::INITIALIZER, parent) {}
+		AstList<ExpressionNode*> m_values;
+		InitializerNode(AstNode* parent, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: ExpressionNode(NodeType::INITIALIZER, parent), m_values(resource) {}
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
 	};
 
@@ -482,7 +643,7 @@ namespace CppInterp {
 	};
 
 	struct BuiltinTypeNode : TypeNode {
-		std::string m_name;
+		std::string_view m_name;
 		BuiltinTypeNode(const Token& token, AstNode* parent) : TypeNode(NodeType::BUILTIN_TYPE, parent) {
 			m_name = token.m_content;
 			m_line = token.m_line;
@@ -492,53 +653,299 @@ namespace CppInterp {
 	};
 
 	struct NamedTypeNode : TypeNode {
-		std::string m_name;
+		SymbolId m_symbol;
 
 		NamedTypeNode(const Token& token, AstNode* parent)
 			: TypeNode(NodeType::NAMED_TYPE, parent) {
-			m_name = token.m_content;
+			m_symbol = TokenSymbol(token);
 			m_line = token.m_line;
 			m_column = token.m_column;
 		}
+		inline std::string_view GetName() const { return SymbolTable::Instance().GetName(m_symbol); }
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
 	};
 
 	struct FunctionTypeNode : TypeNode {
-		std::vector<TypeNode*> m_paramTypes;
+		AstList<TypeNode*> m_paramTypes;
 		TypeNode* m_returnType = nullptr;
-		FunctionTypeNode(AstNode* parent) : TypeNode(NodeType::FUNCTION_TYPE, parent) {}
+		FunctionTypeNode(AstNode* parent, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+			: TypeNode(NodeType::FUNCTION_TYPE, parent), m_paramTypes(resource) {}
 		void Accept(AstVisitor& visitor) override { visitor.Visit(*this); }
 	};
 
+	// Calls function with every child of node that is present, in the order of the members.
+	template <typename F>
+	void ForEachChild(AstNode& node, F&& function) {
+		auto one = [&](AstNode* child) { if (child) function(child); };
+		auto all = [&](const auto& list) { for (AstNode* child : list) one(child); };
+		switch (node.m_nodeType) {
+		case NodeType::PROGRAM: all(static_cast<ProgramNode&>(node).m_declarations); break;
+		case NodeType::FUNCTION_DECL: {
+			auto& decl = static_cast<FunctionDeclNode&>(node);
+			one(decl.m_returnType); one(decl.m_name); all(decl.m_params); one(decl.m_body);
+			break;
+		}
+		case NodeType::COMPOUND_STMT: all(static_cast<CompoundStmtNode&>(node).m_statements); break;
+		case NodeType::EXPRESSION_STMT: one(static_cast<ExpressionStmtNode&>(node).m_expression); break;
+		case NodeType::VAR_DECL: {
+			auto& decl = static_cast<VariableDeclNode&>(node);
+			one(decl.m_type); all(decl.m_declarators);
+			break;
+		}
+		case NodeType::STRUCT_DECL: {
+			auto& decl = static_cast<StructDeclNode&>(node);
+			one(decl.m_name); all(decl.m_members);
+			break;
+		}
+		case NodeType::IF_STMT: {
+			auto& stmt = static_cast<IfStmtNode&>(node);
+			one(stmt.m_condition); one(stmt.m_thenStmt); one(stmt.m_elseStmt);
+			break;
+		}
+		case NodeType::SWITCH_STMT: {
+			auto& stmt = static_cast<SwitchStmtNode&>(node);
+			one(stmt.m_condition); all(stmt.m_cases); one(stmt.m_default);
+			break;
+		}
+		case NodeType::CASE_STMT: {
+			auto& stmt = static_cast<CaseNode&>(node);
+			one(stmt.m_literal); all(stmt.m_statements);
+			break;
+		}
+		case NodeType::DEFAULT_STMT: all(static_cast<DefaultNode&>(node).m_statements); break;
+		case NodeType::WHILE_STMT: {
+			auto& stmt = static_cast<WhileStmtNode&>(node);
+			one(stmt.m_condition); one(stmt.m_body);
+			break;
+		}
+		case NodeType::FOR_STMT: {
+			auto& stmt = static_cast<ForStmtNode&>(node);
+			one(stmt.m_init); one(stmt.m_condition); one(stmt.m_increment); one(stmt.m_body);
+			break;
+		}
+		case NodeType::RETURN_STMT: one(static_cast<ReturnStmtNode&>(node).m_expression); break;
+		case NodeType::COMMA_EXPR: all(static_cast<CommaExprNode&>(node).m_expressions); break;
+		case NodeType::ASSIGN_EXPR: {
+			auto& expr = static_cast<AssignmentExprNode&>(node);
+			one(expr.m_left); one(expr.m_right);
+			break;
+		}
+		case NodeType::COND_EXPR: {
+			auto& expr = static_cast<ConditionalExprNode&>(node);
+			one(expr.m_condition); one(expr.m_trueExpr); one(expr.m_falseExpr);
+			break;
+		}
+		case NodeType::BINARY_EXPR: {
+			auto& expr = static_cast<BinaryExprNode&>(node);
+			one(expr.m_left); one(expr.m_right);
+			break;
+		}
+		case NodeType::UNARY_EXPR: one(static_cast<UnaryExprNode&>(node).m_operand); break;
+		case NodeType::POSTFIX_EXPR: one(static_cast<PostfixExprNode&>(node).m_primary); break;
+		case NodeType::FUNCTION_CALL: {
+			auto& expr = static_cast<FunctionCallNode&>(node);
+			one(expr.m_callee); all(expr.m_arguments);
+			break;
+		}
+		case NodeType::ARRAY_INDEX: {
+			auto& expr = static_cast<ArrayIndexNode&>(node);
+			one(expr.m_array); one(expr.m_index);
+			break;
+		}
+		case NodeType::MEMBER_ACCESS: {
+			auto& expr = static_cast<MemberAccessNode&>(node);
+			one(expr.m_object); one(expr.m_memberName);
+			break;
+		}
+		case NodeType::FUNCTION_LITERAL: {
+			auto& expr = static_cast<FunctionLiteralNode&>(node);
+			all(expr.m_params); one(expr.m_returnType); one(expr.m_body);
+			break;
+		}
+		case NodeType::PARAMETER: {
+			auto& param = static_cast<ParameterNode&>(node);
+			one(param.m_type); one(param.m_declarator);
+			break;
+		}
+		case NodeType::DECLARATOR: {
+			auto& declarator = static_cast<DeclaratorNode&>(node);
+			one(declarator.m_name); all(declarator.m_arraySizes); one(declarator.m_initializer);
+			break;
+		}
+		case NodeType::STRUCT_MEMBER_DECL: {
+			auto& member = static_cast<StructMemberNode&>(node);
+			one(member.m_type); all(member.m_declarators);
+			break;
+		}
+		case NodeType::INITIALIZER: all(static_cast<InitializerNode&>(node).m_values); break;
+		case NodeType::FUNCTION_TYPE: {
+			auto& type = static_cast<FunctionTypeNode&>(node);
+			all(type.m_paramTypes); one(type.m_returnType);
+			break;
+		}
+		default: break;
+		}
+	}
+
+	class AstCache;
+
+	// Replace removed bytes at offset of the parsed source with text.
+	struct TextEdit {
+		size_t m_offset = 0;
+		size_t m_removed = 0;
+		std::string_view m_text;
+	};
+
 	class Parser {
 	public:
 		Parser() = default;
+		// The parser is meant to be reused: the token list, source string, arena and the other buffers
+		// keep their capacity from one parse to the next, so parsing many small sources in a row
+		// stops allocating once they have grown to fit.
 		AstNode* Parse(const std::string& str);
-		AstNode* Parse(const std::vector<Token>& tokens);
+		// takes over the string instead of copying it
+		AstNode* Parse(std::string&& str);
+		// lexes straight from a read-only mapping of the file, which is kept until the next parse
+		AstNode* ParseFile(const std::string& path);
+		// The tokens are borrowed, not copied: they must stay unchanged until the next parse, which
+		// matters for ParseBody. The source they were lexed from must outlive the returned AST.
+		AstNode* Parse(const TokenList& tokens);
+		// takes over the tokens, whose source must outlive the returned AST
+		AstNode* Parse(TokenList&& tokens);
+		// tokens built elsewhere, in source order; their contents must outlive the returned AST
+		AstNode* Parse(std::span<const Token> tokens);
+		// Pulls one or more complete top-level items at a time, so only their tokens are held.
+		// The stream must outlive the returned AST.
+		AstNode* Parse(TokenStream& stream);
+		// Parse with the work spread over pool: the source is lexed in up to chunkCount chunks, then
+		// cut into runs of whole top-level items that are parsed side by side, each into an arena of
+		// its own. The tree, exceptions and diagnostics are those of the sequential overload; a run
+		// that does not parse cleanly sends the whole source through it. Must not be called from a
+		// task of pool.
+		AstNode* Parse(const std::string& str, ThreadPool& pool, size_t chunkCount);
+		AstNode* ParseFile(const std::string& path, ThreadPool& pool, size_t chunkCount);
+		// Load the tree from cache when it holds one for this exact source, otherwise parse and store
+		// the tree unless it has syntax errors. Bodies are always parsed, so entries are complete. A
+		// loaded tree comes without tokens, so Reparse parses everything again.
+		AstNode* Parse(const std::string& str, const AstCache& cache);
+		AstNode* ParseFile(const std::string& path, const AstCache& cache);
+		// Applies edit to the source of the last Parse(string) or ParseFile and brings the tree up to
+		// date. Only the smallest function or compound statement enclosing the edit is re-lexed and
+		// reparsed, in place of the old one; everything else is kept and moved to its new position.
+		// Edits no such block contains, or that do not reparse cleanly, fall back to a full parse.
+		AstNode* Reparse(const TextEdit& edit);
 
 		~Parser();
 
 		inline AstNode* GetAstRoot() const { return m_root; }
-		inline const std::vector<AstNode*>& GetNodes() const { return m_nodes; }
+		inline size_t GetNodeCount() const {
+			size_t count = m_arena.GetObjectCount();
+			for (const auto& worker : m_workers)
+				count += worker->m_arena.GetObjectCount();
+			return count;
+		}
+		// after a parallel parse most nodes are in the arenas of the runs
+		inline const AstArena& GetArena() const { return m_arena; }
+
+		// With recovery on, a syntax error is recorded instead of thrown: the statement or top-level
+		// item it occurred in is dropped, tokens are skipped to the next ';', '}' or statement keyword
+		// and parsing goes on, so one parse reports every error next to a partial AST.
+		inline void SetErrorRecovery(bool enabled) { m_recoverErrors = enabled; }
+		inline bool GetErrorRecovery() const { return m_recoverErrors; }
+		// syntax errors of the last parse in source order, only collected with recovery on
+		inline const std::vector<ParserException>& GetDiagnostics() const { return m_diagnostics; }
+		inline bool HasErrors() const { return !m_diagnostics.empty(); }
+		// With lazy bodies, a function declaration only matches the braces of its body and keeps their
+		// token range, the body is parsed by ParseBody on first use. Syntax errors inside a body are
+		// reported then, not by the parse. Parse(TokenStream&) keeps no tokens and parses every body,
+		// Reparse parses everything again while bodies are left unparsed.
+		inline void SetLazyBodies(bool enabled) { m_lazyBodies = enabled; }
+		inline bool GetLazyBodies() const { return m_lazyBodies; }
+		// Parses the body of a function of the current tree if it was skipped and returns it. A
+		// syntax error throws, or with recovery on is added to the diagnostics, as in a full parse.
+		CompoundStmtNode* ParseBody(FunctionDeclNode& function);
+		inline size_t GetUnparsedBodyCount() const { return m_unparsedBodies; }
+		// the source Reparse edits
+		inline std::string_view GetSource() const { return m_file.IsOpen() ? m_file.View() : std::string_view(m_source); }
+		// whether the last parse loaded its tree from a cache
+		inline bool LastParseCached() const { return m_lastParseCached; }
+		// whether the last Reparse replaced one block instead of parsing everything again
+		inline bool LastReparseIncremental() const { return m_lastReparseIncremental; }
+		// the block the last incremental Reparse put in, nullptr once the tree was parsed again whole
+		inline AstNode* GetLastReparsed() const { return m_lastReparsed; }
 	private:
+		// source extent of a function or compound statement, for Reparse
+		struct Region {
+			AstNode* m_node;
+			uint32_t m_begin; // offset of the first token
+			uint32_t m_end; // past the closing brace
+			int m_line, m_column; // of the first token
+			int m_endLine, m_endColumn; // of the closing brace
+		};
+
+		// nodes own nothing outside the arena, so they are released a block at a time
 		inline void ClearNodes() {
-			for (auto node : m_nodes)
-				delete node;
-			m_nodes.clear();
+			m_arena.Reset();
 			m_root = nullptr;
+			m_diagnostics.clear();
+			m_regions.clear();
+			m_texts.Reset();
+			m_workers.clear();
+			m_unparsedBodies = 0;
+			m_lastParseCached = false;
+			m_lastReparsed = nullptr;
 		}
 
-		void PreprocessTokens(std::vector<Token>& tokens); // distinguish keyword and identifier
+		// Texts kept by nodes are copied when the source is ours, so it can be edited under a tree.
+		// Borrowed tokens must outlive the tree anyway, their texts are viewed as they are.
+		inline std::string_view KeepText(std::string_view text) { return m_trackRegions ? m_texts.Store(text) : text; }
+		// spelling of a builtin type keyword, static so type nodes need no copy
+		static std::string_view BuiltinTypeName(TokenType::Type type);
+		void RecordRegion(AstNode* node, size_t firstToken);
+		AstNode* ReparseAll();
+		// the cached tree of the source, which is already set, or nullptr
+		AstNode* LoadCached(const AstCache& cache);
+		// the parse of the cache overloads on a miss: the source that is set, read once, with bodies parsed
+		AstNode* ParseAndStore(const AstCache& cache);
+		bool ReplaceChild(AstNode* parent, AstNode* child, AstNode* replacement);
+
+		inline void ResetSource() {
+			m_source.clear();
+			m_file.Close();
+			m_tokens = &m_tokenBuffer;
+		}
+		// lex and parse the source that is set, the tail of Parse(string) and ParseFile
+		AstNode* ParseSource();
+
+		bool PullTopLevelItems(TokenStream& stream);
+		// whether a top-level item may end at last when next follows, only for last at nesting depth 0
+		static bool EndsTopLevelItem(TokenType::Type last, TokenType::Type next);
+
+		// runs with fewer tokens are not worth a task
+		static constexpr size_t MinParallelTokens = 16 * 1024;
+		ProgramNode* ParseProgram(ThreadPool& pool, size_t chunkCount);
+		// the items in [begin, end) of m_tokens, throws if the last one does not end at end
+		std::vector<AstNode*> ParseItems(ProgramNode* program, int begin, int end);
+
+		[[noreturn]] inline void ThrowEndOfInput() {
+			Token last = m_tokens->empty() ? Token() : m_tokens->back();
+			throw ParserException("Unexpected end of input while peeking next token", last.m_line, last.m_column);
+		}
 
-		inline const Token& Peek() {
-			if (m_current >= m_tokens.size()) {
-				throw ParserException(
-					"Unexpected end of input while peeking next token",
-					m_tokens.empty() ? 0 : m_tokens.back().m_line,
-					m_tokens.empty() ? 0 : m_tokens.back().m_column
-				);
-			}
-			return m_tokens[m_current];
+		// m_current never goes below 0, the cast keeps the comparison unsigned
+		inline bool AtEnd() const { return static_cast<size_t>(m_current) >= m_tokens->size(); }
+
+		// lookahead reads the dense type array, only Peek builds the whole token
+		inline Token Peek() {
+			if (AtEnd())
+				ThrowEndOfInput();
+			return (*m_tokens)[m_current];
+		}
+
+		inline TokenType::Type PeekType() {
+			if (AtEnd())
+				ThrowEndOfInput();
+			return m_tokens->Type(m_current);
 		}
 
 		inline void Consume() {
@@ -546,7 +953,7 @@ namespace CppInterp {
 		}
 
 		inline bool Check(TokenType::Type type) {
-			return m_current < m_tokens.size() && Peek().m_type == type;
+			return !AtEnd() && m_tokens->Type(m_current) == type;
 		}
 
 		inline bool Match(TokenType::Type type) {
@@ -558,22 +965,43 @@ namespace CppInterp {
 		}
 
 		inline bool CheckAny(const auto& types) {
-			return m_current < m_tokens.size() &&
-				std::any_of(std::begin(types), std::end(types),
-					[&](auto t) { return Peek().m_type == t; });
+			if (AtEnd())
+				return false;
+			TokenType::Type current = m_tokens->Type(m_current);
+			return std::any_of(std::begin(types), std::end(types), [current](auto t) { return current == t; });
 		}
 
 		inline bool CheckAny(std::initializer_list<TokenType::Type> types) {
-			return m_current < m_tokens.size() &&
-				std::any_of(types.begin(), types.end(),
-					[&](auto t) { return Peek().m_type == t; });
+			if (AtEnd())
+				return false;
+			TokenType::Type current = m_tokens->Type(m_current);
+			return std::any_of(types.begin(), types.end(), [current](auto t) { return current == t; });
 		}
 
 		inline bool MatchAny(const std::initializer_list<TokenType::Type>& types) {
 			return std::ranges::any_of(types, [&](auto t) { return Match(t); });
 		}
 
+		// Runs parse, which starts a statement or top-level item. With recovery on, a ParserException
+		// is recorded, the parser resynchronizes and nullptr is returned.
+		template <typename F>
+		auto Recover(F&& parse) -> decltype(parse()) {
+			int start = m_current;
+			try {
+				return parse();
+			}
+			catch (ParserException& ex) {
+				if (!m_recoverErrors)
+					throw;
+				m_diagnostics.push_back(std::move(ex));
+				Synchronize(start);
+				return nullptr;
+			}
+		}
+		void Synchronize(int start);
+
 		ProgramNode* ParseProgram(AstNode* parent);
+		AstNode* ParseDeclaration(ProgramNode* parent);
 		ImportNode* ParseImportStmt(AstNode* parent);
 		FunctionDeclNode* ParseFunctionDecl(AstNode* parent);
 
@@ -595,17 +1023,7 @@ namespace CppInterp {
 		ExpressionNode* ParseCommaExpression(AstNode* parent);
 		ExpressionNode* ParseAssignment(AstNode* parent);
 		ExpressionNode* ParseConditional(AstNode* parent);
-		ExpressionNode* ParseBinary(AstNode* parent, std::function<ExpressionNode* (AstNode*)> lower, const std::vector<TokenType::Type>& ops);
-		ExpressionNode* ParseLogicalOr(AstNode* parent);
-		ExpressionNode* ParseLogicalAnd(AstNode* parent);
-		ExpressionNode* ParseBitOr(AstNode* parent);
-		ExpressionNode* ParseBitXOr(AstNode* parent);
-		ExpressionNode* ParseBitAnd(AstNode* parent);
-		ExpressionNode* ParseEquality(AstNode* parent);
-		ExpressionNode* ParseRelational(AstNode* parent);
-		ExpressionNode* ParseShift(AstNode* parent);
-		ExpressionNode* ParseAdditive(AstNode* parent);
-		ExpressionNode* ParseMultiplicative(AstNode* parent);
+		ExpressionNode* ParseBinary(AstNode* parent, uint8_t minPower);
 		ExpressionNode* ParseUnary(AstNode* parent);
 		ExpressionNode* ParsePostfix(AstNode* parent);
 		ExpressionNode* ParsePrimary(AstNode* parent);
@@ -623,9 +1041,24 @@ namespace CppInterp {
 
 
 		int m_current = 0;
-		std::vector<Token> m_tokens;
-		AstNode* m_root;
-		std::vector<AstNode*> m_nodes;
+		std::string m_source; // names and values in the AST view into this copy
+		MappedFile m_file; // or into this mapping, for ParseFile
+		TokenList m_tokenBuffer;
+		const TokenList* m_tokens = &m_tokenBuffer; // the buffer, or the one of the parser a worker helps
+		AstNode* m_root = nullptr;
+		AstArena m_arena; // every node of the current AST
+		bool m_recoverErrors = false;
+		std::vector<ParserException> m_diagnostics;
+		TextArena m_texts; // literal, import and builtin type texts of the nodes
+		bool m_trackRegions = false; // the source is ours, so it can be edited
+		std::vector<Region> m_regions;
+		bool m_lastReparseIncremental = false;
+		AstNode* m_lastReparsed = nullptr;
+		std::vector<std::unique_ptr<Parser>> m_workers; // hold the nodes of the runs of a parallel parse
+		bool m_lazyBodies = false;
+		bool m_skipBodies = false; // lazy bodies, and the tokens are kept for ParseBody
+		size_t m_unparsedBodies = 0;
+		bool m_lastParseCached = false;
 	};
 
 
@@ -1,432 +1,224 @@
-//#pragma once
-//#include <vector>
-//#include "Parser.h"
-//#include <optional>
-//#include "Exception.hpp"
-//
-//namespace CppInterp {
-//
-//	class ProgramNode;
-//	class ImportStmt;
-//	class FunctionDecl;
-//	class CompoundStmt;
-//	class IfStmt;
-//	class WhileStmt;
-//	class ForStmt;
-//	class SwitchStmt;
-//	class CaseClause;
-//	class DefaultClause;
-//	class ReturnStmt;
-//	class BreakStmt;
-//	class ContinueStmt;
-//	class VariableDecl;
-//	class Declarator;
-//	class StructDef;
-//	class InitializerExpr;
-//	class ConditionalExpr;
-//	class AssignmentExpr;
-//	class BinaryExpr;
-//	class UnaryExpr;
-//	class LiteralExpr;
-//	class IdentifierExpr;
-//	class CallExpr;
-//	class MemberAccessExpr;
-//	class ArrayAccessExpr;
-//	class LambdaExpr;
-//	class Expression;
-//
-//	class AstVisitor {
-//	public:
-//		virtual void Visit(ProgramNode& node) = 0;
-//		virtual void Visit(ImportStmt& node) = 0;
-//		virtual void Visit(FunctionDecl& node) = 0;
-//		virtual void Visit(CompoundStmt& node) = 0;
-//		virtual void Visit(IfStmt& node) = 0;
-//		virtual void Visit(WhileStmt& node) = 0;
-//		virtual void Visit(ForStmt& node) = 0;
-//		virtual void Visit(SwitchStmt& node) = 0;
-//		virtual void Visit(CaseClause& node) = 0;
-//		virtual void Visit(DefaultClause& node) = 0;
-//		virtual void Visit(ReturnStmt& node) = 0;
-//		virtual void Visit(BreakStmt& node) = 0;
-//		virtual void Visit(ContinueStmt& node) = 0;
-//		virtual void Visit(VariableDecl& node) = 0;
-//		virtual void Visit(Declarator& node) = 0;
-//		virtual void Visit(StructDef& node) = 0;
-//		virtual void Visit(InitializerExpr& node) = 0;
-//		virtual void Visit(ConditionalExpr& node) = 0;
-//		virtual void Visit(AssignmentExpr& node) = 0;
-//		virtual void Visit(BinaryExpr& node) = 0;
-//		virtual void Visit(UnaryExpr& node) = 0;
-//		virtual void Visit(LiteralExpr& node) = 0;
-//		virtual void Visit(IdentifierExpr& node) = 0;
-//		virtual void Visit(CallExpr& node) = 0;
-//		virtual void Visit(MemberAccessExpr& node) = 0;
-//		virtual void Visit(ArrayAccessExpr& node) = 0;
-//		virtual void Visit(LambdaExpr& node) = 0;
-//	};
-//
-//	struct TypeInfo {
-//
-//		enum Kind {
-//			BUILTIN,    // int, double, bool, char, string
-//			ARRAY,      // T[]
-//			FUNCTION,   // (paramTypes) -> returnType
-//			STRUCT,     // struct
-//			UNKNOWN
-//		};
-//
-//		Kind m_kind;
-//		std::string m_name;
-//		TypeInfo* m_elementType;
-//		std::vector<TypeInfo*> m_paramTypes;
-//		TypeInfo* m_returnType;
-//
-//		TypeInfo();
-//		TypeInfo(Kind k, const std::string& n = "");
-//
-//		bool IsSame(const TypeInfo& other) const;
-//	};
-//
-//	class TypeRegistry {
-//	public:
-//		TypeRegistry();
-//		~TypeRegistry();
-//
-//		std::optional<TypeInfo*> Find(const std::string& name) const;
-//		TypeInfo* RegisterStruct(const std::string& name);
-//		TypeInfo* GetOrCreateArray(TypeInfo* elem);
-//		TypeInfo* GetOrCreateFunction(const std::vector<TypeInfo*>& params, TypeInfo* ret);
-//
-//	private:
-//		void InitBuiltins();
-//
-//		std::unordered_map<std::string, TypeInfo*> m_builtinTypes;
-//		std::unordered_map<std::string, TypeInfo*> m_structTypes;
-//		std::unordered_map<std::string, TypeInfo*> m_arrayTypes;
-//		std::unordered_map<std::string, TypeInfo*> m_functionTypes;
-//	};
-//
-//	struct AstNode {
-//		virtual ~AstNode() = default;
-//		virtual void Accept(AstVisitor& visitor) = 0;
-//	};
-//
-//	struct ProgramNode : AstNode {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//
-//		std::vector<AstNode*> m_declarations;
-//	};
-//
-//	struct ImportStmt : AstNode {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		std::string m_moduleName;
-//	};
-//
-//	struct FunctionDecl : AstNode {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		std::string m_name;
-//		TypeInfo* m_returnType;
-//		std::vector<VariableDecl*> m_parameters;
-//		CompoundStmt* m_body;
-//	};
-//
-//	struct Statement : AstNode {};
-//
-//	struct CompoundStmt : Statement {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		std::vector<Statement*> m_statements;
-//	};
-//
-//	struct IfStmt : Statement {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		Expression* m_condition;
-//		Statement* m_thenBranch;
-//		Statement* m_elseBranch;
-//	};
-//
-//	struct WhileStmt : Statement {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		Expression* m_condition;
-//		Statement* m_body;
-//	};
-//
-//	struct ForStmt : Statement {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		AstNode* m_init;
-//		Expression* m_condition;
-//		Expression* m_increment;
-//		Statement* m_body;
-//	};
-//
-//	struct DefaultClause : AstNode {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		std::vector<std::unique_ptr<Statement>> statements;
-//	};
-//
-//	struct SwitchStmt : Statement {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		Expression* m_condition;
-//		std::vector<CaseClause*> m_cases;
-//		DefaultClause* m_defaultClause;
-//	};
-//
-//	struct CaseClause : AstNode {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		Expression* m_value;
-//		std::vector<Statement*> m_statements;
-//	};
-//
-//	struct ReturnStmt : Statement {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		Expression* m_value;
-//	};
-//
-//	struct BreakStmt : Statement {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//	};
-//
-//	struct ContinueStmt : Statement {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//	};
-//
-//	struct VariableDecl : Statement {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		bool m_isConst;
-//		TypeInfo* m_type;
-//		std::vector<Declarator*> m_declarators;
-//	};
-//
-//	struct Declarator : AstNode {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		std::string m_name;
-//		std::vector<Expression*> m_arrayDimensions;
-//		Expression* m_initializer;
-//	};
-//
-//	struct StructDef : AstNode {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		std::string m_name;
-//		std::vector<VariableDecl*> m_members;
-//	};
-//
-//	struct Expression : AstNode {};
-//
-//	struct InitializerExpr : Expression {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		std::vector<std::pair<std::string, Expression*>> m_designatedInitializers;
-//	};
-//
-//	struct ConditionalExpr : Expression {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		Expression* m_condition, * m_trueExpr, * m_falseExpr;
-//	};
-//
-//	struct AssignmentExpr : Expression {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		Token m_op;
-//		Expression* m_left, * m_right;
-//	};
-//
-//	struct BinaryExpr : Expression {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		Token m_op;
-//		Expression* m_left, * m_right;
-//	};
-//
-//	struct UnaryExpr : Expression {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		Token m_op;
-//		Expression* m_operand;
-//	};
-//
-//	struct LiteralExpr : Expression {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		Token m_token;
-//	};
-//
-//	struct IdentifierExpr : Expression {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		std::string m_name;
-//	};
-//
-//	struct CallExpr : Expression {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		Expression* m_callee;
-//		std::vector<Expression*> m_arguments;
-//	};
-//
-//	struct MemberAccessExpr : Expression {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		Expression* m_object;
-//		std::string m_member;
-//	};
-//
-//	struct ArrayAccessExpr : Expression {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		Expression* m_array;
-//		Expression* m_index;
-//	};
-//
-//	struct Parameter {
-//		std::string m_name;
-//		TypeInfo* m_type;
-//	};
-//
-//	struct LambdaExpr : Expression {
-//		inline void Accept(AstVisitor& visitor) override {
-//			visitor.Visit(*this);
-//		};
-//		std::vector<Parameter> m_parameters;
-//		TypeInfo* m_returnType;
-//		CompoundStmt* m_body;
-//	};
-//
-//	class AstConverter {
-//	public:
-//		AstConverter() = default;
-//		~AstConverter();
-//
-//		AstNode* ConvertToSemanticAst(AstNode* root);
-//
-//	private:
-//		void ClearNodes();
-//
-//		AstNode* ConvertNode(AstNode* node);
-//
-//		AstNode* ConvertProgram(AstNode* node);
-//		AstNode* ConvertImportStmt(AstNode* node);
-//		AstNode* ConvertFunctionDecl(AstNode* node);
-//
-//		AstNode* ConvertCompoundStmt(AstNode* node);
-//		AstNode* ConvertEmptyStmt(AstNode* node);
-//		AstNode* ConvertVariableDecl(AstNode* node);
-//		AstNode* ConvertDeclaratorList(AstNode* node);
-//		AstNode* ConvertIfStmt(AstNode* node);
-//		AstNode* ConvertCaseClause(AstNode* node);
-//		AstNode* ConvertWhileStmt(AstNode* node);
-//		AstNode* ConvertDefaultClause(AstNode* node);
-//		AstNode* ConvertForStmt(AstNode* node);
-//		AstNode* ConvertReturnStmt(AstNode* node);
-//		AstNode* ConvertBreakStmt(AstNode* node);
-//		AstNode* ConvertContinueStmt(AstNode* node);
-//		AstNode* ConvertStructDecl(AstNode* node);
-//		AstNode* ConvertStructDeclaratorList(AstNode* node);
-//		AstNode* ConvertMemberDecl(AstNode* node);
-//		AstNode* ConvertExpression(AstNode* node);
-//		AstNode* ConvertAssignExpr(AstNode* node);
-//		AstNode* ConvertConditionExpr(AstNode* node);
-//		AstNode* ConvertBinaryExpr(AstNode* node);
-//		AstNode* ConvertUnaryExpr(AstNode* node);
-//		AstNode* ConvertPostfixExpr(AstNode* node);
-//		AstNode* ConvertCallExpr(AstNode* node);
-//		AstNode* ConvertIndexExpr(AstNode* node);
-//		AstNode* ConvertMemberExpr(AstNode* node);
-//		AstNode* ConvertGroupExpr(AstNode* node);
-//		AstNode* ConvertInitializer(AstNode* node);
-//		AstNode* ConvertDesignedInitializer(AstNode* node);
-//		AstNode* ConvertArgumentList(AstNode* node);
-//		AstNode* ConvertFunctionLiteral(AstNode* node);
-//		AstNode* ConvertPrimary(AstNode* node);
-//		AstNode* ConvertLiteral(AstNode* node);
-//		AstNode* ConvertParameterTypeList(AstNode* node);
-//
-//		Declarator* ConvertDeclarator(AstNode* node);
-//		std::vector<VariableDecl*> ConvertParameterList(AstNode* node);
-//		VariableDecl* ConvertParameter(AstNode* node);
-//		TypeInfo* ConvertType(AstNode* node);
-//		std::vector<Expression*> ConvertArraySize(AstNode* node);
-//
-//
-//		using NodeConvertFunc = std::function<AstNode* (AstNode*)>;
-//
-//		AstNode* m_root;
-//		std::vector<AstNode*> m_nodes;
-//		TypeRegistry m_typeRegistry;
-//	};
-//
-//
-//	struct Variable {
-//
-//	};
-//
-//	struct Function {
-//
-//	};
-//
-//	struct Struct {
-//	};
-//
-//	class Context {
-//	public:
-//		Context(Context* parent = nullptr) :m_parent(parent) {}
-//	private:
-//		Context* m_parent;
-//		std::unordered_map<std::string, Variable> m_variables;
-//		std::unordered_map<std::string, Function> m_functions;
-//		std::unordered_map<std::string, Struct> m_structs;
-//	};
-//
-//	class SemanticAnalyzer {
-//	public:
-//		SemanticAnalyzer(AstNode* astRoot);
-//		void SemanticAnalyze();
-//	private:
-//		AstNode* m_astRoot;
-//		Context* m_globalContext;
-//		std::vector<Context*> m_contextStack;
-//		std::vector<Context*> m_contexts;
-//	};
-//}
\ No newline at end of file
+#pragma once
+#include "Parser.h"
+#include "TypeTable.h"
+#include "Exception.hpp"
+#include "ThreadPool.h"
+#include <memory>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace CppInterp {
+
+	// Checks a parsed program. Every identifier is resolved once through nested scopes and bound to a
+	// frame slot or global index on its IdentifierNode, every expression gets its type in
+	// ExpressionNode::m_valueType and errors are collected as diagnostics instead of ending the
+	// analysis. Structs, functions and globals are collected before anything is checked, so they may
+	// be used above their declaration.
+	class SemanticAnalyzer : public AstVisitor {
+	public:
+		SemanticAnalyzer();
+
+		// true when the program has no semantic errors. Function bodies a lazy parse left unparsed
+		// are not checked. The types stay valid until the next Analyze.
+		bool Analyze(AstNode* root);
+		// Analyze with the bodies of the top-level functions checked side by side on pool, in up to
+		// chunkCount runs, once the declarations are collected. Types, bindings and diagnostics, in
+		// their order, are those of the sequential overload. Must not be called from a task of pool.
+		bool Analyze(AstNode* root, ThreadPool& pool, size_t chunkCount);
+		// Brings the last analysis of root up to date after the top-level items holding the changed
+		// nodes were edited in place, as an incremental Parser::Reparse does. Only those items and the
+		// ones naming a function whose signature changed are checked again, the others keep their
+		// results. Results and diagnostics are those of Analyze(root). Falls back to it for another
+		// root, when a struct, a global variable or the name of a function was edited, or when the
+		// type of a global or a field names a function whose signature changed.
+		bool Reanalyze(AstNode* root, std::span<AstNode* const> changed);
+		// top-level items the last Analyze or Reanalyze checked
+		inline size_t GetLastCheckedCount() const { return m_lastChecked; }
+
+		inline const std::vector<SemanticException>& GetDiagnostics() const { return m_diagnostics; }
+		inline bool HasErrors() const { return !m_diagnostics.empty(); }
+		inline TypeTable& GetTypes() { return *m_types; }
+		// type of the global variable or function named name after Analyze, nullptr if there is none
+		const TypeInfo* FindGlobal(std::string_view name) const;
+		// Whether struct layouts may order the fields by alignment instead of declaration to save
+		// padding, on by default. Fields keep their declaration order in TypeInfo::m_fields and for
+		// initializer lists either way, only the offsets change.
+		inline void SetFieldReordering(bool enabled) { m_reorderFields = enabled; }
+		inline bool GetFieldReordering() const { return m_reorderFields; }
+		// a function every program can call without declaring it, like the predeclared print(...)
+		void DeclareNative(std::string_view name, TypeKind::Type returnKind, std::span<const TypeKind::Type> params, bool variadic);
+
+	private:
+		// a declaration in one of the open scopes
+		struct Variable {
+			SymbolId m_name = InvalidSymbol;
+			const TypeInfo* m_type = nullptr;
+			bool m_isConst = false;		// const variables and functions cannot be assigned
+			BindingKind::Type m_binding = BindingKind::UNRESOLVED;
+			uint32_t m_slot = 0;
+			uint32_t m_frame = 0;		// of a LOCAL, how many functions it is nested in
+			uint32_t m_shadowed = 0;	// the visible declaration of the same name before this one, or NoVariable
+		};
+		struct Scope {
+			size_t m_firstVariable = 0;
+			uint32_t m_firstSlot = 0;	// freed again when the scope closes, so sibling blocks share slots
+			std::unordered_map<SymbolId, const TypeInfo*> m_structs;
+		};
+		// what return, break and continue refer to and where locals go, swapped out by function literals
+		struct FunctionContext {
+			const TypeInfo* m_returnType = nullptr; // nullptr outside functions
+			int m_loops = 0;
+			int m_breakables = 0; // loops and switches
+			uint32_t m_frame = 0;
+			uint32_t m_nextSlot = 0;
+			uint32_t m_frameSize = 0;
+		};
+		struct FunctionJob {
+			FunctionDeclNode* m_function;
+			const TypeInfo* m_type;
+			std::vector<SymbolId>* m_uses;
+		};
+		// what Reanalyze keeps of a top-level item
+		struct ItemRecord {
+			std::vector<SymbolId> m_uses;	// the globals and struct types it names, sorted
+			std::vector<SymbolId> m_typeUses;	// VAR_DECL and STRUCT_DECL, the names its types were collected with, sorted
+			size_t m_signatureEnd = 0;		// FUNCTION_DECL, where the diagnostics of its signature end
+			size_t m_diagnosticsEnd = 0;	// where its diagnostics end, they begin where the previous item's do
+			uint32_t m_function = 0;		// FUNCTION_DECL, index into m_functionTypes
+			uint32_t m_variable = 0;		// FUNCTION_DECL, its declaration in m_variables, or NoVariable when it redefines a name
+			uint32_t m_firstGlobal = 0;		// VAR_DECL, index into m_globalTypes of its first declarator
+			uint32_t m_frameSize = 0;		// slots of the program frame it needs
+		};
+		struct Native {
+			SymbolId m_name;
+			TypeKind::Type m_return;
+			std::vector<TypeKind::Type> m_params;
+			bool m_variadic;
+		};
+
+		void Visit(ProgramNode& node) override;
+		void Visit(ImportNode& node) override;
+		void Visit(FunctionDeclNode& node) override;
+
+		void Visit(CompoundStmtNode& node) override;
+		void Visit(ExpressionStmtNode& node) override;
+		void Visit(VariableDeclNode& node) override;
+		void Visit(StructDeclNode& node) override;
+		void Visit(IfStmtNode& node) override;
+		void Visit(SwitchStmtNode& node) override;
+		void Visit(CaseNode& node) override;
+		void Visit(DefaultNode& node) override;
+		void Visit(WhileStmtNode& node) override;
+		void Visit(ForStmtNode& node) override;
+		void Visit(ReturnStmtNode& node) override;
+		void Visit(BreakStmtNode& node) override;
+		void Visit(ContinueStmtNode& node) override;
+
+		void Visit(CommaExprNode& node) override;
+		void Visit(AssignmentExprNode& node) override;
+		void Visit(ConditionalExprNode& node) override;
+		void Visit(BinaryExprNode& node) override;
+		void Visit(UnaryExprNode& node) override;
+		void Visit(PostfixExprNode& node) override;
+		void Visit(FunctionCallNode& node) override;
+		void Visit(ArrayIndexNode& node) override;
+		void Visit(MemberAccessNode& node) override;
+		void Visit(FunctionLiteralNode& node) override;
+		void Visit(IdentifierNode& node) override;
+		void Visit(LiteralNode& node) override;
+
+		void Visit(ParameterNode& node) override;
+		void Visit(DeclaratorNode& node) override;
+		void Visit(StructMemberNode& node) override;
+		void Visit(InitializerNode& node) override;
+
+		void Visit(BuiltinTypeNode& node) override;
+		void Visit(NamedTypeNode& node) override;
+		void Visit(FunctionTypeNode& node) override;
+
+		// below this many bodies per run checking them in parallel does not pay off
+		static constexpr size_t MinParallelFunctions = 32;
+
+		bool Run(AstNode* root, ThreadPool* pool, size_t chunkCount);
+		void CheckItems(ProgramNode& program);
+		void CheckItem(AstNode* item, ItemRecord& record);
+		uint32_t ProgramFrameSize() const;
+		// removes the diagnostics from index first on and returns them
+		std::vector<SemanticException> TakeDiagnostics(size_t first);
+		void CheckItemsParallel(ProgramNode& program, const std::vector<FunctionJob>& jobs, size_t runs);
+		// take over the types and the declared natives and globals of from, to check function bodies
+		void Fork(const SemanticAnalyzer& from);
+		// the diagnostics of jobs[i] end at the returned [i]
+		std::vector<size_t> CheckFunctions(std::span<const FunctionJob> jobs);
+
+		// --- declarations ---
+		void CollectGlobals(ProgramNode& program);
+		TypeInfo* DeclareStruct(StructDeclNode& node);
+		void DefineFields(StructDeclNode& node, TypeInfo* type);
+		// the size, alignment and field offsets of type, after those of the structs it holds
+		void LayOut(TypeInfo* type);
+		const TypeInfo* FunctionType(TypeNode* returnType, const AstList<ParameterNode*>& params);
+		// the frame size the body needs
+		uint32_t CheckFunction(const AstList<ParameterNode*>& params, const TypeInfo* type, CompoundStmtNode* body, AstNode& at);
+		// the type of declarator's name, base with declarator's array sizes
+		const TypeInfo* DeclaredType(const TypeInfo* base, DeclaratorNode& declarator, bool constantSizes);
+		void Declare(IdentifierNode& name, const TypeInfo* type, bool isConst);
+		// nullptr when the name is already declared in the innermost scope
+		Variable* Add(SymbolId name, const TypeInfo* type, bool isConst);
+		const Variable* Lookup(SymbolId name) const;
+		void Bind(IdentifierNode& node, const Variable& variable) const;
+		const TypeInfo* LookupStruct(SymbolId name) const;
+		void PushScope();
+		void PopScope();
+
+		// --- checks ---
+		inline const TypeInfo* ResolveType(TypeNode* node) { node->Accept(*this); return m_result; }
+		const TypeInfo* Check(ExpressionNode* node);
+		void CheckCondition(ExpressionNode* node);
+		void CheckStatement(AstNode* node, bool scoped);
+		// value may be an initializer list when target is an array or a struct
+		void CheckInitializer(const TypeInfo* target, ExpressionNode* value);
+		void CheckAssignable(const TypeInfo* target, const TypeInfo* value, AstNode& at);
+		void CheckModifiable(ExpressionNode* node);
+		static bool IsAssignable(const TypeInfo* target, const TypeInfo* value);
+		static bool AlwaysReturns(AstNode* node);
+		// value of an integral constant expression, nullopt when it is not one
+		static std::optional<int64_t> EvaluateConstant(ExpressionNode* node);
+		// int or double for arithmetic operands, bool and char are promoted
+		const TypeInfo* Arithmetic(const TypeInfo* left, const TypeInfo* right) const;
+
+		void Error(const std::string& message, const AstNode& at);
+		const TypeInfo* Error() const { return m_types->Error(); }
+
+		std::shared_ptr<TypeTable> m_types;	// shared with the workers
+		std::vector<Scope> m_scopes;	// innermost last, [0] holds the natives and [1] the globals
+		size_t m_depth = 0;				// scopes in use, popped scopes are kept for their buckets
+		std::vector<Variable> m_variables;	// declared in the open scopes, in order
+		std::vector<uint32_t> m_innermost;	// by SymbolId, index of the visible declaration in m_variables
+		uint32_t m_globalCount = 0;
+		FunctionContext m_function;
+		const TypeInfo* m_result = nullptr; // type of the last expression or type node visited
+		std::vector<Native> m_natives;
+		std::vector<const TypeInfo*> m_functionTypes;	// of the top-level functions, in order
+		std::vector<const TypeInfo*> m_globalTypes;		// of the top-level declarators, in order
+		size_t m_nextGlobal = 0;
+		std::vector<SemanticException> m_diagnostics;
+		ThreadPool* m_pool = nullptr;	// of the running parallel Analyze
+		size_t m_chunkCount = 1;
+		std::vector<std::unique_ptr<SemanticAnalyzer>> m_workers; // kept for their buffers
+
+		AstNode* m_root = nullptr;			// of the last Analyze
+		std::vector<ItemRecord> m_items;	// by top-level item of m_root
+		// the diagnostics of collecting the globals come first: those of the struct names, of the
+		// signatures, then of the global variables and the struct members
+		size_t m_structsEnd = 0;
+		size_t m_signaturesEnd = 0;
+		size_t m_collectEnd = 0;
+		std::vector<SymbolId>* m_uses = nullptr;	// of the item being checked
+		size_t m_lastChecked = 0;
+		bool m_reorderFields = true;
+		std::vector<const TypeInfo*> m_layingOut;	// the structs LayOut is in, outermost first
+	};
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <shared_mutex>
+#include <mutex>
+#include <cstdint>
+#include <memory>
+#include <bit>
+#include "Singleton.h"
+#include "TextArena.h"
+
+namespace CppInterp {
+
+	// handle of an interned name, equal names have equal ids
+	using SymbolId = uint32_t;
+	constexpr SymbolId InvalidSymbol = UINT32_MAX;
+
+	// Process wide interner for identifier names. Names are stored once and never released,
+	// so views returned by GetName stay valid for the life of the program. Thread safe, GetName
+	// takes no lock: names live in blocks that never move, the id itself orders the read.
+	class SymbolTable :public Singleton<SymbolTable> {
+		friend class ::Singleton<SymbolTable>;
+	public:
+		// holds the table lock, so a run of names costs one acquisition
+		class Batch {
+		public:
+			explicit Batch(SymbolTable& table) :m_table(table), m_lock(table.m_mutex) {}
+			inline SymbolId Intern(std::string_view name) { return m_table.InternLocked(name); }
+
+		private:
+			SymbolTable& m_table;
+			std::unique_lock<std::shared_mutex> m_lock;
+		};
+
+		SymbolId Intern(std::string_view name);
+		// InvalidSymbol if name was never interned
+		SymbolId Find(std::string_view name) const;
+		// id must come from Intern or Find
+		inline std::string_view GetName(SymbolId id) const {
+			auto [block, index] = Locate(id);
+			return m_nameBlocks[block][index];
+		}
+		size_t Size() const;
+
+	private:
+		// block b holds FirstBlockSize << b names, so ids up to InvalidSymbol fit in BlockCount blocks
+		static constexpr uint32_t FirstBlockSize = 1024;
+		static constexpr int BlockCount = 23;
+
+		SymbolTable() = default;
+
+		SymbolId InternLocked(std::string_view name);
+
+		static inline std::pair<int, uint32_t> Locate(SymbolId id) {
+			uint64_t slot = static_cast<uint64_t>(id) / FirstBlockSize + 1;
+			int block = std::bit_width(slot) - 1;
+			uint64_t blockBegin = ((uint64_t(1) << block) - 1) * FirstBlockSize;
+			return { block, static_cast<uint32_t>(id - blockBegin) };
+		}
+
+		mutable std::shared_mutex m_mutex;
+		TextArena m_texts;
+		std::unique_ptr<std::string_view[]> m_nameBlocks[BlockCount]; // indexed through Locate
+		SymbolId m_size = 0;
+		std::unordered_map<std::string_view, SymbolId> m_ids;
+	};
+}
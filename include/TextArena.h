@@ -0,0 +1,31 @@
+#pragma once
+#include <string_view>
+#include <memory>
+#include <vector>
+
+namespace CppInterp {
+
+	// Append-only text storage in fixed size blocks, views into it stay valid until Reset.
+	class TextArena {
+	public:
+		static constexpr size_t BlockSize = 16 * 1024;
+
+		std::string_view Store(std::string_view text);
+		bool Owns(const char* ptr) const;
+		// bytes held by the blocks
+		size_t Capacity() const;
+		// take over the blocks of other, views into them stay valid
+		void Adopt(TextArena&& other);
+		// drop all stored text, keeping the first block for reuse
+		void Reset();
+
+	private:
+		struct Block {
+			std::unique_ptr<char[]> m_data;
+			size_t m_capacity;
+		};
+
+		std::vector<Block> m_blocks;
+		size_t m_used = 0; // bytes used in the last block
+	};
+}
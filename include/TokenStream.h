@@ -0,0 +1,51 @@
+#pragma once
+#include <istream>
+#include <functional>
+#include <unordered_set>
+#include "Lexer.h"
+
+namespace CppInterp {
+
+	// Pull-based tokenizer over chunked input. Only the current chunk and its tokens are buffered;
+	// token text is copied into the stream (identifiers into the SymbolTable) once per distinct
+	// spelling, so memory follows the vocabulary of the source rather than its size. Token views stay valid as long as the stream.
+	class TokenStream {
+	public:
+		static constexpr size_t DefaultChunkSize = 64 * 1024;
+
+		explicit TokenStream(std::istream& input, size_t chunkSize = DefaultChunkSize);
+		// reads until end of file, the descriptor stays owned by the caller
+		explicit TokenStream(int fd, size_t chunkSize = DefaultChunkSize);
+		// tokens view the buffer directly, it must outlive the stream
+		explicit TokenStream(std::string_view buffer, size_t chunkSize = DefaultChunkSize);
+
+		TokenStream(const TokenStream&) = delete;
+		TokenStream& operator=(const TokenStream&) = delete;
+
+		// false once every token has been returned
+		bool Next(Token& token);
+		// the token Next would return, nullptr at the end of input
+		const Token* Peek();
+
+	private:
+		// reads and lexes chunks until a token is buffered or the input ends
+		bool Fill();
+		Token MakeToken(size_t index);
+		std::string_view Intern(std::string_view text);
+
+		std::function<size_t(char*, size_t)> m_read;
+		std::unique_ptr<char[]> m_chunk;
+		size_t m_chunkSize;
+		std::string_view m_buffer; // set when reading from memory
+		size_t m_bufferOffset = 0;
+		bool m_inputEnd = false;
+
+		LexContext m_context;
+		TokenList m_tokens;
+		size_t m_next = 0;
+		Token m_peeked;
+
+		TextArena m_texts;
+		std::unordered_set<std::string_view> m_internedTexts;
+	};
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include "SymbolTable.h"
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace CppInterp {
+
+	struct StructDeclNode;
+
+	// index of a type in its TypeTable
+	using TypeId = uint32_t;
+
+	namespace TypeKind {
+		using Type = uint8_t;
+
+		constexpr Type ERROR = 0;      // an expression that did not check, accepted everywhere so errors do not cascade
+		constexpr Type VOID = 1;
+		constexpr Type BOOL = 2;
+		constexpr Type CHAR = 3;
+		constexpr Type INT = 4;
+		constexpr Type DOUBLE = 5;
+		constexpr Type STRING = 6;
+		constexpr Type NULL_TYPE = 7;  // NULL
+		constexpr Type ARRAY = 8;
+		constexpr Type FUNCTION = 9;
+		constexpr Type STRUCT = 10;
+
+		constexpr size_t BuiltinCount = 8;
+	}
+
+	struct TypeInfo;
+
+	struct StructField {
+		SymbolId m_name = InvalidSymbol;
+		const TypeInfo* m_type = nullptr;
+		uint32_t m_offset = 0;	// bytes from the start of the struct, set by the layout
+	};
+
+	// A type owned by a TypeTable. Builtin, array and function types exist once per table, so two
+	// of them are the same type exactly when the pointers (or ids) are. Struct types are nominal:
+	// every declaration makes a type of its own.
+	struct TypeInfo {
+		TypeKind::Type m_kind = TypeKind::ERROR;
+		bool m_variadic = false;				// FUNCTION, any arguments may follow m_params
+		TypeId m_id = 0;
+		const TypeInfo* m_element = nullptr;	// ARRAY
+		uint32_t m_length = 0;					// ARRAY, 0 when the size is only known at run time
+		const TypeInfo* m_return = nullptr;		// FUNCTION
+		std::vector<const TypeInfo*> m_params;	// FUNCTION
+		SymbolId m_name = InvalidSymbol;		// STRUCT
+		const StructDeclNode* m_decl = nullptr;	// STRUCT
+		std::vector<StructField> m_fields;		// STRUCT, in declaration order, which the offsets need not follow
+		uint32_t m_size = 0;					// STRUCT, set by the layout
+		uint32_t m_align = 0;					// STRUCT, 0 until laid out
+
+		inline bool Is(TypeKind::Type kind) const { return m_kind == kind; }
+		inline bool IsError() const { return m_kind == TypeKind::ERROR; }
+		// bool, char, int and double convert into each other
+		inline bool IsArithmetic() const { return m_kind >= TypeKind::BOOL && m_kind <= TypeKind::DOUBLE; }
+		inline bool IsIntegral() const { return m_kind >= TypeKind::BOOL && m_kind <= TypeKind::INT; }
+		// types NULL converts to
+		inline bool IsNullable() const { return m_kind >= TypeKind::STRING && m_kind != TypeKind::NULL_TYPE; }
+		// index into m_fields, -1 when there is no such field
+		int FindField(SymbolId name) const;
+		// bytes a value takes in place, in a frame slot, an array or a struct. Strings, functions and
+		// arrays sized at run time are held by a handle, everything else inline.
+		uint64_t Size() const;
+		uint32_t Alignment() const;
+		// spelling for diagnostics, like "(int, double[4]) -> string"
+		std::string ToString() const;
+	};
+
+	// Interns the types of one analysis. Lookups hash the kind and the ids of the component types,
+	// no names or spellings are built. Thread safe, analyzers checking function bodies side by side
+	// share one table.
+	class TypeTable {
+	public:
+		TypeTable();
+		TypeTable(const TypeTable&) = delete;
+		TypeTable& operator=(const TypeTable&) = delete;
+
+		inline const TypeInfo* Builtin(TypeKind::Type kind) const { return m_builtins[kind]; }
+		inline const TypeInfo* Error() const { return m_builtins[TypeKind::ERROR]; }
+		// int, double, char, string, bool or void by spelling, nullptr for anything else
+		const TypeInfo* FindBuiltin(std::string_view name) const;
+		const TypeInfo* GetArray(const TypeInfo* element, uint32_t length);
+		const TypeInfo* GetFunction(const TypeInfo* returnType, std::span<const TypeInfo* const> params, bool variadic = false);
+		// a new struct type without fields, the analyzer fills them in
+		TypeInfo* NewStruct(SymbolId name, const StructDeclNode* decl);
+
+		const TypeInfo* Get(TypeId id) const;
+		size_t Size() const;
+
+	private:
+		// what makes an array or function type, params views the stored type's list once interned
+		struct Key {
+			TypeKind::Type m_kind;
+			const TypeInfo* m_inner;	// element or return type
+			uint32_t m_extra;			// length or variadic
+			std::span<const TypeInfo* const> m_params;
+			bool operator==(const Key& other) const;
+		};
+		struct KeyHash {
+			size_t operator()(const Key& key) const;
+		};
+
+		const TypeInfo* Find(const Key& key) const;
+		// called with the lock held exclusively, or from the constructor
+		TypeInfo* Add(TypeInfo&& type);
+		const TypeInfo* Intern(const Key& key, TypeInfo&& type);
+
+		mutable std::shared_mutex m_mutex; // guards m_types and m_interned, the builtins never change
+		std::deque<TypeInfo> m_types; // indexed by id, never moves
+		std::array<const TypeInfo*, TypeKind::BuiltinCount> m_builtins{};
+		std::unordered_map<Key, const TypeInfo*, KeyHash> m_interned;
+	};
+}
@@ -0,0 +1,40 @@
+#include "AstArena.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace CppInterp {
+
+	void* AstArena::do_allocate(size_t bytes, size_t alignment) {
+		auto aligned = [alignment](std::byte* ptr) {
+			auto address = reinterpret_cast<std::uintptr_t>(ptr);
+			return reinterpret_cast<std::byte*>((address + alignment - 1) & ~(std::uintptr_t(alignment) - 1));
+		};
+		std::byte* result = m_cursor ? aligned(m_cursor) : nullptr;
+		if (!result || result + bytes > m_end) {
+			// a list buffer larger than a block gets a block of its own
+			size_t capacity = std::max(BlockSize, bytes + alignment);
+			m_blocks.push_back(Block{ std::make_unique<std::byte[]>(capacity), capacity });
+			m_end = m_blocks.back().m_data.get() + capacity;
+			result = aligned(m_blocks.back().m_data.get());
+		}
+		m_cursor = result + bytes;
+		m_bytesUsed += bytes;
+		return result;
+	}
+
+	size_t AstArena::Capacity() const {
+		size_t capacity = 0;
+		for (const Block& block : m_blocks)
+			capacity += block.m_capacity;
+		return capacity;
+	}
+
+	void AstArena::Reset() {
+		if (m_blocks.size() > 1)
+			m_blocks.erase(m_blocks.begin() + 1, m_blocks.end());
+		m_cursor = m_blocks.empty() ? nullptr : m_blocks.front().m_data.get();
+		m_end = m_blocks.empty() ? nullptr : m_cursor + m_blocks.front().m_capacity;
+		m_objectCount = 0;
+		m_bytesUsed = 0;
+	}
+}
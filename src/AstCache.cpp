@@ -0,0 +1,100 @@
+#include "AstCache.h"
+#include "Serializer.hpp"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <system_error>
+
+namespace CppInterp {
+
+	namespace {
+		// One cache file, the tree is a FlatAst image. The source is kept whole, a hash of 64 bits
+		// alone could hand out the tree of another source that collides with it.
+		struct AstCacheEntry {
+			uint64_t m_sourceHash = 0;
+			std::string m_source;
+			std::string m_tree;
+
+			auto Tie() { return std::tie(m_sourceHash, m_source, m_tree); }
+			auto Tie() const { return std::tie(m_sourceHash, m_source, m_tree); }
+		};
+	}
+
+	AstCache::AstCache(std::filesystem::path directory) : m_directory(std::move(directory)) {}
+
+	uint64_t AstCache::Hash(std::string_view source) {
+		constexpr uint64_t Prime = 0x100000001b3ull;
+		uint64_t hash = 0xcbf29ce484222325ull;
+		size_t i = 0;
+		// little-endian words, so the hash does not depend on the byte order of the machine
+		for (; i + 8 <= source.size(); i += 8) {
+			uint64_t word = 0;
+			for (int b = 7; b >= 0; b--)
+				word = word << 8 | static_cast<unsigned char>(source[i + b]);
+			hash = (hash ^ word) * Prime;
+			hash ^= hash >> 29;
+		}
+		for (; i < source.size(); i++)
+			hash = (hash ^ static_cast<unsigned char>(source[i])) * Prime;
+		return hash;
+	}
+
+	std::filesystem::path AstCache::EntryPath(uint64_t hash) const {
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.ast", static_cast<unsigned long long>(hash));
+		return m_directory / name;
+	}
+
+	std::optional<FlatAst> AstCache::Load(std::string_view source) const {
+		uint64_t hash = Hash(source);
+		std::ifstream file(EntryPath(hash), std::ios::binary);
+		if (!file)
+			return std::nullopt;
+		std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		try {
+			AstCacheEntry entry = Serializer::DeSerialize<AstCacheEntry>(data);
+			if (entry.m_sourceHash != hash || entry.m_source != source)
+				return std::nullopt;
+			FlatAst ast = FlatAst::FromBinary(entry.m_tree);
+			// the parser takes the tree as its program
+			if (ast.Empty() || ast.Kind(FlatAst::Root) != NodeType::PROGRAM)
+				return std::nullopt;
+			return ast;
+		}
+		catch (const std::exception&) {
+			return std::nullopt;
+		}
+	}
+
+	bool AstCache::Store(std::string_view source, const FlatAst& ast) const {
+		AstCacheEntry entry;
+		entry.m_sourceHash = Hash(source);
+		entry.m_source.assign(source);
+		entry.m_tree = ast.ToBinary();
+		std::string data = Serializer::Serialize(entry);
+
+		std::error_code error;
+		std::filesystem::create_directories(m_directory, error);
+		std::filesystem::path path = EntryPath(entry.m_sourceHash);
+		// a name of its own for every writer, so stores of the same source do not truncate each other
+		static std::atomic<uint32_t> stores{ 0 };
+		char suffix[32];
+		std::snprintf(suffix, sizeof(suffix), ".%08x%08x.tmp", static_cast<unsigned>(std::random_device()()),
+			static_cast<unsigned>(stores.fetch_add(1, std::memory_order_relaxed)));
+		std::filesystem::path temporary = path;
+		temporary += suffix;
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			if (!file.write(data.data(), static_cast<std::streamsize>(data.size())))
+				return false;
+		}
+		std::filesystem::rename(temporary, path, error);
+		if (error) {
+			std::filesystem::remove(temporary, error);
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,823 @@
+#include "FlatAst.h"
+#include "Serializer.hpp"
+#include <stdexcept>
+#include <unordered_map>
+
+namespace CppInterp {
+
+	// Appends the rows of a pointer tree in preorder: a node's row is added before its children
+	// are converted, its extra entries after, so child lists stay contiguous.
+	class FlatAstBuilder : public AstVisitor {
+	public:
+		using NodeIndex = FlatAst::NodeIndex;
+
+		FlatAstBuilder(FlatAst& ast, std::vector<const AstNode*>* origins) : m_ast(ast), m_origins(origins) {}
+
+		NodeIndex Convert(const AstNode* node) {
+			if (!node)
+				return FlatAst::InvalidNode;
+			NodeIndex index = static_cast<NodeIndex>(m_ast.m_kinds.size());
+			const_cast<AstNode*>(node)->Accept(*this);
+			return index;
+		}
+
+		void Visit(ProgramNode& node) override { Build(node, {}, node.m_declarations); }
+		void Visit(ImportNode& node) override {
+			NodeIndex self = Add(node, node.m_isStringLiteral);
+			m_ast.m_lhs[self] = AddText(node.m_moduleName);
+		}
+		void Visit(FunctionDeclNode& node) override { Build(node, { node.m_returnType, node.m_name, node.m_body }, node.m_params); }
+
+		void Visit(CompoundStmtNode& node) override { Build(node, {}, node.m_statements); }
+		void Visit(ExpressionStmtNode& node) override { Build(node, { node.m_expression }); }
+		void Visit(VariableDeclNode& node) override { Build(node, { node.m_type }, node.m_declarators, node.m_isConst); }
+		void Visit(StructDeclNode& node) override { Build(node, { node.m_name }, node.m_members); }
+		void Visit(IfStmtNode& node) override { Build(node, { node.m_condition, node.m_thenStmt, node.m_elseStmt }); }
+		void Visit(SwitchStmtNode& node) override { Build(node, { node.m_condition, node.m_default }, node.m_cases); }
+		void Visit(CaseNode& node) override { Build(node, { node.m_literal }, node.m_statements); }
+		void Visit(DefaultNode& node) override { Build(node, {}, node.m_statements); }
+		void Visit(WhileStmtNode& node) override { Build(node, { node.m_condition, node.m_body }); }
+		void Visit(ForStmtNode& node) override { Build(node, { node.m_init, node.m_condition, node.m_increment, node.m_body }); }
+		void Visit(ReturnStmtNode& node) override { Build(node, { node.m_expression }); }
+		void Visit(BreakStmtNode& node) override { Add(node); }
+		void Visit(ContinueStmtNode& node) override { Add(node); }
+
+		void Visit(CommaExprNode& node) override { Build(node, {}, node.m_expressions); }
+		void Visit(AssignmentExprNode& node) override { Build(node, { node.m_left, node.m_right }, node.m_op); }
+		void Visit(ConditionalExprNode& node) override { Build(node, { node.m_condition, node.m_trueExpr, node.m_falseExpr }); }
+		void Visit(BinaryExprNode& node) override { Build(node, { node.m_left, node.m_right }, node.m_op); }
+		void Visit(UnaryExprNode& node) override { Build(node, { node.m_operand }, node.m_op); }
+		void Visit(PostfixExprNode& node) override { Build(node, { node.m_primary }, node.m_op); }
+		void Visit(FunctionCallNode& node) override { Build(node, { node.m_callee }, node.m_arguments); }
+		void Visit(ArrayIndexNode& node) override { Build(node, { node.m_array, node.m_index }); }
+		void Visit(MemberAccessNode& node) override { Build(node, { node.m_object, node.m_memberName }); }
+		void Visit(FunctionLiteralNode& node) override { Build(node, { node.m_returnType, node.m_body }, node.m_params); }
+		void Visit(IdentifierNode& node) override {
+			NodeIndex self = Add(node);
+			m_ast.m_lhs[self] = node.m_symbol;
+		}
+		void Visit(LiteralNode& node) override {
+			NodeIndex self = Add(node, node.m_literalType);
+			m_ast.m_lhs[self] = AddText(node.m_value);
+			if (node.m_literalType == TokenType::STRING_LITERAL) {
+				m_ast.m_rhs[self] = AddText(node.m_literal.m_string);
+				return;
+			}
+			int64_t bits;
+			switch (node.m_literalType) {
+			case TokenType::DOUBLE_LITERAL: bits = std::bit_cast<int64_t>(node.m_literal.m_double); break;
+			case TokenType::CHARACTER_LITERAL: bits = node.m_literal.m_char; break;
+			case TokenType::BOOL_LITERAL: bits = node.m_literal.m_bool; break;
+			default: bits = node.m_literal.m_int; break;
+			}
+			m_ast.m_rhs[self] = static_cast<uint32_t>(m_ast.m_literals.size());
+			m_ast.m_literals.push_back(bits);
+		}
+
+		void Visit(ParameterNode& node) override { Build(node, { node.m_type, node.m_declarator }); }
+		void Visit(DeclaratorNode& node) override { Build(node, { node.m_name, node.m_initializer }, node.m_arraySizes); }
+		void Visit(StructMemberNode& node) override { Build(node, { node.m_type }, node.m_declarators); }
+		void Visit(InitializerNode& node) override { Build(node, {}, node.m_values); }
+
+		void Visit(BuiltinTypeNode& node) override {
+			NodeIndex self = Add(node);
+			m_ast.m_lhs[self] = AddText(node.m_name);
+		}
+		void Visit(NamedTypeNode& node) override {
+			NodeIndex self = Add(node);
+			m_ast.m_lhs[self] = node.m_symbol;
+		}
+		void Visit(FunctionTypeNode& node) override { Build(node, { node.m_returnType }, node.m_paramTypes); }
+
+	private:
+		NodeIndex Add(const AstNode& node, uint8_t op = 0) {
+			NodeIndex index = static_cast<NodeIndex>(m_ast.m_kinds.size());
+			m_ast.m_kinds.push_back(node.m_nodeType);
+			m_ast.m_ops.push_back(op);
+			m_ast.m_lines.push_back(static_cast<uint32_t>(node.m_line));
+			m_ast.m_columns.push_back(static_cast<uint32_t>(node.m_column));
+			m_ast.m_lhs.push_back(FlatAst::InvalidNode);
+			m_ast.m_rhs.push_back(FlatAst::InvalidNode);
+			if (m_origins)
+				m_origins->push_back(&node);
+			return index;
+		}
+
+		uint32_t AddText(std::string_view text) {
+			m_ast.m_texts.push_back(text);
+			return static_cast<uint32_t>(m_ast.m_texts.size() - 1);
+		}
+
+		void Build(const AstNode& node, std::initializer_list<const AstNode*> slots, uint8_t op = 0) {
+			Build(node, slots, std::span<AstNode* const>(), op);
+		}
+
+		template <typename List>
+		void Build(const AstNode& node, std::initializer_list<const AstNode*> slots, const List& list, uint8_t op = 0) {
+			NodeIndex self = Add(node, op);
+			// converted children wait on the scratch stack, nested nodes pop their own entries
+			size_t start = m_scratch.size();
+			for (const AstNode* slot : slots)
+				m_scratch.push_back(Convert(slot));
+			for (const AstNode* child : list)
+				m_scratch.push_back(Convert(child));
+
+			if (FlatAst::Inline(node.m_nodeType)) {
+				if (slots.size() > 0)
+					m_ast.m_lhs[self] = m_scratch[start];
+				if (slots.size() > 1)
+					m_ast.m_rhs[self] = m_scratch[start + 1];
+			}
+			else {
+				m_ast.m_lhs[self] = static_cast<uint32_t>(m_ast.m_extra.size());
+				auto first = m_scratch.begin() + start;
+				m_ast.m_extra.insert(m_ast.m_extra.end(), first, first + slots.size());
+				if (FlatAst::GetShape(node.m_nodeType).m_list) {
+					m_ast.m_extra.push_back(static_cast<NodeIndex>(list.size()));
+					m_ast.m_extra.insert(m_ast.m_extra.end(), first + slots.size(), m_scratch.end());
+				}
+			}
+			m_scratch.resize(start);
+		}
+
+		FlatAst& m_ast;
+		std::vector<const AstNode*>* m_origins;
+		std::vector<NodeIndex> m_scratch;
+	};
+
+	// Creates the pointer nodes of the rows again, each node before its children.
+	class FlatAstLoader {
+	public:
+		using NodeIndex = FlatAst::NodeIndex;
+
+		FlatAstLoader(const FlatAst& ast, AstArena& arena, TextArena& texts)
+			: m_ast(ast), m_arena(arena), m_texts(texts), m_kept(ast.m_texts.size()) {}
+
+		AstNode* Load(NodeIndex index, AstNode* parent) {
+			if (index == FlatAst::InvalidNode)
+				return nullptr;
+			AstNode* node = Create(index, parent);
+			node->m_line = m_ast.Line(index);
+			node->m_column = m_ast.Column(index);
+			return node;
+		}
+
+	private:
+		// the casts are safe for images that passed Validate, which checks the kind of every child
+		template <typename T>
+		T* Slot(NodeIndex index, size_t slot, AstNode* parent) {
+			return static_cast<T*>(Load(m_ast.Child(index, slot), parent));
+		}
+
+		template <typename List>
+		void Fill(List& list, NodeIndex index, AstNode* parent) {
+			auto children = m_ast.List(index);
+			list.reserve(children.size());
+			for (NodeIndex child : children)
+				list.push_back(static_cast<typename List::value_type>(Load(child, parent)));
+		}
+
+		// texts shared by many nodes, like type names, are copied once
+		std::string_view Keep(uint32_t text) {
+			if (!m_kept[text].data())
+				m_kept[text] = m_texts.Store(m_ast.m_texts[text]);
+			return m_kept[text];
+		}
+
+		AstNode* Create(NodeIndex index, AstNode* parent) {
+			switch (m_ast.Kind(index)) {
+			case NodeType::PROGRAM: {
+				auto* node = m_arena.New<ProgramNode>(parent);
+				Fill(node->m_declarations, index, node);
+				return node;
+			}
+			case NodeType::IMPORT_STMT: {
+				auto* node = m_arena.New<ImportNode>(parent);
+				node->m_isStringLiteral = m_ast.Op(index) != 0;
+				node->m_moduleName = Keep(m_ast.m_lhs[index]);
+				return node;
+			}
+			case NodeType::FUNCTION_DECL: {
+				auto* node = m_arena.New<FunctionDeclNode>(parent);
+				node->m_returnType = Slot<TypeNode>(index, 0, node);
+				node->m_name = Slot<IdentifierNode>(index, 1, node);
+				Fill(node->m_params, index, node);
+				node->m_body = Slot<CompoundStmtNode>(index, 2, node);
+				return node;
+			}
+			case NodeType::COMPOUND_STMT: {
+				auto* node = m_arena.New<CompoundStmtNode>(parent);
+				Fill(node->m_statements, index, node);
+				return node;
+			}
+			case NodeType::EXPRESSION_STMT: {
+				auto* node = m_arena.New<ExpressionStmtNode>(parent);
+				node->m_expression = Slot<ExpressionNode>(index, 0, node);
+				return node;
+			}
+			case NodeType::VAR_DECL: {
+				auto* node = m_arena.New<VariableDeclNode>(parent);
+				node->m_isConst = m_ast.Op(index) != 0;
+				node->m_type = Slot<TypeNode>(index, 0, node);
+				Fill(node->m_declarators, index, node);
+				return node;
+			}
+			case NodeType::STRUCT_DECL: {
+				auto* node = m_arena.New<StructDeclNode>(parent);
+				node->m_name = Slot<IdentifierNode>(index, 0, node);
+				Fill(node->m_members, index, node);
+				return node;
+			}
+			case NodeType::IF_STMT: {
+				auto* node = m_arena.New<IfStmtNode>(parent);
+				node->m_condition = Slot<ExpressionNode>(index, 0, node);
+				node->m_thenStmt = Slot<StatementNode>(index, 1, node);
+				node->m_elseStmt = Slot<StatementNode>(index, 2, node);
+				return node;
+			}
+			case NodeType::SWITCH_STMT: {
+				auto* node = m_arena.New<SwitchStmtNode>(parent);
+				node->m_condition = Slot<ExpressionNode>(index, 0, node);
+				Fill(node->m_cases, index, node);
+				node->m_default = Slot<DefaultNode>(index, 1, node);
+				return node;
+			}
+			case NodeType::CASE_STMT: {
+				auto* node = m_arena.New<CaseNode>(parent);
+				node->m_literal = Slot<LiteralNode>(index, 0, node);
+				Fill(node->m_statements, index, node);
+				return node;
+			}
+			case NodeType::DEFAULT_STMT: {
+				auto* node = m_arena.New<DefaultNode>(parent);
+				Fill(node->m_statements, index, node);
+				return node;
+			}
+			case NodeType::WHILE_STMT: {
+				auto* node = m_arena.New<WhileStmtNode>(parent);
+				node->m_condition = Slot<ExpressionNode>(index, 0, node);
+				node->m_body = Slot<StatementNode>(index, 1, node);
+				return node;
+			}
+			case NodeType::FOR_STMT: {
+				auto* node = m_arena.New<ForStmtNode>(parent);
+				node->m_init = Slot<AstNode>(index, 0, node);
+				node->m_condition = Slot<ExpressionNode>(index, 1, node);
+				node->m_increment = Slot<ExpressionNode>(index, 2, node);
+				node->m_body = Slot<StatementNode>(index, 3, node);
+				return node;
+			}
+			case NodeType::RETURN_STMT: {
+				auto* node = m_arena.New<ReturnStmtNode>(parent);
+				node->m_expression = Slot<ExpressionNode>(index, 0, node);
+				return node;
+			}
+			case NodeType::BREAK_STMT:
+				return m_arena.New<BreakStmtNode>(parent);
+			case NodeType::CONTINUE_STMT:
+				return m_arena.New<ContinueStmtNode>(parent);
+			case NodeType::COMMA_EXPR: {
+				auto* node = m_arena.New<CommaExprNode>(parent);
+				Fill(node->m_expressions, index, node);
+				return node;
+			}
+			case NodeType::ASSIGN_EXPR: {
+				auto* node = m_arena.New<AssignmentExprNode>(parent);
+				node->m_op = m_ast.Op(index);
+				node->m_left = Slot<ExpressionNode>(index, 0, node);
+				node->m_right = Slot<ExpressionNode>(index, 1, node);
+				return node;
+			}
+			case NodeType::COND_EXPR: {
+				auto* node = m_arena.New<ConditionalExprNode>(parent);
+				node->m_condition = Slot<ExpressionNode>(index, 0, node);
+				node->m_trueExpr = Slot<ExpressionNode>(index, 1, node);
+				node->m_falseExpr = Slot<ExpressionNode>(index, 2, node);
+				return node;
+			}
+			case NodeType::BINARY_EXPR: {
+				auto* node = m_arena.New<BinaryExprNode>(parent);
+				node->m_op = m_ast.Op(index);
+				node->m_left = Slot<ExpressionNode>(index, 0, node);
+				node->m_right = Slot<ExpressionNode>(index, 1, node);
+				return node;
+			}
+			case NodeType::UNARY_EXPR: {
+				auto* node = m_arena.New<UnaryExprNode>(parent);
+				node->m_op = m_ast.Op(index);
+				node->m_operand = Slot<ExpressionNode>(index, 0, node);
+				return node;
+			}
+			case NodeType::POSTFIX_EXPR: {
+				auto* node = m_arena.New<PostfixExprNode>(parent);
+				node->m_op = m_ast.Op(index);
+				node->m_primary = Slot<ExpressionNode>(index, 0, node);
+				return node;
+			}
+			case NodeType::FUNCTION_CALL: {
+				auto* node = m_arena.New<FunctionCallNode>(parent);
+				node->m_callee = Slot<ExpressionNode>(index, 0, node);
+				Fill(node->m_arguments, index, node);
+				return node;
+			}
+			case NodeType::ARRAY_INDEX: {
+				auto* node = m_arena.New<ArrayIndexNode>(parent);
+				node->m_array = Slot<ExpressionNode>(index, 0, node);
+				node->m_index = Slot<ExpressionNode>(index, 1, node);
+				return node;
+			}
+			case NodeType::MEMBER_ACCESS: {
+				auto* node = m_arena.New<MemberAccessNode>(parent);
+				node->m_object = Slot<ExpressionNode>(index, 0, node);
+				node->m_memberName = Slot<IdentifierNode>(index, 1, node);
+				return node;
+			}
+			case NodeType::FUNCTION_LITERAL: {
+				auto* node = m_arena.New<FunctionLiteralNode>(parent);
+				node->m_returnType = Slot<TypeNode>(index, 0, node);
+				Fill(node->m_params, index, node);
+				node->m_body = Slot<CompoundStmtNode>(index, 1, node);
+				return node;
+			}
+			case NodeType::IDENTIFIER: {
+				Token token(TokenType::IDENTIFIER, {}, 0, 0, m_ast.Symbol(index));
+				return m_arena.New<IdentifierNode>(token, parent);
+			}
+			case NodeType::LITERAL: {
+				Token token(m_ast.Op(index), Keep(m_ast.m_lhs[index]), 0, 0);
+				token.m_literal = m_ast.Literal(index);
+				if (token.m_type == TokenType::STRING_LITERAL)
+					token.m_literal.m_string = Keep(m_ast.m_rhs[index]);
+				return m_arena.New<LiteralNode>(token, parent);
+			}
+			case NodeType::PARAMETER: {
+				auto* node = m_arena.New<ParameterNode>(parent);
+				node->m_type = Slot<TypeNode>(index, 0, node);
+				node->m_declarator = Slot<DeclaratorNode>(index, 1, node);
+				return node;
+			}
+			case NodeType::DECLARATOR: {
+				auto* node = m_arena.New<DeclaratorNode>(parent);
+				node->m_name = Slot<IdentifierNode>(index, 0, node);
+				Fill(node->m_arraySizes, index, node);
+				node->m_initializer = Slot<ExpressionNode>(index, 1, node);
+				return node;
+			}
+			case NodeType::STRUCT_MEMBER_DECL: {
+				auto* node = m_arena.New<StructMemberNode>(parent);
+				node->m_type = Slot<TypeNode>(index, 0, node);
+				Fill(node->m_declarators, index, node);
+				return node;
+			}
+			case NodeType::INITIALIZER: {
+				auto* node = m_arena.New<InitializerNode>(parent);
+				Fill(node->m_values, index, node);
+				return node;
+			}
+			case NodeType::BUILTIN_TYPE: {
+				Token token(TokenType::IDENTIFIER, Keep(m_ast.m_lhs[index]), 0, 0);
+				return m_arena.New<BuiltinTypeNode>(token, parent);
+			}
+			case NodeType::NAMED_TYPE: {
+				Token token(TokenType::IDENTIFIER, {}, 0, 0, m_ast.Symbol(index));
+				return m_arena.New<NamedTypeNode>(token, parent);
+			}
+			case NodeType::FUNCTION_TYPE: {
+				auto* node = m_arena.New<FunctionTypeNode>(parent);
+				node->m_returnType = Slot<TypeNode>(index, 0, node);
+				Fill(node->m_paramTypes, index, node);
+				return node;
+			}
+			default:
+				throw std::runtime_error("FlatAst: unknown node kind " + std::to_string(m_ast.Kind(index)));
+			}
+		}
+
+		const FlatAst& m_ast;
+		AstArena& m_arena;
+		TextArena& m_texts;
+		std::vector<std::string_view> m_kept; // by text index
+	};
+
+	namespace {
+		constexpr uint32_t FlatAstMagic = 0x41495043; // "CPIA"
+		constexpr uint32_t FlatAstVersion = 1;
+
+		// what ToBinary writes, in member order
+		struct FlatAstImage {
+			uint32_t m_magic = 0;
+			uint32_t m_version = 0;
+			std::vector<NodeType::Type> m_kinds;
+			std::vector<uint8_t> m_ops;
+			std::vector<int32_t> m_lines; // difference to the line of the previous node
+			std::vector<uint32_t> m_columns;
+			// Children are written as their distance to the parent, which is small in preorder, and
+			// absent ones as 0. Other operands are written plus one, symbols as an index into the names.
+			std::vector<uint32_t> m_lhs;
+			std::vector<uint32_t> m_rhs;
+			std::vector<uint32_t> m_extra;
+			std::vector<uint32_t> m_textLengths; // of the distinct texts
+			std::string m_text; // the distinct texts one after another
+			std::vector<uint32_t> m_nameLengths;
+			std::string m_names;
+			std::vector<int64_t> m_literals;
+
+			auto Tie() {
+				return std::tie(m_magic, m_version, m_kinds, m_ops, m_lines, m_columns, m_lhs, m_rhs, m_extra,
+					m_textLengths, m_text, m_nameLengths, m_names, m_literals);
+			}
+			auto Tie() const {
+				return std::tie(m_magic, m_version, m_kinds, m_ops, m_lines, m_columns, m_lhs, m_rhs, m_extra,
+					m_textLengths, m_text, m_nameLengths, m_names, m_literals);
+			}
+		};
+
+		inline bool HasSymbol(NodeType::Type kind) {
+			return kind == NodeType::IDENTIFIER || kind == NodeType::NAMED_TYPE;
+		}
+
+		inline bool HasText(NodeType::Type kind) {
+			return kind == NodeType::IMPORT_STMT || kind == NodeType::LITERAL || kind == NodeType::BUILTIN_TYPE;
+		}
+
+		inline uint32_t EncodeChild(FlatAst::NodeIndex node, FlatAst::NodeIndex child) {
+			return child == FlatAst::InvalidNode ? 0 : child - node;
+		}
+
+		inline FlatAst::NodeIndex DecodeChild(FlatAst::NodeIndex node, uint32_t distance) {
+			return distance == 0 ? FlatAst::InvalidNode : node + distance;
+		}
+
+		[[noreturn]] void ThrowDamaged(const char* what) {
+			throw std::runtime_error(std::string("FlatAst image is damaged: ") + what);
+		}
+
+		// the base classes the loader casts children to
+		constexpr bool IsStatement(NodeType::Type kind) {
+			return kind >= NodeType::COMPOUND_STMT && kind <= NodeType::CONTINUE_STMT;
+		}
+		constexpr bool IsExpression(NodeType::Type kind) {
+			return (kind >= NodeType::COMMA_EXPR && kind <= NodeType::LITERAL) || kind == NodeType::INITIALIZER;
+		}
+		constexpr bool IsType(NodeType::Type kind) {
+			return kind >= NodeType::BUILTIN_TYPE && kind <= NodeType::FUNCTION_TYPE;
+		}
+		constexpr bool IsItem(NodeType::Type kind) {
+			return kind == NodeType::IMPORT_STMT || kind == NodeType::FUNCTION_DECL || IsStatement(kind);
+		}
+		constexpr bool IsForInit(NodeType::Type kind) {
+			return kind == NodeType::VAR_DECL || IsExpression(kind);
+		}
+		template <NodeType::Type Expected>
+		constexpr bool Is(NodeType::Type kind) {
+			return kind == Expected;
+		}
+		// kinds the loader can create
+		constexpr bool IsKnown(NodeType::Type kind) {
+			return kind == NodeType::PROGRAM || IsItem(kind) || IsExpression(kind) || IsType(kind) ||
+				(kind >= NodeType::PARAMETER && kind <= NodeType::STRUCT_MEMBER_DECL);
+		}
+
+		// what a child may be and whether the parser always sets it
+		struct ChildRule {
+			bool (*m_accepts)(NodeType::Type);
+			bool m_required;
+		};
+
+		// One rule per fixed slot in shape order, then one for the list entries, which are always present.
+		std::span<const ChildRule> ChildRules(NodeType::Type kind) {
+			using namespace NodeType;
+			switch (kind) {
+			case PROGRAM:
+			case COMPOUND_STMT: {
+				static constexpr ChildRule rules[] = { { IsItem, true } };
+				return rules;
+			}
+			case DEFAULT_STMT: {
+				static constexpr ChildRule rules[] = { { IsStatement, true } };
+				return rules;
+			}
+			case FUNCTION_DECL: {
+				// the body of a lazily parsed function is absent
+				static constexpr ChildRule rules[] = { { IsType, true }, { Is<IDENTIFIER>, true }, { Is<COMPOUND_STMT>, false }, { Is<PARAMETER>, true } };
+				return rules;
+			}
+			case EXPRESSION_STMT:
+			case RETURN_STMT: {
+				static constexpr ChildRule rules[] = { { IsExpression, false } };
+				return rules;
+			}
+			case VAR_DECL: {
+				static constexpr ChildRule rules[] = { { IsType, true }, { Is<DECLARATOR>, true } };
+				return rules;
+			}
+			case STRUCT_DECL: {
+				static constexpr ChildRule rules[] = { { Is<IDENTIFIER>, true }, { Is<STRUCT_MEMBER_DECL>, true } };
+				return rules;
+			}
+			case IF_STMT: {
+				static constexpr ChildRule rules[] = { { IsExpression, true }, { IsStatement, true }, { IsStatement, false } };
+				return rules;
+			}
+			case SWITCH_STMT: {
+				static constexpr ChildRule rules[] = { { IsExpression, true }, { Is<DEFAULT_STMT>, false }, { Is<CASE_STMT>, true } };
+				return rules;
+			}
+			case CASE_STMT: {
+				static constexpr ChildRule rules[] = { { Is<LITERAL>, true }, { IsStatement, true } };
+				return rules;
+			}
+			case WHILE_STMT: {
+				static constexpr ChildRule rules[] = { { IsExpression, true }, { IsStatement, true } };
+				return rules;
+			}
+			case FOR_STMT: {
+				static constexpr ChildRule rules[] = { { IsForInit, false }, { IsExpression, false }, { IsExpression, false }, { IsStatement, true } };
+				return rules;
+			}
+			case COMMA_EXPR:
+			case UNARY_EXPR:
+			case POSTFIX_EXPR:
+			case INITIALIZER: {
+				static constexpr ChildRule rules[] = { { IsExpression, true } };
+				return rules;
+			}
+			case ASSIGN_EXPR:
+			case BINARY_EXPR:
+			case FUNCTION_CALL:
+			case ARRAY_INDEX: {
+				static constexpr ChildRule rules[] = { { IsExpression, true }, { IsExpression, true } };
+				return rules;
+			}
+			case COND_EXPR: {
+				static constexpr ChildRule rules[] = { { IsExpression, true }, { IsExpression, true }, { IsExpression, true } };
+				return rules;
+			}
+			case MEMBER_ACCESS: {
+				static constexpr ChildRule rules[] = { { IsExpression, true }, { Is<IDENTIFIER>, true } };
+				return rules;
+			}
+			case FUNCTION_LITERAL: {
+				static constexpr ChildRule rules[] = { { IsType, true }, { Is<COMPOUND_STMT>, true }, { Is<PARAMETER>, true } };
+				return rules;
+			}
+			case PARAMETER: {
+				static constexpr ChildRule rules[] = { { IsType, true }, { Is<DECLARATOR>, true } };
+				return rules;
+			}
+			case DECLARATOR: {
+				static constexpr ChildRule rules[] = { { Is<IDENTIFIER>, true }, { IsExpression, false }, { IsExpression, true } };
+				return rules;
+			}
+			case STRUCT_MEMBER_DECL: {
+				static constexpr ChildRule rules[] = { { IsType, true }, { Is<DECLARATOR>, true } };
+				return rules;
+			}
+			case FUNCTION_TYPE: {
+				static constexpr ChildRule rules[] = { { IsType, true }, { IsType, true } };
+				return rules;
+			}
+			default:
+				return {};
+			}
+		}
+	}
+
+	AstNode* FlatAst::ToTree(AstArena& arena, TextArena& texts) const {
+		if (Empty())
+			return nullptr;
+		FlatAstLoader loader(*this, arena, texts);
+		return loader.Load(Root, nullptr);
+	}
+
+	std::string FlatAst::ToBinary() const {
+		FlatAstImage image;
+		image.m_magic = FlatAstMagic;
+		image.m_version = FlatAstVersion;
+		image.m_kinds = m_kinds;
+		image.m_ops = m_ops;
+		image.m_columns = m_columns;
+		image.m_literals = m_literals;
+		image.m_lines.resize(Size());
+		image.m_lhs.resize(Size());
+		image.m_rhs.resize(Size());
+		image.m_extra.resize(m_extra.size());
+
+		// the same spellings and names come up again and again
+		std::unordered_map<std::string_view, uint32_t> texts;
+		std::vector<uint32_t> textIndices;
+		textIndices.reserve(m_texts.size());
+		for (std::string_view text : m_texts) {
+			auto [it, added] = texts.try_emplace(text, static_cast<uint32_t>(texts.size()));
+			if (added) {
+				image.m_textLengths.push_back(static_cast<uint32_t>(text.size()));
+				image.m_text += text;
+			}
+			textIndices.push_back(it->second);
+		}
+		std::unordered_map<SymbolId, uint32_t> names;
+
+		uint32_t line = 0;
+		for (NodeIndex node = 0; node < Size(); node++) {
+			NodeType::Type kind = m_kinds[node];
+			image.m_lines[node] = static_cast<int32_t>(m_lines[node] - line);
+			line = m_lines[node];
+			uint32_t lhs = m_lhs[node], rhs = m_rhs[node];
+			Shape shape = GetShape(kind);
+			if (Inline(kind)) {
+				if (shape.m_slots > 0)
+					lhs = EncodeChild(node, lhs) - 1;
+				if (shape.m_slots > 1)
+					rhs = EncodeChild(node, rhs) - 1;
+			}
+			else {
+				for (size_t slot = 0; slot < shape.m_slots; slot++)
+					image.m_extra[lhs + slot] = EncodeChild(node, m_extra[lhs + slot]);
+				if (shape.m_list) {
+					size_t count = lhs + shape.m_slots;
+					image.m_extra[count] = m_extra[count];
+					for (size_t i = count + 1; i <= count + m_extra[count]; i++)
+						image.m_extra[i] = EncodeChild(node, m_extra[i]);
+				}
+			}
+			if (HasSymbol(kind)) {
+				auto [it, added] = names.try_emplace(lhs, static_cast<uint32_t>(names.size()));
+				if (added) {
+					std::string_view name = SymbolTable::Instance().GetName(lhs);
+					image.m_nameLengths.push_back(static_cast<uint32_t>(name.size()));
+					image.m_names += name;
+				}
+				lhs = it->second;
+			}
+			else if (HasText(kind)) {
+				lhs = textIndices[lhs];
+			}
+			if (kind == NodeType::LITERAL && m_ops[node] == TokenType::STRING_LITERAL)
+				rhs = textIndices[rhs];
+			// wraps, absent children and InvalidNode become 0
+			image.m_lhs[node] = lhs + 1;
+			image.m_rhs[node] = rhs + 1;
+		}
+		return Serializer::Serialize(image);
+	}
+
+	FlatAst FlatAst::FromBinary(const std::string& data) {
+		FlatAstImage image = Serializer::DeSerialize<FlatAstImage>(data);
+		if (image.m_magic != FlatAstMagic)
+			throw std::runtime_error("Not a FlatAst image");
+		if (image.m_version != FlatAstVersion)
+			throw std::runtime_error("FlatAst image of format version " + std::to_string(image.m_version));
+		const size_t size = image.m_kinds.size();
+		if (image.m_ops.size() != size || image.m_lines.size() != size || image.m_columns.size() != size ||
+			image.m_lhs.size() != size || image.m_rhs.size() != size)
+			ThrowDamaged("arrays of different lengths");
+
+		FlatAst ast;
+		auto owned = std::make_shared<std::string>(std::move(image.m_text));
+		size_t textOffset = 0;
+		ast.m_texts.reserve(image.m_textLengths.size());
+		for (uint32_t length : image.m_textLengths) {
+			if (length > owned->size() - textOffset)
+				ThrowDamaged("texts");
+			ast.m_texts.emplace_back(owned->data() + textOffset, length);
+			textOffset += length;
+		}
+		ast.m_ownedText = std::move(owned);
+
+		std::vector<SymbolId> symbols;
+		symbols.reserve(image.m_nameLengths.size());
+		{
+			SymbolTable::Batch batch(SymbolTable::Instance());
+			size_t nameOffset = 0;
+			for (uint32_t length : image.m_nameLengths) {
+				if (length > image.m_names.size() - nameOffset)
+					ThrowDamaged("names");
+				symbols.push_back(batch.Intern(std::string_view(image.m_names).substr(nameOffset, length)));
+				nameOffset += length;
+			}
+		}
+
+		ast.m_kinds = std::move(image.m_kinds);
+		ast.m_ops = std::move(image.m_ops);
+		ast.m_columns = std::move(image.m_columns);
+		ast.m_literals = std::move(image.m_literals);
+		ast.m_lines.resize(size);
+		ast.m_lhs.resize(size);
+		ast.m_rhs.resize(size);
+		uint32_t line = 0;
+		for (size_t node = 0; node < size; node++) {
+			line += static_cast<uint32_t>(image.m_lines[node]);
+			ast.m_lines[node] = line;
+			NodeType::Type kind = ast.m_kinds[node];
+			uint32_t lhs = image.m_lhs[node] - 1, rhs = image.m_rhs[node] - 1;
+			Shape shape = GetShape(kind);
+			if (Inline(kind)) {
+				if (shape.m_slots > 0)
+					lhs = DecodeChild(node, lhs + 1);
+				if (shape.m_slots > 1)
+					rhs = DecodeChild(node, rhs + 1);
+			}
+			if (HasSymbol(kind)) {
+				if (lhs >= symbols.size())
+					ThrowDamaged("symbol");
+				lhs = symbols[lhs];
+			}
+			ast.m_lhs[node] = lhs;
+			ast.m_rhs[node] = rhs;
+		}
+		ast.m_extra = std::move(image.m_extra);
+		// the extra entries of a node follow its operands, decode them once those are checked
+		for (NodeIndex node = 0; node < size; node++) {
+			NodeType::Type kind = ast.m_kinds[node];
+			if (Inline(kind))
+				continue;
+			Shape shape = GetShape(kind);
+			size_t begin = ast.m_lhs[node];
+			if (begin > ast.m_extra.size() || shape.m_slots + size_t(shape.m_list) > ast.m_extra.size() - begin)
+				ThrowDamaged("extra offset");
+			for (size_t slot = 0; slot < shape.m_slots; slot++)
+				ast.m_extra[begin + slot] = DecodeChild(node, ast.m_extra[begin + slot]);
+			if (shape.m_list) {
+				size_t count = begin + shape.m_slots;
+				if (ast.m_extra[count] > ast.m_extra.size() - count - 1)
+					ThrowDamaged("list length");
+				for (size_t i = count + 1; i <= count + ast.m_extra[count]; i++)
+					ast.m_extra[i] = DecodeChild(node, ast.m_extra[i]);
+			}
+		}
+		ast.Validate();
+		return ast;
+	}
+
+	void FlatAst::Validate() const {
+		// children come after their parent in preorder, so a valid image has no cycles
+		// and the loader casts every child to the class its kind must have
+		const size_t size = Size();
+		auto child = [&](NodeIndex node, NodeIndex index, const ChildRule& rule) {
+			if (index == InvalidNode) {
+				if (rule.m_required)
+					ThrowDamaged("missing child");
+				return;
+			}
+			if (index <= node || index >= size)
+				ThrowDamaged("child index");
+			if (!rule.m_accepts(m_kinds[index]))
+				ThrowDamaged("child kind");
+		};
+		for (NodeIndex node = 0; node < size; node++) {
+			NodeType::Type kind = m_kinds[node];
+			if (!IsKnown(kind))
+				ThrowDamaged("node kind");
+			Shape shape = GetShape(kind);
+			std::span<const ChildRule> rules = ChildRules(kind);
+			if (Inline(kind)) {
+				if (shape.m_slots > 0)
+					child(node, m_lhs[node], rules[0]);
+				if (shape.m_slots > 1)
+					child(node, m_rhs[node], rules[1]);
+			}
+			else {
+				size_t begin = m_lhs[node];
+				if (begin > m_extra.size() || shape.m_slots + size_t(shape.m_list) > m_extra.size() - begin)
+					ThrowDamaged("extra offset");
+				for (size_t slot = 0; slot < shape.m_slots; slot++)
+					child(node, m_extra[begin + slot], rules[slot]);
+				if (shape.m_list) {
+					size_t first = begin + shape.m_slots + 1;
+					if (m_extra[first - 1] > m_extra.size() - first)
+						ThrowDamaged("list length");
+					for (NodeIndex entry : List(node))
+						child(node, entry, rules[shape.m_slots]);
+				}
+			}
+			if (HasText(kind) && m_lhs[node] >= m_texts.size())
+				ThrowDamaged("text index");
+			if (kind == NodeType::LITERAL &&
+				m_rhs[node] >= (m_ops[node] == TokenType::STRING_LITERAL ? m_texts.size() : m_literals.size()))
+				ThrowDamaged("literal index");
+		}
+	}
+
+	FlatAst FlatAst::FromTree(const AstNode* root, std::vector<const AstNode*>* origins) {
+		FlatAst ast;
+		FlatAstBuilder builder(ast, origins);
+		builder.Convert(root);
+		ast.m_kinds.shrink_to_fit();
+		ast.m_ops.shrink_to_fit();
+		ast.m_lines.shrink_to_fit();
+		ast.m_columns.shrink_to_fit();
+		ast.m_lhs.shrink_to_fit();
+		ast.m_rhs.shrink_to_fit();
+		ast.m_extra.shrink_to_fit();
+		ast.m_texts.shrink_to_fit();
+		ast.m_literals.shrink_to_fit();
+		return ast;
+	}
+
+	size_t FlatAst::MemoryUsage() const {
+		return m_kinds.capacity() * sizeof(NodeType::Type) + m_ops.capacity() +
+			(m_lines.capacity() + m_columns.capacity() + m_lhs.capacity() + m_rhs.capacity()) * sizeof(uint32_t) +
+			m_extra.capacity() * sizeof(NodeIndex) + m_texts.capacity() * sizeof(std::string_view) +
+			m_literals.capacity() * sizeof(int64_t);
+	}
+}
@@ -1,438 +1,661 @@
 #include "Lexer.h"
+#include "LexerScan.h"
+#include <algorithm>
+#include <bit>
+#include <charconv>
 
 namespace CppInterp {
 
-	CharacterSet::CharacterSet() {
-		for (int i = 0; i < 26; i++) {
-			char ch = 'a' + i;
-			m_characterSet[ch] = Character::LETTER;
-			ch = 'A' + i;
-			m_characterSet[ch] = Character::LETTER;
+	constexpr int CharacterClassSize = Character::LINESPLIT + 1;
+
+	// Transitions are described per character class, then expanded to one entry per byte.
+	struct TransitionTableBuilder {
+		Transition m_classTable[StateSize][CharacterClassSize]{};
+		Transition m_otherTable[StateSize]{};
+		Transition m_escapeTable[StateSize]{};
+		bool m_otherTakesAnyByte[StateSize]{};
+
+		struct ByteTransition {
+			State::Type m_state;
+			char m_byte;
+			Transition m_transition;
+		};
+		ByteTransition m_byteTransitions[8]{};
+		int m_byteTransitionCount = 0;
+
+		constexpr TransitionTableBuilder() {
+			for (int state = 0; state < StateSize; state++) {
+				for (int ch = 0; ch < CharacterClassSize; ch++)
+					m_classTable[state][ch] = Transition();
+				m_otherTable[state] = Transition();
+				m_escapeTable[state] = Transition();
+				m_otherTakesAnyByte[state] = false;
+			}
 		}
-		for (int i = 0; i < 10; i++) {
-			char ch = '0' + i;
-			m_characterSet[ch] = Character::NUMBER;
+
+		constexpr void On(State::Type state, Character::Type ch, Transition transition) {
+			m_classTable[state][ch] = transition;
 		}
-		m_characterSet['('] = Character::LEFT_PAREN;
-		m_characterSet[')'] = Character::RIGHT_PAREN;
-		m_characterSet['{'] = Character::LEFT_BRACE;
-		m_characterSet['}'] = Character::RIGHT_BRACE;
-		m_characterSet['['] = Character::LEFT_SQUARE;
-		m_characterSet[']'] = Character::RIGHT_SQUARE;
-		m_characterSet[';'] = Character::SEMICOLON;
-		m_characterSet[','] = Character::COMMA;
-		m_characterSet['+'] = Character::ADD;
-		m_characterSet['-'] = Character::SUBTRACT;
-		m_characterSet['*'] = Character::MULTIPLY;
-		m_characterSet['/'] = Character::DIVIDE;
-		m_characterSet['%'] = Character::MODULO;
-		m_characterSet['>'] = Character::GREATER;
-		m_characterSet['<'] = Character::LESS;
-		m_characterSet['!'] = Character::NOT;
-		m_characterSet['='] = Character::ASSIGN;
-		m_characterSet['&'] = Character::BIT_AND;
-		m_characterSet['|'] = Character::BIT_OR;
-		m_characterSet['^'] = Character::XOR;
-		m_characterSet['~'] = Character::BIT_NOT;
-		m_characterSet[':'] = Character::COLON;
-		m_characterSet['?'] = Character::QUESTION;
-		m_characterSet['.'] = Character::DOT;
-		m_characterSet['\\'] = Character::BACKSLASH;
-		m_characterSet['_'] = Character::UNDERSCORE;
-		m_characterSet['\''] = Character::SINGLE_QUOTE;
-		m_characterSet['"'] = Character::DOUBLE_QUOTE;
-		m_characterSet[' '] = Character::WORDSPLIT;
-		m_characterSet['\t'] = Character::WORDSPLIT;
-		m_characterSet['\n'] = Character::LINESPLIT;
-		m_characterSet['\r'] = Character::LINESPLIT;
-	}
 
-	EscapeCharacterSet::EscapeCharacterSet() {
-		m_escapeCharacterSet['n'] = '\n';
-		m_escapeCharacterSet['t'] = '\t';
-		m_escapeCharacterSet['r'] = '\r';
-		m_escapeCharacterSet['\''] = '\'';
-		m_escapeCharacterSet['"'] = '\"';
-		m_escapeCharacterSet['\\'] = '\\';
-		m_escapeCharacterSet['0'] = '\0';
-	}
+		constexpr void Other(State::Type state, Transition transition) {
+			m_otherTable[state] = transition;
+		}
+
+		// like Other, but also for bytes outside the character set (comment and string bodies)
+		constexpr void OtherAnyByte(State::Type state, Transition transition) {
+			m_otherTable[state] = transition;
+			m_otherTakesAnyByte[state] = true;
+		}
+
+		// overrides the class transition for a single byte
+		constexpr void OnByte(State::Type state, char byte, Transition transition) {
+			m_byteTransitions[m_byteTransitionCount++] = ByteTransition{ state, byte, transition };
+		}
+
+		// only the bytes listed in EscapeCharacterPairs take this transition
+		constexpr void OnEscape(State::Type state, Transition transition) {
+			m_escapeTable[state] = transition;
+		}
 
-	Lexer::Lexer() {
+		constexpr TransitionTable Build() const {
+			const CharacterTable& characterTable = CharacterSet::GetCharacterTable();
+			TransitionTable table{};
+			for (int state = 0; state < StateSize; state++) {
+				table[state].fill(Transition());
+				for (int ch = 0; ch < 256; ch++) {
+					Character::Type chType = characterTable[ch];
+					if (chType == Character::UNKNOWN && !m_otherTakesAnyByte[state])
+						continue;
+					Transition transition = m_classTable[state][chType];
+					if (transition.m_action == Action::REJECT)
+						transition = m_otherTable[state];
+					table[state][ch] = transition;
+				}
+				if (m_escapeTable[state].m_action == Action::REJECT)
+					continue;
+				table[state].fill(Transition());
+				for (auto [ch, escapeCh] : EscapeCharacterPairs)
+					table[state][static_cast<unsigned char>(ch)] = m_escapeTable[state];
+			}
+			for (int i = 0; i < m_byteTransitionCount; i++) {
+				const ByteTransition& byteTransition = m_byteTransitions[i];
+				table[byteTransition.m_state][static_cast<unsigned char>(byteTransition.m_byte)] = byteTransition.m_transition;
+			}
+			return table;
+		}
+	};
+
+	constexpr TransitionTable BuildTransitionTable() {
+		TransitionTableBuilder builder;
 		//identifier
-		m_stateTransitionTable[State::START].emplace(
-			Character::LETTER, Transition(State::IDENTIFIER, TokenType::IDENTIFIER, Action::FORWARD)
-		);
-		m_stateTransitionTable[State::START].emplace(
-			Character::UNDERSCORE, Transition(State::IDENTIFIER, TokenType::IDENTIFIER, Action::FORWARD)
-		);
-		m_stateTransitionTable[State::IDENTIFIER].emplace(
-			Character::LETTER, Transition(State::IDENTIFIER, TokenType::IDENTIFIER, Action::FORWARD)
-		);
-		m_stateTransitionTable[State::IDENTIFIER].emplace(
-			Character::NUMBER, Transition(State::IDENTIFIER, TokenType::IDENTIFIER, Action::FORWARD)
-		);
-		m_stateTransitionTable[State::IDENTIFIER].emplace(
-			Character::UNDERSCORE, Transition(State::IDENTIFIER, TokenType::IDENTIFIER, Action::FORWARD)
-		);
-		m_stateOtherTransitionTable.emplace(
-			State::IDENTIFIER, Transition(State::START, TokenType::IDENTIFIER, Action::RETRACT)
-		);
+		builder.On(State::START, Character::LETTER, Transition(State::IDENTIFIER, TokenType::IDENTIFIER, Action::FORWARD));
+		builder.On(State::START, Character::UNDERSCORE, Transition(State::IDENTIFIER, TokenType::IDENTIFIER, Action::FORWARD));
+		builder.On(State::IDENTIFIER, Character::LETTER, Transition(State::IDENTIFIER, TokenType::IDENTIFIER, Action::FORWARD));
+		builder.On(State::IDENTIFIER, Character::NUMBER, Transition(State::IDENTIFIER, TokenType::IDENTIFIER, Action::FORWARD));
+		builder.On(State::IDENTIFIER, Character::UNDERSCORE, Transition(State::IDENTIFIER, TokenType::IDENTIFIER, Action::FORWARD));
+		builder.Other(State::IDENTIFIER, Transition(State::START, TokenType::IDENTIFIER, Action::RETRACT));
 		//literal
 		// int
-		m_stateTransitionTable[State::START].emplace(
-			Character::NUMBER, Transition(State::INT, TokenType::INT_LITERAL, Action::FORWARD)
-		);
-		m_stateTransitionTable[State::INT].emplace(
-			Character::NUMBER, Transition(State::INT, TokenType::INT_LITERAL, Action::FORWARD)
-		);
-		m_stateOtherTransitionTable.emplace(State::INT,
-			Transition(State::START, TokenType::INT_LITERAL, Action::RETRACT)
-		);
+		builder.On(State::START, Character::NUMBER, Transition(State::INT, TokenType::INT_LITERAL, Action::FORWARD));
+		builder.On(State::INT, Character::NUMBER, Transition(State::INT, TokenType::INT_LITERAL, Action::FORWARD));
+		builder.Other(State::INT, Transition(State::START, TokenType::INT_LITERAL, Action::RETRACT));
 		// double
-		m_stateTransitionTable[State::INT].emplace(
-			Character::DOT, Transition(State::DOUBLE, TokenType::DOUBLE_LITERAL, Action::FORWARD)
-		);
-		m_stateTransitionTable[State::DOUBLE].emplace(
-			Character::NUMBER, Transition(State::DOUBLE, TokenType::DOUBLE_LITERAL, Action::FORWARD)
-		);
-		m_stateOtherTransitionTable.emplace(
-			State::DOUBLE, Transition(State::START, TokenType::DOUBLE_LITERAL, Action::RETRACT)
-		);
+		builder.On(State::INT, Character::DOT, Transition(State::DOUBLE, TokenType::DOUBLE_LITERAL, Action::FORWARD));
+		builder.On(State::DOUBLE, Character::NUMBER, Transition(State::DOUBLE, TokenType::DOUBLE_LITERAL, Action::FORWARD));
+		builder.Other(State::DOUBLE, Transition(State::START, TokenType::DOUBLE_LITERAL, Action::RETRACT));
 		// char
-		m_stateTransitionTable[State::START].emplace(
-			Character::SINGLE_QUOTE, Transition(State::CHAR_BEGIN, TokenType::CHARACTER_LITERAL, Action::FORWARD)
-		);
-		m_stateTransitionTable[State::CHAR_BEGIN].emplace(
-			Character::BACKSLASH, Transition(State::CHAR_ESCAPE, TokenType::CHARACTER_LITERAL, Action::FORWARD)
-		);
-		const auto& escapeCharacterSet = EscapeCharacterSet::Instance().GetEscapeCharacterSet();
-		auto& characterSet = CharacterSet::Instance();
-		for (auto [ch, escapeCh] : escapeCharacterSet) {
-			auto escapeOpt = characterSet.GetCharacterType(ch);
-			if (escapeOpt)
-				m_stateTransitionTable[State::CHAR_ESCAPE].emplace(
-					*escapeOpt, Transition(State::CHAR_END, TokenType::CHARACTER_LITERAL, Action::ESCAPE)
-				);
-		}
-		m_stateOtherTransitionTable.emplace(
-			State::CHAR_BEGIN, Transition(State::CHAR_END, TokenType::CHARACTER_LITERAL, Action::FORWARD)
-		);
-		m_stateTransitionTable[State::CHAR_END].emplace(
-			Character::SINGLE_QUOTE, Transition(State::START, TokenType::CHARACTER_LITERAL, Action::APPEND)
-		);
+		builder.On(State::START, Character::SINGLE_QUOTE, Transition(State::CHAR_BEGIN, TokenType::CHARACTER_LITERAL, Action::FORWARD));
+		builder.On(State::CHAR_BEGIN, Character::BACKSLASH, Transition(State::CHAR_ESCAPE, TokenType::CHARACTER_LITERAL, Action::FORWARD));
+		builder.OnEscape(State::CHAR_ESCAPE, Transition(State::CHAR_END, TokenType::CHARACTER_LITERAL, Action::ESCAPE));
+		builder.Other(State::CHAR_BEGIN, Transition(State::CHAR_END, TokenType::CHARACTER_LITERAL, Action::FORWARD));
+		builder.On(State::CHAR_END, Character::SINGLE_QUOTE, Transition(State::START, TokenType::CHARACTER_LITERAL, Action::APPEND));
 		// string
-		m_stateTransitionTable[State::START].emplace(
-			Character::DOUBLE_QUOTE, Transition(State::STRING, TokenType::STRING_LITERAL, Action::FORWARD)
-		);
-		m_stateTransitionTable[State::STRING].emplace(
-			Character::LETTER, Transition(State::STRING, TokenType::STRING_LITERAL, Action::FORWARD)
-		);
-		m_stateTransitionTable[State::STRING].emplace(
-			Character::BACKSLASH, Transition(State::STRING_ESCAPE, TokenType::STRING_LITERAL, Action::FORWARD)
-		);
-		for (auto [ch, escapeCh] : escapeCharacterSet) {
-			auto escapeOpt = characterSet.GetCharacterType(ch);
-			if (escapeOpt)
-				m_stateTransitionTable[State::STRING_ESCAPE].emplace(
-					*escapeOpt, Transition(State::STRING, TokenType::STRING_LITERAL, Action::ESCAPE)
-				);
-		}
-		m_stateOtherTransitionTable.emplace(
-			State::STRING, Transition(State::STRING, TokenType::STRING_LITERAL, Action::FORWARD)
-		);
-		m_stateTransitionTable[State::STRING].emplace(
-			Character::DOUBLE_QUOTE, Transition(State::START, TokenType::STRING_LITERAL, Action::APPEND)
-		);
+		builder.On(State::START, Character::DOUBLE_QUOTE, Transition(State::STRING, TokenType::STRING_LITERAL, Action::FORWARD));
+		builder.On(State::STRING, Character::LETTER, Transition(State::STRING, TokenType::STRING_LITERAL, Action::FORWARD));
+		builder.On(State::STRING, Character::BACKSLASH, Transition(State::STRING_ESCAPE, TokenType::STRING_LITERAL, Action::FORWARD));
+		builder.OnEscape(State::STRING_ESCAPE, Transition(State::STRING, TokenType::STRING_LITERAL, Action::ESCAPE));
+		builder.OtherAnyByte(State::STRING, Transition(State::STRING, TokenType::STRING_LITERAL, Action::FORWARD));
+		builder.On(State::STRING, Character::DOUBLE_QUOTE, Transition(State::START, TokenType::STRING_LITERAL, Action::APPEND));
 		//split
-		m_stateTransitionTable[State::START].emplace(
-			Character::WORDSPLIT, Transition(State::START, TokenType::UNKNOWN, Action::JUMP)
-		);
-		m_stateTransitionTable[State::START].emplace(
-			Character::LINESPLIT, Transition(State::START, TokenType::UNKNOWN, Action::NEWLINE)
-		);
+		builder.On(State::START, Character::WORDSPLIT, Transition(State::START, TokenType::UNKNOWN, Action::JUMP));
+		builder.On(State::START, Character::LINESPLIT, Transition(State::START, TokenType::UNKNOWN, Action::NEWLINE));
+		// rows advance on '\n' only, so "\r\n" is one line
+		builder.OnByte(State::START, '\r', Transition(State::START, TokenType::UNKNOWN, Action::JUMP));
+		builder.OnByte(State::STRING, '\n', Transition(State::STRING, TokenType::STRING_LITERAL, Action::NEWLINE));
 		//operator
 		// +
-		m_stateTransitionTable[State::START].emplace(
-			Character::ADD, Transition(State::ADD, TokenType::ADD, Action::FORWARD)
-		);
-		m_stateOtherTransitionTable.emplace(
-			State::ADD, Transition(State::START, TokenType::ADD, Action::RETRACT)
-		);
-		m_stateTransitionTable[State::ADD].emplace(
-			Character::ADD, Transition(State::START, TokenType::INCREMENT, Action::APPEND)
-		);
-		m_stateTransitionTable[State::ADD].emplace(
-			Character::ASSIGN, Transition(State::START, TokenType::SELF_ADD, Action::APPEND)
-		);
+		builder.On(State::START, Character::ADD, Transition(State::ADD, TokenType::ADD, Action::FORWARD));
+		builder.Other(State::ADD, Transition(State::START, TokenType::ADD, Action::RETRACT));
+		builder.On(State::ADD, Character::ADD, Transition(State::START, TokenType::INCREMENT, Action::APPEND));
+		builder.On(State::ADD, Character::ASSIGN, Transition(State::START, TokenType::SELF_ADD, Action::APPEND));
 		// -
-		m_stateTransitionTable[State::START].emplace(
-			Character::SUBTRACT, Transition(State::SUBTRACT, TokenType::SUBTRACT, Action::FORWARD)
-		);
-		m_stateOtherTransitionTable.emplace(
-			State::SUBTRACT, Transition(State::START, TokenType::SUBTRACT, Action::RETRACT)
-		);
-		m_stateTransitionTable[State::SUBTRACT].emplace(
-			Character::SUBTRACT, Transition(State::START, TokenType::DECREMENT, Action::APPEND)
-		);
-		m_stateTransitionTable[State::SUBTRACT].emplace(
-			Character::ASSIGN, Transition(State::START, TokenType::SELF_SUB, Action::APPEND)
-		);
+		builder.On(State::START, Character::SUBTRACT, Transition(State::SUBTRACT, TokenType::SUBTRACT, Action::FORWARD));
+		builder.Other(State::SUBTRACT, Transition(State::START, TokenType::SUBTRACT, Action::RETRACT));
+		builder.On(State::SUBTRACT, Character::SUBTRACT, Transition(State::START, TokenType::DECREMENT, Action::APPEND));
+		builder.On(State::SUBTRACT, Character::ASSIGN, Transition(State::START, TokenType::SELF_SUB, Action::APPEND));
 		// *
-		m_stateTransitionTable[State::START].emplace(
-			Character::MULTIPLY, Transition(State::MULTIPLY, TokenType::MULTIPLY, Action::FORWARD)
-		);
-		m_stateOtherTransitionTable.emplace(
-			State::MULTIPLY, Transition(State::START, TokenType::MULTIPLY, Action::RETRACT)
-		);
-		m_stateTransitionTable[State::MULTIPLY].emplace(
-			Character::ASSIGN, Transition(State::START, TokenType::SELF_MUL, Action::APPEND)
-		);
+		builder.On(State::START, Character::MULTIPLY, Transition(State::MULTIPLY, TokenType::MULTIPLY, Action::FORWARD));
+		builder.Other(State::MULTIPLY, Transition(State::START, TokenType::MULTIPLY, Action::RETRACT));
+		builder.On(State::MULTIPLY, Character::ASSIGN, Transition(State::START, TokenType::SELF_MUL, Action::APPEND));
 		// /
-		m_stateTransitionTable[State::START].emplace(
-			Character::DIVIDE, Transition(State::DIVIDE, TokenType::DIVIDE, Action::FORWARD)
-		);
-		m_stateOtherTransitionTable.emplace(
-			State::DIVIDE, Transition(State::START, TokenType::DIVIDE, Action::RETRACT)
-		);
-		m_stateTransitionTable[State::DIVIDE].emplace(
-			Character::ASSIGN, Transition(State::START, TokenType::SELF_DIV, Action::APPEND)
-		);
+		builder.On(State::START, Character::DIVIDE, Transition(State::DIVIDE, TokenType::DIVIDE, Action::FORWARD));
+		builder.Other(State::DIVIDE, Transition(State::START, TokenType::DIVIDE, Action::RETRACT));
+		builder.On(State::DIVIDE, Character::ASSIGN, Transition(State::START, TokenType::SELF_DIV, Action::APPEND));
 		// %
-		m_stateTransitionTable[State::START].emplace(
-			Character::MODULO, Transition(State::MODULO, TokenType::MODULO, Action::FORWARD)
-		);
-		m_stateOtherTransitionTable.emplace(
-			State::MODULO, Transition(State::START, TokenType::MODULO, Action::RETRACT)
-		);
-		m_stateTransitionTable[State::MODULO].emplace(
-			Character::ASSIGN, Transition(State::START, TokenType::SELF_MODULO, Action::APPEND)
-		);
+		builder.On(State::START, Character::MODULO, Transition(State::MODULO, TokenType::MODULO, Action::FORWARD));
+		builder.Other(State::MODULO, Transition(State::START, TokenType::MODULO, Action::RETRACT));
+		builder.On(State::MODULO, Character::ASSIGN, Transition(State::START, TokenType::SELF_MODULO, Action::APPEND));
 		// >
-		m_stateTransitionTable[State::START].emplace(
-			Character::GREATER, Transition(State::GREATER, TokenType::GREATER, Action::FORWARD)
-		);
-		m_stateOtherTransitionTable.emplace(
-			State::GREATER, Transition(State::START, TokenType::GREATER, Action::RETRACT)
-		);
-		m_stateTransitionTable[State::GREATER].emplace(
-			Character::ASSIGN, Transition(State::START, TokenType::GREATER_EQUAL, Action::APPEND)
-		);
-		m_stateTransitionTable[State::GREATER].emplace(
-			Character::GREATER, Transition(State::RIGHT_MOVE, TokenType::RIGHT_MOVE, Action::FORWARD)
-		);
-		m_stateTransitionTable[State::RIGHT_MOVE].emplace(
-			Character::ASSIGN, Transition(State::START, TokenType::SELF_RIGHT_MOVE, Action::APPEND)
-		);
-		m_stateOtherTransitionTable.emplace(
-			State::RIGHT_MOVE, Transition(State::START, TokenType::RIGHT_MOVE, Action::RETRACT)
-		);
+		builder.On(State::START, Character::GREATER, Transition(State::GREATER, TokenType::GREATER, Action::FORWARD));
+		builder.Other(State::GREATER, Transition(State::START, TokenType::GREATER, Action::RETRACT));
+		builder.On(State::GREATER, Character::ASSIGN, Transition(State::START, TokenType::GREATER_EQUAL, Action::APPEND));
+		builder.On(State::GREATER, Character::GREATER, Transition(State::RIGHT_MOVE, TokenType::RIGHT_MOVE, Action::FORWARD));
+		builder.On(State::RIGHT_MOVE, Character::ASSIGN, Transition(State::START, TokenType::SELF_RIGHT_MOVE, Action::APPEND));
+		builder.Other(State::RIGHT_MOVE, Transition(State::START, TokenType::RIGHT_MOVE, Action::RETRACT));
 		// <
-		m_stateTransitionTable[State::START].emplace(
-			Character::LESS, Transition(State::LESS, TokenType::LESS, Action::FORWARD)
-		);
-		m_stateOtherTransitionTable.emplace(
-			State::LESS, Transition(State::START, TokenType::LESS, Action::RETRACT)
-		);
-		m_stateTransitionTable[State::LESS].emplace(
-			Character::ASSIGN, Transition(State::START, TokenType::LESS_EQUAL, Action::APPEND)
-		);
-		m_stateTransitionTable[State::LESS].emplace(
-			Character::LESS, Transition(State::LEFT_MOVE, TokenType::LEFT_MOVE, Action::FORWARD)
-		);
-		m_stateTransitionTable[State::LEFT_MOVE].emplace(
-			Character::ASSIGN, Transition(State::START, TokenType::SELF_LEFT_MOVE, Action::APPEND)
-		);
-		m_stateOtherTransitionTable.emplace(
-			State::LEFT_MOVE, Transition(State::START, TokenType::LEFT_MOVE, Action::RETRACT)
-		);
+		builder.On(State::START, Character::LESS, Transition(State::LESS, TokenType::LESS, Action::FORWARD));
+		builder.Other(State::LESS, Transition(State::START, TokenType::LESS, Action::RETRACT));
+		builder.On(State::LESS, Character::ASSIGN, Transition(State::START, TokenType::LESS_EQUAL, Action::APPEND));
+		builder.On(State::LESS, Character::LESS, Transition(State::LEFT_MOVE, TokenType::LEFT_MOVE, Action::FORWARD));
+		builder.On(State::LEFT_MOVE, Character::ASSIGN, Transition(State::START, TokenType::SELF_LEFT_MOVE, Action::APPEND));
+		builder.Other(State::LEFT_MOVE, Transition(State::START, TokenType::LEFT_MOVE, Action::RETRACT));
 		// !
-		m_stateTransitionTable[State::START].emplace(
-			Character::NOT, Transition(State::NOT, TokenType::NOT, Action::FORWARD)
-		);
-		m_stateOtherTransitionTable.emplace(
-			State::NOT, Transition(State::START, TokenType::NOT, Action::RETRACT)
-		);
-		m_stateTransitionTable[State::NOT].emplace(
-			Character::ASSIGN, Transition(State::START, TokenType::NOT_EQUAL, Action::APPEND)
-		);
+		builder.On(State::START, Character::NOT, Transition(State::NOT, TokenType::NOT, Action::FORWARD));
+		builder.Other(State::NOT, Transition(State::START, TokenType::NOT, Action::RETRACT));
+		builder.On(State::NOT, Character::ASSIGN, Transition(State::START, TokenType::NOT_EQUAL, Action::APPEND));
 		// =
-		m_stateTransitionTable[State::START].emplace(
-			Character::ASSIGN, Transition(State::ASSIGN, TokenType::ASSIGN, Action::FORWARD)
-		);
-		m_stateOtherTransitionTable.emplace(
-			State::ASSIGN, Transition(State::START, TokenType::ASSIGN, Action::RETRACT)
-		);
-		m_stateTransitionTable[State::ASSIGN].emplace(
-			Character::ASSIGN, Transition(State::START, TokenType::EQUAL, Action::APPEND)
-		);
+		builder.On(State::START, Character::ASSIGN, Transition(State::ASSIGN, TokenType::ASSIGN, Action::FORWARD));
+		builder.Other(State::ASSIGN, Transition(State::START, TokenType::ASSIGN, Action::RETRACT));
+		builder.On(State::ASSIGN, Character::ASSIGN, Transition(State::START, TokenType::EQUAL, Action::APPEND));
 		// &
-		m_stateTransitionTable[State::START].emplace(
-			Character::BIT_AND, Transition(State::BIT_AND, TokenType::BIT_AND, Action::FORWARD)
-		);
-		m_stateOtherTransitionTable.emplace(
-			State::BIT_AND, Transition(State::START, TokenType::BIT_AND, Action::RETRACT)
-		);
-		m_stateTransitionTable[State::BIT_AND].emplace(
-			Character::BIT_AND, Transition(State::START, TokenType::AND, Action::APPEND)
-		);
-		m_stateTransitionTable[State::BIT_AND].emplace(
-			Character::ASSIGN, Transition(State::START, TokenType::SELF_BIT_AND, Action::APPEND)
-		);
+		builder.On(State::START, Character::BIT_AND, Transition(State::BIT_AND, TokenType::BIT_AND, Action::FORWARD));
+		builder.Other(State::BIT_AND, Transition(State::START, TokenType::BIT_AND, Action::RETRACT));
+		builder.On(State::BIT_AND, Character::BIT_AND, Transition(State::START, TokenType::AND, Action::APPEND));
+		builder.On(State::BIT_AND, Character::ASSIGN, Transition(State::START, TokenType::SELF_BIT_AND, Action::APPEND));
 		// |
-		m_stateTransitionTable[State::START].emplace(
-			Character::BIT_OR, Transition(State::BIT_OR, TokenType::BIT_OR, Action::FORWARD)
-		);
-		m_stateOtherTransitionTable.emplace(
-			State::BIT_OR, Transition(State::START, TokenType::BIT_OR, Action::RETRACT)
-		);
-		m_stateTransitionTable[State::BIT_OR].emplace(
-			Character::BIT_OR, Transition(State::START, TokenType::OR, Action::APPEND)
-		);
-		m_stateTransitionTable[State::BIT_OR].emplace(
-			Character::ASSIGN, Transition(State::START, TokenType::SELF_BIT_OR, Action::APPEND)
-		);
+		builder.On(State::START, Character::BIT_OR, Transition(State::BIT_OR, TokenType::BIT_OR, Action::FORWARD));
+		builder.Other(State::BIT_OR, Transition(State::START, TokenType::BIT_OR, Action::RETRACT));
+		builder.On(State::BIT_OR, Character::BIT_OR, Transition(State::START, TokenType::OR, Action::APPEND));
+		builder.On(State::BIT_OR, Character::ASSIGN, Transition(State::START, TokenType::SELF_BIT_OR, Action::APPEND));
 		// ^
-		m_stateTransitionTable[State::START].emplace(
-			Character::XOR, Transition(State::XOR, TokenType::XOR, Action::FORWARD)
-		);
-		m_stateOtherTransitionTable.emplace(
-			State::XOR, Transition(State::START, TokenType::XOR, Action::RETRACT)
-		);
-		m_stateTransitionTable[State::XOR].emplace(
-			Character::ASSIGN, Transition(State::START, TokenType::SELF_XOR, Action::APPEND)
-		);
+		builder.On(State::START, Character::XOR, Transition(State::XOR, TokenType::XOR, Action::FORWARD));
+		builder.Other(State::XOR, Transition(State::START, TokenType::XOR, Action::RETRACT));
+		builder.On(State::XOR, Character::ASSIGN, Transition(State::START, TokenType::SELF_XOR, Action::APPEND));
 		//other
-		m_stateTransitionTable[State::START].emplace(
-			Character::LEFT_PAREN, Transition(State::START, TokenType::LEFT_PAREN, Action::APPEND)
-		);
-		m_stateTransitionTable[State::START].emplace(
-			Character::RIGHT_PAREN, Transition(State::START, TokenType::RIGHT_PAREN, Action::APPEND)
-		);
-		m_stateTransitionTable[State::START].emplace(
-			Character::LEFT_BRACE, Transition(State::START, TokenType::LEFT_BRACE, Action::APPEND)
-		);
-		m_stateTransitionTable[State::START].emplace(
-			Character::RIGHT_BRACE, Transition(State::START, TokenType::RIGHT_BRACE, Action::APPEND)
-		);
-		m_stateTransitionTable[State::START].emplace(
-			Character::LEFT_SQUARE, Transition(State::START, TokenType::LEFT_SQUARE, Action::APPEND)
-		);
-		m_stateTransitionTable[State::START].emplace(
-			Character::RIGHT_SQUARE, Transition(State::START, TokenType::RIGHT_SQUARE, Action::APPEND)
-		);
-		m_stateTransitionTable[State::START].emplace(
-			Character::SEMICOLON, Transition(State::START, TokenType::SEMICOLON, Action::APPEND)
-		);
-		m_stateTransitionTable[State::START].emplace(
-			Character::COMMA, Transition(State::START, TokenType::COMMA, Action::APPEND)
-		);
-		m_stateTransitionTable[State::START].emplace(
-			Character::COLON, Transition(State::COLON, TokenType::COLON, Action::FORWARD)
-		);
-		m_stateOtherTransitionTable.emplace(
-			State::COLON, Transition(State::START, TokenType::COLON, Action::RETRACT)
-		);
-		m_stateTransitionTable[State::START].emplace(
-			Character::QUESTION, Transition(State::START, TokenType::QUESTION, Action::APPEND)
-		);
-		m_stateTransitionTable[State::START].emplace(
-			Character::DOT, Transition(State::START, TokenType::DOT, Action::APPEND)
-		);
-		m_stateTransitionTable[State::START].emplace(
-			Character::BIT_NOT, Transition(State::START, TokenType::BIT_NOT, Action::APPEND)
-		);
-		m_stateTransitionTable[State::SUBTRACT].emplace(
-			Character::GREATER, Transition(State::START, TokenType::POINT_TO, Action::APPEND)
-		);
-		m_stateTransitionTable[State::COLON].emplace(
-			Character::COLON, Transition(State::START, TokenType::BELONG_TO, Action::APPEND)
-		);
+		builder.On(State::START, Character::LEFT_PAREN, Transition(State::START, TokenType::LEFT_PAREN, Action::APPEND));
+		builder.On(State::START, Character::RIGHT_PAREN, Transition(State::START, TokenType::RIGHT_PAREN, Action::APPEND));
+		builder.On(State::START, Character::LEFT_BRACE, Transition(State::START, TokenType::LEFT_BRACE, Action::APPEND));
+		builder.On(State::START, Character::RIGHT_BRACE, Transition(State::START, TokenType::RIGHT_BRACE, Action::APPEND));
+		builder.On(State::START, Character::LEFT_SQUARE, Transition(State::START, TokenType::LEFT_SQUARE, Action::APPEND));
+		builder.On(State::START, Character::RIGHT_SQUARE, Transition(State::START, TokenType::RIGHT_SQUARE, Action::APPEND));
+		builder.On(State::START, Character::SEMICOLON, Transition(State::START, TokenType::SEMICOLON, Action::APPEND));
+		builder.On(State::START, Character::COMMA, Transition(State::START, TokenType::COMMA, Action::APPEND));
+		builder.On(State::START, Character::COLON, Transition(State::COLON, TokenType::COLON, Action::FORWARD));
+		builder.Other(State::COLON, Transition(State::START, TokenType::COLON, Action::RETRACT));
+		builder.On(State::START, Character::QUESTION, Transition(State::START, TokenType::QUESTION, Action::APPEND));
+		builder.On(State::START, Character::DOT, Transition(State::START, TokenType::DOT, Action::APPEND));
+		builder.On(State::START, Character::BIT_NOT, Transition(State::START, TokenType::BIT_NOT, Action::APPEND));
+		builder.On(State::SUBTRACT, Character::GREATER, Transition(State::START, TokenType::POINT_TO, Action::APPEND));
+		builder.On(State::COLON, Character::COLON, Transition(State::START, TokenType::BELONG_TO, Action::APPEND));
 		//comment
-		m_stateTransitionTable[State::DIVIDE].emplace(
-			Character::DIVIDE, Transition(State::COMMENT, TokenType::UNKNOWN, Action::FORWARD)
-		);
-		m_stateOtherTransitionTable.emplace(
-			State::COMMENT, Transition(State::COMMENT, TokenType::UNKNOWN, Action::JUMP)
-		);
-		m_stateTransitionTable[State::COMMENT].emplace(
-			Character::LINESPLIT, Transition(State::START, TokenType::UNKNOWN, Action::CLEAR)
-		);
-		// \ 
-		m_stateTransitionTable[State::START].emplace(
-			Character::BACKSLASH, Transition(State::START, TokenType::UNKNOWN, Action::JUMP)
-		);
+		builder.On(State::DIVIDE, Character::DIVIDE, Transition(State::COMMENT, TokenType::UNKNOWN, Action::CLEAR));
+		builder.OtherAnyByte(State::COMMENT, Transition(State::COMMENT, TokenType::UNKNOWN, Action::JUMP));
+		builder.OnByte(State::COMMENT, '\r', Transition(State::START, TokenType::UNKNOWN, Action::JUMP));
+		builder.OnByte(State::COMMENT, '\n', Transition(State::START, TokenType::UNKNOWN, Action::NEWLINE));
+		// '\\' line continuation
+		builder.On(State::START, Character::BACKSLASH, Transition(State::START, TokenType::UNKNOWN, Action::JUMP));
+		return builder.Build();
+	}
+
+	static constexpr TransitionTable s_transitionTable = BuildTransitionTable();
+
+	Lexer::Lexer() :m_transitionTable(s_transitionTable) {
+	}
+
+	void Lexer::ThrowRejected(State::Type state, char ch, int row, int col) const {
+		if (!CharacterSet::Instance().GetCharacterType(ch)) {
+			throw LexerException("Unknown character exception'", ch, row, col);
+		}
+		if (state == State::CHAR_ESCAPE || state == State::STRING_ESCAPE) {
+			throw LexerException("Unknown escape character exception'", ch, row, col);
+		}
+		throw LexerException("Unexpected character exception'", ch, row, col);
+	}
+
+	void Lexer::DecodeNumber(TokenType::Type type, TokenList& tokens) const {
+		size_t index = tokens.size() - 1;
+		std::string_view text = tokens.Content(index);
+		const char* end = text.data() + text.size();
+		int64_t bits = 0;
+		std::from_chars_result result;
+		if (type == TokenType::INT_LITERAL) {
+			result = std::from_chars(text.data(), end, bits);
+		}
+		else {
+			double value = 0;
+			result = std::from_chars(text.data(), end, value);
+			bits = std::bit_cast<int64_t>(value);
+		}
+		if (result.ec != std::errc() || result.ptr != end) {
+			auto [line, column] = tokens.Position(index);
+			throw LexerException("Numeric literal out of range exception'", text.front(), line, column);
+		}
+		tokens.SetNumber(bits);
+	}
+
+	TokenList::TokenList(const TokenList& other)
+		:m_types(other.m_types), m_offsets(other.m_offsets), m_extras(other.m_extras), m_stored(other.m_stored),
+		m_numberTokens(other.m_numberTokens), m_numbers(other.m_numbers), m_base(other.m_base), m_baseOffset(other.m_baseOffset), m_firstLine(other.m_firstLine),
+		m_lineStarts(other.m_lineStarts), m_end(other.m_end) {
+		for (auto& content : m_stored) {
+			if (other.OwnsLiteral(content))
+				content = StoreLiteral(content);
+		}
+	}
+
+	TokenList& TokenList::operator=(TokenList other) noexcept {
+		m_types.swap(other.m_types);
+		m_offsets.swap(other.m_offsets);
+		m_extras.swap(other.m_extras);
+		m_stored.swap(other.m_stored);
+		m_numberTokens.swap(other.m_numberTokens);
+		m_numbers.swap(other.m_numbers);
+		std::swap(m_base, other.m_base);
+		std::swap(m_baseOffset, other.m_baseOffset);
+		std::swap(m_firstLine, other.m_firstLine);
+		m_lineStarts.swap(other.m_lineStarts);
+		std::swap(m_end, other.m_end);
+		std::swap(m_literals, other.m_literals);
+		return *this;
+	}
+
+	Token TokenList::operator[](size_t index) const {
+		auto [line, column] = Position(index);
+		Token token(m_types[index], Content(index), line, column, Symbol(index));
+		token.m_literal = Literal(index);
+		return token;
+	}
+
+	LiteralValue TokenList::Literal(size_t index) const {
+		LiteralValue value;
+		switch (m_types[index]) {
+		case TokenType::INT_LITERAL:
+		case TokenType::DOUBLE_LITERAL: {
+			auto it = std::lower_bound(m_numberTokens.begin(), m_numberTokens.end(), static_cast<uint32_t>(index));
+			if (it == m_numberTokens.end() || *it != index)
+				break;
+			int64_t bits = m_numbers[it - m_numberTokens.begin()];
+			if (m_types[index] == TokenType::INT_LITERAL)
+				value.m_int = bits;
+			else
+				value.m_double = std::bit_cast<double>(bits);
+			break;
+		}
+		case TokenType::CHARACTER_LITERAL: {
+			std::string_view text = TextContent(index);
+			value.m_char = text.size() > 1 ? text[1] : '\0';
+			break;
+		}
+		case TokenType::STRING_LITERAL: {
+			std::string_view text = TextContent(index);
+			value.m_string = text.size() >= 2 ? text.substr(1, text.size() - 2) : std::string_view();
+			break;
+		}
+		case TokenType::BOOL_LITERAL:
+			value.m_bool = TextContent(index) == "true";
+			break;
+		}
+		return value;
+	}
+
+	std::string_view TokenList::Content(size_t index) const {
+		if (m_types[index] == TokenType::IDENTIFIER)
+			return SymbolTable::Instance().GetName(m_extras[index]);
+		return TextContent(index);
+	}
+
+	std::string_view TokenList::TextContent(size_t index) const {
+		uint32_t extra = m_extras[index];
+		if (extra & StoredFlag)
+			return m_stored[extra & ~StoredFlag];
+		ptrdiff_t begin = static_cast<ptrdiff_t>(m_offsets[index]) - static_cast<ptrdiff_t>(m_baseOffset);
+		return std::string_view(m_base + begin, extra);
+	}
+
+	std::pair<int, int> TokenList::Position(size_t index) const {
+		uint32_t offset = m_offsets[index];
+		auto it = std::upper_bound(m_lineStarts.begin(), m_lineStarts.end(), offset);
+		size_t line = it == m_lineStarts.begin() ? 0 : static_cast<size_t>(it - m_lineStarts.begin()) - 1;
+		return { m_firstLine + static_cast<int>(line), static_cast<int>(offset - m_lineStarts[line]) + 1 };
+	}
+
+	size_t TokenList::MemoryUsage() const {
+		return m_types.capacity() * sizeof(TokenType::Type) + m_offsets.capacity() * sizeof(uint32_t) +
+			m_extras.capacity() * sizeof(uint32_t) + m_stored.capacity() * sizeof(std::string_view) +
+			m_numberTokens.capacity() * sizeof(uint32_t) + m_numbers.capacity() * sizeof(int64_t) +
+			m_lineStarts.capacity() * sizeof(uint32_t) + m_literals.Capacity();
+	}
+
+	void TokenList::push_back(const Token& token) {
+		int lastLine = m_firstLine + static_cast<int>(m_lineStarts.size()) - 1;
+		int line = std::max(token.m_line, lastLine);
+		// every line started here lies past the offsets handed out so far
+		for (; lastLine < line; lastLine++)
+			m_lineStarts.push_back(std::max(m_end, m_lineStarts.back()));
+		uint32_t offset = m_lineStarts.back() + static_cast<uint32_t>(std::max(token.m_column, 1) - 1);
+		m_end = std::max(m_end, offset + 1);
+		m_types.push_back(token.m_type);
+		m_offsets.push_back(offset);
+		if (token.m_type == TokenType::IDENTIFIER) {
+			m_extras.push_back(token.m_symbol != InvalidSymbol
+				? token.m_symbol : SymbolTable::Instance().Intern(token.m_content));
+		}
+		else {
+			m_extras.push_back(StoredFlag | static_cast<uint32_t>(m_stored.size()));
+			m_stored.push_back(token.m_content);
+			if (token.m_type == TokenType::INT_LITERAL)
+				SetNumber(token.m_literal.m_int);
+			else if (token.m_type == TokenType::DOUBLE_LITERAL)
+				SetNumber(std::bit_cast<int64_t>(token.m_literal.m_double));
+		}
+	}
+
+	void TokenList::clear() {
+		m_types.clear();
+		m_offsets.clear();
+		m_extras.clear();
+		m_stored.clear();
+		m_numberTokens.clear();
+		m_numbers.clear();
+		ResetLines(m_firstLine + static_cast<int>(m_lineStarts.size()) - 1, m_lineStarts.back());
+	}
+
+	void TokenList::Reset(uint32_t keepLinesFrom) {
+		m_types.clear();
+		m_offsets.clear();
+		m_extras.clear();
+		m_stored.clear();
+		m_numberTokens.clear();
+		m_numbers.clear();
+		m_literals.Reset();
+		auto it = std::upper_bound(m_lineStarts.begin(), m_lineStarts.end(), keepLinesFrom);
+		if (it != m_lineStarts.begin())
+			--it;
+		m_firstLine += static_cast<int>(it - m_lineStarts.begin());
+		m_lineStarts.erase(m_lineStarts.begin(), it);
+	}
+
+	void TokenList::Restart() {
+		Reset();
+		ResetLines(1, 0);
+		m_base = nullptr;
+		m_baseOffset = 0;
+		m_end = 0;
+	}
+
+	void TokenList::Append(TokenList&& other) {
+		uint32_t storedBase = static_cast<uint32_t>(m_stored.size());
+		uint32_t tokenBase = static_cast<uint32_t>(size());
+		for (uint32_t index : other.m_numberTokens)
+			m_numberTokens.push_back(index + tokenBase);
+		m_numbers.insert(m_numbers.end(), other.m_numbers.begin(), other.m_numbers.end());
+		for (size_t i = 0; i < other.size(); i++) {
+			if (other.m_types[i] != TokenType::IDENTIFIER && (other.m_extras[i] & StoredFlag))
+				other.m_extras[i] += storedBase;
+		}
+		m_types.insert(m_types.end(), other.m_types.begin(), other.m_types.end());
+		m_offsets.insert(m_offsets.end(), other.m_offsets.begin(), other.m_offsets.end());
+		m_extras.insert(m_extras.end(), other.m_extras.begin(), other.m_extras.end());
+		m_stored.insert(m_stored.end(), other.m_stored.begin(), other.m_stored.end());
+		// the first line of other is our last line
+		m_lineStarts.insert(m_lineStarts.end(), other.m_lineStarts.begin() + 1, other.m_lineStarts.end());
+		m_literals.Adopt(std::move(other.m_literals));
+		other.Reset();
+	}
+
+	void TokenList::InternIdentifiers(size_t first) {
+		SymbolTable::Batch symbols(SymbolTable::Instance());
+		for (size_t i = first; i < size(); i++) {
+			if (m_types[i] == TokenType::IDENTIFIER)
+				m_extras[i] = symbols.Intern(TextContent(i));
+		}
+	}
+
+	// Length of the run of bytes the FSM would loop over without emitting anything in this state.
+	static inline size_t ScanRun(State::Type state, char ch, const char* begin, const char* end) {
+		switch (state) {
+		case State::START:
+			return ch == ' ' || ch == '\t' ? LexerScan::SkipBlanks(begin, end) : 0;
+		case State::IDENTIFIER:
+			return LexerScan::ScanIdentifier(begin, end);
+		case State::COMMENT:
+			return LexerScan::ScanCommentBody(begin, end);
+		case State::STRING:
+			return LexerScan::ScanStringBody(begin, end);
+		default:
+			return 0;
+		}
+	}
+
+	TokenList Lexer::Tokenize(std::string_view source)
+	{
+		TokenList tokens;
+		Tokenize(source, tokens);
+		return tokens;
+	}
+
+	void Lexer::Tokenize(std::string_view source, TokenList& tokens)
+	{
+		LexContext context;
+		tokens.Restart();
+		TokenizeChunk(context, source, true, tokens);
 	}
 
+	// A chunk lexed on its own, assuming it starts a line in the START state.
+	struct SpeculativeChunk {
+		TokenList m_tokens;
+		LexContext m_context;
+	};
 
-	std::vector<Token> Lexer::Tokenize(const std::string& str)
+	TokenList Lexer::Tokenize(std::string_view source, ThreadPool& pool, size_t chunkCount)
 	{
-		int row = 1, col = 1;
-		std::string buf;
-		State::Type state = State::START;
-		std::vector<Token> tokens;
-		auto it = str.cbegin();
-		const auto& characterSet = CharacterSet::Instance();
+		TokenList tokens;
+		Tokenize(source, tokens, pool, chunkCount);
+		return tokens;
+	}
+
+	void Lexer::Tokenize(std::string_view source, TokenList& tokens, ThreadPool& pool, size_t chunkCount)
+	{
+		chunkCount = std::min(chunkCount, source.size() / MinParallelChunkSize);
+		if (chunkCount < 2) {
+			Tokenize(source, tokens);
+			return;
+		}
+		// Cut right after a '\n'. Every state leaves a line break in START except a string literal,
+		// which may span lines, so a chunk starts in START unless a string is open across the cut.
+		std::vector<std::string_view> chunks;
+		size_t begin = 0;
+		for (size_t n = 1; n < chunkCount && begin < source.size(); n++) {
+			size_t target = std::max(begin, source.size() * n / chunkCount);
+			size_t cut = source.find('\n', target);
+			if (cut == std::string_view::npos)
+				break;
+			chunks.push_back(source.substr(begin, cut + 1 - begin));
+			begin = cut + 1;
+		}
+		chunks.push_back(source.substr(begin));
+
+		std::vector<std::future<SpeculativeChunk>> futures;
+		futures.reserve(chunks.size());
+		for (size_t i = 1; i < chunks.size(); i++) {
+			bool last = i + 1 == chunks.size();
+			uint32_t offset = static_cast<uint32_t>(chunks[i].data() - source.data());
+			futures.push_back(pool.SubmitTask([this, chunk = chunks[i], offset, last]() {
+				SpeculativeChunk result;
+				// rows are relative, offsets are already those of the whole source
+				result.m_context.m_offset = offset;
+				result.m_tokens.ResetLines(1, offset);
+				TokenizeChunk(result.m_context, chunk, last, result.m_tokens);
+				return result;
+				}));
+		}
+
+		LexContext context;
+		tokens.Restart();
+		try {
+			TokenizeChunk(context, chunks[0], chunks.size() == 1, tokens);
+			for (size_t i = 1; i < chunks.size(); i++) {
+				bool last = i + 1 == chunks.size();
+				bool speculationHolds = context.m_state == State::START && !context.m_pending;
+				std::optional<SpeculativeChunk> result;
+				try {
+					result.emplace(futures[i - 1].get());
+				}
+				catch (const LexerException&) {
+					// positions are relative to the chunk, lexing it in place reports the real ones
+				}
+				if (!speculationHolds || !result) {
+					TokenizeChunk(context, chunks[i], last, tokens);
+					continue;
+				}
+				int lineOffset = context.m_row - 1;
+				tokens.Append(std::move(result->m_tokens));
+				context = std::move(result->m_context);
+				context.m_row += lineOffset;
+			}
+		}
+		catch (...) {
+			// the tasks view source, which may not outlive this call
+			for (auto& future : futures) {
+				if (future.valid())
+					future.wait();
+			}
+			throw;
+		}
+	}
+
+	void Lexer::TokenizeChunk(LexContext& context, std::string_view chunk, bool last, TokenList& tokens) const
+	{
+		if (chunk.size() > UINT32_MAX - context.m_offset)
+			throw std::length_error("Lexer: sources over 4 GiB are not supported");
+		int row = context.m_row, col = context.m_col;
+		State::Type state = context.m_state;
+		const bool fastScan = context.m_fastScan;
+		const size_t firstToken = tokens.size();
+		const uint32_t chunkOffset = context.m_offset;
+		tokens.SetSource(chunk.data(), chunkOffset);
+		// the pending token is chunk[tokenBegin, i), or context.m_spill once spilled
+		size_t tokenBegin = 0;
 		const auto& escapeCharacterSet = EscapeCharacterSet::Instance();
-		Transition transition;
-		while (it != str.cend()) {
-			auto chTypeOpt = characterSet.GetCharacterType(*it);
-			if (!chTypeOpt) {
-				throw LexerException("Unknown character exception'", *it, row, col);
+		auto beginToken = [&](size_t i) {
+			if (!context.m_pending) {
+				context.m_pending = true;
+				tokenBegin = i;
+				context.m_tokenOffset = chunkOffset + static_cast<uint32_t>(i);
 			}
-			auto& curStateTransTable = m_stateTransitionTable[state];
-			if (auto transIt = curStateTransTable.find(*chTypeOpt); transIt != curStateTransTable.end()) {
-				transition = transIt->second;
+		};
+		auto emitToken = [&](TokenType::Type type, size_t tokenEnd) {
+			if (context.m_spilled) {
+				std::string_view content = tokens.StoreLiteral(context.m_spill);
+				if (type == TokenType::IDENTIFIER)
+					type = ClassifyKeyword(content);
+				tokens.EmplaceStoredToken(type, context.m_tokenOffset, content);
 			}
 			else {
-				//other state
-				transition = m_stateOtherTransitionTable.at(state);
+				std::string_view content = chunk.substr(tokenBegin, tokenEnd - tokenBegin);
+				if (type == TokenType::IDENTIFIER)
+					type = ClassifyKeyword(content);
+				tokens.EmplaceSourceToken(type, context.m_tokenOffset, static_cast<uint32_t>(content.size()));
 			}
+			if (type == TokenType::INT_LITERAL || type == TokenType::DOUBLE_LITERAL)
+				DecodeNumber(type, tokens);
+			context.m_pending = false;
+			context.m_spilled = false;
+		};
+		size_t i = 0;
+		while (i < chunk.size()) {
+			char ch = chunk[i];
+			if (fastScan) {
+				size_t run = ScanRun(state, ch, chunk.data() + i, chunk.data() + chunk.size());
+				if (run != 0) {
+					if (context.m_spilled)
+						context.m_spill.append(chunk.data() + i, run);
+					i += run;
+					col += static_cast<int>(run);
+					continue;
+				}
+			}
+			const Transition& transition = m_transitionTable[state][static_cast<unsigned char>(ch)];
 			switch (transition.m_action) {
 			case Action::FORWARD: {
-				buf.push_back(*it);
+				beginToken(i);
+				if (context.m_spilled)
+					context.m_spill.push_back(ch);
+				context.m_pendingType = transition.m_tokenType;
 				break;
 			}
 			case Action::RETRACT: {
-				tokens.emplace_back(transition.m_tokenType, buf, row, col - buf.size());
-				buf.clear();
+				emitToken(transition.m_tokenType, i);
 				break;
 			}
 			case Action::APPEND: {
-				buf.push_back(*it);
-				tokens.emplace_back(transition.m_tokenType, buf, row, col - buf.size() + 1);
-				buf.clear();
+				beginToken(i);
+				if (context.m_spilled)
+					context.m_spill.push_back(ch);
+				emitToken(transition.m_tokenType, i + 1);
 				break;
 			}
 			case Action::JUMP: {
 				break;
 			}
 			case Action::CLEAR: {
-				buf.clear();
+				context.m_pending = false;
+				context.m_spilled = false;
 				break;
 			}
 			case Action::NEWLINE: {
+				// only a string literal keeps the line break as part of its text
+				if (context.m_spilled)
+					context.m_spill.push_back(ch);
 				col = 0;
 				row += 1;
+				tokens.AddLineStart(chunkOffset + static_cast<uint32_t>(i) + 1);
 				break;
 			}
 			case Action::ESCAPE: {
-				auto escapeChOpt = escapeCharacterSet.Transform(*it);
-				if (!escapeChOpt) {
-					throw LexerException("Unknown escape character exception'", *it, row, col);
+				// the table only routes known escape characters here, replace the '\\' before it
+				if (!context.m_spilled) {
+					context.m_spilled = true;
+					context.m_spill.assign(chunk.substr(tokenBegin, i - 1 - tokenBegin));
+				}
+				else {
+					context.m_spill.pop_back();
 				}
-				buf.pop_back();
-				buf.push_back(*escapeChOpt);
+				context.m_spill.push_back(*escapeCharacterSet.Transform(ch));
 				break;
 			}
+			case Action::REJECT: {
+				ThrowRejected(state, ch, row, col);
+			}
 			}
 			state = transition.m_next;
 			if (transition.m_action != Action::RETRACT) {
-				it++;
+				i++;
 				col++;
 			}
 		}
-		if (!buf.empty())
-			tokens.emplace_back(transition.m_tokenType, buf, row, col - buf.size() - 1);
-		return tokens;
+		if (last) {
+			if (context.m_pending)
+				emitToken(context.m_pendingType, chunk.size());
+		}
+		else if (context.m_pending && !context.m_spilled) {
+			context.m_spilled = true;
+			context.m_spill.assign(chunk.substr(tokenBegin));
+		}
+		tokens.InternIdentifiers(firstToken);
+		context.m_state = state;
+		context.m_offset = chunkOffset + static_cast<uint32_t>(chunk.size());
+		context.m_row = row;
+		context.m_col = col;
 	}
-}
\ No newline at end of file
+}
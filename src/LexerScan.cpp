@@ -0,0 +1,140 @@
+#include "LexerScan.h"
+#include <bit>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#define CPPINTERP_SCAN_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPPINTERP_SCAN_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace CppInterp::LexerScan {
+
+	namespace {
+#if defined(CPPINTERP_SCAN_AVX2)
+		struct Simd {
+			using Reg = __m256i;
+			static constexpr size_t Width = 32;
+			static Reg Load(const char* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+			static Reg Set(char ch) { return _mm256_set1_epi8(ch); }
+			static Reg Eq(Reg a, char ch) { return _mm256_cmpeq_epi8(a, Set(ch)); }
+			static Reg Or(Reg a, Reg b) { return _mm256_or_si256(a, b); }
+			static Reg And(Reg a, Reg b) { return _mm256_and_si256(a, b); }
+			// bytes >= 0x80 compare as negative, so they never fall in an ASCII range
+			static Reg InRange(Reg a, char low, char high) {
+				return And(_mm256_cmpgt_epi8(a, Set(low - 1)), _mm256_cmpgt_epi8(Set(high + 1), a));
+			}
+			static uint32_t MoveMask(Reg a) { return static_cast<uint32_t>(_mm256_movemask_epi8(a)); }
+		};
+#elif defined(CPPINTERP_SCAN_SSE2)
+		struct Simd {
+			using Reg = __m128i;
+			static constexpr size_t Width = 16;
+			static Reg Load(const char* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+			static Reg Set(char ch) { return _mm_set1_epi8(ch); }
+			static Reg Eq(Reg a, char ch) { return _mm_cmpeq_epi8(a, Set(ch)); }
+			static Reg Or(Reg a, Reg b) { return _mm_or_si128(a, b); }
+			static Reg And(Reg a, Reg b) { return _mm_and_si128(a, b); }
+			// bytes >= 0x80 compare as negative, so they never fall in an ASCII range
+			static Reg InRange(Reg a, char low, char high) {
+				return And(_mm_cmpgt_epi8(a, Set(low - 1)), _mm_cmplt_epi8(a, Set(high + 1)));
+			}
+			static uint32_t MoveMask(Reg a) { return static_cast<uint32_t>(_mm_movemask_epi8(a)); }
+		};
+#endif
+
+#if defined(CPPINTERP_SCAN_AVX2) || defined(CPPINTERP_SCAN_SSE2)
+#define CPPINTERP_SCAN_SIMD
+		constexpr uint32_t FullMask = Simd::Width == 32 ? 0xFFFFFFFFu : 0xFFFFu;
+#endif
+
+		// Each run kind gives Keep(byte) for the scalar tail and Stop(reg), a mask of the bytes ending the run.
+		struct BlankRun {
+			static bool Keep(char ch) { return ch == ' ' || ch == '\t'; }
+#ifdef CPPINTERP_SCAN_SIMD
+			static uint32_t Stop(Simd::Reg v) {
+				return ~Simd::MoveMask(Simd::Or(Simd::Eq(v, ' '), Simd::Eq(v, '\t'))) & FullMask;
+			}
+#endif
+		};
+
+		struct IdentifierRun {
+			static bool Keep(char ch) {
+				unsigned char lower = static_cast<unsigned char>(ch) | 0x20;
+				return (lower >= 'a' && lower <= 'z') || (ch >= '0' && ch <= '9') || ch == '_';
+			}
+#ifdef CPPINTERP_SCAN_SIMD
+			static uint32_t Stop(Simd::Reg v) {
+				Simd::Reg letter = Simd::InRange(Simd::Or(v, Simd::Set(0x20)), 'a', 'z');
+				Simd::Reg digit = Simd::InRange(v, '0', '9');
+				Simd::Reg identifier = Simd::Or(Simd::Or(letter, digit), Simd::Eq(v, '_'));
+				return ~Simd::MoveMask(identifier) & FullMask;
+			}
+#endif
+		};
+
+		struct CommentRun {
+			static bool Keep(char ch) { return ch != '\n' && ch != '\r'; }
+#ifdef CPPINTERP_SCAN_SIMD
+			static uint32_t Stop(Simd::Reg v) {
+				return Simd::MoveMask(Simd::Or(Simd::Eq(v, '\n'), Simd::Eq(v, '\r')));
+			}
+#endif
+		};
+
+		struct StringRun {
+			static bool Keep(char ch) { return ch != '"' && ch != '\\' && CommentRun::Keep(ch); }
+#ifdef CPPINTERP_SCAN_SIMD
+			static uint32_t Stop(Simd::Reg v) {
+				Simd::Reg quoteOrEscape = Simd::Or(Simd::Eq(v, '"'), Simd::Eq(v, '\\'));
+				Simd::Reg lineEnd = Simd::Or(Simd::Eq(v, '\n'), Simd::Eq(v, '\r'));
+				return Simd::MoveMask(Simd::Or(quoteOrEscape, lineEnd));
+			}
+#endif
+		};
+
+		template <typename Run>
+		inline size_t ScanRun(const char* begin, const char* end) {
+			const char* p = begin;
+#ifdef CPPINTERP_SCAN_SIMD
+			while (static_cast<size_t>(end - p) >= Simd::Width) {
+				uint32_t stopMask = Run::Stop(Simd::Load(p));
+				if (stopMask != 0)
+					return p - begin + std::countr_zero(stopMask);
+				p += Simd::Width;
+			}
+#endif
+			while (p < end && Run::Keep(*p))
+				p++;
+			return p - begin;
+		}
+	}
+
+	size_t SkipBlanks(const char* begin, const char* end) {
+		return ScanRun<BlankRun>(begin, end);
+	}
+
+	size_t ScanIdentifier(const char* begin, const char* end) {
+		return ScanRun<IdentifierRun>(begin, end);
+	}
+
+	size_t ScanCommentBody(const char* begin, const char* end) {
+		return ScanRun<CommentRun>(begin, end);
+	}
+
+	size_t ScanStringBody(const char* begin, const char* end) {
+		return ScanRun<StringRun>(begin, end);
+	}
+
+	const char* GetInstructionSet() {
+#if defined(CPPINTERP_SCAN_AVX2)
+		return "AVX2";
+#elif defined(CPPINTERP_SCAN_SSE2)
+		return "SSE2";
+#else
+		return "scalar";
+#endif
+	}
+}
@@ -1,101 +1,540 @@
 
 
 #include "Parser.h"
+#include "AstCache.h"
 #include "Exception.hpp"
+#include <array>
+#include <tuple>
 
 
 using namespace CppInterp;
 
-void Parser::PreprocessTokens(std::vector<Token>& tokens) {
-	static const std::unordered_map<std::string, TokenType::Type> keywordMap = {
-		{"function", TokenType::FUNCTION},
-		{"let", TokenType::LET},
-		{"const", TokenType::CONST},
-		{"struct", TokenType::STRUCT},
-		{"switch", TokenType::SWITCH},
-		{"case", TokenType::CASE},
-		{"default", TokenType::DEFAULT},
-		{"if", TokenType::IF},
-		{"else", TokenType::ELSE},
-		{"while", TokenType::WHILE},
-		{"for", TokenType::FOR},
-		{"return", TokenType::RETURN},
-		{"break", TokenType::BREAK},
-		{"continue", TokenType::CONTINUE},
-		{"true", TokenType::BOOL_LITERAL},
-		{"false", TokenType::BOOL_LITERAL},
-		{"NULL", TokenType::NULL_LITERAL},
-		{"int", TokenType::INT},
-		{"double", TokenType::DOUBLE},
-		{"char", TokenType::CHAR},
-		{"string", TokenType::STRING},
-		{"bool", TokenType::BOOL},
-		{"void", TokenType::VOID},
-		{"import", TokenType::IMPORT},
-		{"lambda",TokenType::LAMBDA}
-	};
-	for (auto& token : tokens) {
-		if (token.m_type == TokenType::IDENTIFIER) {
-			auto it = keywordMap.find(token.m_content);
-			if (it != keywordMap.end()) {
-				token.m_type = it->second;
-			}
-		}
+Parser::~Parser() {
+	ClearNodes();
+}
+
+AstNode* Parser::Parse(const std::string& str) {
+	ClearNodes();
+	ResetSource();
+	m_source.assign(str);
+	return ParseSource();
+}
+
+AstNode* Parser::Parse(std::string&& str) {
+	ClearNodes();
+	ResetSource();
+	m_source = std::move(str);
+	return ParseSource();
+}
+
+AstNode* Parser::ParseFile(const std::string& path) {
+	ClearNodes();
+	ResetSource();
+	m_file.Open(path);
+	return ParseSource();
+}
+
+AstNode* Parser::ParseSource() {
+	m_trackRegions = true;
+	Lexer::Instance().Tokenize(GetSource(), m_tokenBuffer);
+	m_current = 0;
+	m_root = ParseProgram(nullptr);
+	return m_root;
+}
+
+AstNode* Parser::Parse(const std::string& str, ThreadPool& pool, size_t chunkCount) {
+	ClearNodes();
+	ResetSource();
+	m_source.assign(str);
+	m_trackRegions = true;
+	Lexer::Instance().Tokenize(m_source, m_tokenBuffer, pool, chunkCount);
+	m_current = 0;
+	m_root = ParseProgram(pool, chunkCount);
+	return m_root;
+}
+
+AstNode* Parser::ParseFile(const std::string& path, ThreadPool& pool, size_t chunkCount) {
+	ClearNodes();
+	ResetSource();
+	m_file.Open(path);
+	m_trackRegions = true;
+	Lexer::Instance().Tokenize(m_file.View(), m_tokenBuffer, pool, chunkCount);
+	m_current = 0;
+	m_root = ParseProgram(pool, chunkCount);
+	return m_root;
+}
+
+AstNode* Parser::Parse(const std::string& str, const AstCache& cache) {
+	ClearNodes();
+	ResetSource();
+	m_source.assign(str);
+	if (AstNode* root = LoadCached(cache))
+		return root;
+	return ParseAndStore(cache);
+}
+
+AstNode* Parser::ParseFile(const std::string& path, const AstCache& cache) {
+	ClearNodes();
+	ResetSource();
+	m_file.Open(path);
+	if (AstNode* root = LoadCached(cache))
+		return root;
+	return ParseAndStore(cache);
+}
+
+AstNode* Parser::LoadCached(const AstCache& cache) {
+	std::optional<FlatAst> tree = cache.Load(GetSource());
+	if (!tree)
+		return nullptr;
+	// without tokens and blocks, Reparse falls back to a full parse
+	m_trackRegions = true;
+	m_tokenBuffer.Reset();
+	m_current = 0;
+	m_root = tree->ToTree(m_arena, m_texts);
+	m_lastParseCached = true;
+	return m_root;
+}
+
+AstNode* Parser::ParseAndStore(const AstCache& cache) {
+	bool lazy = m_lazyBodies;
+	m_lazyBodies = false;
+	try {
+		ParseSource();
+	}
+	catch (...) {
+		m_lazyBodies = lazy;
+		throw;
 	}
+	m_lazyBodies = lazy;
+	if (!HasErrors())
+		cache.Store(GetSource(), FlatAst::FromTree(m_root));
+	return m_root;
 }
 
-Parser::~Parser() {
+AstNode* Parser::Parse(const TokenList& tokens) {
 	ClearNodes();
+	ResetSource();
+	m_trackRegions = false;
+	m_tokens = &tokens;
+	m_current = 0;
+	m_root = ParseProgram(nullptr);
+	return m_root;
 }
 
-AstNode* Parser::Parse(const std::string& str) {
-	m_tokens.clear();
+AstNode* Parser::Parse(TokenList&& tokens) {
 	ClearNodes();
-	m_tokens = Lexer::Instance().Tokenize(str);
-	PreprocessTokens(m_tokens);
+	ResetSource();
+	m_trackRegions = false;
+	m_tokenBuffer = std::move(tokens);
 	m_current = 0;
 	m_root = ParseProgram(nullptr);
 	return m_root;
 }
 
-AstNode* Parser::Parse(const std::vector<Token>& tokens) {
-	m_tokens.clear();
+AstNode* Parser::Parse(std::span<const Token> tokens) {
 	ClearNodes();
-	m_tokens = tokens;
-	PreprocessTokens(m_tokens);
+	ResetSource();
+	m_trackRegions = false;
+	m_tokenBuffer.Restart();
+	for (const Token& token : tokens)
+		m_tokenBuffer.push_back(token);
 	m_current = 0;
 	m_root = ParseProgram(nullptr);
 	return m_root;
 }
 
+AstNode* Parser::Parse(TokenStream& stream) {
+	ClearNodes();
+	ResetSource();
+	m_trackRegions = false;
+	m_skipBodies = false;
+	ProgramNode* node = m_arena.New<ProgramNode>(nullptr);
+	while (PullTopLevelItems(stream)) {
+		m_current = 0;
+		int tokensSize = m_tokens->size();
+		while (m_current < tokensSize) {
+			if (AstNode* declaration = Recover([&] { return ParseDeclaration(node); }))
+				node->m_declarations.push_back(declaration);
+		}
+	}
+	m_tokenBuffer.clear();
+	m_root = node;
+	return m_root;
+}
+
+AstNode* Parser::Reparse(const TextEdit& edit) {
+	if (!m_root || !m_trackRegions)
+		throw std::logic_error("Reparse needs a tree parsed from a string or a file");
+	if (m_file.IsOpen()) {
+		m_source.assign(m_file.View());
+		m_file.Close();
+	}
+	if (edit.m_offset > m_source.size() || edit.m_removed > m_source.size() - edit.m_offset)
+		throw std::out_of_range("Text edit outside the source");
+
+	// the smallest block the edit lies strictly inside of, its first byte and closing brace untouched
+	const Region* enclosing = nullptr;
+	size_t editEnd = edit.m_offset + edit.m_removed;
+	for (const Region& region : m_regions) {
+		if (region.m_begin < edit.m_offset && editEnd < region.m_end &&
+			(!enclosing || region.m_end - region.m_begin < enclosing->m_end - enclosing->m_begin))
+			enclosing = &region;
+	}
+	m_source.replace(edit.m_offset, edit.m_removed, edit.m_text);
+	// skipped bodies index the full token list, which the block's tokens replace
+	if (!enclosing || HasErrors() || m_unparsedBodies > 0 || m_source.size() > UINT32_MAX)
+		return ReparseAll();
+
+	const Region old = *enclosing;
+	const int64_t delta = static_cast<int64_t>(edit.m_text.size()) - static_cast<int64_t>(edit.m_removed);
+	const uint32_t end = static_cast<uint32_t>(old.m_end + delta);
+	const size_t firstNewRegion = m_regions.size();
+	AstNode* parent = old.m_node->m_parent;
+	AstNode* node = nullptr;
+	bool recover = m_recoverErrors, skipBodies = m_skipBodies;
+	m_recoverErrors = false;
+	m_skipBodies = false;
+	try {
+		// the block starts at a token, so the lexer starts there in START
+		LexContext context;
+		context.m_offset = old.m_begin;
+		context.m_row = old.m_line;
+		context.m_col = old.m_column;
+		m_tokenBuffer.Restart();
+		m_tokenBuffer.ResetLines(old.m_line, old.m_begin - (old.m_column - 1));
+		Lexer::Instance().TokenizeChunk(context, std::string_view(m_source).substr(old.m_begin, end - old.m_begin), true, m_tokenBuffer);
+		m_current = 0;
+		if (old.m_node->m_nodeType == NodeType::FUNCTION_DECL) {
+			if (PeekType() == TokenType::FUNCTION)
+				node = ParseFunctionDecl(parent);
+		}
+		else if (Check(TokenType::LEFT_BRACE)) {
+			node = ParseCompoundStmt(parent);
+		}
+	}
+	catch (const LangException&) {
+		node = nullptr;
+	}
+	m_recoverErrors = recover;
+	m_skipBodies = skipBodies;
+	// the edited text must still be exactly one such block
+	if (!node || static_cast<size_t>(m_current) != m_tokens->size() || !ReplaceChild(parent, old.m_node, node))
+		return ReparseAll();
+
+	// what follows the old closing brace moves with the new one
+	const Region& updated = m_regions.back();
+	const int lineDelta = updated.m_endLine - old.m_endLine;
+	const int columnDelta = updated.m_endColumn - old.m_endColumn;
+	auto shift = [&](int& line, int& column) {
+		if (line > old.m_endLine) {
+			line += lineDelta;
+		}
+		else if (line == old.m_endLine && column > old.m_endColumn) {
+			line += lineDelta;
+			column += columnDelta;
+		}
+	};
+
+	size_t kept = 0;
+	for (size_t i = 0; i < firstNewRegion; i++) {
+		Region region = m_regions[i];
+		if (region.m_begin >= old.m_begin && region.m_end <= old.m_end)
+			continue; // replaced by the regions of the new block
+		if (region.m_begin >= old.m_end) {
+			region.m_begin = static_cast<uint32_t>(region.m_begin + delta);
+			shift(region.m_line, region.m_column);
+		}
+		if (region.m_end >= old.m_end) {
+			region.m_end = static_cast<uint32_t>(region.m_end + delta);
+			shift(region.m_endLine, region.m_endColumn);
+		}
+		m_regions[kept++] = region;
+	}
+	m_regions.erase(m_regions.begin() + kept, m_regions.begin() + firstNewRegion);
+
+	if (lineDelta != 0 || columnDelta != 0) {
+		auto shiftTree = [&](auto& self, AstNode* subtree) -> void {
+			shift(subtree->m_line, subtree->m_column);
+			ForEachChild(*subtree, [&](AstNode* child) { self(self, child); });
+		};
+		// nodes after the block hang off its ancestors, shift leaves the ones before it alone
+		AstNode* child = node;
+		for (AstNode* ancestor = parent; ancestor; child = ancestor, ancestor = ancestor->m_parent) {
+			shift(ancestor->m_line, ancestor->m_column);
+			if (ancestor->m_nodeType == NodeType::PROGRAM) {
+				// top-level items are in source order, only the ones after the block are walked
+				auto& declarations = static_cast<ProgramNode*>(ancestor)->m_declarations;
+				auto it = std::find(declarations.begin(), declarations.end(), child);
+				for (it = it == declarations.end() ? declarations.begin() : it + 1; it != declarations.end(); ++it)
+					shiftTree(shiftTree, *it);
+			}
+			else {
+				ForEachChild(*ancestor, [&](AstNode* sibling) {
+					if (sibling != child)
+						shiftTree(shiftTree, sibling);
+					});
+			}
+		}
+	}
+	m_lastReparseIncremental = true;
+	m_lastReparsed = node;
+	return m_root;
+}
+
+AstNode* Parser::ReparseAll() {
+	std::string source = std::move(m_source);
+	Parse(source);
+	m_lastReparseIncremental = false;
+	return m_root;
+}
+
+bool Parser::ReplaceChild(AstNode* parent, AstNode* child, AstNode* replacement) {
+	auto inList = [&](auto& list) {
+		auto it = std::find(list.begin(), list.end(), child);
+		if (it == list.end())
+			return false;
+		*it = static_cast<std::remove_reference_t<decltype(*it)>>(replacement);
+		return true;
+	};
+	auto inSlot = [&](auto*& slot) {
+		if (slot != child)
+			return false;
+		slot = static_cast<std::remove_reference_t<decltype(slot)>>(replacement);
+		return true;
+	};
+	switch (parent ? parent->m_nodeType : NodeType::PROGRAM) {
+	case NodeType::PROGRAM:
+		return parent && inList(static_cast<ProgramNode*>(parent)->m_declarations);
+	case NodeType::FUNCTION_DECL:
+		return inSlot(static_cast<FunctionDeclNode*>(parent)->m_body);
+	case NodeType::FUNCTION_LITERAL:
+		return inSlot(static_cast<FunctionLiteralNode*>(parent)->m_body);
+	case NodeType::COMPOUND_STMT:
+		return inList(static_cast<CompoundStmtNode*>(parent)->m_statements);
+	case NodeType::CASE_STMT:
+		return inList(static_cast<CaseNode*>(parent)->m_statements);
+	case NodeType::DEFAULT_STMT:
+		return inList(static_cast<DefaultNode*>(parent)->m_statements);
+	case NodeType::IF_STMT: {
+		auto* stmt = static_cast<IfStmtNode*>(parent);
+		return inSlot(stmt->m_thenStmt) || inSlot(stmt->m_elseStmt);
+	}
+	case NodeType::WHILE_STMT:
+		return inSlot(static_cast<WhileStmtNode*>(parent)->m_body);
+	case NodeType::FOR_STMT:
+		return inSlot(static_cast<ForStmtNode*>(parent)->m_body);
+	default:
+		return false;
+	}
+}
+
+void Parser::RecordRegion(AstNode* node, size_t firstToken) {
+	if (!m_trackRegions)
+		return;
+	Region region;
+	region.m_node = node;
+	region.m_begin = m_tokens->Offset(firstToken);
+	region.m_end = m_tokens->Offset(m_current - 1) + 1; // past the '}'
+	std::tie(region.m_line, region.m_column) = m_tokens->Position(firstToken);
+	std::tie(region.m_endLine, region.m_endColumn) = m_tokens->Position(m_current - 1);
+	m_regions.push_back(region);
+}
+
+bool Parser::PullTopLevelItems(TokenStream& stream) {
+	m_tokenBuffer.clear();
+	int depth = 0;
+	Token token;
+	while (stream.Next(token)) {
+		TokenType::Type type = token.m_type;
+		m_tokenBuffer.push_back(token);
+		if (type == TokenType::LEFT_PAREN || type == TokenType::LEFT_BRACE || type == TokenType::LEFT_SQUARE)
+			++depth;
+		else if (type == TokenType::RIGHT_PAREN || type == TokenType::RIGHT_BRACE || type == TokenType::RIGHT_SQUARE)
+			--depth;
+		if (depth > 0 || (type != TokenType::SEMICOLON && type != TokenType::RIGHT_BRACE))
+			continue;
+		const Token* next = stream.Peek();
+		if (!next)
+			break;
+		if (EndsTopLevelItem(type, next->m_type))
+			return true;
+	}
+	return !m_tokenBuffer.empty();
+}
+
+bool Parser::EndsTopLevelItem(TokenType::Type last, TokenType::Type next) {
+	// Only split where the next token can't continue the item.
+	// Merging two items into one batch is always safe.
+	if (next == TokenType::ELSE)
+		return false;
+	if (last == TokenType::SEMICOLON)
+		return true;
+	return last == TokenType::RIGHT_BRACE && (next == TokenType::IDENTIFIER ||
+		TokenType::IsKeyword(next) ||
+		next == TokenType::LEFT_BRACE || next == TokenType::INT_LITERAL ||
+		next == TokenType::DOUBLE_LITERAL || next == TokenType::CHARACTER_LITERAL ||
+		next == TokenType::STRING_LITERAL);
+}
+
 ProgramNode* Parser::ParseProgram(AstNode* parent) {
-	ProgramNode* node = new ProgramNode(parent);
-	m_nodes.push_back(node);
-	int tokensSize = m_tokens.size();
+	m_skipBodies = m_lazyBodies;
+	ProgramNode* node = m_arena.New<ProgramNode>(parent);
+	int tokensSize = m_tokens->size();
 	while (m_current < tokensSize) {
-		const Token& token = Peek();
-		AstNode* target = nullptr;
-		switch (token.m_type)
-		{
-		case TokenType::IMPORT:
-			target = ParseImportStmt(node);
-			break;
-		case TokenType::FUNCTION:
-			target = ParseFunctionDecl(node);
-			break;
-		default:
-			target = ParseStatement(node);
-			break;
-		}
-		node->m_declarations.push_back(target);
+		if (AstNode* declaration = Recover([&] { return ParseDeclaration(node); }))
+			node->m_declarations.push_back(declaration);
 	}
 	return node;
 }
 
+ProgramNode* Parser::ParseProgram(ThreadPool& pool, size_t chunkCount) {
+	const size_t tokenCount = m_tokens->size();
+	m_skipBodies = m_lazyBodies;
+	chunkCount = std::min(chunkCount, tokenCount / MinParallelTokens);
+	if (chunkCount < 2)
+		return ParseProgram(nullptr);
+
+	// cut at the first item boundary past every chunkCount-th of the tokens, from the types alone
+	const TokenType::Type* types = m_tokens->Types();
+	std::vector<int> cuts{ 0 };
+	int depth = 0;
+	for (size_t i = 0; i + 1 < tokenCount && cuts.size() < chunkCount; i++) {
+		TokenType::Type type = types[i];
+		if (type == TokenType::LEFT_PAREN || type == TokenType::LEFT_BRACE || type == TokenType::LEFT_SQUARE)
+			++depth;
+		else if (type == TokenType::RIGHT_PAREN || type == TokenType::RIGHT_BRACE || type == TokenType::RIGHT_SQUARE)
+			--depth;
+		if (depth == 0 && (i + 1) * chunkCount >= tokenCount * cuts.size() && EndsTopLevelItem(type, types[i + 1]))
+			cuts.push_back(static_cast<int>(i + 1));
+	}
+	cuts.push_back(static_cast<int>(tokenCount));
+	const size_t runs = cuts.size() - 1;
+	if (runs < 2)
+		return ParseProgram(nullptr);
+
+	ProgramNode* node = m_arena.New<ProgramNode>(nullptr);
+	for (size_t i = 0; i < runs; i++) {
+		auto worker = std::make_unique<Parser>();
+		worker->m_tokens = m_tokens;
+		worker->m_trackRegions = m_trackRegions;
+		worker->m_skipBodies = m_skipBodies;
+		m_workers.push_back(std::move(worker));
+	}
+	std::vector<std::future<std::vector<AstNode*>>> futures;
+	futures.reserve(runs - 1);
+	for (size_t i = 1; i < runs; i++) {
+		futures.push_back(pool.SubmitTask([worker = m_workers[i].get(), node, begin = cuts[i], end = cuts[i + 1]]() {
+			return worker->ParseItems(node, begin, end);
+			}));
+	}
+
+	// every task is waited for before anything is thrown, they read the tokens
+	std::vector<std::vector<AstNode*>> results(runs);
+	bool clean = true;
+	std::exception_ptr failure;
+	auto collect = [&](size_t run, auto&& parse) {
+		try {
+			results[run] = parse();
+		}
+		catch (const LangException&) {
+			clean = false; // the sequential parse reports it where it belongs
+		}
+		catch (...) {
+			if (!failure)
+				failure = std::current_exception();
+		}
+	};
+	collect(0, [&] { return m_workers[0]->ParseItems(node, cuts[0], cuts[1]); });
+	for (size_t i = 1; i < runs; i++)
+		collect(i, [&] { return futures[i - 1].get(); });
+	if (failure || !clean) {
+		ClearNodes();
+		if (failure)
+			std::rethrow_exception(failure);
+		m_current = 0;
+		return ParseProgram(nullptr);
+	}
+
+	size_t itemCount = 0;
+	for (const auto& items : results)
+		itemCount += items.size();
+	node->m_declarations.reserve(itemCount);
+	for (size_t i = 0; i < runs; i++) {
+		node->m_declarations.insert(node->m_declarations.end(), results[i].begin(), results[i].end());
+		m_regions.insert(m_regions.end(), m_workers[i]->m_regions.begin(), m_workers[i]->m_regions.end());
+		m_unparsedBodies += m_workers[i]->m_unparsedBodies;
+	}
+	m_current = static_cast<int>(tokenCount);
+	return node;
+}
+
+std::vector<AstNode*> Parser::ParseItems(ProgramNode* program, int begin, int end) {
+	std::vector<AstNode*> items;
+	m_current = begin;
+	while (m_current < end)
+		items.push_back(ParseDeclaration(program));
+	if (m_current != end) {
+		auto [line, column] = m_tokens->Position(end);
+		throw ParserException("Top-level item runs past the end of its run", line, column);
+	}
+	return items;
+}
+
+void Parser::Synchronize(int start) {
+	// braces opened by the failed item are still open, skip through their closing braces
+	int depth = 0;
+	for (int i = start; i < m_current; i++) {
+		TokenType::Type type = m_tokens->Type(i);
+		depth += type == TokenType::LEFT_BRACE ? 1 : type == TokenType::RIGHT_BRACE ? -1 : 0;
+	}
+	int tokensSize = m_tokens->size();
+	bool progressed = m_current > start;
+	for (; m_current < tokensSize; progressed = true) {
+		TokenType::Type type = m_tokens->Type(m_current);
+		if (type == TokenType::LEFT_BRACE) {
+			++depth;
+		}
+		else if (type == TokenType::RIGHT_BRACE) {
+			// closes the enclosing block, which is still being parsed
+			if (depth <= 0 && progressed)
+				return;
+			if (--depth <= 0) {
+				Consume();
+				return;
+			}
+		}
+		else if (depth <= 0 && progressed) {
+			if (type == TokenType::SEMICOLON) {
+				Consume();
+				return;
+			}
+			switch (type) {
+			case TokenType::IMPORT: case TokenType::FUNCTION: case TokenType::STRUCT:
+			case TokenType::LET: case TokenType::CONST: case TokenType::IF: case TokenType::SWITCH:
+			case TokenType::WHILE: case TokenType::FOR: case TokenType::RETURN:
+			case TokenType::BREAK: case TokenType::CONTINUE:
+				return;
+			}
+		}
+		Consume();
+	}
+}
+
+AstNode* Parser::ParseDeclaration(ProgramNode* parent) {
+	switch (PeekType())
+	{
+	case TokenType::IMPORT:
+		return ParseImportStmt(parent);
+	case TokenType::FUNCTION:
+		return ParseFunctionDecl(parent);
+	default:
+		return ParseStatement(parent);
+	}
+}
+
 
 ImportNode* Parser::ParseImportStmt(AstNode* parent) {
-	ImportNode* node = new ImportNode(parent);
-	m_nodes.push_back(node);
+	ImportNode* node = m_arena.New<ImportNode>(parent);
 	//import
 	Consume();
 	//string literal or identifier
@@ -103,13 +542,13 @@ ImportNode* Parser::ParseImportStmt(AstNode* parent) {
 		const Token& token = Peek();
 		if (!MatchAny({ TokenType::STRING_LITERAL ,TokenType::IDENTIFIER })) {
 			throw ParserException(
-				"Invalid import: '" + token.m_content + "', expected string literal or identifier after 'import'",
+				"Invalid import: '" + std::string(token.m_content) + "', expected string literal or identifier after 'import'",
 				token.m_line,
 				token.m_column
 			);
 		}
 		node->m_isStringLiteral = token.m_type == TokenType::STRING_LITERAL ? true : false;
-		node->m_moduleName = token.m_content;
+		node->m_moduleName = KeepText(token.m_content);
 		node->m_column = token.m_column;
 		node->m_line = token.m_line;
 	}
@@ -126,8 +565,8 @@ ImportNode* Parser::ParseImportStmt(AstNode* parent) {
 }
 
 FunctionDeclNode* Parser::ParseFunctionDecl(AstNode* parent) {
-	FunctionDeclNode* node = new FunctionDeclNode(parent);
-	m_nodes.push_back(node);
+	size_t firstToken = m_current;
+	FunctionDeclNode* node = m_arena.New<FunctionDeclNode>(parent);
 	//function
 	Consume();
 	//type
@@ -137,7 +576,7 @@ FunctionDeclNode* Parser::ParseFunctionDecl(AstNode* parent) {
 		const Token& token = Peek();
 		if (!Check(TokenType::IDENTIFIER)) {
 			throw ParserException(
-				"Invalid function definition: '" + token.m_content + "', expected identifier after return type",
+				"Invalid function definition: '" + std::string(token.m_content) + "', expected identifier after return type",
 				token.m_line,
 				token.m_column
 			);
@@ -148,7 +587,7 @@ FunctionDeclNode* Parser::ParseFunctionDecl(AstNode* parent) {
 	if (!Match(TokenType::LEFT_PAREN)) {
 		const Token& token = Peek();
 		throw ParserException(
-			"Invalid function definition: '" + token.m_content + "', expected '(' after function name",
+			"Invalid function definition: '" + std::string(token.m_content) + "', expected '(' after function name",
 			token.m_line,
 			token.m_column + token.m_content.size()
 		);
@@ -165,16 +604,53 @@ FunctionDeclNode* Parser::ParseFunctionDecl(AstNode* parent) {
 	if (!Match(TokenType::RIGHT_PAREN)) {
 		const Token& token = Peek();
 		throw ParserException(
-			"Invalid function definition: '" + token.m_content + "', expected ')' after parameter list",
+			"Invalid function definition: '" + std::string(token.m_content) + "', expected ')' after parameter list",
 			token.m_line,
 			token.m_column
 		);
 	}
 	//compound_stmt
+	if (m_skipBodies && Check(TokenType::LEFT_BRACE)) {
+		// an unclosed body is left to ParseCompoundStmt, which reports it
+		int begin = m_current, tokensSize = m_tokens->size(), depth = 0;
+		for (; m_current < tokensSize; m_current++) {
+			TokenType::Type type = m_tokens->Type(m_current);
+			depth += type == TokenType::LEFT_BRACE ? 1 : type == TokenType::RIGHT_BRACE ? -1 : 0;
+			if (depth == 0)
+				break;
+		}
+		if (depth == 0) {
+			Consume();
+			node->m_bodyBegin = static_cast<uint32_t>(begin);
+			node->m_bodyEnd = static_cast<uint32_t>(m_current);
+			++m_unparsedBodies;
+			RecordRegion(node, firstToken);
+			return node;
+		}
+		m_current = begin;
+	}
 	node->m_body = ParseCompoundStmt(node);
+	RecordRegion(node, firstToken);
 	return node;
 }
 
+CompoundStmtNode* Parser::ParseBody(FunctionDeclNode& function) {
+	if (function.IsBodyParsed())
+		return function.m_body;
+	int current = m_current;
+	m_current = static_cast<int>(function.m_bodyBegin);
+	try {
+		function.m_body = ParseCompoundStmt(&function);
+	}
+	catch (...) {
+		m_current = current;
+		throw;
+	}
+	m_current = current;
+	--m_unparsedBodies;
+	return function.m_body;
+}
+
 StatementNode* Parser::ParseStatement(AstNode* parent) {
 	const Token& token = Peek();
 	StatementNode* node = nullptr;
@@ -220,36 +696,37 @@ StatementNode* Parser::ParseStatement(AstNode* parent) {
 }
 
 CompoundStmtNode* Parser::ParseCompoundStmt(AstNode* parent) {
-	CompoundStmtNode* node = new CompoundStmtNode(parent);
-	m_nodes.push_back(node);
+	size_t firstToken = m_current;
+	CompoundStmtNode* node = m_arena.New<CompoundStmtNode>(parent);
 	//{
 	if (!Match(TokenType::LEFT_BRACE)) {
 		const Token& token = Peek();
 		throw ParserException(
-			"Invalid compound statement: '" + token.m_content + "', expected '{' at the beginning of compound statement",
+			"Invalid compound statement: '" + std::string(token.m_content) + "', expected '{' at the beginning of compound statement",
 			token.m_line,
 			token.m_column
 		);
 	}
 	//statement
-	while (!Check(TokenType::RIGHT_BRACE)) {
-		node->m_statements.push_back(ParseStatement(node));
+	while (!AtEnd() && !Check(TokenType::RIGHT_BRACE)) {
+		if (StatementNode* statement = Recover([&] { return ParseStatement(node); }))
+			node->m_statements.push_back(statement);
 	}
 	//}
 	if (!Match(TokenType::RIGHT_BRACE)) {
 		const Token& token = Peek();
 		throw ParserException(
-			"Invalid compound statement: '" + token.m_content + "', expected '}' at the end of compound statement",
+			"Invalid compound statement: '" + std::string(token.m_content) + "', expected '}' at the end of compound statement",
 			token.m_line,
 			token.m_column
 		);
 	}
+	RecordRegion(node, firstToken);
 	return node;
 }
 
 ExpressionStmtNode* Parser::ParseExpressionStmt(AstNode* parent) {
-	ExpressionStmtNode* exprNode = new ExpressionStmtNode(parent);
-	m_nodes.push_back(exprNode);
+	ExpressionStmtNode* exprNode = m_arena.New<ExpressionStmtNode>(parent);
 	//expression
 	if (!Check(TokenType::SEMICOLON)) {
 		exprNode->m_expression = ParseCommaExpression(exprNode);
@@ -267,13 +744,12 @@ ExpressionStmtNode* Parser::ParseExpressionStmt(AstNode* parent) {
 }
 
 VariableDeclNode* Parser::ParseVariableDeclaration(AstNode* parent, bool consumeSemicol) {
-	VariableDeclNode* node = new VariableDeclNode(parent);
-	m_nodes.push_back(node);
+	VariableDeclNode* node = m_arena.New<VariableDeclNode>(parent);
 	//let or const
 	const Token& token = Peek();
 	if (!MatchAny({ TokenType::LET ,TokenType::CONST })) {
 		throw ParserException(
-			"Invalid variable declaration: '" + token.m_content + "', expected 'let' or 'const' at the beginning of variable declaration",
+			"Invalid variable declaration: '" + std::string(token.m_content) + "', expected 'let' or 'const' at the beginning of variable declaration",
 			token.m_line,
 			token.m_column
 		);
@@ -304,8 +780,7 @@ VariableDeclNode* Parser::ParseVariableDeclaration(AstNode* parent, bool consume
 }
 
 StructDeclNode* Parser::ParseStructDeclaration(AstNode* parent) {
-	StructDeclNode* node = new StructDeclNode(parent);
-	m_nodes.push_back(node);
+	StructDeclNode* node = m_arena.New<StructDeclNode>(parent);
 	//struct
 	Consume();
 	//indentifier
@@ -313,7 +788,7 @@ StructDeclNode* Parser::ParseStructDeclaration(AstNode* parent) {
 		const Token& token = Peek();
 		if (!Check(TokenType::IDENTIFIER)) {
 			throw ParserException(
-				"Invalid struct definition: '" + token.m_content + "', expected identifier after 'struct'",
+				"Invalid struct definition: '" + std::string(token.m_content) + "', expected identifier after 'struct'",
 				token.m_line,
 				token.m_column
 			);
@@ -324,7 +799,7 @@ StructDeclNode* Parser::ParseStructDeclaration(AstNode* parent) {
 	if (!Match(TokenType::LEFT_BRACE)) {
 		const Token& token = Peek();
 		throw ParserException(
-			"Invalid struct definition: '" + token.m_content + "', expected '{' after struct name",
+			"Invalid struct definition: '" + std::string(token.m_content) + "', expected '{' after struct name",
 			token.m_line,
 			token.m_column + token.m_content.size()
 		);
@@ -338,7 +813,7 @@ StructDeclNode* Parser::ParseStructDeclaration(AstNode* parent) {
 	if (!Match(TokenType::RIGHT_BRACE)) {
 		const Token& token = Peek();
 		throw ParserException(
-			"Invalid struct definition: '" + token.m_content + "', expected '}' at the end of struct definition",
+			"Invalid struct definition: '" + std::string(token.m_content) + "', expected '}' at the end of struct definition",
 			token.m_line,
 			token.m_column
 		);
@@ -356,8 +831,7 @@ StructDeclNode* Parser::ParseStructDeclaration(AstNode* parent) {
 }
 
 IfStmtNode* Parser::ParseIfStmt(AstNode* parent) {
-	IfStmtNode* node = new IfStmtNode(parent);
-	m_nodes.push_back(node);
+	IfStmtNode* node = m_arena.New<IfStmtNode>(parent);
 	//if
 	Consume();
 	// "("
@@ -390,8 +864,7 @@ IfStmtNode* Parser::ParseIfStmt(AstNode* parent) {
 }
 
 SwitchStmtNode* Parser::ParseSwitchStmt(AstNode* parent) {
-	SwitchStmtNode* node = new SwitchStmtNode(parent);
-	m_nodes.push_back(node);
+	SwitchStmtNode* node = m_arena.New<SwitchStmtNode>(parent);
 	//switch
 	Consume();
 	// (
@@ -444,8 +917,7 @@ SwitchStmtNode* Parser::ParseSwitchStmt(AstNode* parent) {
 }
 
 CaseNode* Parser::ParseCaseClause(AstNode* parent) {
-	CaseNode* node = new CaseNode(parent);
-	m_nodes.push_back(node);
+	CaseNode* node = m_arena.New<CaseNode>(parent);
 	//case
 	Consume();
 	//literal
@@ -454,7 +926,7 @@ CaseNode* Parser::ParseCaseClause(AstNode* parent) {
 	if (!Match(TokenType::COLON)) {
 		const Token& token = Peek();
 		throw ParserException(
-			"Invalid case clause: '" + token.m_content + "', expected ':' after case literal",
+			"Invalid case clause: '" + std::string(token.m_content) + "', expected ':' after case literal",
 			token.m_line,
 			token.m_column
 		);
@@ -470,34 +942,28 @@ CaseNode* Parser::ParseCaseClause(AstNode* parent) {
 }
 
 DefaultNode* Parser::ParseDefaultClause(AstNode* parent) {
-	DefaultNode* node = new DefaultNode(parent);
-	m_nodes.push_back(node);
+	DefaultNode* node = m_arena.New<DefaultNode>(parent);
 	//default
 	Consume();
 	//:
 	if (!Match(TokenType::COLON)) {
 		const Token& token = Peek();
 		throw ParserException(
-			"Invalid case clause: '" + token.m_content + "', expected ':' after case literal",
+			"Invalid case clause: '" + std::string(token.m_content) + "', expected ':' after case literal",
 			token.m_line,
 			token.m_column
 		);
 	}
 	//statement
 	{
-		const Token* pToken = &Peek();
-		while (pToken->m_type != TokenType::RIGHT_BRACE)
-		{
+		while (PeekType() != TokenType::RIGHT_BRACE)
 			node->m_statements.push_back(ParseStatement(node));
-			pToken = &Peek();
-		}
 	}
 	return node;
 }
 
 WhileStmtNode* Parser::ParseWhileStmt(AstNode* parent) {
-	WhileStmtNode* node = new WhileStmtNode(parent);
-	m_nodes.push_back(node);
+	WhileStmtNode* node = m_arena.New<WhileStmtNode>(parent);
 	//while
 	Consume();
 	// (
@@ -526,8 +992,7 @@ WhileStmtNode* Parser::ParseWhileStmt(AstNode* parent) {
 }
 
 ForStmtNode* Parser::ParseForStmt(AstNode* parent) {
-	ForStmtNode* node = new ForStmtNode(parent);
-	m_nodes.push_back(node);
+	ForStmtNode* node = m_arena.New<ForStmtNode>(parent);
 	//for
 	Consume();
 	//(
@@ -588,9 +1053,10 @@ ForStmtNode* Parser::ParseForStmt(AstNode* parent) {
 }
 
 ReturnStmtNode* Parser::ParseReturnStmt(AstNode* parent) {
-	ReturnStmtNode* node = new ReturnStmtNode(parent);
-	m_nodes.push_back(node);
+	ReturnStmtNode* node = m_arena.New<ReturnStmtNode>(parent);
 	//return
+	node->m_column = Peek().m_column;
+	node->m_line = Peek().m_line;
 	Consume();
 	//expression
 	if (!Check(TokenType::SEMICOLON)) {
@@ -609,9 +1075,10 @@ ReturnStmtNode* Parser::ParseReturnStmt(AstNode* parent) {
 }
 
 BreakStmtNode* Parser::ParseBreakStmt(AstNode* parent) {
-	BreakStmtNode* node = new BreakStmtNode(parent);
-	m_nodes.push_back(node);
+	BreakStmtNode* node = m_arena.New<BreakStmtNode>(parent);
 	//break
+	node->m_column = Peek().m_column;
+	node->m_line = Peek().m_line;
 	Consume();
 	//;
 	if (!Match(TokenType::SEMICOLON)) {
@@ -626,9 +1093,10 @@ BreakStmtNode* Parser::ParseBreakStmt(AstNode* parent) {
 }
 
 ContinueStmtNode* Parser::ParseContinueStmt(AstNode* parent) {
-	ContinueStmtNode* node = new ContinueStmtNode(parent);
-	m_nodes.push_back(node);
+	ContinueStmtNode* node = m_arena.New<ContinueStmtNode>(parent);
 	//continue
+	node->m_column = Peek().m_column;
+	node->m_line = Peek().m_line;
 	Consume();
 	//;
 	if (!Match(TokenType::SEMICOLON)) {
@@ -648,8 +1116,7 @@ ExpressionNode* Parser::ParseCommaExpression(AstNode* parent) {
 	if (!Check(TokenType::COMMA))
 		return first;
 	//list parent
-	CommaExprNode* node = new CommaExprNode(parent);
-	m_nodes.push_back(node);
+	CommaExprNode* node = m_arena.New<CommaExprNode>(parent);
 	node->m_expressions.push_back(first);
 	first->m_parent = node;
 	//splitToken element
@@ -665,11 +1132,10 @@ ExpressionNode* Parser::ParseAssignment(AstNode* parent) {
 	if (CheckAny({ TokenType::ASSIGN,TokenType::SELF_ADD,TokenType::SELF_SUB,
 			TokenType::SELF_MUL ,TokenType::SELF_DIV,TokenType::SELF_MODULO }))
 	{
-		AssignmentExprNode* node = new AssignmentExprNode(parent);
-		m_nodes.push_back(node);
+		AssignmentExprNode* node = m_arena.New<AssignmentExprNode>(parent);
 		//=, +=, -=, *=, /=, %=
 		const Token& token = Peek();
-		node->m_op = token.m_content;
+		node->m_op = OpCode::FromToken(token.m_type);
 		node->m_column = token.m_column;
 		node->m_line = token.m_line;
 		Consume();
@@ -685,11 +1151,10 @@ ExpressionNode* Parser::ParseAssignment(AstNode* parent) {
 
 ExpressionNode* Parser::ParseConditional(AstNode* parent) {
 	//logical_or
-	ExpressionNode* condition = ParseLogicalOr(parent);
+	ExpressionNode* condition = ParseBinary(parent, 1);
 	//? expression : conditional
 	if (Check(TokenType::QUESTION)) {
-		ConditionalExprNode* node = new ConditionalExprNode(parent);
-		m_nodes.push_back(node);
+		ConditionalExprNode* node = m_arena.New<ConditionalExprNode>(parent);
 		//?
 		Consume();
 		//condition
@@ -701,7 +1166,7 @@ ExpressionNode* Parser::ParseConditional(AstNode* parent) {
 		if (!Match(TokenType::COLON)) {
 			const Token& token = Peek();
 			throw ParserException(
-				"Invalid conditional expression: '" + token.m_content + "', expected ':' after true expression",
+				"Invalid conditional expression: '" + std::string(token.m_content) + "', expected ':' after true expression",
 				token.m_line,
 				token.m_column
 			);
@@ -713,21 +1178,46 @@ ExpressionNode* Parser::ParseConditional(AstNode* parent) {
 	return condition;
 }
 
-ExpressionNode* Parser::ParseBinary(AstNode* parent, std::function<ExpressionNode* (AstNode*)> lower, const std::vector<TokenType::Type>& ops)
+namespace {
+	// Binding power of each binary operator, 0 for tokens that do not continue a binary expression.
+	// Higher binds tighter, every level is left associative.
+	constexpr std::array<uint8_t, 256> MakeBindingPowers() {
+		std::array<uint8_t, 256> powers{};
+		powers[TokenType::OR] = 1;
+		powers[TokenType::AND] = 2;
+		powers[TokenType::BIT_OR] = 3;
+		powers[TokenType::XOR] = 4;
+		powers[TokenType::BIT_AND] = 5;
+		powers[TokenType::EQUAL] = powers[TokenType::NOT_EQUAL] = 6;
+		powers[TokenType::LESS] = powers[TokenType::GREATER] = 7;
+		powers[TokenType::LESS_EQUAL] = powers[TokenType::GREATER_EQUAL] = 7;
+		powers[TokenType::LEFT_MOVE] = powers[TokenType::RIGHT_MOVE] = 8;
+		powers[TokenType::ADD] = powers[TokenType::SUBTRACT] = 9;
+		powers[TokenType::MULTIPLY] = powers[TokenType::DIVIDE] = powers[TokenType::MODULO] = 10;
+		return powers;
+	}
+
+	constexpr std::array<uint8_t, 256> BindingPowers = MakeBindingPowers();
+}
+
+// logical_or through multiplicative by precedence climbing: operands are unary expressions and
+// operators binding tighter than minPower are left to the caller
+ExpressionNode* Parser::ParseBinary(AstNode* parent, uint8_t minPower)
 {
-	ExpressionNode* left = lower(parent);
+	ExpressionNode* left = ParseUnary(parent);
 
-	while (CheckAny(ops))
-	{
+	while (!AtEnd()) {
+		uint8_t power = BindingPowers[m_tokens->Type(m_current)];
+		if (power == 0 || power < minPower)
+			break;
 		Token op = Peek();
 		Consume();
-		ExpressionNode* right = lower(parent);
+		ExpressionNode* right = ParseBinary(parent, power + 1);
 
-		BinaryExprNode* node = new BinaryExprNode(parent);
-		m_nodes.push_back(node);
+		BinaryExprNode* node = m_arena.New<BinaryExprNode>(parent);
 		node->m_left = left;
 		left->m_parent = node;
-		node->m_op = op.m_content;
+		node->m_op = OpCode::FromToken(op.m_type);
 		node->m_column = op.m_column;
 		node->m_line = op.m_line;
 		node->m_right = right;
@@ -737,50 +1227,6 @@ ExpressionNode* Parser::ParseBinary(AstNode* parent, std::function<ExpressionNod
 	return left;
 }
 
-ExpressionNode* Parser::ParseLogicalOr(AstNode* parent) {
-	return ParseBinary(parent, std::bind(&Parser::ParseLogicalAnd, this, std::placeholders::_1), { TokenType::OR });
-}
-
-ExpressionNode* Parser::ParseLogicalAnd(AstNode* parent) {
-	return ParseBinary(parent, std::bind(&Parser::ParseBitOr, this, std::placeholders::_1), { TokenType::AND });
-}
-
-ExpressionNode* Parser::ParseBitOr(AstNode* parent) {
-	return ParseBinary(parent, std::bind(&Parser::ParseBitXOr, this, std::placeholders::_1), { TokenType::BIT_OR });
-}
-
-ExpressionNode* Parser::ParseBitXOr(AstNode* parent) {
-	return ParseBinary(parent, std::bind(&Parser::ParseBitAnd, this, std::placeholders::_1), { TokenType::XOR });
-}
-
-ExpressionNode* Parser::ParseBitAnd(AstNode* parent) {
-	return ParseBinary(parent, std::bind(&Parser::ParseEquality, this, std::placeholders::_1), { TokenType::BIT_AND });
-}
-
-ExpressionNode* Parser::ParseEquality(AstNode* parent) {
-	return ParseBinary(parent, std::bind(&Parser::ParseRelational, this, std::placeholders::_1), { TokenType::EQUAL, TokenType::NOT_EQUAL });
-}
-
-ExpressionNode* Parser::ParseRelational(AstNode* parent) {
-	return ParseBinary(parent, std::bind(&Parser::ParseShift, this, std::placeholders::_1),
-		{ TokenType::LESS, TokenType::GREATER, TokenType::LESS_EQUAL, TokenType::GREATER_EQUAL });
-}
-
-ExpressionNode* Parser::ParseShift(AstNode* parent) {
-	return ParseBinary(parent, std::bind(&Parser::ParseAdditive, this, std::placeholders::_1),
-		{ TokenType::LEFT_MOVE, TokenType::RIGHT_MOVE });
-}
-
-ExpressionNode* Parser::ParseAdditive(AstNode* parent) {
-	return ParseBinary(parent, std::bind(&Parser::ParseMultiplicative, this, std::placeholders::_1),
-		{ TokenType::ADD, TokenType::SUBTRACT });
-}
-
-ExpressionNode* Parser::ParseMultiplicative(AstNode* parent) {
-	return ParseBinary(parent, std::bind(&Parser::ParseUnary, this, std::placeholders::_1),
-		{ TokenType::MULTIPLY, TokenType::DIVIDE, TokenType::MODULO });
-}
-
 ExpressionNode* Parser::ParseUnary(AstNode* parent) {
 	std::vector<Token> ops;
 	while (CheckAny({ TokenType::ADD ,TokenType::SUBTRACT,TokenType::NOT,
@@ -792,9 +1238,8 @@ ExpressionNode* Parser::ParseUnary(AstNode* parent) {
 	//right associative
 	ExpressionNode* node = ParsePostfix(parent);
 	for (auto it = ops.rbegin(); it != ops.rend(); ++it) {
-		UnaryExprNode* unary = new UnaryExprNode(parent);
-		m_nodes.push_back(unary);
-		unary->m_op = it->m_content;
+		UnaryExprNode* unary = m_arena.New<UnaryExprNode>(parent);
+		unary->m_op = OpCode::FromUnaryToken(it->m_type);
 		unary->m_column = it->m_column;
 		unary->m_line = it->m_line;
 		unary->m_operand = node;
@@ -816,9 +1261,8 @@ ExpressionNode* Parser::ParsePostfix(AstNode* parent) {
 
 		if (MatchAny({ TokenType::INCREMENT ,TokenType::DECREMENT })) {
 			//++ --
-			PostfixExprNode* postfix = new PostfixExprNode(parent);
-			m_nodes.push_back(postfix);
-			postfix->m_op = token.m_content;
+			PostfixExprNode* postfix = m_arena.New<PostfixExprNode>(parent);
+			postfix->m_op = OpCode::FromPostfixToken(token.m_type);
 			postfix->m_column = token.m_column;
 			postfix->m_line = token.m_line;
 			postfix->m_primary = current;
@@ -828,8 +1272,7 @@ ExpressionNode* Parser::ParsePostfix(AstNode* parent) {
 		}
 		else if (Match(TokenType::DOT)) {
 			// . identifier
-			MemberAccessNode* member = new MemberAccessNode(parent);
-			m_nodes.push_back(member);
+			MemberAccessNode* member = m_arena.New<MemberAccessNode>(parent);
 			member->m_object = current;
 			current->m_parent = member;
 			// identifier
@@ -847,8 +1290,7 @@ ExpressionNode* Parser::ParsePostfix(AstNode* parent) {
 		}
 		else if (Match(TokenType::LEFT_SQUARE)) {
 			//[ expression ]
-			ArrayIndexNode* index = new ArrayIndexNode(parent);
-			m_nodes.push_back(index);
+			ArrayIndexNode* index = m_arena.New<ArrayIndexNode>(parent);
 			index->m_array = current;
 			current->m_parent = index;
 			// expression
@@ -857,7 +1299,7 @@ ExpressionNode* Parser::ParsePostfix(AstNode* parent) {
 			if (!Match(TokenType::RIGHT_SQUARE)) {
 				const Token& rbracketToken = Peek();
 				throw ParserException(
-					"Invalid index expression: '" + rbracketToken.m_content + "', expected ']' after index expression",
+					"Invalid index expression: '" + std::string(rbracketToken.m_content) + "', expected ']' after index expression",
 					rbracketToken.m_line,
 					rbracketToken.m_column
 				);
@@ -867,8 +1309,7 @@ ExpressionNode* Parser::ParsePostfix(AstNode* parent) {
 		}
 		else if (Match(TokenType::LEFT_PAREN)) {
 			// ( [ argument_list ] )
-			FunctionCallNode* call = new FunctionCallNode(parent);
-			m_nodes.push_back(call);
+			FunctionCallNode* call = m_arena.New<FunctionCallNode>(parent);
 			call->m_callee = current;
 			current->m_parent = call;
 			// argument_list
@@ -902,8 +1343,7 @@ ExpressionNode* Parser::ParsePrimary(AstNode* parent) {
 	switch (token.m_type) {
 	case TokenType::IDENTIFIER: {
 		// identifier
-		node = new IdentifierNode(token, parent);
-		m_nodes.push_back(node);
+		node = m_arena.New<IdentifierNode>(token, parent);
 		Consume();
 		break;
 	}
@@ -941,7 +1381,7 @@ ExpressionNode* Parser::ParsePrimary(AstNode* parent) {
 	}
 	default: {
 		throw ParserException(
-			"Invalid primary expression: '" + token.m_content +
+			"Invalid primary expression: '" + std::string(token.m_content) +
 			"', expected identifier, literal, or '('",
 			token.m_line,
 			token.m_column
@@ -953,13 +1393,12 @@ ExpressionNode* Parser::ParsePrimary(AstNode* parent) {
 }
 
 FunctionLiteralNode* Parser::ParseFunctionLiteral(AstNode* parent) {
-	FunctionLiteralNode* node = new FunctionLiteralNode(parent);
-	m_nodes.push_back(node);
+	FunctionLiteralNode* node = m_arena.New<FunctionLiteralNode>(parent);
 	//lambda
 	if (!Match(TokenType::LAMBDA)) {
 		const Token& token = Peek();
 		throw ParserException(
-			"Invalid function literal: '" + token.m_content + "', expected 'lambda' at the beginning of function literal",
+			"Invalid function literal: '" + std::string(token.m_content) + "', expected 'lambda' at the beginning of function literal",
 			token.m_line,
 			token.m_column
 		);
@@ -968,7 +1407,7 @@ FunctionLiteralNode* Parser::ParseFunctionLiteral(AstNode* parent) {
 	if (!Match(TokenType::LEFT_PAREN)) {
 		const Token& token = Peek();
 		throw ParserException(
-			"Invalid function literal: '" + token.m_content + "', expected '(' after 'lambda'",
+			"Invalid function literal: '" + std::string(token.m_content) + "', expected '(' after 'lambda'",
 			token.m_line,
 			token.m_column
 		);
@@ -985,7 +1424,7 @@ FunctionLiteralNode* Parser::ParseFunctionLiteral(AstNode* parent) {
 	if (!Match(TokenType::RIGHT_PAREN)) {
 		const Token& token = Peek();
 		throw ParserException(
-			"Invalid function literal: '" + token.m_content + "', expected ')' after parameter list",
+			"Invalid function literal: '" + std::string(token.m_content) + "', expected ')' after parameter list",
 			token.m_line,
 			token.m_column
 		);
@@ -994,7 +1433,7 @@ FunctionLiteralNode* Parser::ParseFunctionLiteral(AstNode* parent) {
 	if (!Match(TokenType::POINT_TO)) {
 		const Token& token = Peek();
 		throw ParserException(
-			"Invalid function literal: '" + token.m_content + "', expected '->' after parameter list",
+			"Invalid function literal: '" + std::string(token.m_content) + "', expected '->' after parameter list",
 			token.m_line,
 			token.m_column
 		);
@@ -1015,8 +1454,7 @@ IdentifierNode* Parser::ParseIdentifier(AstNode* parent) {
 			token.m_column
 		);
 	}
-	IdentifierNode* node = new IdentifierNode(token, parent);
-	m_nodes.push_back(node);
+	IdentifierNode* node = m_arena.New<IdentifierNode>(token, parent);
 	return node;
 }
 
@@ -1025,19 +1463,21 @@ LiteralNode* Parser::ParseLiteral(AstNode* parent) {
 	if (!MatchAny({ TokenType::INT_LITERAL,TokenType::DOUBLE_LITERAL, TokenType::CHARACTER_LITERAL,
 	TokenType::STRING_LITERAL,TokenType::BOOL_LITERAL,TokenType::NULL_LITERAL })) {
 		throw ParserException(
-			"Invalid literal: '" + token.m_content + "', expected literal but got identifier",
+			"Invalid literal: '" + std::string(token.m_content) + "', expected literal but got identifier",
 			token.m_line,
 			token.m_column
 		);
 	}
-	LiteralNode* node = new LiteralNode(token, parent);
-	m_nodes.push_back(node);
+	LiteralNode* node = m_arena.New<LiteralNode>(token, parent);
+	node->m_value = KeepText(node->m_value);
+	// the lexer's string is the spelling without its quotes, so it can view the kept copy
+	if (node->m_literalType == TokenType::STRING_LITERAL && node->m_value.size() >= 2)
+		node->m_literal.m_string = node->m_value.substr(1, node->m_value.size() - 2);
 	return node;
 }
 
 ParameterNode* Parser::ParseParameter(AstNode* parent) {
-	ParameterNode* node = new ParameterNode(parent);
-	m_nodes.push_back(node);
+	ParameterNode* node = m_arena.New<ParameterNode>(parent);
 	//type
 	node->m_type = ParseType(node);
 	//declarator
@@ -1047,8 +1487,7 @@ ParameterNode* Parser::ParseParameter(AstNode* parent) {
 
 DeclaratorNode* Parser::ParseDeclarator(AstNode* parent) {
 	// identifier
-	DeclaratorNode* declarator = new DeclaratorNode(parent);
-	m_nodes.push_back(declarator);
+	DeclaratorNode* declarator = m_arena.New<DeclaratorNode>(parent);
 	const Token& token = Peek();
 	if (!Check(TokenType::IDENTIFIER)) {
 		throw ParserException(
@@ -1065,7 +1504,7 @@ DeclaratorNode* Parser::ParseDeclarator(AstNode* parent) {
 		if (!Match(TokenType::RIGHT_SQUARE)) {
 			const Token& t = Peek();
 			throw ParserException(
-				"Invalid array declarator: expected ']' after '" + t.m_content + "'",
+				"Invalid array declarator: expected ']' after '" + std::string(t.m_content) + "'",
 				t.m_line,
 				t.m_column
 			);
@@ -1079,8 +1518,7 @@ DeclaratorNode* Parser::ParseDeclarator(AstNode* parent) {
 }
 
 StructMemberNode* Parser::ParseStructMemberDeclaration(AstNode* parent) {
-	StructMemberNode* node = new StructMemberNode(parent);
-	m_nodes.push_back(node);
+	StructMemberNode* node = m_arena.New<StructMemberNode>(parent);
 	//type
 	node->m_type = ParseType(node);
 	//declarator_list
@@ -1108,8 +1546,7 @@ ExpressionNode* Parser::ParseInitializer(AstNode* parent) {
 		return ParseAssignment(parent);
 	}
 
-	InitializerNode* node = new InitializerNode(parent);
-	m_nodes.push_back(node);
+	InitializerNode* node = m_arena.New<InitializerNode>(parent);
 	//{
 	Match(TokenType::LEFT_BRACE);
 	//{}
@@ -1135,14 +1572,24 @@ ExpressionNode* Parser::ParseInitializer(AstNode* parent) {
 	return node;
 }
 
+std::string_view Parser::BuiltinTypeName(TokenType::Type type) {
+	switch (type) {
+	case TokenType::INT: return "int";
+	case TokenType::DOUBLE: return "double";
+	case TokenType::CHAR: return "char";
+	case TokenType::STRING: return "string";
+	case TokenType::BOOL: return "bool";
+	default: return "void";
+	}
+}
+
 TypeNode* Parser::ParseType(AstNode* parent) {
 	TypeNode* node = nullptr;
 	const Token& token = Peek();
 	switch (token.m_type) {
 	case TokenType::IDENTIFIER:
 		// user-defined type
-		node = new NamedTypeNode(token, parent);
-		m_nodes.push_back(node);
+		node = m_arena.New<NamedTypeNode>(token, parent);
 		Consume();
 		break;
 	case TokenType::INT:
@@ -1152,8 +1599,8 @@ TypeNode* Parser::ParseType(AstNode* parent) {
 	case TokenType::BOOL:
 	case TokenType::VOID:
 		// bultin type
-		node = new BuiltinTypeNode(token, parent);
-		m_nodes.push_back(node);
+		node = m_arena.New<BuiltinTypeNode>(token, parent);
+		static_cast<BuiltinTypeNode*>(node)->m_name = BuiltinTypeName(token.m_type);
 		Consume();
 		break;
 	case TokenType::LEFT_PAREN:
@@ -1162,7 +1609,7 @@ TypeNode* Parser::ParseType(AstNode* parent) {
 		break;
 	default:
 		throw ParserException(
-			"Invalid type: '" + token.m_content + "', expected type name, builtin type, or '(' for function type",
+			"Invalid type: '" + std::string(token.m_content) + "', expected type name, builtin type, or '(' for function type",
 			token.m_line,
 			token.m_column
 		);
@@ -1171,13 +1618,12 @@ TypeNode* Parser::ParseType(AstNode* parent) {
 }
 
 TypeNode* Parser::ParseFunctionType(AstNode* parent) {
-	FunctionTypeNode* node = new FunctionTypeNode(parent);
-	m_nodes.push_back(node);
+	FunctionTypeNode* node = m_arena.New<FunctionTypeNode>(parent);
 	//(
 	if (!Match(TokenType::LEFT_PAREN)) {
 		const Token& token = Peek();
 		throw ParserException(
-			"Invalid function type: '" + token.m_content + "', expected '(' at the beginning of function type",
+			"Invalid function type: '" + std::string(token.m_content) + "', expected '(' at the beginning of function type",
 			token.m_line,
 			token.m_column
 		);
@@ -1193,7 +1639,7 @@ TypeNode* Parser::ParseFunctionType(AstNode* parent) {
 	if (!Match(TokenType::RIGHT_PAREN)) {
 		const Token& token = Peek();
 		throw ParserException(
-			"Invalid function type: '" + token.m_content + "', expected ')' after parameter type list",
+			"Invalid function type: '" + std::string(token.m_content) + "', expected ')' after parameter type list",
 			token.m_line,
 			token.m_column
 		);
@@ -1202,7 +1648,7 @@ TypeNode* Parser::ParseFunctionType(AstNode* parent) {
 	if (!Match(TokenType::POINT_TO)) {
 		const Token& token = Peek();
 		throw ParserException(
-			"Invalid function type: '" + token.m_content + "', expected '->' after parameter type list",
+			"Invalid function type: '" + std::string(token.m_content) + "', expected '->' after parameter type list",
 			token.m_line,
 			token.m_column
 		);
@@ -1229,7 +1675,7 @@ void AstPrinter::Visit(ImportNode& node) {
 
 void AstPrinter::Visit(FunctionDeclNode& node) {
 	PrintIndent(m_depth);
-	std::cout << "FunctionDecl: " << node.m_name->m_name << "\n";
+	std::cout << "FunctionDecl: " << node.m_name->GetName() << "\n";
 	++m_depth;
 	if (node.m_returnType) node.m_returnType->Accept(*this);
 	for (auto* param : node.m_params)
@@ -1272,7 +1718,7 @@ void AstPrinter::Visit(VariableDeclNode& node) {
 
 void AstPrinter::Visit(StructDeclNode& node) {
 	PrintIndent(m_depth);
-	std::cout << "StructDecl: " << node.m_name->m_name << "\n";
+	std::cout << "StructDecl: " << node.m_name->GetName() << "\n";
 	++m_depth;
 	for (auto* member : node.m_members)
 		if (member) member->Accept(*this);
@@ -1391,7 +1837,7 @@ void AstPrinter::Visit(CommaExprNode& node) {
 
 void AstPrinter::Visit(AssignmentExprNode& node) {
 	PrintIndent(m_depth);
-	std::cout << "AssignmentExpr: " << node.m_op << "\n";
+	std::cout << "AssignmentExpr: " << OpCode::GetName(node.m_op) << "\n";
 	++m_depth;
 	if (node.m_left)
 		node.m_left->Accept(*this);
@@ -1415,7 +1861,7 @@ void AstPrinter::Visit(ConditionalExprNode& node) {
 
 void AstPrinter::Visit(BinaryExprNode& node) {
 	PrintIndent(m_depth);
-	std::cout << "BinaryExpr: " << node.m_op << "\n";
+	std::cout << "BinaryExpr: " << OpCode::GetName(node.m_op) << "\n";
 	++m_depth;
 	if (node.m_left)
 		node.m_left->Accept(*this);
@@ -1426,7 +1872,7 @@ void AstPrinter::Visit(BinaryExprNode& node) {
 
 void AstPrinter::Visit(UnaryExprNode& node) {
 	PrintIndent(m_depth);
-	std::cout << "UnaryExpr: " << node.m_op << "\n";
+	std::cout << "UnaryExpr: " << OpCode::GetName(node.m_op) << "\n";
 	++m_depth;
 	if (node.m_operand)
 		node.m_operand->Accept(*this);
@@ -1435,7 +1881,7 @@ void AstPrinter::Visit(UnaryExprNode& node) {
 
 void AstPrinter::Visit(PostfixExprNode& node) {
 	PrintIndent(m_depth);
-	std::cout << "PostfixExpr: " << node.m_op << "\n";
+	std::cout << "PostfixExpr: " << OpCode::GetName(node.m_op) << "\n";
 	++m_depth;
 	if (node.m_primary)
 		node.m_primary->Accept(*this);
@@ -1471,7 +1917,7 @@ void AstPrinter::Visit(MemberAccessNode& node) {
 	if (node.m_object)
 		node.m_object->Accept(*this);
 	PrintIndent(m_depth);
-	std::cout << "MemberName: " << node.m_memberName->m_name << "\n";
+	std::cout << "MemberName: " << node.m_memberName->GetName() << "\n";
 	--m_depth;
 }
 
@@ -1490,7 +1936,7 @@ void AstPrinter::Visit(FunctionLiteralNode& node) {
 
 void AstPrinter::Visit(IdentifierNode& node) {
 	PrintIndent(m_depth);
-	std::cout << "Identifier: " << node.m_name << "\n";
+	std::cout << "Identifier: " << node.GetName() << "\n";
 }
 
 void AstPrinter::Visit(LiteralNode& node) {
@@ -1511,7 +1957,7 @@ void AstPrinter::Visit(ParameterNode& node) {
 
 void AstPrinter::Visit(DeclaratorNode& node) {
 	PrintIndent(m_depth);
-	std::cout << "Declarator: " << node.m_name->m_name << "\n";
+	std::cout << "Declarator: " << node.m_name->GetName() << "\n";
 	++m_depth;
 	for (auto* sizeExpr : node.m_arraySizes)
 		if (sizeExpr) sizeExpr->Accept(*this);
@@ -1547,7 +1993,7 @@ void AstPrinter::Visit(BuiltinTypeNode& node) {
 
 void AstPrinter::Visit(NamedTypeNode& node) {
 	PrintIndent(m_depth);
-	std::cout << "NamedType: " << node.m_name << "\n";
+	std::cout << "NamedType: " << node.GetName() << "\n";
 }
 
 void AstPrinter::Visit(FunctionTypeNode& node) {
@@ -1,439 +1,1320 @@
-//#include "SemanticAnalyzer.h"
-//#include "assert.h"
-//
-//namespace CppInterp {
-//
-//	TypeInfo::TypeInfo() : m_kind(UNKNOWN) {}
-//
-//	TypeInfo::TypeInfo(Kind k, const std::string& n) : m_kind(k), m_name(n) {}
-//
-//	bool TypeInfo::IsSame(const TypeInfo& other) const {
-//		if (m_kind != other.m_kind) return false;
-//		switch (m_kind) {
-//		case BUILTIN:
-//		case STRUCT:
-//			return m_name == other.m_name;
-//		case ARRAY:
-//			return m_elementType->IsSame(*other.m_elementType);
-//		case FUNCTION:
-//			if (m_paramTypes.size() != other.m_paramTypes.size()) return false;
-//			for (size_t i = 0; i < m_paramTypes.size(); i++)
-//				if (!m_paramTypes[i]->IsSame(*other.m_paramTypes[i])) return false;
-//			return m_returnType->IsSame(*other.m_returnType);
-//		default: return false;
-//		}
-//	}
-//
-//	TypeRegistry::TypeRegistry() {
-//		InitBuiltins();
-//	}
-//
-//	std::optional<TypeInfo*> TypeRegistry::Find(const std::string& name) const {
-//		if (auto it = m_builtinTypes.find(name); it != m_builtinTypes.end())
-//			return { it->second };
-//		if (auto it = m_structTypes.find(name); it != m_structTypes.end())
-//			return { it->second };
-//		return std::nullopt;
-//	}
-//
-//	TypeInfo* TypeRegistry::RegisterStruct(const std::string& name) {
-//		if (auto it = m_structTypes.find(name); it != m_structTypes.end())
-//			return it->second;
-//		auto* t = new TypeInfo{ TypeInfo::STRUCT, name };
-//		m_structTypes[name] = t;
-//		return t;
-//	}
-//
-//	TypeInfo* TypeRegistry::GetOrCreateArray(TypeInfo* elem) {
-//		std::string key = elem->m_name + "[]";
-//		if (auto it = m_arrayTypes.find(key); it != m_arrayTypes.end())
-//			return it->second;
-//		auto* t = new TypeInfo{ TypeInfo::ARRAY, key };
-//		t->m_elementType = elem;
-//		m_arrayTypes[key] = t;
-//		return t;
-//	}
-//
-//	TypeInfo* TypeRegistry::GetOrCreateFunction(const std::vector<TypeInfo*>& params, TypeInfo* ret) {
-//		std::string key = ret->m_name + "(";
-//		for (auto* p : params) key += p->m_name + ",";
-//		key += ")";
-//		if (auto it = m_functionTypes.find(key); it != m_functionTypes.end())
-//			return it->second;
-//		auto* t = new TypeInfo{ TypeInfo::FUNCTION, key };
-//		t->m_returnType = ret;
-//		t->m_paramTypes = params;
-//		m_functionTypes[key] = t;
-//		return t;
-//	}
-//
-//	void TypeRegistry::InitBuiltins() {
-//		m_builtinTypes.emplace("int", new TypeInfo{ TypeInfo::BUILTIN,"int" });
-//		m_builtinTypes.emplace("double", new TypeInfo{ TypeInfo::BUILTIN,"double" });
-//		m_builtinTypes.emplace("char", new TypeInfo{ TypeInfo::BUILTIN,"char" });
-//		m_builtinTypes.emplace("string", new TypeInfo{ TypeInfo::BUILTIN,"string" });
-//		m_builtinTypes.emplace("bool", new TypeInfo{ TypeInfo::BUILTIN,"bool" });
-//		m_builtinTypes.emplace("void", new TypeInfo{ TypeInfo::BUILTIN,"void" });
-//	}
-//
-//	TypeRegistry::~TypeRegistry() {
-//		for (auto& pair : m_builtinTypes)
-//			delete pair.second;
-//		for (auto& pair : m_structTypes)
-//			delete pair.second;
-//		for (auto& pair : m_arrayTypes)
-//			delete pair.second;
-//		for (auto& pair : m_functionTypes)
-//			delete pair.second;
-//	}
-//
-//	void AstConverter::ClearNodes() {
-//		for (auto node : m_nodes)
-//			delete node;
-//		m_root = nullptr;
-//	}
-//
-//	AstConverter::~AstConverter() {
-//		ClearNodes();
-//	}
-//
-//	AstNode* AstConverter::ConvertToSemanticAst(AstNode* root) {
-//		if (!root)
-//			return nullptr;
-//		ClearNodes();
-//		m_root = ConvertNode(root);
-//		return m_root;
-//	}
-//
-//	AstNode* AstConverter::ConvertNode(AstNode* node) {
-//		switch (node->m_type) {
-//		case NodeType::PROGRAM:
-//			return ConvertProgram(node);
-//		case NodeType::IMPORT_STMT:
-//			return ConvertImportStmt(node);
-//		case NodeType::FUNCTION_DECL:
-//			return ConvertFunctionDecl(node);
-//		case NodeType::PARAMETER:
-//			return ConvertParameter(node);
-//		case NodeType::COMPOUND_STMT:
-//			return ConvertCompoundStmt(node);
-//		case NodeType::EMPTY_STMT:
-//			return ConvertEmptyStmt(node);
-//		case NodeType::VAR_DECL:
-//			return ConvertVariableDecl(node);
-//		case NodeType::DECLARATOR_LIST:
-//			return ConvertDeclaratorList(node);
-//		case NodeType::DECLARATOR:
-//			return ConvertDeclarator(node);
-//		case NodeType::IF_STMT:
-//			return ConvertIfStmt(node);
-//		case NodeType::CASE_CLAUSE:
-//			return ConvertCaseClause(node);
-//		case NodeType::WHILE_STMT:
-//			return ConvertWhileStmt(node);
-//		case NodeType::DEFAULT_CLAUSE:
-//			return ConvertDefaultClause(node);
-//		case NodeType::FOR_STMT:
-//			return ConvertForStmt(node);
-//		case NodeType::RETURN_STMT:
-//			return ConvertReturnStmt(node);
-//		case NodeType::BREAK_STMT:
-//			return ConvertBreakStmt(node);
-//		case NodeType::CONTINUE_STMT:
-//			return ConvertContinueStmt(node);
-//		case NodeType::STRUCT_DECL:
-//			return ConvertStructDecl(node);
-//		case NodeType::STRUCT_DECLARATOR_LIST:
-//			return ConvertStructDeclaratorList(node);
-//		case NodeType::STRUCT_MEMBER_DECL:
-//			return ConvertMemberDecl(node);
-//		case NodeType::EXPRESSION:
-//			return ConvertExpression(node);
-//		case NodeType::ASSIGN_EXPR:
-//			return ConvertAssignExpr(node);
-//		case NodeType::CONDITIONAL_EXPR:
-//			return ConvertConditionExpr(node);
-//		case NodeType::BINARY_EXPR:
-//			return ConvertBinaryExpr(node);
-//		case NodeType::UNARY_EXPR:
-//			return ConvertUnaryExpr(node);
-//		case NodeType::POSTFIX_EXPR:
-//			return ConvertPostfixExpr(node);
-//		case NodeType::CALL_EXPR:
-//			return ConvertCallExpr(node);
-//		case NodeType::INDEX_EXPR:
-//			return ConvertIndexExpr(node);
-//		case NodeType::MEMBER_EXPR:
-//			return ConvertMemberExpr(node);
-//		case NodeType::GROUP_EXPR:
-//			return ConvertGroupExpr(node);
-//		case NodeType::INITIALIZER:
-//			return ConvertInitializer(node);
-//		case NodeType::ARGUMENT_LIST:
-//			return ConvertArgumentList(node);
-//		case NodeType::FUNCTION_LITERAL:
-//			return ConvertFunctionLiteral(node);
-//		case NodeType::PRIMARY:
-//			return ConvertPrimary(node);
-//		case NodeType::LITERAL:
-//			return ConvertLiteral(node);
-//		case NodeType::PARAMETER_TYPE_LIST:
-//			return ConvertParameterTypeList(node);
-//		default:
-//			throw std::runtime_error("Unknown AST node type during conversion");
-//		}
-//	}
-//
-//
-//	AstNode* AstConverter::ConvertProgram(AstNode* node) {
-//		auto* cur = new ProgramNode();
-//		for (auto child : node->m_children) {
-//			auto decl = ConvertNode(child);
-//			cur->m_declarations.push_back(decl);
-//		}
-//		m_nodes.push_back(cur);
-//		return cur;
-//	}
-//
-//	AstNode* AstConverter::ConvertImportStmt(AstNode* node) {
-//		assert(node->m_children.size() == 1);
-//		auto* cur = new ImportStmt();
-//		cur->m_moduleName = node->m_token.m_content;
-//		m_nodes.push_back(cur);
-//		return cur;
-//	}
-//
-//	AstNode* AstConverter::ConvertFunctionDecl(AstNode* node) {
-//		assert(node->m_children.size() == 4);
-//		auto* cur = new FunctionDecl();
-//		cur->m_returnType = ConvertType(node->m_children[0]);
-//		cur->m_name = node->m_children[1]->m_token.m_content;
-//		cur->m_parameters = ConvertParameterList(node->m_children[2]);
-//		cur->m_body = dynamic_cast<CompoundStmt*>(ConvertCompoundStmt(node->m_children[3]));
-//		m_nodes.push_back(cur);
-//		return cur;
-//	}
-//
-//	AstNode* AstConverter::ConvertCompoundStmt(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertEmptyStmt(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	Declarator* AstConverter::ConvertDeclarator(AstNode* node) {
-//		auto* cur = new Declarator();
-//		int childNums = node->m_children.size();
-//		assert(childNums >= 1);
-//		cur->m_name = node->m_children[0]->m_token.m_content;
-//		if (childNums > 1) {
-//			cur->m_arrayDimensions = ConvertArraySize(node->m_children[1]);
-//		}
-//		if (childNums > 2) {
-//			cur->m_initializer = dynamic_cast<Expression*>(ConvertNode(node->m_children[2]));
-//		}
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertIfStmt(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertCaseClause(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertWhileStmt(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertDefaultClause(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertForStmt(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertReturnStmt(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertBreakStmt(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertContinueStmt(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertStructDecl(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertStructDeclaratorList(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertMemberDecl(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertExpression(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertAssignExpr(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertConditionExpr(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertBinaryExpr(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertUnaryExpr(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertPostfixExpr(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertCallExpr(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertIndexExpr(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertMemberExpr(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertGroupExpr(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertDesignedInitializer(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertArgumentList(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertFunctionLiteral(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertPrimary(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertLiteral(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//	AstNode* AstConverter::ConvertParameterTypeList(AstNode* node) {
-//		auto* cur = new FunctionDecl();
-//		return cur;
-//	}
-//
-//	std::vector<VariableDecl*> AstConverter::ConvertParameterList(AstNode* node) {
-//		std::vector<VariableDecl*> params;
-//		for (auto paramNode : node->m_children[2]->m_children) {
-//			params.push_back(ConvertParameter(paramNode));
-//		}
-//		return params;
-//	}
-//
-//	VariableDecl* AstConverter::ConvertParameter(AstNode* node) {
-//		auto* cur = new VariableDecl();
-//		assert(node->m_children.size() == 2);
-//		AstNode* typeNode = node->m_children[0];
-//		cur->m_isConst = node->m_token.m_type == TokenType::CONST ? true : false;
-//		cur->m_type = ConvertType(typeNode);
-//		if (node->m_children.size() > 1 && node->m_children[1]->m_type == NodeType::ARRAY_SIZE) {
-//			cur->m_type = m_typeRegistry.GetOrCreateArray(cur->m_type);
-//		}
-//		cur->m_declarators.push_back(ConvertDeclarator(node->m_children[1]));
-//		return cur;
-//	}
-//
-//	AstNode* AstConverter::ConvertInitializer(AstNode* node) {
-//		auto* cur = new InitializerExpr();
-//		for (auto* child : node->m_children) {
-//
-//		}
-//		return cur;
-//	}
-//
-//	TypeInfo* AstConverter::ConvertType(AstNode* node) {
-//		const Token& token = node->m_token;
-//		switch (node->m_type)
-//		{
-//		case NodeType::BUILTIN_TYPE:
-//		{
-//			if (auto optType = m_typeRegistry.Find(token.m_content); optType.has_value()) {
-//				return optType.value();
-//			}
-//			else {
-//				throw SemanticException("Unknown builtin type: " + token.m_content, token.m_column, token.m_line);
-//			}
-//		}
-//		case NodeType::IDENTIFIER:
-//		{
-//			if (auto optType = m_typeRegistry.Find(token.m_content); optType.has_value()) {
-//				return optType.value();
-//			}
-//			else {
-//				return m_typeRegistry.RegisterStruct(token.m_content);
-//			}
-//		}
-//		case NodeType::FUNCTION_TYPE:
-//		{
-//			assert(node->m_children.size() == 2);
-//			std::vector<TypeInfo*> paramTypes;
-//			AstNode* paramListNode = node->m_children[0];
-//			if (paramListNode->m_type == TokenType::IDENTIFIER)
-//			{
-//				// single parameter
-//				paramTypes.push_back(ConvertType(paramListNode));
-//			}
-//			else {
-//				// parameter list
-//				for (auto* paramNode : paramListNode->m_children) {
-//					TypeInfo* paramType = ConvertType(paramNode);
-//					paramTypes.push_back(paramType);
-//				}
-//			}
-//			TypeInfo* returnType = ConvertType(node->m_children[1]);
-//			return m_typeRegistry.GetOrCreateFunction(paramTypes, returnType);
-//		}
-//		default:
-//			throw SemanticException("Convert error: unexpected astnode type " +
-//				NodeTypeToString(node->m_type), token.m_column, token.m_line);
-//		}
-//	}
-//
-//	std::vector<Expression*> AstConverter::ConvertArraySize(AstNode* node) {
-//		std::vector<Expression*> dimens;
-//		for (auto* dim : node->m_children) {
-//			dimens.push_back(dynamic_cast<Expression*>(ConvertNode(dim)));
-//		}
-//		return dimens;
-//	}
-//
-//	SemanticAnalyzer::SemanticAnalyzer(AstNode* astRoot) :m_astRoot(astRoot) {
-//
-//	}
-//
-//	void SemanticAnalyzer::SemanticAnalyze() {
-//
-//	}
-//}
\ No newline at end of file
+#include "SemanticAnalyzer.h"
+#include <algorithm>
+
+using namespace CppInterp;
+
+namespace {
+	// scopes below the first block: natives, then the globals
+	constexpr size_t GlobalDepth = 2;
+	constexpr uint32_t NoVariable = UINT32_MAX;
+
+	std::string Quote(std::string_view text) {
+		return "'" + std::string(text) + "'";
+	}
+
+	std::string Quote(const TypeInfo* type) {
+		return Quote(type->ToString());
+	}
+
+	void SortUses(std::vector<SymbolId>& uses) {
+		std::sort(uses.begin(), uses.end());
+		uses.erase(std::unique(uses.begin(), uses.end()), uses.end());
+	}
+
+	// Many nodes carry no position of their own, errors point at the first node below that has one,
+	// or else at the nearest ancestor with one.
+	std::pair<int, int> SourcePosition(const AstNode& node) {
+		const AstNode* found = nullptr;
+		auto find = [&](auto& self, AstNode* current) -> void {
+			if (found)
+				return;
+			if (current->m_line > 0) {
+				found = current;
+				return;
+			}
+			ForEachChild(*current, [&](AstNode* child) { self(self, child); });
+		};
+		find(find, const_cast<AstNode*>(&node));
+		for (const AstNode* ancestor = node.m_parent; !found && ancestor; ancestor = ancestor->m_parent) {
+			if (ancestor->m_line > 0)
+				found = ancestor;
+		}
+		return found ? std::make_pair(found->m_line, found->m_column) : std::make_pair(0, 0);
+	}
+}
+
+SemanticAnalyzer::SemanticAnalyzer() {
+	DeclareNative("print", TypeKind::VOID, {}, true);
+}
+
+bool SemanticAnalyzer::Analyze(AstNode* root) {
+	return Run(root, nullptr, 1);
+}
+
+bool SemanticAnalyzer::Analyze(AstNode* root, ThreadPool& pool, size_t chunkCount) {
+	return Run(root, &pool, chunkCount);
+}
+
+bool SemanticAnalyzer::Run(AstNode* root, ThreadPool* pool, size_t chunkCount) {
+	m_pool = pool;
+	m_chunkCount = chunkCount;
+	m_root = root;
+	m_uses = nullptr;
+	m_lastChecked = 0;
+	// the previous analysis leaves its natives and globals declared
+	while (m_depth > 0)
+		PopScope();
+	m_types = std::make_shared<TypeTable>();
+	m_diagnostics.clear();
+	m_function = {};
+	m_globalCount = 0;
+	PushScope();
+	for (const Native& native : m_natives) {
+		std::vector<const TypeInfo*> params;
+		for (TypeKind::Type kind : native.m_params)
+			params.push_back(m_types->Builtin(kind));
+		Add(native.m_name, m_types->GetFunction(m_types->Builtin(native.m_return), params, native.m_variadic), true);
+	}
+	if (root)
+		root->Accept(*this);
+	return !HasErrors();
+}
+
+bool SemanticAnalyzer::Reanalyze(AstNode* root, std::span<AstNode* const> changed) {
+	if (!root || root != m_root || root->m_nodeType != NodeType::PROGRAM)
+		return Analyze(root);
+	auto& program = static_cast<ProgramNode&>(*root);
+	const auto& items = program.m_declarations;
+	if (items.size() != m_items.size())
+		return Analyze(root);
+
+	std::vector<bool> edited(items.size()), recheck(items.size());
+	for (AstNode* node : changed) {
+		while (node && node->m_parent != root)
+			node = node->m_parent;
+		auto it = std::find(items.begin(), items.end(), node);
+		// a new struct or global would change what every other item sees
+		if (it == items.end() || node->m_nodeType == NodeType::STRUCT_DECL || node->m_nodeType == NodeType::VAR_DECL)
+			return Analyze(root);
+		edited[it - items.begin()] = true;
+	}
+
+	// Signatures first. A function whose type changed sends its users through the check again,
+	// their signatures too, as an array size may call it. A global or a field whose type calls it
+	// was collected with it, only Analyze redoes that. The new diagnostics are kept by item.
+	std::vector<std::pair<size_t, std::vector<SemanticException>>> signatures, fresh;
+	std::vector<bool> resigned(items.size());
+	std::vector<SymbolId> retyped;
+	auto resign = [&](size_t i) {
+		auto& function = static_cast<FunctionDeclNode&>(*items[i]);
+		ItemRecord& record = m_items[i];
+		resigned[i] = true;
+		record.m_uses.clear();
+		m_uses = &record.m_uses;
+		const size_t first = m_diagnostics.size();
+		const TypeInfo* type = FunctionType(function.m_returnType, function.m_params);
+		signatures.emplace_back(i, TakeDiagnostics(first));
+		m_uses = nullptr;
+		SortUses(record.m_uses);
+		Variable& variable = m_variables[record.m_variable];
+		Bind(*function.m_name, variable);
+		if (type != variable.m_type) {
+			variable.m_type = type;
+			m_functionTypes[record.m_function] = type;
+			retyped.push_back(variable.m_name);
+		}
+	};
+	for (size_t i = 0; i < items.size(); i++) {
+		if (!edited[i])
+			continue;
+		recheck[i] = true;
+		if (items[i]->m_nodeType != NodeType::FUNCTION_DECL)
+			continue;
+		auto& function = static_cast<FunctionDeclNode&>(*items[i]);
+		const ItemRecord& record = m_items[i];
+		if (record.m_variable == NoVariable || m_variables[record.m_variable].m_name != function.m_name->m_symbol)
+			return Analyze(root);
+		resign(i);
+	}
+	while (!retyped.empty()) {
+		const SymbolId name = retyped.back();
+		retyped.pop_back();
+		for (size_t user = 0; user < items.size(); user++) {
+			const ItemRecord& record = m_items[user];
+			if (std::binary_search(record.m_typeUses.begin(), record.m_typeUses.end(), name))
+				return Analyze(root);
+			if (!std::binary_search(record.m_uses.begin(), record.m_uses.end(), name))
+				continue;
+			recheck[user] = true;
+			if (items[user]->m_nodeType == NodeType::FUNCTION_DECL && !resigned[user] && record.m_variable != NoVariable)
+				resign(user);
+		}
+	}
+	std::sort(signatures.begin(), signatures.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+	for (size_t i = 0; i < items.size(); i++) {
+		if (!recheck[i])
+			continue;
+		const size_t first = m_diagnostics.size();
+		CheckItem(items[i], m_items[i]);
+		fresh.emplace_back(i, TakeDiagnostics(first));
+	}
+	m_lastChecked = fresh.size();
+	program.m_frameSize = ProgramFrameSize();
+
+	// splice the new diagnostics in where Analyze reports them, the kept ones are moved over
+	std::vector<SemanticException> merged;
+	merged.reserve(m_diagnostics.size());
+	auto keep = [&](size_t begin, size_t end) {
+		merged.insert(merged.end(), std::make_move_iterator(m_diagnostics.begin() + begin), std::make_move_iterator(m_diagnostics.begin() + end));
+	};
+	auto replace = [&](auto& next) {
+		merged.insert(merged.end(), std::make_move_iterator(next->second.begin()), std::make_move_iterator(next->second.end()));
+		++next;
+	};
+	keep(0, m_structsEnd);
+	size_t begin = m_structsEnd;
+	auto signature = signatures.begin();
+	for (size_t i = 0; i < items.size(); i++) {
+		if (items[i]->m_nodeType != NodeType::FUNCTION_DECL)
+			continue;
+		ItemRecord& record = m_items[i];
+		if (signature != signatures.end() && signature->first == i)
+			replace(signature);
+		else
+			keep(begin, record.m_signatureEnd);
+		begin = record.m_signatureEnd;
+		record.m_signatureEnd = merged.size();
+	}
+	const size_t signaturesEnd = merged.size();
+	keep(m_signaturesEnd, m_collectEnd);
+	begin = m_collectEnd;
+	m_signaturesEnd = signaturesEnd;
+	m_collectEnd = merged.size();
+	auto checked = fresh.begin();
+	for (size_t i = 0; i < items.size(); i++) {
+		ItemRecord& record = m_items[i];
+		if (checked != fresh.end() && checked->first == i)
+			replace(checked);
+		else
+			keep(begin, record.m_diagnosticsEnd);
+		begin = record.m_diagnosticsEnd;
+		record.m_diagnosticsEnd = merged.size();
+	}
+	m_diagnostics = std::move(merged);
+	return !HasErrors();
+}
+
+std::vector<SemanticException> SemanticAnalyzer::TakeDiagnostics(size_t first) {
+	std::vector<SemanticException> taken(m_diagnostics.begin() + first, m_diagnostics.end());
+	m_diagnostics.erase(m_diagnostics.begin() + first, m_diagnostics.end());
+	return taken;
+}
+
+const TypeInfo* SemanticAnalyzer::FindGlobal(std::string_view name) const {
+	SymbolId symbol = SymbolTable::Instance().Find(name);
+	if (symbol == InvalidSymbol)
+		return nullptr;
+	const Variable* variable = Lookup(symbol);
+	return variable && variable->m_binding != BindingKind::LOCAL ? variable->m_type : nullptr;
+}
+
+void SemanticAnalyzer::DeclareNative(std::string_view name, TypeKind::Type returnKind, std::span<const TypeKind::Type> params, bool variadic) {
+	m_natives.push_back({ SymbolTable::Instance().Intern(name), returnKind, { params.begin(), params.end() }, variadic });
+}
+
+// --- declarations ---
+
+void SemanticAnalyzer::Visit(ProgramNode& node) {
+	PushScope();
+	CollectGlobals(node);
+	node.m_globalCount = m_globalCount;
+	CheckItems(node);
+	node.m_frameSize = ProgramFrameSize();
+	m_lastChecked = m_items.size();
+}
+
+void SemanticAnalyzer::CheckItems(ProgramNode& program) {
+	const auto& items = program.m_declarations;
+	if (m_pool) {
+		std::vector<FunctionJob> jobs;
+		for (size_t i = 0; i < items.size(); i++) {
+			if (items[i]->m_nodeType != NodeType::FUNCTION_DECL)
+				continue;
+			auto* function = static_cast<FunctionDeclNode*>(items[i]);
+			if (function->m_body)
+				jobs.push_back({ function, m_functionTypes[m_items[i].m_function], &m_items[i].m_uses });
+		}
+		const size_t runs = std::min(m_chunkCount, jobs.size() / MinParallelFunctions);
+		if (runs >= 2) {
+			CheckItemsParallel(program, jobs, runs);
+			return;
+		}
+	}
+
+	for (size_t i = 0; i < items.size(); i++) {
+		CheckItem(items[i], m_items[i]);
+		m_items[i].m_diagnosticsEnd = m_diagnostics.size();
+	}
+}
+
+void SemanticAnalyzer::CheckItem(AstNode* item, ItemRecord& record) {
+	m_uses = &record.m_uses;
+	switch (item->m_nodeType) {
+	case NodeType::FUNCTION_DECL: {
+		auto& function = static_cast<FunctionDeclNode&>(*item);
+		if (function.m_body)
+			function.m_frameSize = CheckFunction(function.m_params, m_functionTypes[record.m_function], function.m_body, function);
+		break;
+	}
+	case NodeType::STRUCT_DECL:
+		break;
+	default:
+		// statements outside functions share the frame of the program
+		m_nextGlobal = record.m_firstGlobal;
+		m_function.m_frameSize = 0;
+		CheckStatement(item, false);
+		record.m_frameSize = m_function.m_frameSize;
+		break;
+	}
+	m_uses = nullptr;
+	SortUses(record.m_uses);
+}
+
+uint32_t SemanticAnalyzer::ProgramFrameSize() const {
+	uint32_t size = 0;
+	for (const ItemRecord& record : m_items)
+		size = std::max(size, record.m_frameSize);
+	return size;
+}
+
+void SemanticAnalyzer::CheckItemsParallel(ProgramNode& program, const std::vector<FunctionJob>& jobs, size_t runs) {
+	// runs of about as many bodies each, run i checks jobs [bounds[i], bounds[i + 1])
+	std::vector<size_t> bounds(runs + 1);
+	for (size_t i = 0; i <= runs; i++)
+		bounds[i] = jobs.size() * i / runs;
+	auto slice = [&](size_t run) {
+		return std::span<const FunctionJob>(jobs).subspan(bounds[run], bounds[run + 1] - bounds[run]);
+	};
+	while (m_workers.size() < runs)
+		m_workers.push_back(std::make_unique<SemanticAnalyzer>());
+	for (size_t i = 0; i < runs; i++)
+		m_workers[i]->Fork(*this);
+	std::vector<std::future<std::vector<size_t>>> futures;
+	futures.reserve(runs - 1);
+	for (size_t i = 1; i < runs; i++)
+		futures.push_back(m_pool->SubmitTask([worker = m_workers[i].get(), run = slice(i)]() { return worker->CheckFunctions(run); }));
+
+	// the first run and the statements outside functions are checked here, every task is waited
+	// for before anything is thrown, they read the globals
+	const size_t collected = m_diagnostics.size();
+	std::vector<size_t> itemEnds(program.m_declarations.size(), collected);
+	std::vector<std::vector<size_t>> jobEnds(runs);
+	std::exception_ptr failure;
+	auto collect = [&](auto&& check) {
+		try {
+			check();
+		}
+		catch (...) {
+			if (!failure)
+				failure = std::current_exception();
+		}
+	};
+	collect([&] { jobEnds[0] = m_workers[0]->CheckFunctions(slice(0)); });
+	collect([&] {
+		for (size_t i = 0; i < program.m_declarations.size(); i++) {
+			AstNode* item = program.m_declarations[i];
+			if (item->m_nodeType != NodeType::FUNCTION_DECL)
+				CheckItem(item, m_items[i]);
+			itemEnds[i] = m_diagnostics.size();
+		}
+	});
+	for (size_t i = 1; i < runs; i++)
+		collect([&] { jobEnds[i] = futures[i - 1].get(); });
+	if (failure)
+		std::rethrow_exception(failure);
+
+	// merge in source order, as the sequential check reports them
+	std::vector<SemanticException> merged(m_diagnostics.begin(), m_diagnostics.begin() + collected);
+	size_t job = 0, run = 0, previous = collected;
+	for (size_t i = 0; i < program.m_declarations.size(); i++) {
+		if (job < jobs.size() && program.m_declarations[i] == jobs[job].m_function) {
+			while (job >= bounds[run + 1])
+				run++;
+			const size_t local = job - bounds[run];
+			const auto& diagnostics = m_workers[run]->m_diagnostics;
+			merged.insert(merged.end(), diagnostics.begin() + (local ? jobEnds[run][local - 1] : 0), diagnostics.begin() + jobEnds[run][local]);
+			job++;
+		}
+		merged.insert(merged.end(), m_diagnostics.begin() + previous, m_diagnostics.begin() + itemEnds[i]);
+		previous = itemEnds[i];
+		m_items[i].m_diagnosticsEnd = merged.size();
+	}
+	m_diagnostics = std::move(merged);
+}
+
+void SemanticAnalyzer::Fork(const SemanticAnalyzer& from) {
+	m_types = from.m_types;
+	if (m_scopes.size() < GlobalDepth)
+		m_scopes.resize(GlobalDepth);
+	std::copy_n(from.m_scopes.begin(), GlobalDepth, m_scopes.begin());
+	m_depth = GlobalDepth;
+	m_variables = from.m_variables;
+	m_innermost = from.m_innermost;
+	m_globalCount = from.m_globalCount;
+	m_reorderFields = from.m_reorderFields;
+	m_function = {};
+	m_diagnostics.clear();
+	m_uses = nullptr;
+}
+
+std::vector<size_t> SemanticAnalyzer::CheckFunctions(std::span<const FunctionJob> jobs) {
+	std::vector<size_t> ends;
+	ends.reserve(jobs.size());
+	for (const FunctionJob& job : jobs) {
+		FunctionDeclNode& function = *job.m_function;
+		m_uses = job.m_uses;
+		function.m_frameSize = CheckFunction(function.m_params, job.m_type, function.m_body, function);
+		m_uses = nullptr;
+		SortUses(*job.m_uses);
+		ends.push_back(m_diagnostics.size());
+	}
+	return ends;
+}
+
+void SemanticAnalyzer::CollectGlobals(ProgramNode& program) {
+	const auto& items = program.m_declarations;
+	m_functionTypes.clear();
+	m_globalTypes.clear();
+	m_nextGlobal = 0;
+	// the records keep their buffers, every field read later is set below or by the checks
+	m_items.resize(items.size());
+	for (ItemRecord& record : m_items) {
+		record.m_uses.clear();
+		record.m_typeUses.clear();
+		record.m_frameSize = 0;
+	}
+	// struct names first, so signatures, globals and fields can name any of them
+	std::vector<std::pair<size_t, TypeInfo*>> structs;
+	for (size_t i = 0; i < items.size(); i++) {
+		if (items[i]->m_nodeType == NodeType::STRUCT_DECL)
+			structs.emplace_back(i, DeclareStruct(static_cast<StructDeclNode&>(*items[i])));
+	}
+	m_structsEnd = m_diagnostics.size();
+
+	for (size_t i = 0; i < items.size(); i++) {
+		if (items[i]->m_nodeType != NodeType::FUNCTION_DECL)
+			continue;
+		auto& function = static_cast<FunctionDeclNode&>(*items[i]);
+		ItemRecord& record = m_items[i];
+		m_uses = &record.m_uses;
+		const TypeInfo* type = FunctionType(function.m_returnType, function.m_params);
+		record.m_function = static_cast<uint32_t>(m_functionTypes.size());
+		m_functionTypes.push_back(type);
+		const size_t declared = m_variables.size();
+		Declare(*function.m_name, type, true);
+		record.m_variable = m_variables.size() > declared ? static_cast<uint32_t>(declared) : NoVariable;
+		record.m_signatureEnd = m_diagnostics.size();
+	}
+	m_signaturesEnd = m_diagnostics.size();
+
+	for (size_t i = 0; i < items.size(); i++) {
+		if (items[i]->m_nodeType != NodeType::VAR_DECL)
+			continue;
+		auto& decl = static_cast<VariableDeclNode&>(*items[i]);
+		m_uses = &m_items[i].m_typeUses;
+		m_items[i].m_firstGlobal = static_cast<uint32_t>(m_globalTypes.size());
+		const TypeInfo* base = ResolveType(decl.m_type);
+		if (base->Is(TypeKind::VOID))
+			Error("variables cannot have type 'void'", *decl.m_type);
+		for (DeclaratorNode* declarator : decl.m_declarators) {
+			const TypeInfo* type = DeclaredType(base, *declarator, false);
+			m_globalTypes.push_back(type);
+			Declare(*declarator->m_name, type, decl.m_isConst);
+		}
+	}
+
+	for (auto& [item, type] : structs) {
+		m_uses = &m_items[item].m_typeUses;
+		DefineFields(static_cast<StructDeclNode&>(*items[item]), type);
+	}
+	// once every struct has its fields, a struct can be laid out after the ones it holds
+	for (auto& [item, type] : structs)
+		LayOut(type);
+	m_uses = nullptr;
+	for (ItemRecord& record : m_items)
+		SortUses(record.m_typeUses);
+	m_collectEnd = m_diagnostics.size();
+}
+
+TypeInfo* SemanticAnalyzer::DeclareStruct(StructDeclNode& node) {
+	TypeInfo* type = m_types->NewStruct(node.m_name->m_symbol, &node);
+	if (!m_scopes[m_depth - 1].m_structs.try_emplace(node.m_name->m_symbol, type).second)
+		Error("redefinition of struct " + Quote(node.m_name->GetName()), *node.m_name);
+	return type;
+}
+
+void SemanticAnalyzer::DefineFields(StructDeclNode& node, TypeInfo* type) {
+	for (StructMemberNode* member : node.m_members) {
+		const TypeInfo* base = ResolveType(member->m_type);
+		if (base->Is(TypeKind::VOID))
+			Error("struct members cannot have type 'void'", *member->m_type);
+		for (DeclaratorNode* declarator : member->m_declarators) {
+			const TypeInfo* fieldType = DeclaredType(base, *declarator, true);
+			const TypeInfo* element = fieldType;
+			while (element->Is(TypeKind::ARRAY))
+				element = element->m_element;
+			if (declarator->m_initializer)
+				Error("struct members cannot have initializers", *declarator->m_initializer);
+			if (type->FindField(declarator->m_name->m_symbol) >= 0)
+				Error("duplicate member " + Quote(declarator->m_name->GetName()) + " in struct " + Quote(type), *declarator->m_name);
+			else if (element == type)
+				Error("struct " + Quote(type) + " cannot contain itself", *declarator->m_name);
+			else
+				type->m_fields.push_back({ declarator->m_name->m_symbol, fieldType });
+		}
+	}
+}
+
+void SemanticAnalyzer::LayOut(TypeInfo* type) {
+	if (type->m_align != 0)
+		return;
+	m_layingOut.push_back(type);
+	const size_t count = type->m_fields.size();
+	// a field that would hold a struct being laid out takes no space, it was reported
+	std::vector<bool> cyclic(count);
+	for (size_t i = 0; i < count; i++) {
+		const TypeInfo* element = type->m_fields[i].m_type;
+		while (element->Is(TypeKind::ARRAY))
+			element = element->m_element;
+		if (!element->Is(TypeKind::STRUCT))
+			continue;
+		if (std::find(m_layingOut.begin(), m_layingOut.end(), element) == m_layingOut.end()) {
+			// NewStruct hands out struct types mutable, only the fields hold them as const
+			LayOut(const_cast<TypeInfo*>(element));
+			continue;
+		}
+		cyclic[i] = true;
+		const std::string message = "struct " + Quote(type) + " cannot contain itself through " + Quote(element);
+		for (StructMemberNode* member : type->m_decl->m_members) {
+			for (DeclaratorNode* declarator : member->m_declarators) {
+				if (declarator->m_name->m_symbol == type->m_fields[i].m_name)
+					Error(message, *declarator->m_name);
+			}
+		}
+	}
+
+	// by alignment, largest first, leaves padding at most at the end
+	std::vector<uint32_t> order(count);
+	for (uint32_t i = 0; i < count; i++)
+		order[i] = i;
+	if (m_reorderFields) {
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			return type->m_fields[a].m_type->Alignment() > type->m_fields[b].m_type->Alignment();
+		});
+	}
+	uint64_t offset = 0;
+	uint32_t align = 1;
+	for (uint32_t i : order) {
+		StructField& field = type->m_fields[i];
+		if (!cyclic[i]) {
+			const uint32_t fieldAlign = field.m_type->Alignment();
+			offset = (offset + fieldAlign - 1) / fieldAlign * fieldAlign;
+			align = std::max(align, fieldAlign);
+		}
+		field.m_offset = static_cast<uint32_t>(std::min<uint64_t>(offset, UINT32_MAX));
+		// one field past 4 GiB already makes the struct too large, capping it keeps the sum from overflowing
+		if (!cyclic[i])
+			offset += std::min<uint64_t>(field.m_type->Size(), uint64_t(UINT32_MAX) + 1);
+	}
+	uint64_t size = (offset + align - 1) / align * align;
+	if (size > UINT32_MAX) {
+		Error("struct " + Quote(type) + " is too large", *type->m_decl->m_name);
+		size = 0;
+	}
+	type->m_size = static_cast<uint32_t>(size);
+	type->m_align = align;
+	m_layingOut.pop_back();
+}
+
+const TypeInfo* SemanticAnalyzer::FunctionType(TypeNode* returnType, const AstList<ParameterNode*>& params) {
+	const TypeInfo* result = ResolveType(returnType);
+	std::vector<const TypeInfo*> paramTypes;
+	paramTypes.reserve(params.size());
+	for (ParameterNode* param : params) {
+		const TypeInfo* base = ResolveType(param->m_type);
+		if (base->Is(TypeKind::VOID))
+			Error("parameters cannot have type 'void'", *param->m_type);
+		if (param->m_declarator->m_initializer)
+			Error("parameters cannot have default values", *param->m_declarator->m_initializer);
+		paramTypes.push_back(DeclaredType(base, *param->m_declarator, false));
+	}
+	return m_types->GetFunction(result, paramTypes);
+}
+
+uint32_t SemanticAnalyzer::CheckFunction(const AstList<ParameterNode*>& params, const TypeInfo* type, CompoundStmtNode* body, AstNode& at) {
+	FunctionContext saved = m_function;
+	m_function = { type->m_return, 0, 0, saved.m_frame + 1 };
+	// parameters and the outermost block share one scope, the parameters take the first slots
+	PushScope();
+	for (size_t i = 0; i < params.size(); i++)
+		Declare(*params[i]->m_declarator->m_name, type->m_params[i], false);
+	for (AstNode* statement : body->m_statements)
+		CheckStatement(statement, false);
+	PopScope();
+	const uint32_t frameSize = m_function.m_frameSize;
+	m_function = saved;
+
+	const TypeInfo* result = type->m_return;
+	if (!result->Is(TypeKind::VOID) && !result->IsError() && !AlwaysReturns(body)) {
+		if (at.m_nodeType == NodeType::FUNCTION_DECL) {
+			auto& function = static_cast<FunctionDeclNode&>(at);
+			Error("function " + Quote(function.m_name->GetName()) + " does not return a value on every path", *function.m_name);
+		}
+		else {
+			Error("lambda does not return a value on every path", at);
+		}
+	}
+	return frameSize;
+}
+
+const TypeInfo* SemanticAnalyzer::DeclaredType(const TypeInfo* base, DeclaratorNode& declarator, bool constantSizes) {
+	// int a[2][3] holds 2 arrays of 3, so the last size wraps the element first
+	const TypeInfo* type = base;
+	for (auto it = declarator.m_arraySizes.rbegin(); it != declarator.m_arraySizes.rend(); ++it) {
+		ExpressionNode* size = *it;
+		const TypeInfo* sizeType = Check(size);
+		uint32_t length = 0;
+		if (sizeType->IsError()) {
+		}
+		else if (!sizeType->IsIntegral()) {
+			Error("array size must be an integer, not " + Quote(sizeType), *size);
+		}
+		else if (std::optional<int64_t> value = EvaluateConstant(size)) {
+			if (*value <= 0 || *value > UINT32_MAX)
+				Error("array size must be positive, got " + std::to_string(*value), *size);
+			else
+				length = static_cast<uint32_t>(*value);
+		}
+		else if (constantSizes) {
+			Error("array size of a struct member must be a constant", *size);
+		}
+		type = m_types->GetArray(type, length);
+	}
+	return type;
+}
+
+void SemanticAnalyzer::Declare(IdentifierNode& name, const TypeInfo* type, bool isConst) {
+	if (const Variable* variable = Add(name.m_symbol, type, isConst))
+		Bind(name, *variable);
+	else
+		Error("redefinition of " + Quote(name.GetName()), name);
+}
+
+SemanticAnalyzer::Variable* SemanticAnalyzer::Add(SymbolId name, const TypeInfo* type, bool isConst) {
+	if (name >= m_innermost.size())
+		m_innermost.resize(std::max<size_t>(name + 1, SymbolTable::Instance().Size()), NoVariable);
+	const uint32_t shadowed = m_innermost[name];
+	if (shadowed != NoVariable && shadowed >= m_scopes[m_depth - 1].m_firstVariable)
+		return nullptr;
+
+	Variable variable{ name, type, isConst };
+	variable.m_shadowed = shadowed;
+	if (m_depth == 1) {
+		variable.m_binding = BindingKind::NATIVE;
+		variable.m_slot = static_cast<uint32_t>(m_variables.size());
+	}
+	else if (m_depth == GlobalDepth) {
+		variable.m_binding = BindingKind::GLOBAL;
+		variable.m_slot = m_globalCount++;
+	}
+	else {
+		variable.m_binding = BindingKind::LOCAL;
+		variable.m_frame = m_function.m_frame;
+		variable.m_slot = m_function.m_nextSlot++;
+		m_function.m_frameSize = std::max(m_function.m_frameSize, m_function.m_nextSlot);
+	}
+	m_innermost[name] = static_cast<uint32_t>(m_variables.size());
+	return &m_variables.emplace_back(variable);
+}
+
+const SemanticAnalyzer::Variable* SemanticAnalyzer::Lookup(SymbolId name) const {
+	uint32_t index = name < m_innermost.size() ? m_innermost[name] : NoVariable;
+	return index != NoVariable ? &m_variables[index] : nullptr;
+}
+
+void SemanticAnalyzer::Bind(IdentifierNode& node, const Variable& variable) const {
+	node.m_binding = variable.m_binding;
+	node.m_slot = variable.m_slot;
+	// a lambda reaches the locals of the functions around it
+	node.m_depth = variable.m_binding == BindingKind::LOCAL ? static_cast<uint16_t>(m_function.m_frame - variable.m_frame) : 0;
+}
+
+const TypeInfo* SemanticAnalyzer::LookupStruct(SymbolId name) const {
+	for (size_t depth = m_depth; depth-- > 0;) {
+		const auto& structs = m_scopes[depth].m_structs;
+		if (auto it = structs.find(name); it != structs.end())
+			return it->second;
+	}
+	return nullptr;
+}
+
+void SemanticAnalyzer::PushScope() {
+	if (m_depth == m_scopes.size())
+		m_scopes.emplace_back();
+	Scope& scope = m_scopes[m_depth++];
+	scope.m_firstVariable = m_variables.size();
+	scope.m_firstSlot = m_function.m_nextSlot;
+	scope.m_structs.clear();
+}
+
+void SemanticAnalyzer::PopScope() {
+	const Scope& scope = m_scopes[--m_depth];
+	while (m_variables.size() > scope.m_firstVariable) {
+		m_innermost[m_variables.back().m_name] = m_variables.back().m_shadowed;
+		m_variables.pop_back();
+	}
+	m_function.m_nextSlot = scope.m_firstSlot;
+}
+
+void SemanticAnalyzer::Visit(ImportNode&) {
+	// modules are resolved when the program runs
+}
+
+void SemanticAnalyzer::Visit(FunctionDeclNode& node) {
+	// only found at the top level, where Visit(ProgramNode&) checks it with its collected type
+	if (node.m_body)
+		node.m_frameSize = CheckFunction(node.m_params, FunctionType(node.m_returnType, node.m_params), node.m_body, node);
+}
+
+void SemanticAnalyzer::Visit(VariableDeclNode& node) {
+	// CollectGlobals already declared the top-level ones
+	const bool global = m_depth == GlobalDepth;
+	const TypeInfo* base = nullptr;
+	if (!global) {
+		base = ResolveType(node.m_type);
+		if (base->Is(TypeKind::VOID))
+			Error("variables cannot have type 'void'", *node.m_type);
+	}
+	for (DeclaratorNode* declarator : node.m_declarators) {
+		const TypeInfo* type = global ? m_globalTypes[m_nextGlobal++] : DeclaredType(base, *declarator, false);
+		if (declarator->m_initializer)
+			CheckInitializer(type, declarator->m_initializer);
+		else if (node.m_isConst)
+			Error("const " + Quote(declarator->m_name->GetName()) + " needs an initializer", *declarator->m_name);
+		// declared after its initializer, which still sees an outer variable of the same name
+		if (!global)
+			Declare(*declarator->m_name, type, node.m_isConst);
+	}
+}
+
+void SemanticAnalyzer::Visit(StructDeclNode& node) {
+	if (m_depth != GlobalDepth) {
+		TypeInfo* type = DeclareStruct(node);
+		DefineFields(node, type);
+		LayOut(type);
+	}
+}
+
+void SemanticAnalyzer::Visit(ParameterNode&) {
+	// checked by the function that holds it
+}
+
+void SemanticAnalyzer::Visit(DeclaratorNode&) {
+	// checked by the declaration that holds it
+}
+
+void SemanticAnalyzer::Visit(StructMemberNode&) {
+	// checked by the struct that holds it
+}
+
+// --- statements ---
+
+void SemanticAnalyzer::CheckStatement(AstNode* node, bool scoped) {
+	if (!node)
+		return;
+	if (scoped)
+		PushScope();
+	node->Accept(*this);
+	if (scoped)
+		PopScope();
+}
+
+void SemanticAnalyzer::Visit(CompoundStmtNode& node) {
+	PushScope();
+	for (AstNode* statement : node.m_statements)
+		CheckStatement(statement, false);
+	PopScope();
+}
+
+void SemanticAnalyzer::Visit(ExpressionStmtNode& node) {
+	if (node.m_expression)
+		Check(node.m_expression);
+}
+
+void SemanticAnalyzer::Visit(IfStmtNode& node) {
+	CheckCondition(node.m_condition);
+	CheckStatement(node.m_thenStmt, true);
+	CheckStatement(node.m_elseStmt, true);
+}
+
+void SemanticAnalyzer::Visit(SwitchStmtNode& node) {
+	const TypeInfo* type = Check(node.m_condition);
+	if (!type->IsError() && !type->IsIntegral())
+		Error("switch condition must be an integer, not " + Quote(type), *node.m_condition);
+	m_function.m_breakables++;
+	// the cases share one scope, as they are one block
+	PushScope();
+	std::vector<int64_t> seen;
+	for (CaseNode* clause : node.m_cases) {
+		if (LiteralNode* literal = clause->m_literal) {
+			const TypeInfo* value = Check(literal);
+			if (!value->IsIntegral()) {
+				Error("case value must be an integer, not " + Quote(value), *literal);
+			}
+			else if (std::optional<int64_t> constant = EvaluateConstant(literal)) {
+				if (std::find(seen.begin(), seen.end(), *constant) != seen.end())
+					Error("duplicate case value " + std::string(literal->m_value), *literal);
+				seen.push_back(*constant);
+			}
+		}
+		clause->Accept(*this);
+	}
+	if (node.m_default)
+		node.m_default->Accept(*this);
+	PopScope();
+	m_function.m_breakables--;
+}
+
+void SemanticAnalyzer::Visit(CaseNode& node) {
+	for (StatementNode* statement : node.m_statements)
+		CheckStatement(statement, false);
+}
+
+void SemanticAnalyzer::Visit(DefaultNode& node) {
+	for (StatementNode* statement : node.m_statements)
+		CheckStatement(statement, false);
+}
+
+void SemanticAnalyzer::Visit(WhileStmtNode& node) {
+	CheckCondition(node.m_condition);
+	m_function.m_loops++;
+	m_function.m_breakables++;
+	CheckStatement(node.m_body, true);
+	m_function.m_loops--;
+	m_function.m_breakables--;
+}
+
+void SemanticAnalyzer::Visit(ForStmtNode& node) {
+	PushScope();
+	if (node.m_init) {
+		if (node.m_init->m_nodeType == NodeType::VAR_DECL)
+			node.m_init->Accept(*this);
+		else
+			Check(static_cast<ExpressionNode*>(node.m_init));
+	}
+	if (node.m_condition)
+		CheckCondition(node.m_condition);
+	if (node.m_increment)
+		Check(node.m_increment);
+	m_function.m_loops++;
+	m_function.m_breakables++;
+	CheckStatement(node.m_body, true);
+	m_function.m_loops--;
+	m_function.m_breakables--;
+	PopScope();
+}
+
+void SemanticAnalyzer::Visit(ReturnStmtNode& node) {
+	const TypeInfo* value = node.m_expression ? Check(node.m_expression) : nullptr;
+	const TypeInfo* expected = m_function.m_returnType;
+	if (!expected) {
+		Error("return outside a function", node);
+	}
+	else if (expected->Is(TypeKind::VOID)) {
+		if (value && !value->IsError() && !value->Is(TypeKind::VOID))
+			Error("a void function cannot return a value", *node.m_expression);
+	}
+	else if (!value) {
+		if (!expected->IsError())
+			Error("missing return value of type " + Quote(expected), node);
+	}
+	else {
+		CheckAssignable(expected, value, *node.m_expression);
+	}
+}
+
+void SemanticAnalyzer::Visit(BreakStmtNode& node) {
+	if (m_function.m_breakables == 0)
+		Error("break outside a loop or switch", node);
+}
+
+void SemanticAnalyzer::Visit(ContinueStmtNode& node) {
+	if (m_function.m_loops == 0)
+		Error("continue outside a loop", node);
+}
+
+bool SemanticAnalyzer::AlwaysReturns(AstNode* node) {
+	if (!node)
+		return false;
+	switch (node->m_nodeType) {
+	case NodeType::RETURN_STMT:
+		return true;
+	case NodeType::COMPOUND_STMT: {
+		const auto& statements = static_cast<CompoundStmtNode*>(node)->m_statements;
+		return std::any_of(statements.begin(), statements.end(), [](AstNode* statement) { return AlwaysReturns(statement); });
+	}
+	case NodeType::IF_STMT: {
+		auto* stmt = static_cast<IfStmtNode*>(node);
+		return AlwaysReturns(stmt->m_thenStmt) && AlwaysReturns(stmt->m_elseStmt);
+	}
+	default:
+		return false;
+	}
+}
+
+// --- expressions ---
+
+const TypeInfo* SemanticAnalyzer::Check(ExpressionNode* node) {
+	node->Accept(*this);
+	node->m_valueType = m_result;
+	return m_result;
+}
+
+void SemanticAnalyzer::CheckCondition(ExpressionNode* node) {
+	const TypeInfo* type = Check(node);
+	if (!type->IsError() && !type->IsArithmetic())
+		Error("condition must be a bool or a number, not " + Quote(type), *node);
+}
+
+void SemanticAnalyzer::CheckInitializer(const TypeInfo* target, ExpressionNode* value) {
+	if (value->m_nodeType != NodeType::INITIALIZER) {
+		CheckAssignable(target, Check(value), *value);
+		return;
+	}
+	auto& list = static_cast<InitializerNode&>(*value);
+	list.m_valueType = target;
+	const size_t count = list.m_values.size();
+	if (target->Is(TypeKind::ARRAY)) {
+		if (target->m_length && count > target->m_length)
+			Error("too many initializers for " + Quote(target), list);
+		for (ExpressionNode* element : list.m_values)
+			CheckInitializer(target->m_element, element);
+	}
+	else if (target->Is(TypeKind::STRUCT)) {
+		if (count > target->m_fields.size())
+			Error("too many initializers for " + Quote(target), list);
+		for (size_t i = 0; i < count; i++)
+			CheckInitializer(i < target->m_fields.size() ? target->m_fields[i].m_type : Error(), list.m_values[i]);
+	}
+	else {
+		if (!target->IsError())
+			Error("cannot initialize " + Quote(target) + " with an initializer list", list);
+		for (ExpressionNode* element : list.m_values)
+			CheckInitializer(Error(), element);
+	}
+}
+
+bool SemanticAnalyzer::IsAssignable(const TypeInfo* target, const TypeInfo* value) {
+	return target == value || target->IsError() || value->IsError() ||
+		(target->IsArithmetic() && value->IsArithmetic()) ||
+		(value->Is(TypeKind::NULL_TYPE) && target->IsNullable());
+}
+
+void SemanticAnalyzer::CheckAssignable(const TypeInfo* target, const TypeInfo* value, AstNode& at) {
+	if (!IsAssignable(target, value))
+		Error("cannot convert " + Quote(value) + " to " + Quote(target), at);
+}
+
+void SemanticAnalyzer::CheckModifiable(ExpressionNode* node) {
+	switch (node->m_nodeType) {
+	case NodeType::IDENTIFIER: {
+		auto* name = static_cast<IdentifierNode*>(node);
+		const Variable* variable = Lookup(name->m_symbol);
+		if (variable && variable->m_isConst)
+			Error("cannot assign to constant " + Quote(name->GetName()), *node);
+		break;
+	}
+	case NodeType::ARRAY_INDEX:
+		CheckModifiable(static_cast<ArrayIndexNode*>(node)->m_array);
+		break;
+	case NodeType::MEMBER_ACCESS:
+		CheckModifiable(static_cast<MemberAccessNode*>(node)->m_object);
+		break;
+	default:
+		if (!node->m_valueType->IsError())
+			Error("expression is not assignable", *node);
+		break;
+	}
+}
+
+const TypeInfo* SemanticAnalyzer::Arithmetic(const TypeInfo* left, const TypeInfo* right) const {
+	bool isDouble = left->Is(TypeKind::DOUBLE) || right->Is(TypeKind::DOUBLE);
+	return m_types->Builtin(isDouble ? TypeKind::DOUBLE : TypeKind::INT);
+}
+
+std::optional<int64_t> SemanticAnalyzer::EvaluateConstant(ExpressionNode* node) {
+	switch (node->m_nodeType) {
+	case NodeType::LITERAL: {
+		auto* literal = static_cast<LiteralNode*>(node);
+		switch (literal->m_literalType) {
+		case TokenType::INT_LITERAL: return literal->m_literal.m_int;
+		case TokenType::CHARACTER_LITERAL: return literal->m_literal.m_char;
+		case TokenType::BOOL_LITERAL: return literal->m_literal.m_bool;
+		default: return std::nullopt;
+		}
+	}
+	case NodeType::UNARY_EXPR: {
+		auto* unary = static_cast<UnaryExprNode*>(node);
+		std::optional<int64_t> operand = EvaluateConstant(unary->m_operand);
+		if (!operand)
+			return std::nullopt;
+		// wrap around like the machine does instead of overflowing
+		uint64_t value = static_cast<uint64_t>(*operand);
+		switch (unary->m_op) {
+		case OpCode::PLUS: return *operand;
+		case OpCode::NEGATE: return static_cast<int64_t>(0 - value);
+		case OpCode::BIT_NOT: return static_cast<int64_t>(~value);
+		case OpCode::LOGICAL_NOT: return *operand == 0;
+		default: return std::nullopt;
+		}
+	}
+	case NodeType::BINARY_EXPR: {
+		auto* binary = static_cast<BinaryExprNode*>(node);
+		std::optional<int64_t> left = EvaluateConstant(binary->m_left);
+		std::optional<int64_t> right = left ? EvaluateConstant(binary->m_right) : std::nullopt;
+		if (!right)
+			return std::nullopt;
+		int64_t a = *left, b = *right;
+		uint64_t ua = static_cast<uint64_t>(a), ub = static_cast<uint64_t>(b);
+		switch (binary->m_op) {
+		case OpCode::ADD: return static_cast<int64_t>(ua + ub);
+		case OpCode::SUBTRACT: return static_cast<int64_t>(ua - ub);
+		case OpCode::MULTIPLY: return static_cast<int64_t>(ua * ub);
+		case OpCode::DIVIDE: return b == 0 || (a == INT64_MIN && b == -1) ? std::nullopt : std::optional<int64_t>(a / b);
+		case OpCode::MODULO: return b == 0 || (a == INT64_MIN && b == -1) ? std::nullopt : std::optional<int64_t>(a % b);
+		case OpCode::LEFT_SHIFT: return b < 0 || b > 63 ? std::nullopt : std::optional<int64_t>(static_cast<int64_t>(ua << b));
+		case OpCode::RIGHT_SHIFT: return b < 0 || b > 63 ? std::nullopt : std::optional<int64_t>(a >> b);
+		case OpCode::BIT_AND: return a & b;
+		case OpCode::BIT_OR: return a | b;
+		case OpCode::BIT_XOR: return a ^ b;
+		case OpCode::LOGICAL_AND: return a && b;
+		case OpCode::LOGICAL_OR: return a || b;
+		case OpCode::EQUAL: return a == b;
+		case OpCode::NOT_EQUAL: return a != b;
+		case OpCode::LESS: return a < b;
+		case OpCode::GREATER: return a > b;
+		case OpCode::LESS_EQUAL: return a <= b;
+		case OpCode::GREATER_EQUAL: return a >= b;
+		default: return std::nullopt;
+		}
+	}
+	case NodeType::COND_EXPR: {
+		auto* conditional = static_cast<ConditionalExprNode*>(node);
+		std::optional<int64_t> condition = EvaluateConstant(conditional->m_condition);
+		if (!condition)
+			return std::nullopt;
+		return EvaluateConstant(*condition ? conditional->m_trueExpr : conditional->m_falseExpr);
+	}
+	default:
+		return std::nullopt;
+	}
+}
+
+void SemanticAnalyzer::Visit(CommaExprNode& node) {
+	const TypeInfo* type = Error();
+	for (ExpressionNode* expression : node.m_expressions)
+		type = Check(expression);
+	m_result = type;
+}
+
+void SemanticAnalyzer::Visit(AssignmentExprNode& node) {
+	const TypeInfo* target = Check(node.m_left);
+	const TypeInfo* value = Check(node.m_right);
+	CheckModifiable(node.m_left);
+	m_result = target;
+	if (target->IsError() || value->IsError())
+		return;
+	switch (node.m_op) {
+	case OpCode::ASSIGN:
+		CheckAssignable(target, value, *node.m_right);
+		return;
+	case OpCode::ADD_ASSIGN:
+		if (target->Is(TypeKind::STRING) && (value->Is(TypeKind::STRING) || value->Is(TypeKind::CHAR)))
+			return;
+		[[fallthrough]];
+	case OpCode::SUB_ASSIGN:
+	case OpCode::MUL_ASSIGN:
+	case OpCode::DIV_ASSIGN:
+		if (target->IsArithmetic() && value->IsArithmetic())
+			return;
+		break;
+	case OpCode::MOD_ASSIGN:
+		if (target->IsIntegral() && value->IsIntegral())
+			return;
+		break;
+	default:
+		break;
+	}
+	Error("invalid operands " + Quote(target) + " and " + Quote(value) + " to " + Quote(OpCode::GetName(node.m_op)), node);
+}
+
+void SemanticAnalyzer::Visit(ConditionalExprNode& node) {
+	CheckCondition(node.m_condition);
+	const TypeInfo* left = Check(node.m_trueExpr);
+	const TypeInfo* right = Check(node.m_falseExpr);
+	if (left->IsError() || right->IsError())
+		m_result = Error();
+	else if (left == right)
+		m_result = left;
+	else if (left->IsArithmetic() && right->IsArithmetic())
+		m_result = Arithmetic(left, right);
+	else if (left->Is(TypeKind::NULL_TYPE) && right->IsNullable())
+		m_result = right;
+	else if (right->Is(TypeKind::NULL_TYPE) && left->IsNullable())
+		m_result = left;
+	else {
+		Error("operands of '?:' have different types " + Quote(left) + " and " + Quote(right), node);
+		m_result = Error();
+	}
+}
+
+void SemanticAnalyzer::Visit(BinaryExprNode& node) {
+	const TypeInfo* left = Check(node.m_left);
+	const TypeInfo* right = Check(node.m_right);
+	m_result = Error();
+	if (left->IsError() || right->IsError())
+		return;
+	const bool arithmetic = left->IsArithmetic() && right->IsArithmetic();
+	const bool integral = left->IsIntegral() && right->IsIntegral();
+	switch (node.m_op) {
+	case OpCode::ADD:
+		if ((left->Is(TypeKind::STRING) && (right->Is(TypeKind::STRING) || right->Is(TypeKind::CHAR))) ||
+			(left->Is(TypeKind::CHAR) && right->Is(TypeKind::STRING))) {
+			m_result = m_types->Builtin(TypeKind::STRING);
+			return;
+		}
+		[[fallthrough]];
+	case OpCode::SUBTRACT:
+	case OpCode::MULTIPLY:
+	case OpCode::DIVIDE:
+		if (arithmetic)
+			m_result = Arithmetic(left, right);
+		break;
+	case OpCode::MODULO:
+	case OpCode::BIT_AND:
+	case OpCode::BIT_OR:
+	case OpCode::BIT_XOR:
+	case OpCode::LEFT_SHIFT:
+	case OpCode::RIGHT_SHIFT:
+		if (integral)
+			m_result = m_types->Builtin(TypeKind::INT);
+		break;
+	case OpCode::LESS:
+	case OpCode::GREATER:
+	case OpCode::LESS_EQUAL:
+	case OpCode::GREATER_EQUAL:
+		if (arithmetic || (left->Is(TypeKind::STRING) && right->Is(TypeKind::STRING)))
+			m_result = m_types->Builtin(TypeKind::BOOL);
+		break;
+	case OpCode::EQUAL:
+	case OpCode::NOT_EQUAL:
+		if (left == right || arithmetic || (left->Is(TypeKind::NULL_TYPE) && right->IsNullable()) ||
+			(right->Is(TypeKind::NULL_TYPE) && left->IsNullable()))
+			m_result = m_types->Builtin(TypeKind::BOOL);
+		break;
+	case OpCode::LOGICAL_AND:
+	case OpCode::LOGICAL_OR:
+		if (arithmetic)
+			m_result = m_types->Builtin(TypeKind::BOOL);
+		break;
+	default:
+		break;
+	}
+	if (m_result->IsError())
+		Error("invalid operands " + Quote(left) + " and " + Quote(right) + " to " + Quote(OpCode::GetName(node.m_op)), node);
+}
+
+void SemanticAnalyzer::Visit(UnaryExprNode& node) {
+	const TypeInfo* operand = Check(node.m_operand);
+	m_result = Error();
+	if (operand->IsError())
+		return;
+	switch (node.m_op) {
+	case OpCode::PLUS:
+	case OpCode::NEGATE:
+		if (operand->IsArithmetic())
+			m_result = Arithmetic(operand, operand);
+		break;
+	case OpCode::LOGICAL_NOT:
+		if (operand->IsArithmetic())
+			m_result = m_types->Builtin(TypeKind::BOOL);
+		break;
+	case OpCode::BIT_NOT:
+		if (operand->IsIntegral())
+			m_result = m_types->Builtin(TypeKind::INT);
+		break;
+	case OpCode::ADD_ASSIGN:
+	case OpCode::SUB_ASSIGN:
+		// prefix increment and decrement
+		if (operand->IsArithmetic()) {
+			CheckModifiable(node.m_operand);
+			m_result = operand;
+		}
+		break;
+	default:
+		break;
+	}
+	if (m_result->IsError())
+		Error("invalid operand " + Quote(operand) + " to " + Quote(OpCode::GetName(node.m_op)), node);
+}
+
+void SemanticAnalyzer::Visit(PostfixExprNode& node) {
+	const TypeInfo* operand = Check(node.m_primary);
+	m_result = operand;
+	if (operand->IsError())
+		return;
+	if (!operand->IsArithmetic()) {
+		Error("invalid operand " + Quote(operand) + " to " + Quote(OpCode::GetName(node.m_op)), node);
+		m_result = Error();
+		return;
+	}
+	CheckModifiable(node.m_primary);
+}
+
+void SemanticAnalyzer::Visit(FunctionCallNode& node) {
+	const TypeInfo* callee = Check(node.m_callee);
+	const size_t count = node.m_arguments.size();
+	if (!callee->Is(TypeKind::FUNCTION)) {
+		if (!callee->IsError())
+			Error(Quote(callee) + " is not a function", *node.m_callee);
+		for (ExpressionNode* argument : node.m_arguments)
+			CheckInitializer(Error(), argument);
+		m_result = Error();
+		return;
+	}
+	const auto& params = callee->m_params;
+	if (count < params.size() || (count > params.size() && !callee->m_variadic)) {
+		Error("wrong number of arguments, expected " + std::to_string(params.size()) + " and got " + std::to_string(count), node);
+	}
+	for (size_t i = 0; i < count; i++) {
+		ExpressionNode* argument = node.m_arguments[i];
+		if (i < params.size())
+			CheckInitializer(params[i], argument);
+		else if (callee->m_variadic)
+			Check(argument);
+		else
+			CheckInitializer(Error(), argument);
+	}
+	m_result = callee->m_return;
+}
+
+void SemanticAnalyzer::Visit(ArrayIndexNode& node) {
+	const TypeInfo* array = Check(node.m_array);
+	const TypeInfo* index = Check(node.m_index);
+	if (!index->IsError() && !index->IsIntegral())
+		Error("array index must be an integer, not " + Quote(index), *node.m_index);
+	if (array->Is(TypeKind::ARRAY)) {
+		m_result = array->m_element;
+	}
+	else if (array->Is(TypeKind::STRING)) {
+		m_result = m_types->Builtin(TypeKind::CHAR);
+	}
+	else {
+		if (!array->IsError())
+			Error("cannot index " + Quote(array), node);
+		m_result = Error();
+	}
+}
+
+void SemanticAnalyzer::Visit(MemberAccessNode& node) {
+	const TypeInfo* object = Check(node.m_object);
+	m_result = Error();
+	if (object->IsError()) {
+	}
+	else if (!object->Is(TypeKind::STRUCT)) {
+		Error("member access on " + Quote(object) + ", which is not a struct", *node.m_memberName);
+	}
+	else if (int field = object->FindField(node.m_memberName->m_symbol); field < 0) {
+		Error(Quote(object) + " has no member " + Quote(node.m_memberName->GetName()), *node.m_memberName);
+	}
+	else {
+		m_result = object->m_fields[field].m_type;
+		node.m_offset = object->m_fields[field].m_offset;
+	}
+	node.m_memberName->m_valueType = m_result;
+}
+
+void SemanticAnalyzer::Visit(FunctionLiteralNode& node) {
+	const TypeInfo* type = FunctionType(node.m_returnType, node.m_params);
+	if (node.m_body)
+		node.m_frameSize = CheckFunction(node.m_params, type, node.m_body, node);
+	m_result = type;
+}
+
+void SemanticAnalyzer::Visit(IdentifierNode& node) {
+	if (const Variable* variable = Lookup(node.m_symbol)) {
+		Bind(node, *variable);
+		if (m_uses && variable->m_binding == BindingKind::GLOBAL)
+			m_uses->push_back(node.m_symbol);
+		m_result = variable->m_type;
+		return;
+	}
+	node.m_binding = BindingKind::UNRESOLVED;
+	Error("use of undeclared identifier " + Quote(node.GetName()), node);
+	m_result = Error();
+}
+
+void SemanticAnalyzer::Visit(LiteralNode& node) {
+	TypeKind::Type kind = TypeKind::ERROR;
+	switch (node.m_literalType) {
+	case TokenType::INT_LITERAL: kind = TypeKind::INT; break;
+	case TokenType::DOUBLE_LITERAL: kind = TypeKind::DOUBLE; break;
+	case TokenType::CHARACTER_LITERAL: kind = TypeKind::CHAR; break;
+	case TokenType::STRING_LITERAL: kind = TypeKind::STRING; break;
+	case TokenType::BOOL_LITERAL: kind = TypeKind::BOOL; break;
+	case TokenType::NULL_LITERAL: kind = TypeKind::NULL_TYPE; break;
+	default: break;
+	}
+	m_result = m_types->Builtin(kind);
+}
+
+void SemanticAnalyzer::Visit(InitializerNode& node) {
+	// CheckInitializer takes the lists it expects
+	Error("an initializer list needs an array or struct to initialize", node);
+	for (ExpressionNode* value : node.m_values)
+		CheckInitializer(Error(), value);
+	m_result = Error();
+}
+
+// --- types ---
+
+void SemanticAnalyzer::Visit(BuiltinTypeNode& node) {
+	const TypeInfo* type = m_types->FindBuiltin(node.m_name);
+	m_result = type ? type : Error();
+}
+
+void SemanticAnalyzer::Visit(NamedTypeNode& node) {
+	if (const TypeInfo* type = LookupStruct(node.m_symbol)) {
+		if (m_uses)
+			m_uses->push_back(node.m_symbol);
+		m_result = type;
+		return;
+	}
+	Error("unknown type " + Quote(node.GetName()), node);
+	m_result = Error();
+}
+
+void SemanticAnalyzer::Visit(FunctionTypeNode& node) {
+	std::vector<const TypeInfo*> params;
+	params.reserve(node.m_paramTypes.size());
+	for (TypeNode* param : node.m_paramTypes)
+		params.push_back(ResolveType(param));
+	const TypeInfo* result = ResolveType(node.m_returnType);
+	m_result = m_types->GetFunction(result, params);
+}
+
+void SemanticAnalyzer::Error(const std::string& message, const AstNode& at) {
+	auto [line, column] = SourcePosition(at);
+	m_diagnostics.emplace_back(message, line, column);
+}
@@ -0,0 +1,42 @@
+#include "SymbolTable.h"
+#include <stdexcept>
+
+namespace CppInterp {
+
+	SymbolId SymbolTable::Intern(std::string_view name) {
+		{
+			std::shared_lock<std::shared_mutex> lock(m_mutex);
+			if (auto it = m_ids.find(name); it != m_ids.end())
+				return it->second;
+		}
+		std::unique_lock<std::shared_mutex> lock(m_mutex);
+		return InternLocked(name);
+	}
+
+	SymbolId SymbolTable::Find(std::string_view name) const {
+		std::shared_lock<std::shared_mutex> lock(m_mutex);
+		auto it = m_ids.find(name);
+		return it == m_ids.end() ? InvalidSymbol : it->second;
+	}
+
+	size_t SymbolTable::Size() const {
+		std::shared_lock<std::shared_mutex> lock(m_mutex);
+		return m_size;
+	}
+
+	SymbolId SymbolTable::InternLocked(std::string_view name) {
+		if (auto it = m_ids.find(name); it != m_ids.end())
+			return it->second;
+		if (m_size == InvalidSymbol)
+			throw std::length_error("SymbolTable: too many symbols");
+		SymbolId id = m_size;
+		auto [block, index] = Locate(id);
+		if (!m_nameBlocks[block])
+			m_nameBlocks[block] = std::make_unique<std::string_view[]>(size_t(FirstBlockSize) << block);
+		std::string_view stored = m_texts.Store(name);
+		m_nameBlocks[block][index] = stored;
+		m_ids.emplace(stored, id);
+		m_size++;
+		return id;
+	}
+}
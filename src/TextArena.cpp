@@ -0,0 +1,54 @@
+#include "TextArena.h"
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+
+namespace CppInterp {
+
+	std::string_view TextArena::Store(std::string_view text) {
+		if (m_blocks.empty() || m_blocks.back().m_capacity - m_used < text.size()) {
+			size_t capacity = std::max(BlockSize, text.size());
+			m_blocks.push_back(Block{ std::make_unique<char[]>(capacity), capacity });
+			m_used = 0;
+		}
+		char* dest = m_blocks.back().m_data.get() + m_used;
+		std::memcpy(dest, text.data(), text.size());
+		m_used += text.size();
+		return std::string_view(dest, text.size());
+	}
+
+	bool TextArena::Owns(const char* ptr) const {
+		return std::any_of(m_blocks.begin(), m_blocks.end(), [ptr](const Block& block) {
+			return ptr >= block.m_data.get() && ptr < block.m_data.get() + block.m_capacity;
+			});
+	}
+
+	size_t TextArena::Capacity() const {
+		size_t capacity = 0;
+		for (const Block& block : m_blocks)
+			capacity += block.m_capacity;
+		return capacity;
+	}
+
+	void TextArena::Adopt(TextArena&& other) {
+		if (other.m_blocks.empty())
+			return;
+		if (m_blocks.empty()) {
+			m_blocks = std::move(other.m_blocks);
+			m_used = other.m_used;
+		}
+		else {
+			// keep filling our current block, the adopted ones go in front of it
+			m_blocks.insert(m_blocks.end() - 1,
+				std::make_move_iterator(other.m_blocks.begin()), std::make_move_iterator(other.m_blocks.end()));
+		}
+		other.m_blocks.clear();
+		other.m_used = 0;
+	}
+
+	void TextArena::Reset() {
+		if (m_blocks.size() > 1)
+			m_blocks.erase(m_blocks.begin() + 1, m_blocks.end());
+		m_used = 0;
+	}
+}
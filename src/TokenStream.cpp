@@ -0,0 +1,98 @@
+#include "TokenStream.h"
+#include <stdexcept>
+#include <cerrno>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace CppInterp {
+
+	TokenStream::TokenStream(std::istream& input, size_t chunkSize)
+		:m_chunk(std::make_unique<char[]>(chunkSize)), m_chunkSize(chunkSize) {
+		m_read = [&input](char* buffer, size_t capacity) {
+			input.read(buffer, static_cast<std::streamsize>(capacity));
+			return static_cast<size_t>(input.gcount());
+			};
+	}
+
+	TokenStream::TokenStream(int fd, size_t chunkSize)
+		:m_chunk(std::make_unique<char[]>(chunkSize)), m_chunkSize(chunkSize) {
+		m_read = [fd](char* buffer, size_t capacity) {
+			while (true) {
+#ifdef _WIN32
+				int count = _read(fd, buffer, static_cast<unsigned int>(capacity));
+#else
+				ssize_t count = ::read(fd, buffer, capacity);
+#endif
+				if (count >= 0)
+					return static_cast<size_t>(count);
+				if (errno != EINTR)
+					throw std::runtime_error("TokenStream: failed to read from file descriptor " + std::to_string(fd));
+			}
+			};
+	}
+
+	TokenStream::TokenStream(std::string_view buffer, size_t chunkSize)
+		:m_chunkSize(chunkSize), m_buffer(buffer) {
+	}
+
+	bool TokenStream::Next(Token& token) {
+		if (!Fill())
+			return false;
+		token = MakeToken(m_next++);
+		return true;
+	}
+
+	const Token* TokenStream::Peek() {
+		if (!Fill())
+			return nullptr;
+		m_peeked = MakeToken(m_next);
+		return &m_peeked;
+	}
+
+	bool TokenStream::Fill() {
+		while (m_next >= m_tokens.size()) {
+			if (m_inputEnd)
+				return false;
+			// tokens already returned view interned text, so the previous chunk can go,
+			// except the line index where a token spanning chunks began
+			m_tokens.Reset(m_context.m_pending ? m_context.m_tokenOffset : UINT32_MAX);
+			m_next = 0;
+			std::string_view chunk;
+			if (m_read) {
+				size_t count = m_read(m_chunk.get(), m_chunkSize);
+				chunk = std::string_view(m_chunk.get(), count);
+				m_inputEnd = count == 0;
+			}
+			else {
+				chunk = m_buffer.substr(m_bufferOffset, m_chunkSize);
+				m_bufferOffset += chunk.size();
+				m_inputEnd = m_bufferOffset >= m_buffer.size();
+			}
+			Lexer::Instance().TokenizeChunk(m_context, chunk, m_inputEnd, m_tokens);
+		}
+		return true;
+	}
+
+	Token TokenStream::MakeToken(size_t index) {
+		Token token = m_tokens[index];
+		// identifiers view the symbol table and a memory buffer outlives the stream, other text
+		// read from input or stored in the chunk's list needs a copy
+		if (token.m_symbol == InvalidSymbol && (m_read || m_tokens.OwnsLiteral(token.m_content))) {
+			token.m_content = Intern(token.m_content);
+			if (token.m_type == TokenType::STRING_LITERAL)
+				token.m_literal.m_string = token.m_content.substr(1, token.m_content.size() - 2);
+		}
+		return token;
+	}
+
+	std::string_view TokenStream::Intern(std::string_view text) {
+		if (auto it = m_internedTexts.find(text); it != m_internedTexts.end())
+			return *it;
+		std::string_view stored = m_texts.Store(text);
+		m_internedTexts.insert(stored);
+		return stored;
+	}
+}
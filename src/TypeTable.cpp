@@ -0,0 +1,176 @@
+#include "TypeTable.h"
+#include <algorithm>
+
+namespace CppInterp {
+
+	int TypeInfo::FindField(SymbolId name) const {
+		for (size_t i = 0; i < m_fields.size(); i++) {
+			if (m_fields[i].m_name == name)
+				return static_cast<int>(i);
+		}
+		return -1;
+	}
+
+	namespace {
+		constexpr uint32_t HandleSize = 8;
+	}
+
+	uint64_t TypeInfo::Size() const {
+		switch (m_kind) {
+		case TypeKind::BOOL:
+		case TypeKind::CHAR: return 1;
+		case TypeKind::INT:
+		case TypeKind::DOUBLE: return 8;
+		case TypeKind::STRING:
+		case TypeKind::NULL_TYPE:
+		case TypeKind::FUNCTION: return HandleSize;
+		case TypeKind::ARRAY: {
+			if (!m_length)
+				return HandleSize;
+			// saturates, so nested arrays too large for memory stay too large
+			uint64_t element = m_element->Size();
+			return element > UINT64_MAX / m_length ? UINT64_MAX : element * m_length;
+		}
+		case TypeKind::STRUCT: return m_size;
+		default: return 0;
+		}
+	}
+
+	uint32_t TypeInfo::Alignment() const {
+		switch (m_kind) {
+		case TypeKind::ARRAY: return m_length ? m_element->Alignment() : HandleSize;
+		case TypeKind::STRUCT: return std::max<uint32_t>(m_align, 1);
+		default: return static_cast<uint32_t>(std::clamp<uint64_t>(Size(), 1, HandleSize));
+		}
+	}
+
+	std::string TypeInfo::ToString() const {
+		switch (m_kind) {
+		case TypeKind::ERROR: return "<error>";
+		case TypeKind::VOID: return "void";
+		case TypeKind::BOOL: return "bool";
+		case TypeKind::CHAR: return "char";
+		case TypeKind::INT: return "int";
+		case TypeKind::DOUBLE: return "double";
+		case TypeKind::STRING: return "string";
+		case TypeKind::NULL_TYPE: return "NULL";
+		case TypeKind::STRUCT: return std::string(SymbolTable::Instance().GetName(m_name));
+		case TypeKind::ARRAY: {
+			// int a[2][3] is an array of 2 arrays of 3 ints
+			std::string dims;
+			const TypeInfo* type = this;
+			for (; type->m_kind == TypeKind::ARRAY; type = type->m_element)
+				dims += type->m_length ? "[" + std::to_string(type->m_length) + "]" : "[]";
+			return type->ToString() + dims;
+		}
+		case TypeKind::FUNCTION: {
+			std::string text = "(";
+			for (size_t i = 0; i < m_params.size(); i++)
+				text += (i ? ", " : "") + m_params[i]->ToString();
+			if (m_variadic)
+				text += m_params.empty() ? "..." : ", ...";
+			return text + ") -> " + m_return->ToString();
+		}
+		default: return "<unknown>";
+		}
+	}
+
+	bool TypeTable::Key::operator==(const Key& other) const {
+		return m_kind == other.m_kind && m_inner == other.m_inner && m_extra == other.m_extra &&
+			std::ranges::equal(m_params, other.m_params);
+	}
+
+	size_t TypeTable::KeyHash::operator()(const Key& key) const {
+		uint64_t hash = key.m_kind;
+		auto mix = [&](uint64_t value) { hash = (hash ^ value) * 0x9E3779B97F4A7C15ull; };
+		mix(key.m_inner->m_id);
+		mix(key.m_extra);
+		for (const TypeInfo* param : key.m_params)
+			mix(param->m_id);
+		return static_cast<size_t>(hash ^ (hash >> 32));
+	}
+
+	TypeTable::TypeTable() {
+		for (TypeKind::Type kind = 0; kind < TypeKind::BuiltinCount; kind++) {
+			TypeInfo type;
+			type.m_kind = kind;
+			m_builtins[kind] = Add(std::move(type));
+		}
+	}
+
+	const TypeInfo* TypeTable::FindBuiltin(std::string_view name) const {
+		TypeKind::Type kind = TypeKind::ERROR;
+		if (name == "int") kind = TypeKind::INT;
+		else if (name == "double") kind = TypeKind::DOUBLE;
+		else if (name == "char") kind = TypeKind::CHAR;
+		else if (name == "string") kind = TypeKind::STRING;
+		else if (name == "bool") kind = TypeKind::BOOL;
+		else if (name == "void") kind = TypeKind::VOID;
+		return kind == TypeKind::ERROR ? nullptr : m_builtins[kind];
+	}
+
+	const TypeInfo* TypeTable::GetArray(const TypeInfo* element, uint32_t length) {
+		Key key{ TypeKind::ARRAY, element, length, {} };
+		if (const TypeInfo* found = Find(key))
+			return found;
+		TypeInfo type;
+		type.m_kind = TypeKind::ARRAY;
+		type.m_element = element;
+		type.m_length = length;
+		return Intern(key, std::move(type));
+	}
+
+	const TypeInfo* TypeTable::GetFunction(const TypeInfo* returnType, std::span<const TypeInfo* const> params, bool variadic) {
+		Key key{ TypeKind::FUNCTION, returnType, variadic, params };
+		if (const TypeInfo* found = Find(key))
+			return found;
+		TypeInfo type;
+		type.m_kind = TypeKind::FUNCTION;
+		type.m_variadic = variadic;
+		type.m_return = returnType;
+		type.m_params.assign(params.begin(), params.end());
+		return Intern(key, std::move(type));
+	}
+
+	TypeInfo* TypeTable::NewStruct(SymbolId name, const StructDeclNode* decl) {
+		TypeInfo type;
+		type.m_kind = TypeKind::STRUCT;
+		type.m_name = name;
+		type.m_decl = decl;
+		std::unique_lock lock(m_mutex);
+		return Add(std::move(type));
+	}
+
+	const TypeInfo* TypeTable::Get(TypeId id) const {
+		std::shared_lock lock(m_mutex);
+		return &m_types[id];
+	}
+
+	size_t TypeTable::Size() const {
+		std::shared_lock lock(m_mutex);
+		return m_types.size();
+	}
+
+	const TypeInfo* TypeTable::Find(const Key& key) const {
+		std::shared_lock lock(m_mutex);
+		auto it = m_interned.find(key);
+		return it != m_interned.end() ? it->second : nullptr;
+	}
+
+	TypeInfo* TypeTable::Add(TypeInfo&& type) {
+		type.m_id = static_cast<TypeId>(m_types.size());
+		return &m_types.emplace_back(std::move(type));
+	}
+
+	const TypeInfo* TypeTable::Intern(const Key& key, TypeInfo&& type) {
+		std::unique_lock lock(m_mutex);
+		// another thread may have added it since Find
+		if (auto it = m_interned.find(key); it != m_interned.end())
+			return it->second;
+		TypeInfo* stored = Add(std::move(type));
+		Key storedKey = key;
+		storedKey.m_params = stored->m_params;
+		m_interned.emplace(storedKey, stored);
+		return stored;
+	}
+}
@@ -2,9 +2,40 @@
 //
 
 #include <iostream>
+#include <optional>
+#include <string>
+#include "Parser.h"
+#include "AstCache.h"
 
-int main()
+using namespace CppInterp;
+
+int main(int argc, char* argv[])
 {
-	std::cout << "Hello CMake." << std::endl;
+	// --cache <directory> keeps parsed trees between runs
+	std::optional<AstCache> cache;
+	if (argc == 4 && std::string(argv[2]) == "--cache")
+		cache.emplace(argv[3]);
+	if (argc < 2 || (argc != 2 && !cache)) {
+		std::cerr << "usage: CppInterp <source file> [--cache <directory>]" << std::endl;
+		return 1;
+	}
+	Parser parser;
+	parser.SetErrorRecovery(true);
+	try {
+		AstNode* root = cache ? parser.ParseFile(argv[1], *cache) : parser.ParseFile(argv[1]);
+		for (const ParserException& error : parser.GetDiagnostics())
+			std::cerr << argv[1] << ": " << error.what() << std::endl;
+		if (parser.HasErrors())
+			return 1;
+		AstPrinter::PrintAstTree(root);
+	}
+	catch (const LangException& e) {
+		std::cerr << argv[1] << ": " << e.what() << std::endl;
+		return 1;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
 	return 0;
 }